@@ -0,0 +1,77 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "AllocationCounter.h"
+
+#ifdef _DEBUG
+
+#include <crtdbg.h>
+#include <stdio.h>
+
+// Heap allocations made by the current thread since it started
+static thread_local UINT64 ThreadAllocations = 0;
+
+//
+// Called by the debug CRT on every heap operation. Must not allocate.
+//
+static int __cdecl AllocHook(int AllocType, void*, size_t, int BlockType, long, const unsigned char*, int)
+{
+    // The CRT's own bookkeeping is not ours to account for
+    if (BlockType != _CRT_BLOCK && (AllocType == _HOOK_ALLOC || AllocType == _HOOK_REALLOC))
+    {
+        ThreadAllocations++;
+    }
+
+    return TRUE;
+}
+
+void InstallAllocationHook()
+{
+    _CrtSetAllocHook(AllocHook);
+}
+
+ALLOCATIONCOUNTER::ALLOCATIONCOUNTER(_In_ LPCWSTR Name) : m_Name(Name),
+                                                          m_Frames(0),
+                                                          m_FrameStart(0)
+{
+}
+
+void ALLOCATIONCOUNTER::BeginFrame()
+{
+    m_FrameStart = ThreadAllocations;
+}
+
+//
+// Assert if the frame that just completed allocated after warm-up
+//
+void ALLOCATIONCOUNTER::EndFrame()
+{
+    UINT64 Count = ThreadAllocations - m_FrameStart;
+    if (m_Frames < ALLOCATION_WARMUP_FRAMES)
+    {
+        m_Frames++;
+        return;
+    }
+
+    if (Count)
+    {
+        wchar_t Msg[128];
+        swprintf_s(Msg, L"%s: %llu heap allocations in a steady state frame\n", m_Name, Count);
+        OutputDebugStringW(Msg);
+    }
+    _ASSERTE(Count == 0);
+}
+
+//
+// Start warming up again, e.g. after the pipeline was rebuilt
+//
+void ALLOCATIONCOUNTER::Restart()
+{
+    m_Frames = 0;
+}
+
+#endif
@@ -0,0 +1,58 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _ALLOCATIONCOUNTER_H_
+#define _ALLOCATIONCOUNTER_H_
+
+#include <windows.h>
+
+// Frames a loop may allocate in while its arenas and buffers size themselves
+#define ALLOCATION_WARMUP_FRAMES 120
+
+#ifdef _DEBUG
+
+//
+// Install the CRT allocation hook that counts heap allocations per thread. Call once at startup.
+//
+void InstallAllocationHook();
+
+//
+// Checks that a frame loop does not allocate from the CRT heap once warmed up.
+// Allocations made by the system (DXGI, WinRT) go to their own heaps and are not counted.
+//
+class ALLOCATIONCOUNTER
+{
+    public:
+        ALLOCATIONCOUNTER(_In_ LPCWSTR Name);
+        void BeginFrame();
+        void EndFrame();
+        void Restart();
+
+    private:
+        LPCWSTR m_Name;
+        UINT m_Frames;
+        UINT64 m_FrameStart;
+};
+
+#else
+
+// Release builds do not count anything
+
+inline void InstallAllocationHook() {}
+
+class ALLOCATIONCOUNTER
+{
+    public:
+        ALLOCATIONCOUNTER(_In_ LPCWSTR) {}
+        void BeginFrame() {}
+        void EndFrame() {}
+        void Restart() {}
+};
+
+#endif
+
+#endif
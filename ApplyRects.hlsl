@@ -0,0 +1,62 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+//----------------------------------------------------------------------
+
+// Must match APPLY_TILE_SIZE in RectApply.h
+#define APPLY_TILE_SIZE 32
+#define APPLY_ROWS_PER_THREAD 4
+
+// Must match APPLY_RECT and APPLY_TILE in RectApply.h
+struct APPLY_RECT
+{
+    int4 Dest;
+    int2 AxisX;
+    int2 AxisY;
+    int2 Offset;
+    uint Source;
+    uint Padding;
+};
+
+struct APPLY_TILE
+{
+    uint2 Origin;
+    uint First;
+    uint Count;
+};
+
+Texture2D<float4> Frame : register( t0 );
+Texture2D<float4> Moved : register( t1 );
+StructuredBuffer<APPLY_RECT> Rects : register( t2 );
+StructuredBuffer<APPLY_TILE> Tiles : register( t3 );
+StructuredBuffer<uint> TileRects : register( t4 );
+RWTexture2D<float4> Target : register( u0 );
+
+//--------------------------------------------------------------------------------------
+// Compute Shader: one group per tile some rect touches, each thread walks APPLY_ROWS_PER_THREAD rows of
+// one column. A pixel takes the last rect of the tile covering it, moves come before dirty rects.
+//--------------------------------------------------------------------------------------
+[numthreads(APPLY_TILE_SIZE, APPLY_TILE_SIZE / APPLY_ROWS_PER_THREAD, 1)]
+void CS_ApplyRects(uint3 GroupId : SV_GroupID, uint3 ThreadId : SV_GroupThreadID)
+{
+    APPLY_TILE Tile = Tiles[GroupId.x];
+
+    for (uint Row = 0; Row < APPLY_ROWS_PER_THREAD; ++Row)
+    {
+        int2 Pos = int2(Tile.Origin) + int2(ThreadId.x, ThreadId.y + Row * (APPLY_TILE_SIZE / APPLY_ROWS_PER_THREAD));
+
+        for (uint i = Tile.Count; i > 0; --i)
+        {
+            APPLY_RECT Rect = Rects[TileRects[Tile.First + i - 1]];
+            if (all(Pos >= Rect.Dest.xy) && all(Pos < Rect.Dest.zw))
+            {
+                int2 Src = Rect.AxisX * Pos.x + Rect.AxisY * Pos.y + Rect.Offset;
+                Target[Pos] = Rect.Source ? Frame.Load(int3(Src, 0)) : Moved.Load(int3(Src, 0));
+                break;
+            }
+        }
+    }
+}
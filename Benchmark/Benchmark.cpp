@@ -0,0 +1,3131 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+//
+// Headless benchmark of the frame pipeline. Synthetic workloads produce the move and dirty rects
+// DXGI would report for common desktop activity, and every frame goes through the software backend:
+// move apply, dirty apply, copy of the damaged regions to the scanout image and pointer compose.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "Foveation.h"
+#include "FrameGovernor.h"
+#include "Scaling.h"
+#include "CompressionPool.h"
+#include "EdidParser.h"
+#include "FrameProfiler.h"
+#include "FrameRecorder.h"
+#include "HmdProfile.h"
+#include "PointerPredictor.h"
+#include "PointerSource.h"
+#include "RectApply.h"
+#include "RectTransform.h"
+#include "RefreshPolicy.h"
+#include "SoftwareCompositor.h"
+#include "StreamClient.h"
+#include "StreamSink.h"
+#include "TileDetector.h"
+#ifdef HAVE_X11_CAPTURE
+#include "X11DuplicationManager.h"
+#endif
+
+//
+// Every heap allocation made by the process goes through here so we can report allocations per frame
+//
+static std::atomic<uint64_t> AllocationCount(0);
+
+static void* CountedAlloc(size_t Size)
+{
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc(Size ? Size : 1);
+}
+
+void* operator new(size_t Size)
+{
+    void* Ptr = CountedAlloc(Size);
+    if (!Ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return Ptr;
+}
+
+void* operator new[](size_t Size)
+{
+    return operator new(Size);
+}
+
+void* operator new(size_t Size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(Size);
+}
+
+void* operator new[](size_t Size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(Size);
+}
+
+void operator delete(void* Ptr) noexcept
+{
+    free(Ptr);
+}
+
+void operator delete[](void* Ptr) noexcept
+{
+    free(Ptr);
+}
+
+void operator delete(void* Ptr, size_t) noexcept
+{
+    free(Ptr);
+}
+
+void operator delete[](void* Ptr, size_t) noexcept
+{
+    free(Ptr);
+}
+
+void operator delete(void* Ptr, const std::nothrow_t&) noexcept
+{
+    free(Ptr);
+}
+
+void operator delete[](void* Ptr, const std::nothrow_t&) noexcept
+{
+    free(Ptr);
+}
+
+//
+// Metadata for one synthetic frame, laid out like the move rects followed by the dirty rects of a real frame
+//
+#define MAX_MOVE_RECTS  8
+#define MAX_DIRTY_RECTS 32
+
+typedef struct _FRAME_METADATA
+{
+    DXGI_OUTDUPL_MOVE_RECT Moves[MAX_MOVE_RECTS];
+    UINT MoveCount;
+    RECT Dirties[MAX_DIRTY_RECTS];
+    UINT DirtyCount;
+    POINT Pointer;
+} FRAME_METADATA;
+
+typedef void (*GENERATE_FRAME)(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta);
+
+// Changes the pixels of the duplicated frame, for workloads where the reported rects are not the whole story
+typedef void (*TOUCH_FRAME)(UINT Frame, SOFTWARE_SURFACE* Surface);
+
+typedef struct _WORKLOAD
+{
+    const char* Name;
+    GENERATE_FRAME Generate;
+    TOUCH_FRAME Touch;
+    UINT PointerType;
+} WORKLOAD;
+
+static void SetBenchRect(RECT* Rect, LONG Left, LONG Top, LONG Right, LONG Bottom)
+{
+    Rect->left = Left;
+    Rect->top = Top;
+    Rect->right = Right;
+    Rect->bottom = Bottom;
+}
+
+static void AddDirty(FRAME_METADATA* Meta, LONG Left, LONG Top, LONG Right, LONG Bottom)
+{
+    if (Meta->DirtyCount < MAX_DIRTY_RECTS && Right > Left && Bottom > Top)
+    {
+        SetBenchRect(&Meta->Dirties[Meta->DirtyCount++], Left, Top, Right, Bottom);
+    }
+}
+
+static void AddMove(FRAME_METADATA* Meta, LONG SourceX, LONG SourceY, LONG Left, LONG Top, LONG Right, LONG Bottom)
+{
+    if (Meta->MoveCount < MAX_MOVE_RECTS)
+    {
+        DXGI_OUTDUPL_MOVE_RECT* Move = &Meta->Moves[Meta->MoveCount++];
+        Move->SourcePoint.x = SourceX;
+        Move->SourcePoint.y = SourceY;
+        SetBenchRect(&Move->DestinationRect, Left, Top, Right, Bottom);
+    }
+}
+
+//
+// Pointer drifting around the middle of the screen
+//
+static void MovePointer(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    Meta->Pointer.x = Width / 2 + static_cast<LONG>((Frame * 7) % 400) - 200;
+    Meta->Pointer.y = Height / 2 + static_cast<LONG>((Frame * 3) % 200) - 100;
+}
+
+//
+// Typing: a glyph and the caret change every frame
+//
+static void GenerateTyping(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    LONG Column = Frame % 80;
+    LONG Line = (Frame / 80) % 30;
+    LONG X = 100 + Column * 10;
+    LONG Y = 200 + Line * 20;
+
+    AddDirty(Meta, X, Y, X + 10, Y + 18);
+    AddDirty(Meta, X + 10, Y, X + 12, Y + 18);
+
+    // The pointer does not move while typing
+    Meta->Pointer.x = Width / 3;
+    Meta->Pointer.y = Height / 3;
+}
+
+//
+// Scrolling: the content moves up and a strip of new content appears at the bottom
+//
+static void GenerateScrolling(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    const LONG Step = 40;
+    AddMove(Meta, 0, Step, 0, 0, Width, Height - Step);
+    AddDirty(Meta, 0, Height - Step, Width, Height);
+    MovePointer(Frame, Width, Height, Meta);
+}
+
+//
+// Video: one fixed region redrawn every frame, as with 60 fps playback on a 60 Hz desktop
+//
+static void GenerateVideo(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    AddDirty(Meta, Width / 6, Height / 6, Width - Width / 6, Height - Height / 6);
+    MovePointer(Frame, Width, Height, Meta);
+}
+
+//
+// Window drag: the window and its shadow move by a few pixels so source and destination overlap,
+// and the uncovered background is redrawn
+//
+static void GenerateWindowDrag(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    const LONG WindowWidth = 800;
+    const LONG WindowHeight = 600;
+    const LONG Shadow = 16;
+
+    LONG RangeX = Width - WindowWidth - Shadow;
+    LONG RangeY = Height - WindowHeight - Shadow;
+    if (RangeX <= 8 || RangeY <= 4)
+    {
+        GenerateVideo(Frame, Width, Height, Meta);
+        return;
+    }
+
+    LONG OldX = (Frame * 8) % RangeX;
+    LONG OldY = (Frame * 4) % RangeY;
+    LONG NewX = ((Frame + 1) * 8) % RangeX;
+    LONG NewY = ((Frame + 1) * 4) % RangeY;
+
+    AddMove(Meta, OldX, OldY, NewX, NewY, NewX + WindowWidth, NewY + WindowHeight);
+    AddMove(Meta, OldX + WindowWidth, OldY + Shadow, NewX + WindowWidth, NewY + Shadow, NewX + WindowWidth + Shadow, NewY + WindowHeight + Shadow);
+
+    // Background that the window no longer covers
+    if (NewX >= OldX)
+    {
+        AddDirty(Meta, OldX, OldY, NewX, OldY + WindowHeight + Shadow);
+    }
+    else
+    {
+        AddDirty(Meta, NewX + WindowWidth + Shadow, OldY, OldX + WindowWidth + Shadow, OldY + WindowHeight + Shadow);
+    }
+    if (NewY >= OldY)
+    {
+        AddDirty(Meta, OldX, OldY, OldX + WindowWidth + Shadow, NewY);
+    }
+    else
+    {
+        AddDirty(Meta, OldX, NewY + WindowHeight + Shadow, OldX + WindowWidth + Shadow, OldY + WindowHeight + Shadow);
+    }
+
+    // The pointer drags the title bar
+    Meta->Pointer.x = NewX + 100;
+    Meta->Pointer.y = NewY + 10;
+}
+
+//
+// Full redraw: the whole output is dirty
+//
+static void GenerateFullRedraw(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    AddDirty(Meta, 0, 0, Width, Height);
+    MovePointer(Frame, Width, Height, Meta);
+}
+
+//
+// Pointer: only the pointer moves, the desktop under it stays the same
+//
+static void GeneratePointer(UINT Frame, INT Width, INT Height, FRAME_METADATA* Meta)
+{
+    MovePointer(Frame, Width, Height, Meta);
+}
+
+//
+// Change one pixel in each tile of a region, enough for the change detector to see it
+//
+static void TouchRegion(UINT Frame, SOFTWARE_SURFACE* Surface, UINT Left, UINT Top, UINT Right, UINT Bottom)
+{
+    Right = (Right < Surface->Width) ? Right : Surface->Width;
+    Bottom = (Bottom < Surface->Height) ? Bottom : Surface->Height;
+    for (UINT Y = Top; Y < Bottom; Y += TILE_SIZE)
+    {
+        UINT* Row = reinterpret_cast<UINT*>(Surface->Bits + static_cast<size_t>(Y) * Surface->Pitch);
+        for (UINT X = Left; X < Right; X += TILE_SIZE)
+        {
+            Row[X] = 0xFF000000 | (Frame * 2654435761u);
+        }
+    }
+}
+
+static void TouchAll(UINT Frame, SOFTWARE_SURFACE* Surface)
+{
+    TouchRegion(Frame, Surface, 0, 0, Surface->Width, Surface->Height);
+}
+
+//
+// Full report: DXGI says the whole output is dirty but only a small video player really changes,
+// as some drivers and remote sessions do
+//
+static void TouchPlayer(UINT Frame, SOFTWARE_SURFACE* Surface)
+{
+    TouchRegion(Frame, Surface, Surface->Width / 4, Surface->Height / 4, Surface->Width / 4 + 640, Surface->Height / 4 + 360);
+}
+
+static const WORKLOAD Workloads[] = {
+    {"typing",      GenerateTyping,     nullptr,        DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME},
+    {"scrolling",   GenerateScrolling,  nullptr,        DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR},
+    {"video",       GenerateVideo,      nullptr,        DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR},
+    {"windowdrag",  GenerateWindowDrag, nullptr,        DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR},
+    {"fullredraw",  GenerateFullRedraw, TouchAll,       DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR},
+    {"fullreport",  GenerateFullRedraw, TouchPlayer,    DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR},
+    {"pointer",     GeneratePointer,    nullptr,        DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR},
+};
+
+//
+// Pointer shapes, like the ones DXGI returns
+//
+#define POINTER_SIZE 32
+
+typedef struct _POINTER_SHAPE
+{
+    DXGI_OUTDUPL_POINTER_SHAPE_INFO Info;
+    BYTE Buffer[POINTER_SIZE * POINTER_SIZE * SOFTWARE_BPP];
+} POINTER_SHAPE;
+
+static void MakePointerShape(UINT Type, POINTER_SHAPE* Shape)
+{
+    memset(Shape, 0, sizeof(POINTER_SHAPE));
+    Shape->Info.Type = Type;
+    Shape->Info.Width = POINTER_SIZE;
+
+    if (Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME)
+    {
+        // AND mask followed by XOR mask, one bit per pixel. An I-beam: AND clears a 2 pixel column, XOR inverts it.
+        Shape->Info.Height = POINTER_SIZE * 2;
+        Shape->Info.Pitch = POINTER_SIZE / 8;
+        memset(Shape->Buffer, 0xFF, Shape->Info.Pitch * POINTER_SIZE);
+        for (UINT Row = 2; Row < POINTER_SIZE - 2; ++Row)
+        {
+            Shape->Buffer[Row * Shape->Info.Pitch + 2] = 0xE7;
+            Shape->Buffer[(Row + POINTER_SIZE) * Shape->Info.Pitch + 2] = 0x18;
+        }
+        return;
+    }
+
+    Shape->Info.Height = POINTER_SIZE;
+    Shape->Info.Pitch = POINTER_SIZE * SOFTWARE_BPP;
+    UINT* Pixels = reinterpret_cast<UINT*>(Shape->Buffer);
+    for (UINT Row = 0; Row < POINTER_SIZE; ++Row)
+    {
+        for (UINT Col = 0; Col < POINTER_SIZE; ++Col)
+        {
+            // Arrow-ish triangle with a soft edge
+            bool Inside = Col <= Row;
+            UINT Alpha = Inside ? ((Col + 2 >= Row) ? 0x80 : 0xFF) : 0x00;
+            if (Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR)
+            {
+                // Mask set means XOR with the desktop
+                Alpha = (Inside && Col + 2 >= Row) ? 0xFF : 0x00;
+            }
+            Pixels[Row * POINTER_SIZE + Col] = (Alpha << 24) | (Inside ? 0x00FFFFFF : 0);
+        }
+    }
+}
+
+typedef struct _BENCHMARK_OPTIONS
+{
+    UINT Frames;
+    UINT WarmupFrames;
+    INT Width;
+    INT Height;
+    DXGI_MODE_ROTATION Rotation;
+    const char* Workload;
+    bool TileDetection;
+
+    // Recompose the whole view every frame like the headset path, optionally foveated with this downscale
+    bool Warp;
+    UINT FoveationScale;
+
+    // Mip levels of the desktop image rebuilt under the damage, 1 for none
+    UINT MipLevels;
+
+    // Stream the composed view to a loopback client, with raw or LZ4 tiles, optionally checking every frame
+    bool Stream;
+    TILE_CODEC StreamCodec;
+    bool StreamVerify;
+
+    // Tiles compressed by a pool of this many workers, 0 for on the frame loop. Without a client the stream
+    // goes nowhere, which measures the compression alone.
+    UINT Workers;
+    bool StreamClient;
+
+    // Stream to the client over a localhost TCP connection on this port instead of the loopback ring, 0 for none
+    UINT StreamPort;
+
+    // Run the compression alone at 1 to 16 workers
+    bool Scaling;
+
+    // Record the composed view of each workload to a frame log named after this prefix, then seek around in it
+    const char* RecordPrefix;
+
+    // Measure the pointer predictors on a trace written with /pointertrace, or "synthetic" for a generated one
+    const char* PointerTrace;
+
+    // Play a generated pointer trace through a pointer stream in real time and predict from it as the presenter does
+    bool PointerSource;
+
+    // Time the dirty rect to vertex transform against the per rect one it replaced
+    bool Transform;
+
+    // Check the tiled rect apply engine against applying moves and dirty rects one at a time
+    bool Apply;
+
+    // Check that changes cancelling out in plain sums of pixels still change the tile hashes
+    bool TileHash;
+
+    // Compare uploading dirty rects as expanded vertices against instanced rects on each workload's frames
+    bool Instanced;
+
+    // Replay a timing trace of one "cpu_ns gpu_ns" line per frame through the frame governor, or "synthetic"
+    const char* GovernorTrace;
+
+    // Play desktop scenarios through the refresh policy and compare against a fixed refresh rate
+    bool Refresh;
+
+    // Check the EDID parser and mode policies against the blobs in this directory
+    const char* EdidDir;
+
+    // Capture frames from this X server through the software backend instead of running the workloads
+    const char* X11Display;
+
+    // Run the workloads through modeled GPU timestamps onto a profiling timeline, check it and export it here
+    const char* ProfilePath;
+} BENCHMARK_OPTIONS;
+
+typedef struct _BENCHMARK_RESULT
+{
+    double FramesPerSecond;
+    double NsPerRect;
+    double BytesPerFrame;
+    double AllocationsPerFrame;
+
+    // Streaming, the client side covers the warmup frames too
+    double WireBytesPerFrame;
+    double CompressionRatio;
+    double RawMBPerSecond;
+    uint64_t FramesHeld;
+    double LatencyUs;
+    double MaxLatencyUs;
+    uint64_t FramesCorrupt;
+    bool ClientFailed;
+
+    // Recording, and seeking the log back afterwards
+    uint64_t FramesRecorded;
+    uint64_t FramesDropped;
+    uint64_t Keyframes;
+    double LogBytesPerFrame;
+    double SeekUs;
+    bool ReplayFailed;
+} BENCHMARK_RESULT;
+
+//
+// Channel that takes everything and keeps nothing, so the sink never waits for a client
+//
+class DISCARDCHANNEL : public STREAMCHANNEL
+{
+    public:
+        bool Send(const BYTE*, UINT) override { return true; }
+        STREAM_RECEIVE Receive(BYTE*, UINT, UINT*, UINT) override { return STREAM_RECEIVE_CLOSED; }
+        UINT GetQueuedMessages() override { return 0; }
+        UINT GetQueuedBytes() override { return 0; }
+        UINT GetMaxMessageSize() override { return UINT32_MAX; }
+        void Close() override {}
+};
+
+// Frames are recorded at a steady 60 Hz, so the keyframes land at the same frames every run
+#define RECORD_FRAME_NS 16666667ull
+
+// Seeks timed on the log after a recorded run
+#define RECORD_SEEKS 32
+
+static uint64_t NowNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//
+// Box filter a damaged desktop region down the mip chain, each level from the one above it
+//
+static void UpdateMips(SOFTWARECOMPOSITOR* Compositor, SOFTWARE_SURFACE** Mips, UINT MipCount, const RECT* Rect)
+{
+    for (UINT Level = 1; Level < MipCount; ++Level)
+    {
+        RECT Aligned;
+        if (!AlignToScale(Rect, 1u << Level, Mips[0]->Width, Mips[0]->Height, &Aligned))
+        {
+            return;
+        }
+
+        RECT Source = {Aligned.left >> (Level - 1), Aligned.top >> (Level - 1), Aligned.right >> (Level - 1), Aligned.bottom >> (Level - 1)};
+        Compositor->DownsampleRect(Mips[Level - 1], &Source, 2, Mips[Level]);
+    }
+}
+
+//
+// Run one workload through the pipeline
+//
+static bool RunWorkload(const WORKLOAD* Workload, const BENCHMARK_OPTIONS* Options, BENCHMARK_RESULT* Result)
+{
+    memset(Result, 0, sizeof(BENCHMARK_RESULT));
+
+    bool Rotated = (Options->Rotation == DXGI_MODE_ROTATION_ROTATE90 || Options->Rotation == DXGI_MODE_ROTATION_ROTATE270);
+
+    // The duplicated frame is in the output's native orientation, the desktop image in desktop orientation
+    INT TexWidth = Rotated ? Options->Height : Options->Width;
+    INT TexHeight = Rotated ? Options->Width : Options->Height;
+
+    SOFTWARECOMPOSITOR Compositor;
+    if (!Compositor.Initialize(Options->Width, Options->Height))
+    {
+        return false;
+    }
+
+    SOFTWARECOMPOSITOR FrameHolder;
+    SOFTWARECOMPOSITOR ScanoutHolder;
+    if (!FrameHolder.Initialize(TexWidth, TexHeight) || !ScanoutHolder.Initialize(Options->Width, Options->Height))
+    {
+        return false;
+    }
+    SOFTWARE_SURFACE* Frame = FrameHolder.GetDesktop();
+    SOFTWARE_SURFACE* Scanout = ScanoutHolder.GetDesktop();
+
+    // Mip levels below the desktop image, like the presenter's copy of the desktop
+    FOVEATION_OPTIONS Foveation;
+    Foveation.Mode = Options->FoveationScale ? FOVEATION_CENTER : FOVEATION_OFF;
+    Foveation.Scale = Options->FoveationScale;
+    Foveation.FoveaPercent = FOVEATION_DEFAULT_PERCENT;
+    UINT WantedLevels = Options->MipLevels;
+    if (Options->FoveationScale && WantedLevels < GetFoveationLevel(&Foveation) + 1)
+    {
+        WantedLevels = GetFoveationLevel(&Foveation) + 1;
+    }
+    UINT MipCount = GetMipCount(Options->Width, Options->Height, WantedLevels);
+
+    SOFTWARECOMPOSITOR MipHolders[MIP_MAX_LEVELS];
+    SOFTWARE_SURFACE* Mips[MIP_MAX_LEVELS] = {Compositor.GetDesktop()};
+    for (UINT Level = 1; Level < MipCount; ++Level)
+    {
+        if (!MipHolders[Level].Initialize(Options->Width >> Level, Options->Height >> Level))
+        {
+            return false;
+        }
+        Mips[Level] = MipHolders[Level].GetDesktop();
+    }
+
+    // The sharp region when foveated stays at the center of the view
+    RECT Fovea = {0, 0, 0, 0};
+    if (Options->FoveationScale)
+    {
+        GetFoveaRect(&Foveation, Options->Width, Options->Height, POINT{0, 0}, &Fovea);
+    }
+
+    // Something other than zeros so the pointer blend does real work
+    for (INT Y = 0; Y < TexHeight; ++Y)
+    {
+        UINT* Row = reinterpret_cast<UINT*>(Frame->Bits + static_cast<size_t>(Y) * Frame->Pitch);
+        for (INT X = 0; X < TexWidth; ++X)
+        {
+            Row[X] = 0xFF000000 | ((X * 2654435761u) ^ (Y * 40503u));
+        }
+    }
+
+    POINTER_SHAPE Shape;
+    MakePointerShape(Workload->PointerType, &Shape);
+
+    TILEDETECTOR Detector;
+    if (Options->TileDetection && !Detector.Initialize(TexWidth, TexHeight))
+    {
+        return false;
+    }
+
+    // The sink takes the composed view, the client decodes it on its own thread like it would on the headset
+    LZ4TILECODEC SinkCodec;
+    LZ4TILECODEC ClientCodec;
+    COMPRESSIONPOOL Pool;
+    LOOPBACKCHANNEL Channel;
+    SOCKETCHANNEL SinkSocket;
+    SOCKETCHANNEL ClientSocket;
+    DISCARDCHANNEL Discard;
+    STREAMSINK Sink;
+    STREAMCLIENT Client;
+    std::thread ClientThread;
+    bool ClientFailed = false;
+    if (Options->Stream)
+    {
+        bool Lz4 = (Options->StreamCodec == TILE_CODEC_LZ4);
+        STREAM_OPTIONS StreamOptions = {STREAM_DEFAULT_QUEUED_FRAMES, STREAM_DEFAULT_QUEUED_BYTES, Options->StreamVerify};
+        UINT FrameBytes = Options->Width * Options->Height * SOFTWARE_BPP;
+        if (Options->Workers && !Pool.Initialize(Options->Workers, Options->StreamCodec, Options->Width, Options->Height, 2))
+        {
+            return false;
+        }
+        STREAMCHANNEL* SinkChannel = &Discard;
+        if (Options->StreamClient && Options->StreamPort)
+        {
+            // The sink only sends once the client is connected, so wait for the sender thread to accept it
+            uint16_t Port = static_cast<uint16_t>(Options->StreamPort);
+            if (!SinkSocket.Listen(Port, STREAM_DEFAULT_QUEUED_BYTES + 3 * FrameBytes) || !ClientSocket.Connect("127.0.0.1", Port) ||
+                !Client.Initialize(Lz4 ? &ClientCodec : nullptr, &ClientSocket))
+            {
+                return false;
+            }
+            while (!SinkSocket.IsConnected())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            SinkChannel = &SinkSocket;
+        }
+        else if (Options->StreamClient)
+        {
+            if (!Channel.Initialize(STREAM_DEFAULT_QUEUED_BYTES + 3 * FrameBytes) || !Client.Initialize(Lz4 ? &ClientCodec : nullptr, &Channel))
+            {
+                return false;
+            }
+            SinkChannel = &Channel;
+        }
+        if (!Sink.Initialize(Options->Width, Options->Height, Lz4 ? &SinkCodec : nullptr, Options->Workers ? &Pool : nullptr, SinkChannel, &StreamOptions))
+        {
+            return false;
+        }
+
+        if (Options->StreamClient)
+        {
+            ClientThread = std::thread([&Client, &ClientFailed]
+            {
+                STREAM_RECEIVE Ret;
+                do
+                {
+                    Ret = Client.ReceiveFrame(100);
+                } while (Ret == STREAM_RECEIVE_MESSAGE || Ret == STREAM_RECEIVE_TIMEOUT);
+                ClientFailed = (Ret == STREAM_RECEIVE_ERROR);
+            });
+        }
+    }
+
+    FRAMERECORDER Recorder;
+    char RecordPath[512];
+    if (Options->RecordPrefix)
+    {
+        snprintf(RecordPath, sizeof(RecordPath), "%s-%s.ddlog", Options->RecordPrefix, Workload->Name);
+        if (!Recorder.Initialize(RecordPath, Options->Width, Options->Height))
+        {
+            return false;
+        }
+    }
+
+    FRAME_METADATA Meta;
+    RECT MoveDest[MAX_MOVE_RECTS];
+    RECT DirtyDest[MAX_DIRTY_RECTS];
+    RECT LastPointer = {0, 0, 0, 0};
+    uint64_t RectCount = 0;
+    uint64_t Allocations = 0;
+
+    auto Start = std::chrono::steady_clock::now();
+    for (UINT FrameIndex = 0; FrameIndex < Options->WarmupFrames + Options->Frames; ++FrameIndex)
+    {
+        if (FrameIndex == Options->WarmupFrames)
+        {
+            Compositor.ResetCounters();
+            Sink.ResetStats();
+            RectCount = 0;
+            Allocations = AllocationCount.load(std::memory_order_relaxed);
+            Start = std::chrono::steady_clock::now();
+        }
+
+        Meta.MoveCount = 0;
+        Meta.DirtyCount = 0;
+        Workload->Generate(FrameIndex, TexWidth, TexHeight, &Meta);
+        if (Workload->Touch)
+        {
+            Workload->Touch(FrameIndex, Frame);
+        }
+
+        // Look for what really changed when the whole frame is reported, like DISPLAYMANAGER::ProcessFrame
+        if (Options->TileDetection)
+        {
+            bool FullFrame = !Meta.MoveCount && Meta.DirtyCount == 1 &&
+                             Meta.Dirties[0].left <= 0 && Meta.Dirties[0].top <= 0 &&
+                             Meta.Dirties[0].right >= TexWidth && Meta.Dirties[0].bottom >= TexHeight;
+            if (!FullFrame)
+            {
+                Detector.Invalidate();
+            }
+            else if (Detector.ShouldDetect())
+            {
+                Detector.HashTiles(Frame->Bits, Frame->Pitch);
+
+                RECT Rects[MAX_DIRTY_RECTS];
+                UINT Count;
+                if (Detector.BuildDirtyRects(Rects, MAX_DIRTY_RECTS, &Count))
+                {
+                    memcpy(Meta.Dirties, Rects, Count * sizeof(RECT));
+                    Meta.DirtyCount = Count;
+                }
+            }
+        }
+        RectCount += Meta.MoveCount + Meta.DirtyCount;
+
+        // Apply, moves first like DISPLAYMANAGER::ProcessFrame
+        Compositor.CopyMove(Meta.Moves, Meta.MoveCount, Options->Rotation, TexWidth, TexHeight, MoveDest);
+        Compositor.CopyDirty(Frame, Meta.Dirties, Meta.DirtyCount, Options->Rotation, DirtyDest);
+
+        // Rebuild the mip levels under the damage only, like OUTPUTMANAGER::UpdateMips
+        for (UINT i = 0; i < Meta.MoveCount; ++i)
+        {
+            UpdateMips(&Compositor, Mips, MipCount, &MoveDest[i]);
+        }
+        for (UINT i = 0; i < Meta.DirtyCount; ++i)
+        {
+            UpdateMips(&Compositor, Mips, MipCount, &DirtyDest[i]);
+        }
+
+        // Nothing but the pointer changed, like OUTPUTMANAGER::UpdateApplicationWindow only the desktop under where
+        // it was is drawn again even when the view is otherwise redrawn whole
+        bool PointerOnly = Options->Warp && !Options->FoveationScale && FrameIndex && !Meta.MoveCount && !Meta.DirtyCount;
+
+        if (Options->FoveationScale)
+        {
+            // The view is built from a mip level and the fovea
+            Compositor.ComposeFoveated(Mips[GetFoveationLevel(&Foveation)], Options->FoveationScale, &Fovea, Scanout);
+        }
+        else if (PointerOnly)
+        {
+            Compositor.CopyRect(Compositor.GetDesktop(), &LastPointer, Scanout);
+        }
+        else if (Options->Warp)
+        {
+            // The whole view is drawn again for every scanout
+            RECT Whole = {0, 0, Options->Width, Options->Height};
+            Compositor.CopyRect(Compositor.GetDesktop(), &Whole, Scanout);
+        }
+        else
+        {
+            // Present: refresh the damaged regions and where the pointer was, then draw the pointer
+            for (UINT i = 0; i < Meta.MoveCount; ++i)
+            {
+                Compositor.CopyRect(Compositor.GetDesktop(), &MoveDest[i], Scanout);
+            }
+            for (UINT i = 0; i < Meta.DirtyCount; ++i)
+            {
+                Compositor.CopyRect(Compositor.GetDesktop(), &DirtyDest[i], Scanout);
+            }
+            Compositor.CopyRect(Compositor.GetDesktop(), &LastPointer, Scanout);
+        }
+
+        Compositor.DrawPointer(Shape.Buffer, &Shape.Info, Meta.Pointer, Scanout);
+
+        if (Options->Stream || Options->RecordPrefix)
+        {
+            // What changed in the view: the applied rects and the pointer where it was and where it is now
+            RECT Damage[MAX_MOVE_RECTS + MAX_DIRTY_RECTS + 2];
+            UINT DamageCount = 0;
+            if (Options->Warp && !PointerOnly)
+            {
+                SetBenchRect(&Damage[DamageCount++], 0, 0, Options->Width, Options->Height);
+            }
+            else
+            {
+                memcpy(Damage, MoveDest, Meta.MoveCount * sizeof(RECT));
+                DamageCount += Meta.MoveCount;
+                memcpy(Damage + DamageCount, DirtyDest, Meta.DirtyCount * sizeof(RECT));
+                DamageCount += Meta.DirtyCount;
+                Damage[DamageCount++] = LastPointer;
+                SetBenchRect(&Damage[DamageCount++], Meta.Pointer.x, Meta.Pointer.y, Meta.Pointer.x + POINTER_SIZE, Meta.Pointer.y + POINTER_SIZE);
+            }
+            if (Options->Stream)
+            {
+                Sink.SubmitFrame(Scanout, Damage, DamageCount, NowNs());
+            }
+            if (Options->RecordPrefix)
+            {
+                Recorder.RecordFrame(Scanout, Damage, DamageCount, FrameIndex * RECORD_FRAME_NS);
+            }
+        }
+
+        SetBenchRect(&LastPointer, Meta.Pointer.x, Meta.Pointer.y, Meta.Pointer.x + POINTER_SIZE, Meta.Pointer.y + POINTER_SIZE);
+    }
+    auto End = std::chrono::steady_clock::now();
+    Allocations = AllocationCount.load(std::memory_order_relaxed) - Allocations;
+
+    double ElapsedNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start).count());
+    Result->FramesPerSecond = Options->Frames / (ElapsedNs / 1e9);
+    Result->NsPerRect = RectCount ? ElapsedNs / RectCount : 0.0;
+    Result->BytesPerFrame = static_cast<double>(Compositor.GetBytesTouched()) / Options->Frames;
+    Result->AllocationsPerFrame = static_cast<double>(Allocations) / Options->Frames;
+
+    if (Options->Stream)
+    {
+        // Tiles held back at the end go out once the client catches up, then its copy must match the view
+        while (!Sink.Flush(Scanout, NowNs()))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        STREAM_STATS SinkStats;
+        Sink.GetStats(&SinkStats);
+        Result->WireBytesPerFrame = static_cast<double>(SinkStats.WireBytes) / Options->Frames;
+        Result->CompressionRatio = SinkStats.WireBytes ? static_cast<double>(SinkStats.RawBytes) / SinkStats.WireBytes : 0.0;
+        Result->FramesHeld = SinkStats.FramesHeld;
+        Result->RawMBPerSecond = SinkStats.RawBytes / (ElapsedNs / 1e3);
+
+        if (Options->StreamClient)
+        {
+            // Over TCP the client sees the end of the stream once the sender has written everything queued
+            if (Options->StreamPort)
+            {
+                SinkSocket.Close();
+            }
+            else
+            {
+                Channel.Close();
+            }
+            ClientThread.join();
+
+            STREAM_CLIENT_STATS ClientStats;
+            Client.GetStats(&ClientStats);
+            Result->LatencyUs = ClientStats.FramesReceived ? ClientStats.LatencyTotalNs / 1e3 / ClientStats.FramesReceived : 0.0;
+            Result->MaxLatencyUs = ClientStats.LatencyMaxNs / 1e3;
+            Result->FramesCorrupt = ClientStats.FramesCorrupt;
+            Result->ClientFailed = ClientFailed || !Client.GetFrame() || STREAMSINK::HashFrame(Client.GetFrame()) != STREAMSINK::HashFrame(Scanout);
+        }
+    }
+
+    if (Options->RecordPrefix)
+    {
+        // Tiles of frames dropped at the end go with one more frame, then the log must end on the view
+        uint64_t LastTime = (Options->WarmupFrames + Options->Frames) * RECORD_FRAME_NS;
+        while (Recorder.IsRecording() && !Recorder.RecordFrame(Scanout, nullptr, 0, LastTime))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Recorder.Close();
+
+        RECORDER_STATS RecorderStats;
+        Recorder.GetStats(&RecorderStats);
+        Result->FramesRecorded = RecorderStats.FramesRecorded;
+        Result->FramesDropped = RecorderStats.FramesDropped;
+        Result->Keyframes = RecorderStats.Keyframes;
+        Result->LogBytesPerFrame = static_cast<double>(RecorderStats.BytesWritten) / (Options->WarmupFrames + Options->Frames);
+
+        // Seek back and forth across the recording, every seek lands in a different keyframe interval
+        FRAMELOGREADER Reader;
+        if (!Reader.Open(RecordPath))
+        {
+            Result->ReplayFailed = true;
+            return true;
+        }
+        uint64_t SeekStart = NowNs();
+        for (UINT i = 0; i < RECORD_SEEKS; ++i)
+        {
+            uint64_t Time = ((i * 7919u) % RECORD_SEEKS) * LastTime / RECORD_SEEKS;
+            Result->ReplayFailed |= !Reader.Seek(Time);
+        }
+        Result->SeekUs = (NowNs() - SeekStart) / 1e3 / RECORD_SEEKS;
+        Result->ReplayFailed |= !Reader.Seek(LastTime) || STREAMSINK::HashFrame(Reader.GetFrame()) != STREAMSINK::HashFrame(Scanout);
+    }
+
+    return true;
+}
+
+static void ShowHelp()
+{
+    printf("Usage: DesktopDuplicationBenchmark [options]\n"
+           "  --workload [all | typing | scrolling | video | windowdrag | fullredraw | fullreport | pointer]\n"
+           "  --frames n\t\tnumber of measured frames per workload (default 600)\n"
+           "  --size WxH\t\tdesktop size (default 1920x1080)\n"
+           "  --rotation [0 | 90 | 180 | 270]\n"
+           "  --tiles\t\tfind the changed tiles of frames reported as fully dirty\n"
+           "  --warp\t\tdraw the whole view every frame like the headset path\n"
+           "  --foveation [2 | 4]\tdraw the whole view every frame from a mip level downscaled this much, but for a sharp center\n"
+           "  --mips n\t\tkeep n mip levels of the desktop image (1 to 6, default 1)\n"
+           "  --stream [raw | lz4]\tstream the changed tiles of the view to a loopback client\n"
+           "  --tcp port\t\tstream to the client over a localhost TCP connection on port\n"
+           "  --verify\t\thave the streaming client check every frame it rebuilds\n"
+           "  --workers n\t\tcompress streamed tiles on a pool of n worker threads\n"
+           "  --scaling\t\tmeasure tile compression alone with 1, 2, 4, 8 and 16 workers\n"
+           "  --record prefix\trecord the view of each workload to prefix-<workload>.ddlog and seek in it\n"
+           "  --pointertrace [synthetic | file]\tmeasure how far the pointer predictors are off on a pointer trace\n"
+           "  --pointersource\tpredict from a pointer stream fed in real time by a 1 kHz source\n"
+           "  --transform\t\ttime turning 10 to 10000 dirty rects into vertices at each rotation\n"
+           "  --apply\t\tcheck the tiled rect apply engine against applying rects one at a time at each rotation\n"
+           "  --tilehash\t\tcheck that tile change detection finds changes cancelling out in sums of pixels\n"
+           "  --instanced\t\tcompare the upload of dirty rects as vertices and as instances, and check the instance expansion\n"
+           "  --governor [synthetic | file]\treplay a timing trace through the frame governor with and without it shedding work\n"
+           "  --refresh\t\tcheck the refresh rate the headset settles at for idle, typing, video and pointer motion, and its cost per hour\n"
+           "  --edid dir\t\tcheck the EDID parser and mode policies against the blobs in dir, Benchmark/edid in the sources\n"
+           "  --x11 display\t\tcapture --frames frames from an X server through the software backend, with --profile export the timeline\n"
+           "  --profile file\ttime the workloads on a modeled GPU, check the timeline and export it as a trace\n");
+}
+
+// The presenter wakes at 90 Hz in the prediction measurements
+#define PREDICTION_REFRESH_NS 11111111ull
+
+// DXGI reports the pointer once per refresh of a 60 Hz desktop, a pointer source samples it every millisecond.
+// Either only reports moves.
+#define SYNTHETIC_UPDATE_NS 16666667ull
+#define SYNTHETIC_SOURCE_NS 1000000ull
+#define SYNTHETIC_TRACE_NS 60000000000ull
+
+// How long the pointer source is played in real time, and how far past each wake it is predicted to
+#define POINTER_SOURCE_RUN_NS 3000000000ull
+#define POINTER_SOURCE_LEAD_NS 8000000ull
+
+//
+// Minimum jerk strokes between random points with pauses in between, which is close to how a hand moves a mouse,
+// seen by something reporting the pointer every UpdateNs. The strokes are the same at any rate.
+//
+static bool GenerateTrace(INT Width, INT Height, uint64_t UpdateNs, POINTER_SAMPLE** Samples, UINT* Count)
+{
+    UINT Capacity = static_cast<UINT>(SYNTHETIC_TRACE_NS / UpdateNs) + 1;
+    *Samples = new (std::nothrow) POINTER_SAMPLE[Capacity];
+    *Count = 0;
+    if (!*Samples)
+    {
+        return false;
+    }
+
+    uint32_t Seed = 12345;
+    auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+    uint32_t JitterSeed = 54321;
+    uint32_t JitterUs = static_cast<uint32_t>(UpdateNs / 16000);
+
+    double FromX = Width / 2.0;
+    double FromY = Height / 2.0;
+    double ToX = FromX;
+    double ToY = FromY;
+    uint64_t StrokeStart = 0;
+    uint64_t StrokeEnd = 0;
+    for (uint64_t Time = UpdateNs; Time < SYNTHETIC_TRACE_NS && *Count < Capacity; Time += UpdateNs)
+    {
+        if (Time >= StrokeEnd)
+        {
+            // Next stroke after a pause
+            FromX = ToX;
+            FromY = ToY;
+            ToX = Random(static_cast<uint32_t>(Width));
+            ToY = Random(static_cast<uint32_t>(Height));
+            StrokeStart = StrokeEnd + Random(300) * 1000000ull;
+            StrokeEnd = StrokeStart + (150 + Random(450)) * 1000000ull;
+        }
+
+        // Updates land a little off their grid
+        JitterSeed = JitterSeed * 1664525u + 1013904223u;
+        uint64_t SampleTime = Time - JitterUs * 1000ull + ((JitterSeed >> 8) % (2 * JitterUs + 1)) * 1000ull;
+        double Tau = (SampleTime <= StrokeStart) ? 0.0 : (SampleTime >= StrokeEnd) ? 1.0 : static_cast<double>(SampleTime - StrokeStart) / (StrokeEnd - StrokeStart);
+        double Progress = Tau * Tau * Tau * (10 - 15 * Tau + 6 * Tau * Tau);
+        LONG X = static_cast<LONG>(lround(FromX + (ToX - FromX) * Progress));
+        LONG Y = static_cast<LONG>(lround(FromY + (ToY - FromY) * Progress));
+
+        if (*Count && (*Samples)[*Count - 1].X == X && (*Samples)[*Count - 1].Y == Y)
+        {
+            continue;
+        }
+        (*Samples)[*Count].Time = SampleTime;
+        (*Samples)[*Count].X = X;
+        (*Samples)[*Count].Y = Y;
+        ++*Count;
+    }
+    return true;
+}
+
+//
+// Where the trace has the pointer at Time. Between updates it moved in a line, unless the gap is a pause
+//
+static void TracePosition(const POINTER_SAMPLE* Samples, UINT Next, uint64_t Time, double* X, double* Y)
+{
+    const POINTER_SAMPLE* Before = &Samples[Next - 1];
+    const POINTER_SAMPLE* After = &Samples[Next];
+    if (After->Time - Before->Time > PREDICTION_IDLE_NS)
+    {
+        *X = Before->X;
+        *Y = Before->Y;
+        return;
+    }
+
+    double T = static_cast<double>(Time - Before->Time) / (After->Time - Before->Time);
+    *X = Before->X + (After->X - Before->X) * T;
+    *Y = Before->Y + (After->Y - Before->Y) * T;
+}
+
+//
+// Replay a pointer trace through each predictor as the presenter would see it, predicting a lead past every
+// wake up, and report how far off the predictions are at the frames where the pointer moves
+//
+static bool MeasureTrace(const char* Name, const POINTER_SAMPLE* Samples, UINT Count)
+{
+    static const PREDICTION_MODE Modes[] = {PREDICTION_OFF, PREDICTION_VELOCITY, PREDICTION_KALMAN};
+    static const char* ModeNames[] = {"off", "velocity", "kalman"};
+    static const UINT LeadsMs[] = {4, 8, 16, 33};
+
+    UINT MaxFrames = static_cast<UINT>((Samples[Count - 1].Time - Samples[0].Time) / PREDICTION_REFRESH_NS) + 1;
+    double* Errors = new (std::nothrow) double[MaxFrames];
+    if (!Errors)
+    {
+        return false;
+    }
+
+    printf("%s: %u pointer updates over %.1f s\n\n", Name, Count, (Samples[Count - 1].Time - Samples[0].Time) / 1e9);
+    printf("%-12s %8s %10s %10s %10s %10s\n", "predictor", "lead ms", "frames", "mean px", "p95 px", "max px");
+    for (UINT m = 0; m < sizeof(Modes) / sizeof(Modes[0]); ++m)
+    {
+        for (UINT LeadMs : LeadsMs)
+        {
+            POINTER_HISTORY History;
+            memset(&History, 0, sizeof(History));
+            UINT Fed = 0;
+            UINT Next = 1;
+            UINT Frames = 0;
+            for (uint64_t Wake = Samples[0].Time; ; Wake += PREDICTION_REFRESH_NS)
+            {
+                uint64_t Target = Wake + LeadMs * 1000000ull;
+                while (Next < Count && Samples[Next].Time <= Target)
+                {
+                    ++Next;
+                }
+                if (Next >= Count)
+                {
+                    break;
+                }
+                while (Fed < Count && Samples[Fed].Time <= Wake)
+                {
+                    AddPointerSample(&History, Samples[Fed].Time, Samples[Fed].X, Samples[Fed].Y);
+                    ++Fed;
+                }
+
+                POINT Predicted;
+                PredictPointer(&History, Modes[m], Wake, Target, &Predicted);
+                double TrueX;
+                double TrueY;
+                TracePosition(Samples, Next, Target, &TrueX, &TrueY);
+
+                // Frames where the pointer rests and nothing is predicted say nothing about the predictor
+                const POINTER_SAMPLE* Newest = &Samples[Fed - 1];
+                bool Still = (TrueX == Newest->X && TrueY == Newest->Y && Predicted.x == Newest->X && Predicted.y == Newest->Y);
+                if (!Still && Frames < MaxFrames)
+                {
+                    Errors[Frames++] = hypot(Predicted.x - TrueX, Predicted.y - TrueY);
+                }
+            }
+
+            double Sum = 0.0;
+            for (UINT i = 0; i < Frames; ++i)
+            {
+                Sum += Errors[i];
+            }
+            std::sort(Errors, Errors + Frames);
+            printf("%-12s %8u %10u %10.2f %10.2f %10.2f\n", ModeNames[m], LeadMs, Frames, Frames ? Sum / Frames : 0.0,
+                   Frames ? Errors[Frames * 95 / 100] : 0.0, Frames ? Errors[Frames - 1] : 0.0);
+        }
+    }
+    printf("\n");
+
+    delete [] Errors;
+    return true;
+}
+
+//
+// Measure the predictors on a pointer trace file, or on the same generated strokes as DXGI and as a pointer
+// source would report them
+//
+static bool RunPrediction(const BENCHMARK_OPTIONS* Options)
+{
+    static const uint64_t SyntheticRates[] = {SYNTHETIC_UPDATE_NS, SYNTHETIC_SOURCE_NS};
+    static const char* SyntheticNames[] = {"dxgi 60 Hz", "source 1 kHz"};
+
+    bool Synthetic = (strcmp(Options->PointerTrace, "synthetic") == 0);
+    UINT Traces = Synthetic ? sizeof(SyntheticRates) / sizeof(SyntheticRates[0]) : 1;
+    for (UINT t = 0; t < Traces; ++t)
+    {
+        POINTER_SAMPLE* Samples = nullptr;
+        UINT Count = 0;
+        bool Loaded = Synthetic ? GenerateTrace(Options->Width, Options->Height, SyntheticRates[t], &Samples, &Count) :
+                                  POINTERTRACE::Load(Options->PointerTrace, &Samples, &Count);
+        if (!Loaded || Count < 2)
+        {
+            fprintf(stderr, "Failed to load pointer trace %s\n", Options->PointerTrace);
+            delete [] Samples;
+            return false;
+        }
+
+        bool Measured = MeasureTrace(Synthetic ? SyntheticNames[t] : Options->PointerTrace, Samples, Count);
+        delete [] Samples;
+        if (!Measured)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Play the generated strokes through a pointer stream at 1 kHz in real time while waking at 90 Hz to read the
+// stream and predict past the wake, like the presenter does with the cursor source
+//
+static bool RunPointerSource(const BENCHMARK_OPTIONS* Options)
+{
+    POINTER_SAMPLE* Samples = nullptr;
+    UINT Count = 0;
+    if (!GenerateTrace(Options->Width, Options->Height, SYNTHETIC_SOURCE_NS, &Samples, &Count) || Count < 2)
+    {
+        delete [] Samples;
+        return false;
+    }
+
+    UINT MaxFrames = static_cast<UINT>(POINTER_SOURCE_RUN_NS / PREDICTION_REFRESH_NS) + 1;
+    double* Errors = new (std::nothrow) double[MaxFrames * 2];
+    POINTERSTREAM* Stream = new (std::nothrow) POINTERSTREAM;
+    SCRIPTEDPOINTERSOURCE Source;
+    if (!Errors || !Stream || !Source.Initialize(Samples, Count) || !Source.Start(Stream))
+    {
+        delete Stream;
+        delete [] Errors;
+        delete [] Samples;
+        return false;
+    }
+
+    double* Latest = Errors + MaxFrames;
+    POINTER_HISTORY History;
+    memset(&History, 0, sizeof(History));
+    UINT Frames = 0;
+    UINT Wakes = 0;
+    UINT Next = 1;
+    uint64_t Start = Source.GetStartTime();
+    for (uint64_t Wake = Start + PREDICTION_REFRESH_NS; Wake < Start + POINTER_SOURCE_RUN_NS && !Source.IsFinished(); Wake += PREDICTION_REFRESH_NS)
+    {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(Wake))));
+        ++Wakes;
+        if (!Stream->Read(&History))
+        {
+            continue;
+        }
+
+        uint64_t Now = SCRIPTEDPOINTERSOURCE::Now();
+        uint64_t Target = Now + POINTER_SOURCE_LEAD_NS;
+        POINT Predicted;
+        PredictPointer(&History, PREDICTION_KALMAN, Now, Target, &Predicted);
+
+        // Back on the clock of the trace
+        uint64_t TraceTarget = Target - Start + Samples[0].Time;
+        while (Next < Count && Samples[Next].Time <= TraceTarget)
+        {
+            ++Next;
+        }
+        if (Next >= Count)
+        {
+            break;
+        }
+        double TrueX;
+        double TrueY;
+        TracePosition(Samples, Next, TraceTarget, &TrueX, &TrueY);
+
+        const POINTER_SAMPLE* Newest = &History.Samples[(History.Count - 1) % POINTER_HISTORY_SIZE];
+        if ((TrueX != Newest->X || TrueY != Newest->Y) && Frames < MaxFrames)
+        {
+            Errors[Frames] = hypot(Predicted.x - TrueX, Predicted.y - TrueY);
+            Latest[Frames] = hypot(Newest->X - TrueX, Newest->Y - TrueY);
+            ++Frames;
+        }
+    }
+    Source.Stop();
+
+    printf("%u wakes, %u positions streamed, %u copies retried, %u frames with the pointer moving\n\n", Wakes, History.Count, Stream->GetRetries(), Frames);
+    printf("%-12s %10s %10s %10s\n", "predictor", "mean px", "p95 px", "max px");
+    double* Tables[] = {Latest, Errors};
+    const char* Names[] = {"off", "kalman"};
+    for (UINT i = 0; i < 2; ++i)
+    {
+        double Sum = 0.0;
+        for (UINT f = 0; f < Frames; ++f)
+        {
+            Sum += Tables[i][f];
+        }
+        std::sort(Tables[i], Tables[i] + Frames);
+        printf("%-12s %10.2f %10.2f %10.2f\n", Names[i], Frames ? Sum / Frames : 0.0, Frames ? Tables[i][Frames * 95 / 100] : 0.0,
+               Frames ? Tables[i][Frames - 1] : 0.0);
+    }
+
+    delete Stream;
+    delete [] Errors;
+    delete [] Samples;
+    return true;
+}
+
+// Rects transformed per timing of the rect transform, at least
+#define TRANSFORM_RECTS_TIMED 2000000
+
+//
+// Vertices of one dirty rect the way DISPLAYMANAGER::SetDirtyVert made them: the rotation worked out again and
+// eight divisions for every rect. Kept to time and check the batched transform against.
+//
+static void ReferenceDirtyVert(RECT_VERTEX* Vertices, RECT* DestRect, const RECT* Dirty, DXGI_MODE_ROTATION Rotation, INT Width, INT Height,
+                               INT OriginX, INT OriginY, UINT FullWidth, UINT FullHeight, UINT ThisWidth, UINT ThisHeight)
+{
+    INT CenterX = FullWidth / 2;
+    INT CenterY = FullHeight / 2;
+    RECT DestDirty = *Dirty;
+    float Left = Dirty->left / static_cast<float>(ThisWidth);
+    float Top = Dirty->top / static_cast<float>(ThisHeight);
+    float Right = Dirty->right / static_cast<float>(ThisWidth);
+    float Bottom = Dirty->bottom / static_cast<float>(ThisHeight);
+    float Tex[4][2];
+    switch (Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+        {
+            DestDirty = {Width - Dirty->bottom, Dirty->left, Width - Dirty->top, Dirty->right};
+            float Corners[4][2] = {{Right, Bottom}, {Left, Bottom}, {Right, Top}, {Left, Top}};
+            memcpy(Tex, Corners, sizeof(Tex));
+            break;
+        }
+        case DXGI_MODE_ROTATION_ROTATE180:
+        {
+            DestDirty = {Width - Dirty->right, Height - Dirty->bottom, Width - Dirty->left, Height - Dirty->top};
+            float Corners[4][2] = {{Right, Top}, {Right, Bottom}, {Left, Top}, {Left, Bottom}};
+            memcpy(Tex, Corners, sizeof(Tex));
+            break;
+        }
+        case DXGI_MODE_ROTATION_ROTATE270:
+        {
+            DestDirty = {Dirty->top, Height - Dirty->right, Dirty->bottom, Height - Dirty->left};
+            float Corners[4][2] = {{Left, Top}, {Right, Top}, {Left, Bottom}, {Right, Bottom}};
+            memcpy(Tex, Corners, sizeof(Tex));
+            break;
+        }
+        default:
+        {
+            float Corners[4][2] = {{Left, Bottom}, {Left, Top}, {Right, Bottom}, {Right, Top}};
+            memcpy(Tex, Corners, sizeof(Tex));
+            break;
+        }
+    }
+
+    static const UINT Slots[4] = {0, 1, 2, 5};
+    LONG PosX[4] = {DestDirty.left, DestDirty.left, DestDirty.right, DestDirty.right};
+    LONG PosY[4] = {DestDirty.bottom, DestDirty.top, DestDirty.bottom, DestDirty.top};
+    for (UINT i = 0; i < 4; ++i)
+    {
+        RECT_VERTEX* Vertex = &Vertices[Slots[i]];
+        Vertex->Pos[0] = (PosX[i] + OriginX - CenterX) / static_cast<float>(CenterX);
+        Vertex->Pos[1] = -1 * (PosY[i] + OriginY - CenterY) / static_cast<float>(CenterY);
+        Vertex->Pos[2] = 0.0f;
+        Vertex->TexCoord[0] = Tex[i][0];
+        Vertex->TexCoord[1] = Tex[i][1];
+    }
+    Vertices[3] = Vertices[2];
+    Vertices[4] = Vertices[1];
+
+    *DestRect = {DestDirty.left + OriginX, DestDirty.top + OriginY, DestDirty.right + OriginX, DestDirty.bottom + OriginY};
+}
+
+//
+// Turn growing numbers of dirty rects into vertices at every rotation, one rect at a time as before and all
+// at once with the per output transform, and check both give the same vertices
+//
+static bool RunTransform(const BENCHMARK_OPTIONS* Options)
+{
+    static const UINT RectCounts[] = {10, 100, 1000, 10000};
+    static const DXGI_MODE_ROTATION Rotations[] = {DXGI_MODE_ROTATION_IDENTITY, DXGI_MODE_ROTATION_ROTATE90, DXGI_MODE_ROTATION_ROTATE180, DXGI_MODE_ROTATION_ROTATE270};
+
+    UINT MaxRects = RectCounts[sizeof(RectCounts) / sizeof(RectCounts[0]) - 1];
+    RECT* Dirty = new (std::nothrow) RECT[MaxRects * 3];
+    RECT_VERTEX* Vertices = new (std::nothrow) RECT_VERTEX[MaxRects * RECT_VERTICES * 2];
+    if (!Dirty || !Vertices)
+    {
+        delete [] Dirty;
+        delete [] Vertices;
+        return false;
+    }
+    RECT* ReferenceDest = Dirty + MaxRects;
+    RECT* BatchDest = Dirty + MaxRects * 2;
+    RECT_VERTEX* ReferenceVertices = Vertices;
+    RECT_VERTEX* BatchVertices = Vertices + MaxRects * RECT_VERTICES;
+
+    // The output sits right of a 1280 pixel wide one on the shared surface, so the origin is not zero
+    const INT OriginX = 1280;
+    const INT OriginY = 0;
+
+    printf("%-8s %8s %14s %14s %8s\n", "rotation", "rects", "per rect ns", "batched ns", "speedup");
+    bool Matched = true;
+    for (DXGI_MODE_ROTATION Rotation : Rotations)
+    {
+        bool Rotated = (Rotation == DXGI_MODE_ROTATION_ROTATE90 || Rotation == DXGI_MODE_ROTATION_ROTATE270);
+        INT TexWidth = Rotated ? Options->Height : Options->Width;
+        INT TexHeight = Rotated ? Options->Width : Options->Height;
+        UINT FullWidth = OriginX + Options->Width;
+        UINT FullHeight = Options->Height;
+
+        uint32_t Seed = 12345;
+        auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+        for (UINT i = 0; i < MaxRects; ++i)
+        {
+            LONG Left = Random(static_cast<uint32_t>(TexWidth - 1));
+            LONG Top = Random(static_cast<uint32_t>(TexHeight - 1));
+            Dirty[i] = {Left, Top, Left + 1 + static_cast<LONG>(Random(static_cast<uint32_t>(TexWidth - Left))), Top + 1 + static_cast<LONG>(Random(static_cast<uint32_t>(TexHeight - Top)))};
+        }
+
+        RECT_TRANSFORM Transform;
+        InitRectTransform(&Transform, Rotation, Options->Width, Options->Height, OriginX, OriginY, TexWidth, TexHeight, FullWidth, FullHeight);
+
+        for (UINT Count : RectCounts)
+        {
+            UINT Repeats = TRANSFORM_RECTS_TIMED / Count;
+
+            uint64_t Start = NowNs();
+            for (UINT Repeat = 0; Repeat < Repeats; ++Repeat)
+            {
+                for (UINT i = 0; i < Count; ++i)
+                {
+                    ReferenceDirtyVert(&ReferenceVertices[i * RECT_VERTICES], &ReferenceDest[i], &Dirty[i], Rotation, Options->Width, Options->Height,
+                                       OriginX, OriginY, FullWidth, FullHeight, TexWidth, TexHeight);
+                }
+            }
+            double ReferenceNs = static_cast<double>(NowNs() - Start) / (static_cast<double>(Repeats) * Count);
+
+            Start = NowNs();
+            for (UINT Repeat = 0; Repeat < Repeats; ++Repeat)
+            {
+                TransformDirtyRects(&Transform, Dirty, Count, BatchVertices, BatchDest);
+            }
+            double BatchNs = static_cast<double>(NowNs() - Start) / (static_cast<double>(Repeats) * Count);
+
+            // Multiplying by reciprocals rounds differently from dividing, by far less than a pixel
+            for (UINT i = 0; i < Count * RECT_VERTICES && Matched; ++i)
+            {
+                for (UINT c = 0; c < 5; ++c)
+                {
+                    const float* A = (c < 3) ? &ReferenceVertices[i].Pos[c] : &ReferenceVertices[i].TexCoord[c - 3];
+                    const float* B = (c < 3) ? &BatchVertices[i].Pos[c] : &BatchVertices[i].TexCoord[c - 3];
+                    if (fabsf(*A - *B) > 1e-5f)
+                    {
+                        fprintf(stderr, "Vertex %u differs at rotation %d\n", i, (Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90);
+                        Matched = false;
+                        break;
+                    }
+                }
+            }
+            if (Matched && memcmp(ReferenceDest, BatchDest, Count * sizeof(RECT)) != 0)
+            {
+                fprintf(stderr, "Destination rects differ at rotation %d\n", (Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90);
+                Matched = false;
+            }
+
+            printf("%-8d %8u %14.2f %14.2f %7.2fx\n", (Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90, Count, ReferenceNs, BatchNs, ReferenceNs / BatchNs);
+        }
+    }
+
+    delete [] Dirty;
+    delete [] Vertices;
+    return Matched;
+}
+
+// Dirty rects of one frame in the apply check are up to this many, a move or two comes with most frames
+#define APPLY_MAX_DIRTY 64
+#define APPLY_MAX_MOVES 2
+
+//
+// A frame where every pixel tells where it came from, so a rect landing at the wrong place or turned the wrong
+// way shows up
+//
+static void FillFrame(UINT Frame, SOFTWARE_SURFACE* Surface)
+{
+    for (UINT Y = 0; Y < Surface->Height; ++Y)
+    {
+        UINT* Row = reinterpret_cast<UINT*>(Surface->Bits + static_cast<size_t>(Y) * Surface->Pitch);
+        for (UINT X = 0; X < Surface->Width; ++X)
+        {
+            Row[X] = (X * 73856093u) ^ (Y * 19349663u) ^ (Frame * 83492791u);
+        }
+    }
+}
+
+//
+// Apply random frames of moves and dirty rects at every rotation, one rect at a time as the draw and copy path
+// does and through the tiled list of the compute apply engine, and check both desktops stay the same. Frames
+// the list cannot express take the one at a time path on both, as DISPLAYMANAGER does.
+//
+static bool RunApply(const BENCHMARK_OPTIONS* Options)
+{
+    static const DXGI_MODE_ROTATION Rotations[] = {DXGI_MODE_ROTATION_IDENTITY, DXGI_MODE_ROTATION_ROTATE90, DXGI_MODE_ROTATION_ROTATE180, DXGI_MODE_ROTATION_ROTATE270};
+
+    SOFTWARECOMPOSITOR Reference;
+    SOFTWARECOMPOSITOR Tiled;
+    SOFTWARE_SURFACE Frame = {};
+    FRAMEARENA Arena;
+    Frame.Bits = new (std::nothrow) BYTE[static_cast<size_t>(Options->Width) * Options->Height * SOFTWARE_BPP];
+    if (!Frame.Bits || !Reference.Initialize(Options->Width, Options->Height) || !Tiled.Initialize(Options->Width, Options->Height) ||
+        !Arena.Initialize(FRAMEARENA_GRANULARITY))
+    {
+        delete [] Frame.Bits;
+        return false;
+    }
+
+    UINT Frames = (Options->Frames < 100) ? Options->Frames : 100;
+    printf("%-8s %8s %10s %10s %10s %14s %14s\n", "rotation", "frames", "fallback", "rects", "tiles", "one by one us", "build us");
+    bool Matched = true;
+    for (DXGI_MODE_ROTATION Rotation : Rotations)
+    {
+        bool Rotated = (Rotation == DXGI_MODE_ROTATION_ROTATE90 || Rotation == DXGI_MODE_ROTATION_ROTATE270);
+        INT TexWidth = Rotated ? Options->Height : Options->Width;
+        INT TexHeight = Rotated ? Options->Width : Options->Height;
+        Frame.Width = TexWidth;
+        Frame.Height = TexHeight;
+        Frame.Pitch = TexWidth * SOFTWARE_BPP;
+
+        RECT_TRANSFORM Transform;
+        InitRectTransform(&Transform, Rotation, Options->Width, Options->Height, 0, 0, TexWidth, TexHeight, Options->Width, Options->Height);
+
+        // Both start from the same desktop
+        FillFrame(0, &Frame);
+        RECT Whole = {0, 0, TexWidth, TexHeight};
+        Reference.CopyDirty(&Frame, &Whole, 1, Rotation, nullptr);
+        Tiled.CopyDirty(&Frame, &Whole, 1, Rotation, nullptr);
+
+        uint32_t Seed = 4242;
+        auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+
+        UINT Fallbacks = 0;
+        uint64_t Rects = 0;
+        uint64_t Tiles = 0;
+        uint64_t ReferenceNs = 0;
+        uint64_t BuildNs = 0;
+        for (UINT f = 1; f <= Frames && Matched; ++f)
+        {
+            FillFrame(f, &Frame);
+
+            // Scrolls of a window by a few rows or columns, in frame coordinates like DXGI reports them
+            DXGI_OUTDUPL_MOVE_RECT Moves[APPLY_MAX_MOVES];
+            UINT MoveCount = Random(APPLY_MAX_MOVES + 1);
+            for (UINT i = 0; i < MoveCount; ++i)
+            {
+                LONG Width = 64 + Random(static_cast<uint32_t>(TexWidth / 2));
+                LONG Height = 64 + Random(static_cast<uint32_t>(TexHeight / 2));
+                LONG Left = Random(static_cast<uint32_t>(TexWidth - Width));
+                LONG Top = Random(static_cast<uint32_t>(TexHeight - Height));
+                LONG Shift = 1 + Random(48);
+                LONG DeltaX = 0;
+                LONG DeltaY = 0;
+                if (Random(2))
+                {
+                    DeltaY = (Top >= Shift) ? -Shift : Shift;
+                }
+                else
+                {
+                    DeltaX = (Left >= Shift) ? -Shift : Shift;
+                }
+                Moves[i].SourcePoint = {Left, Top};
+                Moves[i].DestinationRect = {Left + DeltaX, Top + DeltaY, Left + Width + DeltaX, Top + Height + DeltaY};
+            }
+
+            RECT Dirty[APPLY_MAX_DIRTY];
+            UINT DirtyCount = 1 + Random(APPLY_MAX_DIRTY);
+            for (UINT i = 0; i < DirtyCount; ++i)
+            {
+                LONG Left = Random(static_cast<uint32_t>(TexWidth - 1));
+                LONG Top = Random(static_cast<uint32_t>(TexHeight - 1));
+                Dirty[i] = {Left, Top, Left + 1 + static_cast<LONG>(Random(static_cast<uint32_t>(std::min(TexWidth - Left, 400)))),
+                            Top + 1 + static_cast<LONG>(Random(static_cast<uint32_t>(std::min(TexHeight - Top, 400))))};
+            }
+
+            uint64_t Start = NowNs();
+            Reference.CopyMove(Moves, MoveCount, Rotation, TexWidth, TexHeight, nullptr);
+            Reference.CopyDirty(&Frame, Dirty, DirtyCount, Rotation, nullptr);
+            ReferenceNs += NowNs() - Start;
+
+            Arena.Reset();
+            APPLY_LIST List;
+            Start = NowNs();
+            bool Built = BuildApplyList(&Transform, TexWidth, TexHeight, Moves, MoveCount, Dirty, DirtyCount, &Arena, &List);
+            BuildNs += NowNs() - Start;
+            if (Built)
+            {
+                Tiled.ApplyRects(&Frame, &List);
+                Rects += List.RectCount;
+                Tiles += List.TileCount;
+            }
+            else
+            {
+                Tiled.CopyMove(Moves, MoveCount, Rotation, TexWidth, TexHeight, nullptr);
+                Tiled.CopyDirty(&Frame, Dirty, DirtyCount, Rotation, nullptr);
+                ++Fallbacks;
+            }
+
+            if (memcmp(Reference.GetDesktop()->Bits, Tiled.GetDesktop()->Bits, static_cast<size_t>(Options->Width) * Options->Height * SOFTWARE_BPP) != 0)
+            {
+                fprintf(stderr, "Desktops differ after frame %u at rotation %d\n", f, (Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90);
+                Matched = false;
+            }
+        }
+
+        UINT Built = Frames - Fallbacks;
+        printf("%-8d %8u %10u %10.1f %10.1f %14.1f %14.1f\n", (Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90, Frames, Fallbacks,
+               Built ? static_cast<double>(Rects) / Built : 0.0, Built ? static_cast<double>(Tiles) / Built : 0.0,
+               ReferenceNs / 1000.0 / Frames, BuildNs / 1000.0 / Frames);
+    }
+
+    delete [] Frame.Bits;
+    return Matched;
+}
+
+//
+// Changes that cancel out in plain sums of pixels: +d, -d, -d, +d on pixels four apart, which HashTiles multiplies
+// in the same place of their pairs, and on four pixels in a row, which TileHash.hlsl sums one after the other. Make
+// one such change in every tile in turn and check the detector finds that tile and no other, then that a frame
+// left alone has no changes at all. Last, time hashing a frame against copying it, which it has to beat for
+// detection on the CPU to pay off.
+//
+static bool RunTileHash(const BENCHMARK_OPTIONS* Options)
+{
+    static const UINT Strides[] = {4, 1};
+
+    SOFTWARECOMPOSITOR FrameHolder;
+    TILEDETECTOR Detector;
+    if (!FrameHolder.Initialize(Options->Width, Options->Height) || !Detector.Initialize(Options->Width, Options->Height))
+    {
+        return false;
+    }
+    SOFTWARE_SURFACE* Frame = FrameHolder.GetDesktop();
+    FillFrame(0, Frame);
+
+    RECT Rects[TILE_MAX_RECTS];
+    UINT Count;
+    Detector.HashTiles(Frame->Bits, Frame->Pitch);
+    Detector.BuildDirtyRects(Rects, TILE_MAX_RECTS, &Count);
+
+    uint32_t Seed = 3331;
+    auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+
+    printf("%-10s %8s %8s %8s\n", "pattern", "tiles", "missed", "extra");
+    bool Succeeded = true;
+    for (UINT Stride : Strides)
+    {
+        UINT Tiles = 0;
+        UINT Missed = 0;
+        UINT Extra = 0;
+        for (UINT Row = 0; Row < Detector.GetRows(); ++Row)
+        {
+            for (UINT Column = 0; Column < Detector.GetColumns(); ++Column)
+            {
+                LONG Left = Column * TILE_SIZE;
+                LONG Top = Row * TILE_SIZE;
+                LONG Right = std::min<LONG>(Left + TILE_SIZE, Options->Width);
+                LONG Bottom = std::min<LONG>(Top + TILE_SIZE, Options->Height);
+                if (Right - Left <= static_cast<LONG>(Stride * 3))
+                {
+                    continue;
+                }
+
+                // Zero sum and zero first moment, per lane for a stride of 4
+                static const INT Signs[4] = {1, -1, -1, 1};
+                UINT Delta = 0x00010101u * (1 + Random(16));
+                UINT X = Left + Random(Right - Left - Stride * 3);
+                UINT Y = Top + Random(Bottom - Top);
+                UINT* Pixels = reinterpret_cast<UINT*>(Frame->Bits + static_cast<size_t>(Y) * Frame->Pitch);
+                for (UINT i = 0; i < 4; ++i)
+                {
+                    Pixels[X + i * Stride] += Signs[i] * Delta;
+                }
+
+                Detector.HashTiles(Frame->Bits, Frame->Pitch);
+                bool Found = Detector.BuildDirtyRects(Rects, TILE_MAX_RECTS, &Count) && Count >= 1 && Rects[0].left == Left && Rects[0].top == Top &&
+                             Rects[0].right == Right && Rects[0].bottom == Bottom;
+                ++Tiles;
+                Missed += Found ? 0 : 1;
+                Extra += (Count > 1) ? 1 : 0;
+            }
+        }
+
+        printf("%-10s %8u %8u %8u\n", (Stride == 1) ? "adjacent" : "lane", Tiles, Missed, Extra);
+        Succeeded = Succeeded && !Missed && !Extra;
+    }
+
+    Detector.HashTiles(Frame->Bits, Frame->Pitch);
+    if (!Detector.BuildDirtyRects(Rects, TILE_MAX_RECTS, &Count) || Count)
+    {
+        fprintf(stderr, "An unchanged frame has changed tiles\n");
+        Succeeded = false;
+    }
+
+    size_t FrameBytes = static_cast<size_t>(Frame->Pitch) * Frame->Height;
+    BYTE* Copy = new (std::nothrow) BYTE[FrameBytes];
+    if (!Copy)
+    {
+        return false;
+    }
+    const UINT Repeats = 100;
+    uint64_t HashStart = NowNs();
+    for (UINT i = 0; i < Repeats; ++i)
+    {
+        Detector.HashTiles(Frame->Bits, Frame->Pitch);
+    }
+    uint64_t CopyStart = NowNs();
+    for (UINT i = 0; i < Repeats; ++i)
+    {
+        // Read back into the frame so the copies cannot be left out
+        memcpy(Copy, Frame->Bits, FrameBytes);
+        Frame->Bits[i] ^= Copy[FrameBytes - 1];
+    }
+    uint64_t End = NowNs();
+    printf("\nhashing a frame %.0f us, copying it %.0f us\n", (CopyStart - HashStart) / 1000.0 / Repeats, (End - CopyStart) / 1000.0 / Repeats);
+    delete [] Copy;
+
+    return Succeeded;
+}
+
+// The presenter wakes at 90 Hz and the desktop is duplicated at 60 Hz in the profiler check
+#define PROFILE_PRESENT_NS 11111111ull
+#define PROFILE_DUPLICATE_NS 16666667ull
+#define PROFILE_LANES 2
+
+//
+// A span the timeline should come up with for a modeled pass, on the CPU clock
+//
+typedef struct _PROFILE_EXPECTED
+{
+    uint64_t Frame;
+    PROFILE_PASS Pass;
+    uint64_t StartNs;
+    uint64_t EndNs;
+} PROFILE_EXPECTED;
+
+//
+// One lane of the profiler check: the modeled GPU timer and, worked out separately, where its passes really ran
+//
+typedef struct _PROFILE_LANE
+{
+    MODELEDGPUTIMER Timer;
+    GPU_COST_MODEL Model;
+    uint64_t BusyUntilNs;
+    uint64_t Frames;
+    PROFILE_EXPECTED* Expected;
+    UINT ExpectedCount;
+} PROFILE_LANE;
+
+static void BeginProfileFrame(PROFILE_LANE* Lane, uint64_t NowNs)
+{
+    Lane->Timer.BeginFrame(Lane->Frames, NowNs);
+    Lane->BusyUntilNs = std::max(Lane->BusyUntilNs, NowNs + Lane->Model.SubmitLatencyNs);
+}
+
+static void AddProfilePass(PROFILE_LANE* Lane, PROFILE_PASS Pass, uint64_t Pixels)
+{
+    Lane->Timer.AddPass(Pass, Pixels);
+    uint64_t EndNs = Lane->BusyUntilNs + Lane->Model.PassNs + static_cast<uint64_t>(Pixels * Lane->Model.NsPerPixel);
+    Lane->Expected[Lane->ExpectedCount++] = {Lane->Frames, Pass, Lane->BusyUntilNs, EndNs};
+    Lane->BusyUntilNs = EndNs;
+}
+
+static void EndProfileFrame(PROFILE_LANE* Lane)
+{
+    Lane->Timer.EndFrame();
+    ++Lane->Frames;
+}
+
+static uint64_t RectPixels(const RECT* Rect)
+{
+    return static_cast<uint64_t>(Rect->right - Rect->left) * (Rect->bottom - Rect->top);
+}
+
+//
+// Feed the workloads through modeled GPU timers, the presenter on lane 0 and one output on lane 1, each on a clock
+// of its own, and check that the timeline puts every pass back where it ran on the CPU clock. Every frame of the
+// model starts on an idle GPU, so the offset found for each lane is its clock offset plus the submit latency.
+//
+static bool RunProfile(const BENCHMARK_OPTIONS* Options)
+{
+    PROFILETIMELINE Timeline;
+    PROFILE_LANE Lanes[PROFILE_LANES];
+    PROFILE_EVENT* Events = nullptr;
+    UINT MaxEvents = Options->Frames * (PROFILE_MAX_FRAME_PASSES * 2 + 1);
+    bool Succeeded = Timeline.Initialize(PROFILE_EVENT_CAPACITY);
+    Events = new (std::nothrow) PROFILE_EVENT[MaxEvents];
+    Succeeded = Succeeded && Events;
+    for (PROFILE_LANE& Lane : Lanes)
+    {
+        Lane.Expected = new (std::nothrow) PROFILE_EXPECTED[Options->Frames * PROFILE_MAX_FRAME_PASSES];
+        Lane.Frames = 0;
+        Succeeded = Succeeded && Lane.Expected;
+    }
+
+    // A 10 MHz presenter GPU clock and an odd 1 GHz one for the output, both far from the CPU clock's zero
+    Lanes[0].Model = {20000, 0.25, 150000, 10000000ull, 3000123457ull};
+    Lanes[1].Model = {15000, 0.5, 80000, 1000000007ull, 17000000ull};
+
+    printf("%-12s %8s %8s %11s %11s %11s %11s %11s %11s\n", "workload", "frames", "copies", "move ms", "dirty ms", "draw ms", "mouse ms", "submit ms", "error us");
+    if (Succeeded)
+    {
+        uint32_t Seed = 4242;
+        auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+
+        uint64_t Now = 1000000000ull;
+        bool Found = false;
+        for (const WORKLOAD& Workload : Workloads)
+        {
+            if (strcmp(Options->Workload, "all") != 0 && strcmp(Options->Workload, Workload.Name) != 0)
+            {
+                continue;
+            }
+            Found = true;
+
+            Timeline.ResetStats();
+            for (UINT l = 0; l < PROFILE_LANES; ++l)
+            {
+                Lanes[l].Timer.Initialize(&Timeline, l, &Lanes[l].Model);
+                Lanes[l].BusyUntilNs = 0;
+                Lanes[l].ExpectedCount = 0;
+            }
+
+            FRAME_METADATA Meta;
+            UINT DuplicatedFrames = 0;
+            UINT Copies = 0;
+            uint64_t NextDuplicateNs = Now;
+            for (UINT f = 0; f < Options->Frames; ++f, Now += PROFILE_PRESENT_NS)
+            {
+                // Frames duplicated since the last refresh, pointer only ones never reach the GPU
+                bool Changed = false;
+                for (; NextDuplicateNs <= Now; NextDuplicateNs += PROFILE_DUPLICATE_NS)
+                {
+                    Meta.MoveCount = 0;
+                    Meta.DirtyCount = 0;
+                    Workload.Generate(DuplicatedFrames++, Options->Width, Options->Height, &Meta);
+                    if (!Meta.MoveCount && !Meta.DirtyCount)
+                    {
+                        continue;
+                    }
+
+                    BeginProfileFrame(&Lanes[1], NextDuplicateNs);
+                    if (Meta.MoveCount)
+                    {
+                        // Copied aside and back
+                        uint64_t Pixels = 0;
+                        for (UINT i = 0; i < Meta.MoveCount; ++i)
+                        {
+                            Pixels += 2 * RectPixels(&Meta.Moves[i].DestinationRect);
+                        }
+                        AddProfilePass(&Lanes[1], PROFILE_PASS_COPY_MOVE, Pixels);
+                    }
+                    if (Meta.DirtyCount)
+                    {
+                        uint64_t Pixels = 0;
+                        for (UINT i = 0; i < Meta.DirtyCount; ++i)
+                        {
+                            Pixels += RectPixels(&Meta.Dirties[i]);
+                        }
+                        AddProfilePass(&Lanes[1], PROFILE_PASS_COPY_DIRTY, Pixels);
+                    }
+                    EndProfileFrame(&Lanes[1]);
+                    Changed = true;
+                    ++Copies;
+                }
+
+                // The whole view is drawn when the desktop changed, otherwise only the desktop under the old pointer
+                BeginProfileFrame(&Lanes[0], Now);
+                AddProfilePass(&Lanes[0], PROFILE_PASS_DRAW_FRAME, Changed ? static_cast<uint64_t>(Options->Width) * Options->Height : POINTER_SIZE * POINTER_SIZE);
+                AddProfilePass(&Lanes[0], PROFILE_PASS_DRAW_MOUSE, POINTER_SIZE * POINTER_SIZE);
+                AddProfilePass(&Lanes[0], PROFILE_PASS_PRESENT, 0);
+                EndProfileFrame(&Lanes[0]);
+                Timeline.AddCpuSpan(0, Lanes[0].Frames - 1, PROFILE_PASS_SUBMIT, Now, Now + 200000 + Random(100000));
+            }
+            for (PROFILE_LANE& Lane : Lanes)
+            {
+                Lane.Timer.Flush();
+            }
+
+            // The newest events are this workload's, every lane in order
+            UINT Expected = Lanes[0].ExpectedCount + Lanes[1].ExpectedCount + Options->Frames;
+            if (Timeline.GetEvents(Events, Expected) != Expected)
+            {
+                fprintf(stderr, "%s: the timeline lost events\n", Workload.Name);
+                Succeeded = false;
+                break;
+            }
+
+            UINT Next[PROFILE_LANES] = {};
+            uint64_t MaxErrorNs = 0;
+            for (UINT i = 0; i < Expected && Succeeded; ++i)
+            {
+                const PROFILE_EVENT* Event = &Events[i];
+                if (Event->Track == PROFILE_TRACK_CPU)
+                {
+                    continue;
+                }
+
+                PROFILE_LANE* Lane = &Lanes[Event->Lane];
+                const PROFILE_EXPECTED* Span = &Lane->Expected[Next[Event->Lane]++];
+                if (Event->Frame != Span->Frame || Event->Pass != Span->Pass)
+                {
+                    fprintf(stderr, "%s: lane %u has %s of frame %llu where %s of frame %llu belongs\n", Workload.Name, Event->Lane,
+                            GetProfilePassName(Event->Pass), static_cast<unsigned long long>(Event->Frame),
+                            GetProfilePassName(Span->Pass), static_cast<unsigned long long>(Span->Frame));
+                    Succeeded = false;
+                    break;
+                }
+
+                int64_t StartError = static_cast<int64_t>(Event->StartNs - (Span->StartNs - Lane->Model.SubmitLatencyNs));
+                int64_t EndError = static_cast<int64_t>(Event->EndNs - (Span->EndNs - Lane->Model.SubmitLatencyNs));
+                MaxErrorNs = std::max(MaxErrorNs, static_cast<uint64_t>(std::max(llabs(StartError), llabs(EndError))));
+            }
+
+            // Within a tick of either clock
+            if (Succeeded && MaxErrorNs > 200)
+            {
+                fprintf(stderr, "%s: passes are up to %llu ns off on the timeline\n", Workload.Name, static_cast<unsigned long long>(MaxErrorNs));
+                Succeeded = false;
+            }
+
+            PROFILE_STAT Stats[PROFILE_PASS_COUNT];
+            for (UINT Pass = 0; Pass < PROFILE_PASS_COUNT; ++Pass)
+            {
+                Timeline.GetStat((Pass == PROFILE_PASS_SUBMIT) ? PROFILE_TRACK_CPU : PROFILE_TRACK_GPU, static_cast<PROFILE_PASS>(Pass), &Stats[Pass]);
+            }
+            if (Stats[PROFILE_PASS_DRAW_FRAME].Count != Options->Frames || Stats[PROFILE_PASS_SUBMIT].Count != Options->Frames ||
+                Stats[PROFILE_PASS_COPY_MOVE].Count + Stats[PROFILE_PASS_COPY_DIRTY].Count != Lanes[1].ExpectedCount)
+            {
+                fprintf(stderr, "%s: the statistics miss passes\n", Workload.Name);
+                Succeeded = false;
+            }
+
+            printf("%-12s %8u %8u %11.3f %11.3f %11.3f %11.3f %11.3f %11.3f\n", Workload.Name, Options->Frames, Copies,
+                   Stats[PROFILE_PASS_COPY_MOVE].Mean, Stats[PROFILE_PASS_COPY_DIRTY].Mean, Stats[PROFILE_PASS_DRAW_FRAME].Mean,
+                   Stats[PROFILE_PASS_DRAW_MOUSE].Mean, Stats[PROFILE_PASS_SUBMIT].Mean, MaxErrorNs / 1000.0);
+            if (!Succeeded)
+            {
+                break;
+            }
+        }
+
+        if (!Found)
+        {
+            fprintf(stderr, "Unknown workload %s\n", Options->Workload);
+            Succeeded = false;
+        }
+    }
+
+    if (Succeeded && !Timeline.Export(Options->ProfilePath))
+    {
+        fprintf(stderr, "Failed to write %s\n", Options->ProfilePath);
+        Succeeded = false;
+    }
+
+    delete [] Events;
+    for (PROFILE_LANE& Lane : Lanes)
+    {
+        delete [] Lane.Expected;
+    }
+    return Succeeded;
+}
+
+//
+// Check the vertices the instanced draw expands each rect into against the ones TransformDirtyRects emits
+//
+static bool CheckInstances(const RECT_TRANSFORM* Transform, const RECT* Dirty, UINT Count, const RECT_VERTEX* Vertices)
+{
+    static const UINT Slots[RECT_INSTANCE_VERTICES] = {0, 1, 2, 5};
+
+    RECT_CONSTANTS Constants;
+    InitRectConstants(Transform, &Constants);
+    for (UINT i = 0; i < Count; ++i)
+    {
+        for (UINT v = 0; v < RECT_INSTANCE_VERTICES; ++v)
+        {
+            RECT_VERTEX Vertex;
+            ExpandRectInstance(&Constants, &Dirty[i], v, &Vertex);
+            const RECT_VERTEX* Expected = &Vertices[i * RECT_VERTICES + Slots[v]];
+            for (UINT c = 0; c < 5; ++c)
+            {
+                float A = (c < 3) ? Vertex.Pos[c] : Vertex.TexCoord[c - 3];
+                float B = (c < 3) ? Expected->Pos[c] : Expected->TexCoord[c - 3];
+                if (fabsf(A - B) > 1e-5f)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//
+// The dirty rects of each workload's frames uploaded as six vertices each, as the draw path did, and as one
+// 16 byte instance each plus the per output constants. The CPU side of both is timed, the copy standing in
+// for the write into the mapped buffer.
+//
+static bool RunInstanced(const BENCHMARK_OPTIONS* Options)
+{
+    static const DXGI_MODE_ROTATION Rotations[] = {DXGI_MODE_ROTATION_IDENTITY, DXGI_MODE_ROTATION_ROTATE90, DXGI_MODE_ROTATION_ROTATE180, DXGI_MODE_ROTATION_ROTATE270};
+
+    UINT* Counts = new (std::nothrow) UINT[Options->Frames];
+    RECT* Dirty = new (std::nothrow) RECT[static_cast<size_t>(Options->Frames) * MAX_DIRTY_RECTS];
+    RECT* DestRects = new (std::nothrow) RECT[MAX_DIRTY_RECTS];
+    RECT_VERTEX* Vertices = new (std::nothrow) RECT_VERTEX[MAX_DIRTY_RECTS * RECT_VERTICES];
+    BYTE* Upload = new (std::nothrow) BYTE[sizeof(RECT_VERTEX) * MAX_DIRTY_RECTS * RECT_VERTICES];
+    bool Succeeded = Counts && Dirty && DestRects && Vertices && Upload;
+
+    // The output sits right of a 1280 pixel wide one on the shared surface, so the origin is not zero
+    const INT OriginX = 1280;
+    const INT OriginY = 0;
+
+    printf("%-12s %8s %10s %12s %12s %12s %12s %8s\n", "workload", "frames", "rects", "vertex B/f", "instance B/f", "vertex ns/f", "instance ns/f", "matched");
+    bool Found = false;
+    for (const WORKLOAD& Workload : Workloads)
+    {
+        if (!Succeeded)
+        {
+            break;
+        }
+        if (strcmp(Options->Workload, "all") != 0 && strcmp(Options->Workload, Workload.Name) != 0)
+        {
+            continue;
+        }
+        Found = true;
+
+        bool Rotated = (Options->Rotation == DXGI_MODE_ROTATION_ROTATE90 || Options->Rotation == DXGI_MODE_ROTATION_ROTATE270);
+        INT TexWidth = Rotated ? Options->Height : Options->Width;
+        INT TexHeight = Rotated ? Options->Width : Options->Height;
+
+        // The frames as the workload reports them, the rects are in frame orientation
+        FRAME_METADATA Meta;
+        UINT TotalRects = 0;
+        for (UINT f = 0; f < Options->Frames; ++f)
+        {
+            Meta.MoveCount = 0;
+            Meta.DirtyCount = 0;
+            Workload.Generate(f, TexWidth, TexHeight, &Meta);
+            Counts[f] = Meta.DirtyCount;
+            memcpy(&Dirty[static_cast<size_t>(f) * MAX_DIRTY_RECTS], Meta.Dirties, Meta.DirtyCount * sizeof(RECT));
+            TotalRects += Meta.DirtyCount;
+        }
+
+        // Every rotation expands to the same vertices as the CPU transform
+        bool Matched = true;
+        for (DXGI_MODE_ROTATION Rotation : Rotations)
+        {
+            bool Turned = (Rotation == DXGI_MODE_ROTATION_ROTATE90 || Rotation == DXGI_MODE_ROTATION_ROTATE270);
+            INT Width = Turned ? TexHeight : TexWidth;
+            INT Height = Turned ? TexWidth : TexHeight;
+            RECT_TRANSFORM Transform;
+            InitRectTransform(&Transform, Rotation, Width, Height, OriginX, OriginY, TexWidth, TexHeight, OriginX + Width, Height);
+            for (UINT f = 0; f < Options->Frames && Matched; ++f)
+            {
+                const RECT* Frame = &Dirty[static_cast<size_t>(f) * MAX_DIRTY_RECTS];
+                TransformDirtyRects(&Transform, Frame, Counts[f], Vertices, DestRects);
+                Matched = CheckInstances(&Transform, Frame, Counts[f], Vertices);
+
+                RECT InstanceDest[MAX_DIRTY_RECTS];
+                TransformDirtyDestRects(&Transform, Frame, Counts[f], InstanceDest);
+                Matched = Matched && memcmp(InstanceDest, DestRects, Counts[f] * sizeof(RECT)) == 0;
+            }
+            if (!Matched)
+            {
+                fprintf(stderr, "%s: instanced rects differ at rotation %d\n", Workload.Name, (Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90);
+                Succeeded = false;
+                break;
+            }
+        }
+
+        // Timed at the rotation asked for, the whole trace enough times to time a fair number of rects
+        RECT_TRANSFORM Transform;
+        InitRectTransform(&Transform, Options->Rotation, Options->Width, Options->Height, OriginX, OriginY, TexWidth, TexHeight, OriginX + Options->Width, Options->Height);
+        UINT Repeats = TotalRects ? std::max(1u, TRANSFORM_RECTS_TIMED / TotalRects) : 1;
+
+        uint64_t Start = NowNs();
+        for (UINT Repeat = 0; Repeat < Repeats; ++Repeat)
+        {
+            for (UINT f = 0; f < Options->Frames; ++f)
+            {
+                TransformDirtyRects(&Transform, &Dirty[static_cast<size_t>(f) * MAX_DIRTY_RECTS], Counts[f], Vertices, DestRects);
+                memcpy(Upload, Vertices, Counts[f] * RECT_VERTICES * sizeof(RECT_VERTEX));
+            }
+        }
+        double VertexNs = static_cast<double>(NowNs() - Start) / (static_cast<double>(Repeats) * Options->Frames);
+
+        Start = NowNs();
+        for (UINT Repeat = 0; Repeat < Repeats; ++Repeat)
+        {
+            for (UINT f = 0; f < Options->Frames; ++f)
+            {
+                const RECT* Frame = &Dirty[static_cast<size_t>(f) * MAX_DIRTY_RECTS];
+                TransformDirtyDestRects(&Transform, Frame, Counts[f], DestRects);
+                InitRectConstants(&Transform, reinterpret_cast<RECT_CONSTANTS*>(Upload));
+                memcpy(Upload + sizeof(RECT_CONSTANTS), Frame, Counts[f] * sizeof(RECT));
+            }
+        }
+        double InstanceNs = static_cast<double>(NowNs() - Start) / (static_cast<double>(Repeats) * Options->Frames);
+
+        // Frames without dirty rects upload nothing either way
+        UINT DrawnFrames = 0;
+        for (UINT f = 0; f < Options->Frames; ++f)
+        {
+            DrawnFrames += Counts[f] ? 1 : 0;
+        }
+        double VertexBytes = static_cast<double>(TotalRects) * RECT_VERTICES * sizeof(RECT_VERTEX) / Options->Frames;
+        double InstanceBytes = (static_cast<double>(TotalRects) * sizeof(RECT) + static_cast<double>(DrawnFrames) * sizeof(RECT_CONSTANTS)) / Options->Frames;
+
+        printf("%-12s %8u %10u %12.1f %12.1f %12.1f %12.1f %8s\n", Workload.Name, Options->Frames, TotalRects, VertexBytes, InstanceBytes,
+               VertexNs, InstanceNs, Matched ? "yes" : "no");
+    }
+
+    delete [] Counts;
+    delete [] Dirty;
+    delete [] DestRects;
+    delete [] Vertices;
+    delete [] Upload;
+
+    if (!Found)
+    {
+        ShowHelp();
+    }
+    return Succeeded && Found;
+}
+
+// The governed headset refreshes at 90 Hz and the presenter has the default profile's pacing offset to finish
+#define GOVERNOR_PERIOD_NS 11111111ull
+#define GOVERNOR_BUDGET_NS 5000000ull
+#define GOVERNOR_TRACE_FRAMES 5400
+
+//
+// Cost of one frame at full quality
+//
+typedef struct _GOVERNOR_TRACE_FRAME
+{
+    uint64_t CpuNs;
+    uint64_t GpuNs;
+} GOVERNOR_TRACE_FRAME;
+
+// Modeled share of the full quality cost left at each level, in percent. Shedding takes work off the presenter
+// and off the capture threads sharing the GPU with it.
+static const UINT GovernorCpuPercent[GOVERNOR_LEVEL_COUNT] = {100, 96, 88, 80, 76};
+static const UINT GovernorGpuPercent[GOVERNOR_LEVEL_COUNT] = {100, 100, 85, 70, 50};
+
+//
+// The presenter alone on the GPU, with spells of a game sharing it that queue the presenter's work behind its
+// own, and the odd spike on top
+//
+static bool GenerateGovernorTrace(GOVERNOR_TRACE_FRAME** Frames, UINT* Count)
+{
+    *Frames = new (std::nothrow) GOVERNOR_TRACE_FRAME[GOVERNOR_TRACE_FRAMES];
+    *Count = 0;
+    if (!*Frames)
+    {
+        return false;
+    }
+
+    uint32_t Seed = 12345;
+    auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+
+    bool Contended = false;
+    uint64_t QueueNs = 0;
+    UINT SpellEnd = 0;
+    for (UINT i = 0; i < GOVERNOR_TRACE_FRAMES; ++i)
+    {
+        if (i >= SpellEnd)
+        {
+            // Spells of 2 to 10 seconds, a game waiting on the GPU queues 0.5 to 3 ms in front of us
+            Contended = !Contended;
+            QueueNs = Contended ? (500 + Random(2500)) * 1000ull : 0;
+            SpellEnd = i + 180 + Random(720);
+        }
+
+        GOVERNOR_TRACE_FRAME* Frame = &(*Frames)[(*Count)++];
+        Frame->CpuNs = (1000 + Random(600)) * 1000ull;
+        Frame->GpuNs = (1500 + Random(800)) * 1000ull + (Contended ? QueueNs + Random(1000) * 1000ull : 0);
+        if (Random(100) == 0)
+        {
+            Frame->GpuNs += 4000000ull;
+        }
+    }
+    return true;
+}
+
+//
+// Read a timing trace of one "cpu_ns gpu_ns" line per presented frame, Frames is allocated with new[] and owned
+// by the caller
+//
+static bool LoadGovernorTrace(const char* Path, GOVERNOR_TRACE_FRAME** Frames, UINT* Count)
+{
+    *Frames = nullptr;
+    *Count = 0;
+
+    FILE* File = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&File, Path, "r") != 0)
+    {
+        File = nullptr;
+    }
+#else
+    File = fopen(Path, "r");
+#endif
+    if (!File)
+    {
+        return false;
+    }
+
+    UINT Capacity = 0;
+    char Line[128];
+    bool Result = true;
+    while (fgets(Line, sizeof(Line), File))
+    {
+        unsigned long long CpuNs;
+        unsigned long long GpuNs;
+        if (Line[0] == '#' || sscanf(Line, "%llu %llu", &CpuNs, &GpuNs) != 2)
+        {
+            continue;
+        }
+
+        if (*Count == Capacity)
+        {
+            UINT NewCapacity = Capacity ? Capacity * 2 : 1024;
+            GOVERNOR_TRACE_FRAME* Grown = new (std::nothrow) GOVERNOR_TRACE_FRAME[NewCapacity];
+            if (!Grown)
+            {
+                Result = false;
+                break;
+            }
+            if (*Frames)
+            {
+                memcpy(Grown, *Frames, *Count * sizeof(GOVERNOR_TRACE_FRAME));
+                delete [] *Frames;
+            }
+            *Frames = Grown;
+            Capacity = NewCapacity;
+        }
+
+        (*Frames)[*Count].CpuNs = CpuNs;
+        (*Frames)[*Count].GpuNs = GpuNs;
+        ++*Count;
+    }
+    fclose(File);
+    return Result;
+}
+
+//
+// Play a trace through the governor in a closed loop, each frame costing what its level leaves of the traced cost.
+// GPU costs reach the governor PROFILE_LATENCY frames late as they do from the timeline. Levels holds the level
+// each frame ran at, and the number of frames over budget is returned.
+//
+static UINT ReplayGovernor(const GOVERNOR_TRACE_FRAME* Frames, UINT Count, GOVERNOR_LEVEL* Levels, GOVERNOR_STATS* Stats)
+{
+    FRAMEGOVERNOR Governor;
+    Governor.Initialize(GOVERNOR_PERIOD_NS, GOVERNOR_BUDGET_NS);
+
+    uint64_t GpuNs[PROFILE_LATENCY] = {};
+    GOVERNOR_LEVEL Level = GOVERNOR_LEVEL_FULL;
+    UINT Missed = 0;
+    for (UINT i = 0; i < Count; ++i)
+    {
+        Levels[i] = Level;
+        uint64_t CpuNs = Frames[i].CpuNs * GovernorCpuPercent[Level] / 100;
+        uint64_t FrameGpuNs = Frames[i].GpuNs * GovernorGpuPercent[Level] / 100;
+        Missed += (CpuNs > GOVERNOR_BUDGET_NS || FrameGpuNs > GOVERNOR_BUDGET_NS) ? 1 : 0;
+
+        GOVERNOR_SAMPLE Sample;
+        Sample.CpuNs = CpuNs;
+        Sample.HasGpu = (i >= PROFILE_LATENCY);
+        Sample.GpuNs = GpuNs[i % PROFILE_LATENCY];
+        GpuNs[i % PROFILE_LATENCY] = FrameGpuNs;
+        Level = Governor.AddFrame(&Sample);
+    }
+    Governor.GetStats(Stats);
+    return Missed;
+}
+
+//
+// Levels only ever move one step, and only once the last change has settled and enough frames in a row were
+// over or under budget
+//
+static bool CheckGovernorSteps(const GOVERNOR_LEVEL* Levels, UINT Count)
+{
+    UINT LastChange = 0;
+    bool Changed = false;
+    for (UINT i = 1; i < Count; ++i)
+    {
+        if (Levels[i] == Levels[i - 1])
+        {
+            continue;
+        }
+
+        bool Shed = (Levels[i] == Levels[i - 1] + 1);
+        if (!Shed && Levels[i] + 1 != Levels[i - 1])
+        {
+            return false;
+        }
+        UINT Needed = (Shed ? GOVERNOR_SHED_FRAMES : GOVERNOR_RESTORE_FRAMES) + (Changed ? GOVERNOR_SETTLE_FRAMES : 0);
+        if (i - LastChange < Needed)
+        {
+            return false;
+        }
+        LastChange = i;
+        Changed = true;
+    }
+    return true;
+}
+
+//
+// Replay a timing trace, or a generated one of a game contending for the GPU, with and without the governor.
+// Replays are checked to give the same levels every time and to change them only as the governor promises.
+//
+static bool RunGovernor(const BENCHMARK_OPTIONS* Options)
+{
+    GOVERNOR_TRACE_FRAME* Frames = nullptr;
+    UINT Count = 0;
+    bool Synthetic = (strcmp(Options->GovernorTrace, "synthetic") == 0);
+    bool Loaded = Synthetic ? GenerateGovernorTrace(&Frames, &Count) : LoadGovernorTrace(Options->GovernorTrace, &Frames, &Count);
+    if (!Loaded || !Count)
+    {
+        fprintf(stderr, "Failed to load timing trace %s\n", Options->GovernorTrace);
+        delete [] Frames;
+        return false;
+    }
+
+    GOVERNOR_LEVEL* Levels = new (std::nothrow) GOVERNOR_LEVEL[Count];
+    GOVERNOR_LEVEL* Replayed = new (std::nothrow) GOVERNOR_LEVEL[Count];
+    if (!Levels || !Replayed)
+    {
+        delete [] Frames;
+        delete [] Levels;
+        delete [] Replayed;
+        return false;
+    }
+
+    UINT Ungoverned = 0;
+    for (UINT i = 0; i < Count; ++i)
+    {
+        Ungoverned += (Frames[i].CpuNs > GOVERNOR_BUDGET_NS || Frames[i].GpuNs > GOVERNOR_BUDGET_NS) ? 1 : 0;
+    }
+
+    GOVERNOR_STATS Stats;
+    GOVERNOR_STATS ReplayedStats;
+    uint64_t Start = NowNs();
+    UINT Governed = ReplayGovernor(Frames, Count, Levels, &Stats);
+    uint64_t Elapsed = NowNs() - Start;
+    UINT GovernedAgain = ReplayGovernor(Frames, Count, Replayed, &ReplayedStats);
+
+    bool Deterministic = (Governed == GovernedAgain) && (memcmp(Levels, Replayed, Count * sizeof(GOVERNOR_LEVEL)) == 0) &&
+                         (memcmp(&Stats, &ReplayedStats, sizeof(Stats)) == 0);
+    bool Stepped = CheckGovernorSteps(Levels, Count);
+
+    printf("%s, %u frames, %.1f ms budget of %.1f ms\n\n", Synthetic ? "synthetic contention" : Options->GovernorTrace, Count,
+           GOVERNOR_BUDGET_NS / 1000000.0, GOVERNOR_PERIOD_NS / 1000000.0);
+    printf("%-14s %10s %10s\n", "", "missed", "missed %");
+    printf("%-14s %10u %10.2f\n", "ungoverned", Ungoverned, 100.0 * Ungoverned / Count);
+    printf("%-14s %10u %10.2f\n\n", "governed", Governed, 100.0 * Governed / Count);
+    printf("%u sheds, %u restores, %.0f ns/frame deciding\n", Stats.Sheds, Stats.Restores, static_cast<double>(Elapsed) / Count);
+    for (UINT l = 0; l < GOVERNOR_LEVEL_COUNT; ++l)
+    {
+        printf("  %-14s %6.2f%% of frames\n", GetGovernorLevelName(static_cast<GOVERNOR_LEVEL>(l)), 100.0 * Stats.FramesAtLevel[l] / Count);
+    }
+    printf("replay %s, steps %s\n", Deterministic ? "deterministic" : "NOT DETERMINISTIC", Stepped ? "ok" : "OUT OF ORDER");
+
+    delete [] Frames;
+    delete [] Levels;
+    delete [] Replayed;
+    return Deterministic && Stepped;
+}
+
+// Modes of the modeled headset, all at one resolution, and the one the mode policy picks
+static const MODE_CANDIDATE RefreshModes[] = {{2160, 1200, 60.0, true}, {2160, 1200, 72.0, true}, {2160, 1200, 90.0, true},
+                                              {2160, 1200, 120.0, true}, {2160, 1200, 144.0, true}};
+#define REFRESH_DEFAULT_MODE 2
+
+// The desktop composes at 60 Hz, every scenario runs this long
+#define REFRESH_DESKTOP_NS 16666667ull
+#define REFRESH_SCENARIO_NS 20000000000ull
+
+// Modeled GPU time of a v-blank, with the desktop or pointer redrawn and with only a present
+#define REFRESH_DRAW_NS 500000ull
+#define REFRESH_PRESENT_NS 50000ull
+
+typedef enum
+{
+    REFRESH_ACTIVITY_NONE    = 0,
+    REFRESH_ACTIVITY_TYPING  = 1,
+    REFRESH_ACTIVITY_VIDEO   = 2,
+    REFRESH_ACTIVITY_POINTER = 3
+} REFRESH_ACTIVITY;
+
+typedef struct _REFRESH_SCENARIO
+{
+    const char* Name;
+    REFRESH_ACTIVITY Activity;
+    uint32_t VideoMilliHz;
+
+    // Rate the headset should settle at
+    double ExpectedRate;
+} REFRESH_SCENARIO;
+
+static const REFRESH_SCENARIO RefreshScenarios[] = {
+    {"idle",        REFRESH_ACTIVITY_NONE,      0,      60.0},
+    {"typing",      REFRESH_ACTIVITY_TYPING,    0,      90.0},
+    {"video 24",    REFRESH_ACTIVITY_VIDEO,     24000,  72.0},
+    {"video 23.976", REFRESH_ACTIVITY_VIDEO,    23976,  72.0},
+    {"video 30",    REFRESH_ACTIVITY_VIDEO,     30000,  60.0},
+    {"video 60",    REFRESH_ACTIVITY_VIDEO,     60000,  60.0},
+    {"pointer",     REFRESH_ACTIVITY_POINTER,   0,      144.0},
+};
+
+typedef struct _REFRESH_RESULT
+{
+    REFRESH_STATS Stats;
+    uint64_t GpuNs;
+    double FinalRate;
+    REFRESH_CONTENT FinalContent;
+} REFRESH_RESULT;
+
+//
+// Run one scenario on the headset's v-blanks, at the rates the policy picks or fixed at the default mode
+//
+static void RunRefreshScenario(const REFRESH_SCENARIO* Scenario, const POINTER_SAMPLE* Pointer, UINT PointerCount, bool Adapt, REFRESH_RESULT* Result)
+{
+    REFRESHPOLICY Policy;
+    Policy.Initialize(RefreshModes, sizeof(RefreshModes) / sizeof(RefreshModes[0]), REFRESH_DEFAULT_MODE);
+
+    uint32_t Seed = 12345;
+    auto Random = [&Seed](uint32_t Range) { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) % Range; };
+
+    // Desktop updates land on the desktop's v-blanks
+    uint64_t NextUpdate = UINT64_MAX;
+    uint64_t VideoFrame = 0;
+    if (Scenario->Activity == REFRESH_ACTIVITY_TYPING)
+    {
+        NextUpdate = REFRESH_DESKTOP_NS * (1 + Random(20));
+    }
+    else if (Scenario->Activity == REFRESH_ACTIVITY_VIDEO)
+    {
+        NextUpdate = REFRESH_DESKTOP_NS;
+    }
+    UINT NextPointer = 0;
+
+    Result->GpuNs = 0;
+    int Mode = REFRESH_DEFAULT_MODE;
+    uint64_t Now = REFRESH_DESKTOP_NS;
+    while (Now < REFRESH_SCENARIO_NS)
+    {
+        bool Changed = false;
+        while (NextUpdate <= Now)
+        {
+            Policy.AddDesktopUpdate(NextUpdate);
+            Changed = true;
+            if (Scenario->Activity == REFRESH_ACTIVITY_TYPING)
+            {
+                NextUpdate += REFRESH_DESKTOP_NS * (5 + Random(20));
+            }
+            else
+            {
+                ++VideoFrame;
+                uint64_t FrameNs = REFRESH_DESKTOP_NS + VideoFrame * 1000000000000ull / Scenario->VideoMilliHz;
+                NextUpdate = (FrameNs + REFRESH_DESKTOP_NS - 1) / REFRESH_DESKTOP_NS * REFRESH_DESKTOP_NS;
+            }
+        }
+        while (Scenario->Activity == REFRESH_ACTIVITY_POINTER && NextPointer < PointerCount && Pointer[NextPointer].Time <= Now)
+        {
+            Policy.AddPointerMove(Pointer[NextPointer++].Time);
+            Changed = true;
+        }
+        Result->GpuNs += Changed ? REFRESH_DRAW_NS : REFRESH_PRESENT_NS;
+
+        int Wanted = Policy.AddVBlank(Now);
+        if (Adapt && Wanted != Mode)
+        {
+            Policy.SetMode(Wanted, Now);
+            Mode = Wanted;
+        }
+        Now += static_cast<uint64_t>(1000000000.0 / RefreshModes[Mode].RefreshRate);
+    }
+
+    Policy.GetStats(&Result->Stats);
+    Result->FinalRate = RefreshModes[Mode].RefreshRate;
+    Result->FinalContent = Policy.GetContent();
+}
+
+//
+// Play desktop scenarios through the refresh policy, check the rate each settles at, and compare the v-blanks
+// and modeled GPU time per hour against staying at the mode policy's rate
+//
+static bool RunRefresh(const BENCHMARK_OPTIONS* Options)
+{
+    POINTER_SAMPLE* Pointer = nullptr;
+    UINT PointerCount = 0;
+    if (!GenerateTrace(Options->Width, Options->Height, SYNTHETIC_UPDATE_NS, &Pointer, &PointerCount))
+    {
+        return false;
+    }
+
+    printf("modes 60, 72, 90, 120 and 144 Hz, %.0f Hz by the mode policy\n\n", RefreshModes[REFRESH_DEFAULT_MODE].RefreshRate);
+    printf("%-13s %-8s %9s %9s %9s %14s %14s %14s %14s\n", "scenario", "content", "rate Hz", "average", "switches", "v-blanks/h", "fixed v-b/h", "GPU ms/h", "fixed GPU ms/h");
+    bool Succeeded = true;
+    for (const REFRESH_SCENARIO& Scenario : RefreshScenarios)
+    {
+        REFRESH_RESULT Adapted;
+        REFRESH_RESULT Fixed;
+        RunRefreshScenario(&Scenario, Pointer, PointerCount, true, &Adapted);
+        RunRefreshScenario(&Scenario, Pointer, PointerCount, false, &Fixed);
+
+        double PerHour = 3600e9 / Adapted.Stats.ElapsedNs;
+        double FixedPerHour = 3600e9 / Fixed.Stats.ElapsedNs;
+        bool Settled = fabs(Adapted.FinalRate - Scenario.ExpectedRate) < 0.05;
+        Succeeded = Succeeded && Settled;
+        printf("%-13s %-8s %9.0f %9.2f %9u %14.0f %14.0f %14.0f %14.0f%s\n", Scenario.Name, GetRefreshContentName(Adapted.FinalContent), Adapted.FinalRate,
+               Adapted.Stats.VBlanks * 1e9 / Adapted.Stats.ElapsedNs, Adapted.Stats.Switches, Adapted.Stats.VBlanks * PerHour, Fixed.Stats.VBlanks * FixedPerHour,
+               Adapted.GpuNs / 1e6 * PerHour, Fixed.GpuNs / 1e6 * FixedPerHour, Settled ? "" : "  WRONG RATE");
+    }
+
+    delete [] Pointer;
+    return Succeeded;
+}
+
+// Largest blob read, and the most timings a blob is checked for
+#define EDID_BLOB_MAX_SIZE (EDID_BLOCK_SIZE * 4)
+#define EDID_EXPECTED_TIMINGS 8
+
+//
+// What ParseEdid and SelectMode should make of one blob. Modes are picked among its timings, the first one
+// preferred, for a profile at the display's preferred resolution and ProfileRate.
+//
+typedef struct _EDID_EXPECTED
+{
+    const char* File;
+    uint16_t ProductId;
+    const char* Name;
+    uint32_t MinRefreshRate;
+    uint32_t MaxRefreshRate;
+    EDID_TIMING Timings[EDID_EXPECTED_TIMINGS];
+    uint32_t TimingCount;
+    double ProfileRate;
+    int ProfileMode;
+    int HighestRefreshMode;
+    int LowestLatencyMode;
+} EDID_EXPECTED;
+
+// Only the size, rate and interlacing of each timing are checked
+static const EDID_EXPECTED EdidExpected[] =
+{
+    // Base block only
+    {"base.bin", 0xc207, "TEST HMD", 60, 90,
+     {{0, 1920, 1080, 0, 0, 90.0, false}, {0, 1920, 1080, 0, 0, 60.0, false}}, 2,
+     60.0, 1, 0, 0},
+
+    // CTA-861 detailed timing, then codes 4, 5, 63 and 97. Code 16 repeats the preferred timing.
+    {"cta.bin", 0x0001, "TEST TV", 24, 120,
+     {{0, 1920, 1080, 0, 0, 60.0, false}, {0, 2560, 1440, 0, 0, 120.0, false}, {0, 1280, 720, 0, 0, 60.0, false},
+      {0, 1920, 1080, 0, 0, 60.05, true}, {0, 1920, 1080, 0, 0, 120.0, false}, {0, 3840, 2160, 0, 0, 60.0, false}}, 6,
+     60.0, 0, 4, 4},
+
+    // 1080i60 between 1080p60 and 1080p100, counting its frame rate twice would make it the fastest
+    {"interlaced.bin", 0x0002, "TEST ITL", 0, 0,
+     {{0, 1920, 1080, 0, 0, 60.0, false}, {0, 1920, 1080, 0, 0, 60.05, true}, {0, 1920, 1080, 0, 0, 100.0, false}}, 3,
+     60.0, 0, 2, 2},
+
+    // DisplayID type I timings at 120 and 100 Hz, type VII at 144 Hz, one of them at a lower resolution
+    {"displayid.bin", 0x0003, "TEST DID", 72, 144,
+     {{0, 2160, 1200, 0, 0, 90.0, false}, {0, 2160, 1200, 0, 0, 120.0, false}, {0, 2160, 1200, 0, 0, 100.0, false},
+      {0, 2160, 1200, 0, 0, 144.0, false}, {0, 1920, 1080, 0, 0, 144.0, false}}, 5,
+     90.0, 0, 3, 4},
+};
+
+static size_t ReadEdidBlob(const char* Dir, const char* File, uint8_t* Data)
+{
+    char Path[512];
+    snprintf(Path, sizeof(Path), "%s/%s", Dir, File);
+    FILE* Blob = fopen(Path, "rb");
+    if (!Blob)
+    {
+        fprintf(stderr, "Failed to open %s\n", Path);
+        return 0;
+    }
+    size_t Size = fread(Data, 1, EDID_BLOB_MAX_SIZE, Blob);
+    fclose(Blob);
+    return Size;
+}
+
+static bool CheckEdidBlob(const EDID_EXPECTED* Expected, const uint8_t* Data, size_t Size)
+{
+    EDID_INFO Info;
+    if (!ParseEdid(Data, Size, &Info))
+    {
+        fprintf(stderr, "%s: not parsed\n", Expected->File);
+        return false;
+    }
+
+    bool Succeeded = true;
+    if (Info.VendorId != 0xd94d || Info.ProductId != Expected->ProductId || strcmp(Info.Manufacturer, "SNY") != 0 ||
+        strcmp(Info.Name, Expected->Name) != 0 || Info.MinRefreshRate != Expected->MinRefreshRate || Info.MaxRefreshRate != Expected->MaxRefreshRate)
+    {
+        fprintf(stderr, "%s: read %04x:%04x %s \"%s\" %u-%u Hz\n", Expected->File, Info.VendorId, Info.ProductId, Info.Manufacturer, Info.Name,
+                Info.MinRefreshRate, Info.MaxRefreshRate);
+        Succeeded = false;
+    }
+
+    bool TimingsMatch = (Info.TimingCount == Expected->TimingCount);
+    for (uint32_t i = 0; TimingsMatch && i < Info.TimingCount; ++i)
+    {
+        const EDID_TIMING* Timing = &Info.Timings[i];
+        const EDID_TIMING* Wanted = &Expected->Timings[i];
+        TimingsMatch = Timing->Width == Wanted->Width && Timing->Height == Wanted->Height && Timing->Interlaced == Wanted->Interlaced &&
+                       fabs(Timing->RefreshRate - Wanted->RefreshRate) < 0.01;
+    }
+    if (!TimingsMatch)
+    {
+        fprintf(stderr, "%s: timings are\n", Expected->File);
+        for (uint32_t i = 0; i < Info.TimingCount; ++i)
+        {
+            fprintf(stderr, "  %ux%u%s %.2f Hz\n", Info.Timings[i].Width, Info.Timings[i].Height, Info.Timings[i].Interlaced ? "i" : "",
+                    Info.Timings[i].RefreshRate);
+        }
+        return false;
+    }
+
+    // The modes the display manager would list for these timings
+    MODE_CANDIDATE Modes[EDID_MAX_TIMINGS];
+    for (uint32_t i = 0; i < Info.TimingCount; ++i)
+    {
+        Modes[i] = {Info.Timings[i].Width, Info.Timings[i].Height, Info.Timings[i].RefreshRate, i == 0};
+    }
+    HMD_PROFILE Profile = {"check", Info.VendorId, Info.ProductId, 0, 0, Expected->ProfileRate, HMD_MIN_SCANOUT_COUNT, 0};
+    int Picked[3] = {SelectMode(Modes, Info.TimingCount, &Profile, MODE_POLICY_PROFILE),
+                     SelectMode(Modes, Info.TimingCount, &Profile, MODE_POLICY_HIGHEST_REFRESH),
+                     SelectMode(Modes, Info.TimingCount, &Profile, MODE_POLICY_LOWEST_LATENCY)};
+    int Wanted[3] = {Expected->ProfileMode, Expected->HighestRefreshMode, Expected->LowestLatencyMode};
+    static const char* PolicyNames[3] = {"profile", "refresh", "latency"};
+    for (UINT i = 0; i < 3; ++i)
+    {
+        if (Picked[i] != Wanted[i])
+        {
+            fprintf(stderr, "%s: the %s policy picked mode %d instead of %d\n", Expected->File, PolicyNames[i], Picked[i], Wanted[i]);
+            Succeeded = false;
+        }
+    }
+
+    printf("%-16s %3s %04x:%04x %-10s %8u %8d %8d %8d\n", Expected->File, Info.Manufacturer, Info.VendorId, Info.ProductId, Info.Name,
+           Info.TimingCount, Picked[0], Picked[1], Picked[2]);
+    return Succeeded;
+}
+
+//
+// Parse the EDID blobs in Dir and check what comes out of each, then which mode each mode policy picks among
+// its timings. Blobs with a corrupt base block must be refused, a corrupt extension only skipped.
+//
+static bool RunEdid(const BENCHMARK_OPTIONS* Options)
+{
+    uint8_t Data[EDID_BLOB_MAX_SIZE];
+    bool Succeeded = true;
+
+    printf("%-16s %3s %9s %-10s %8s %8s %8s %8s\n", "blob", "mfg", "id", "name", "timings", "profile", "refresh", "latency");
+    for (const EDID_EXPECTED& Expected : EdidExpected)
+    {
+        size_t Size = ReadEdidBlob(Options->EdidDir, Expected.File, Data);
+        Succeeded = Size && CheckEdidBlob(&Expected, Data, Size) && Succeeded;
+    }
+
+    // A flipped bit in the base block fails its checksum, one in the DisplayID extension leaves the base block
+    EDID_INFO Info;
+    size_t Size = ReadEdidBlob(Options->EdidDir, "displayid.bin", Data);
+    if (Size == 2 * EDID_BLOCK_SIZE)
+    {
+        Data[EDID_BLOCK_SIZE + 10] ^= 1;
+        if (!ParseEdid(Data, Size, &Info) || Info.TimingCount != 1)
+        {
+            fprintf(stderr, "A corrupt extension was not skipped\n");
+            Succeeded = false;
+        }
+        Data[20] ^= 1;
+        if (ParseEdid(Data, Size, &Info) || ParseEdid(Data, EDID_BLOCK_SIZE - 1, &Info))
+        {
+            fprintf(stderr, "A corrupt or truncated base block was parsed\n");
+            Succeeded = false;
+        }
+    }
+    else
+    {
+        Succeeded = false;
+    }
+
+    return Succeeded;
+}
+
+#ifdef HAVE_X11_CAPTURE
+
+// Capture gives up after this many waits in a row with nothing changing on the server
+#define X11_IDLE_WAITS 10
+
+//
+// Capture frames from an X server and put them through the software backend the way DISPLAYMANAGER and
+// OUTPUTMANAGER put duplicated frames through the GPU: damage into the desktop image, then the damage and where
+// the pointer was into the scanout with the pointer on top. With --profile each frame's passes go on a timeline,
+// the duplication thread's on lane 1 and the presenter's on lane 0, and the timeline is exported.
+//
+static bool RunX11(const BENCHMARK_OPTIONS* Options)
+{
+    X11DUPLICATIONMANAGER Dupl;
+    if (Dupl.InitDupl(Options->X11Display) != DUPL_RETURN_SUCCESS)
+    {
+        fprintf(stderr, "Failed to capture %s\n", Options->X11Display);
+        return false;
+    }
+
+    RECT Desktop;
+    Dupl.GetDesktopCoordinates(&Desktop);
+    UINT Width = Desktop.right - Desktop.left;
+    UINT Height = Desktop.bottom - Desktop.top;
+
+    SOFTWARECOMPOSITOR Compositor;
+    SOFTWARECOMPOSITOR ScanoutHolder;
+    FRAMEARENA Arena;
+    PROFILETIMELINE Timeline;
+    if (!Compositor.Initialize(Width, Height) || !ScanoutHolder.Initialize(Width, Height) || !Arena.Initialize(FRAMEARENA_GRANULARITY) ||
+        (Options->ProfilePath && !Timeline.Initialize(PROFILE_EVENT_CAPACITY)))
+    {
+        return false;
+    }
+    SOFTWARE_SURFACE* Scanout = ScanoutHolder.GetDesktop();
+
+    // The position carries a lock, so these are constructed rather than zeroed
+    PTR_INFO PtrInfo = {};
+    PTR_POSITION PtrPosition = {};
+    InitializeSRWLock(&PtrPosition.Lock);
+    RECT LastPointer = {0, 0, 0, 0};
+    UINT Frames = 0;
+    UINT PointerOnly = 0;
+    UINT ShapeChanges = 0;
+    UINT IdleWaits = 0;
+    uint64_t RectCount = 0;
+    uint64_t DirtyPixels = 0;
+    uint64_t ApplyNs = 0;
+    uint64_t DrawNs = 0;
+    uint64_t MouseNs = 0;
+    uint64_t Allocations = 0;
+    bool Succeeded = true;
+
+    printf("%s, %ux%u, up to %u frames\n\n", Options->X11Display, Width, Height, Options->Frames);
+    while (Frames < Options->Frames && IdleWaits < X11_IDLE_WAITS)
+    {
+        Arena.Reset();
+        FRAME_DATA Data;
+        bool Timeout;
+        if (Dupl.GetFrame(&Data, &Arena, &Timeout) != DUPL_RETURN_SUCCESS)
+        {
+            fprintf(stderr, "Failed to capture frame %u\n", Frames);
+            Succeeded = false;
+            break;
+        }
+        if (Timeout)
+        {
+            ++IdleWaits;
+            continue;
+        }
+        IdleWaits = 0;
+
+        // The first frame grows the buffers, count from the second
+        if (Frames == 1)
+        {
+            Allocations = AllocationCount.load(std::memory_order_relaxed);
+        }
+
+        // Apply the damage, like DISPLAYMANAGER::ProcessFrame
+        uint64_t ApplyStart = NowNs();
+        const RECT* Dirty = reinterpret_cast<const RECT*>(Data.MetaData + Data.MoveCount * sizeof(DXGI_OUTDUPL_MOVE_RECT));
+        RECT* DirtyDest = Arena.AllocArray<RECT>(std::max(Data.DirtyCount, 1u));
+        if (!DirtyDest)
+        {
+            Succeeded = false;
+            break;
+        }
+        Compositor.CopyDirty(Data.Frame, Dirty, Data.DirtyCount, DXGI_MODE_ROTATION_IDENTITY, DirtyDest);
+
+        UINT ShapeSerial = PtrInfo.ShapeSerial;
+        if (Dupl.GetMouse(&PtrInfo, &PtrPosition, &Data.FrameInfo, Desktop.left, Desktop.top) != DUPL_RETURN_SUCCESS ||
+            Dupl.DoneWithFrame() != DUPL_RETURN_SUCCESS)
+        {
+            fprintf(stderr, "Failed to get the pointer of frame %u\n", Frames);
+            Succeeded = false;
+            break;
+        }
+        uint64_t DrawStart = NowNs();
+
+        // Present: refresh the damaged regions and where the pointer was, then draw the pointer
+        for (UINT i = 0; i < Data.DirtyCount; ++i)
+        {
+            Compositor.CopyRect(Compositor.GetDesktop(), &DirtyDest[i], Scanout);
+            DirtyPixels += RectPixels(&DirtyDest[i]);
+        }
+        Compositor.CopyRect(Compositor.GetDesktop(), &LastPointer, Scanout);
+        uint64_t MouseStart = NowNs();
+        if (PtrPosition.Visible && PtrInfo.PtrShapeBuffer)
+        {
+            Compositor.DrawPointer(PtrInfo.PtrShapeBuffer, &PtrInfo.ShapeInfo, PtrPosition.Position, Scanout);
+            LastPointer = {PtrPosition.Position.x, PtrPosition.Position.y, PtrPosition.Position.x + static_cast<LONG>(PtrInfo.ShapeInfo.Width),
+                           PtrPosition.Position.y + static_cast<LONG>(PtrInfo.ShapeInfo.Height)};
+        }
+        else
+        {
+            LastPointer = {0, 0, 0, 0};
+        }
+        uint64_t MouseEnd = NowNs();
+
+        ApplyNs += DrawStart - ApplyStart;
+        DrawNs += MouseStart - DrawStart;
+        MouseNs += MouseEnd - MouseStart;
+        RectCount += Data.DirtyCount;
+        PointerOnly += Data.FrameInfo.LastPresentTime.QuadPart ? 0 : 1;
+        ShapeChanges += (PtrInfo.ShapeSerial != ShapeSerial) ? 1 : 0;
+        if (Options->ProfilePath)
+        {
+            if (Data.DirtyCount)
+            {
+                Timeline.AddCpuSpan(1, Frames, PROFILE_PASS_COPY_DIRTY, ApplyStart, DrawStart);
+            }
+            Timeline.AddCpuSpan(0, Frames, PROFILE_PASS_DRAW_FRAME, DrawStart, MouseStart);
+            Timeline.AddCpuSpan(0, Frames, PROFILE_PASS_DRAW_MOUSE, MouseStart, MouseEnd);
+        }
+        ++Frames;
+    }
+
+    if (Frames)
+    {
+        double AllocationsPerFrame = (Frames > 1) ? static_cast<double>(AllocationCount.load(std::memory_order_relaxed) - Allocations) / (Frames - 1) : 0.0;
+        printf("%8s %8s %8s %12s %12s %10s %10s %10s %13s\n", "frames", "pointer", "shapes", "rects/frame", "Mpx/frame", "apply ms", "draw ms", "mouse ms", "allocs/frame");
+        printf("%8u %8u %8u %12.2f %12.3f %10.3f %10.3f %10.3f %13.2f\n", Frames, PointerOnly, ShapeChanges, static_cast<double>(RectCount) / Frames,
+               DirtyPixels / 1e6 / Frames, ApplyNs / 1e6 / Frames, DrawNs / 1e6 / Frames, MouseNs / 1e6 / Frames, AllocationsPerFrame);
+    }
+    if (IdleWaits >= X11_IDLE_WAITS)
+    {
+        printf("\nnothing changed for %u ms, stopped after %u frames\n", X11_FRAME_TIMEOUT_MS * X11_IDLE_WAITS, Frames);
+    }
+
+    if (Succeeded && Options->ProfilePath && !Timeline.Export(Options->ProfilePath))
+    {
+        fprintf(stderr, "Failed to write %s\n", Options->ProfilePath);
+        Succeeded = false;
+    }
+
+    delete [] PtrInfo.PtrShapeBuffer;
+    return Succeeded && Frames;
+}
+
+#else
+
+static bool RunX11(const BENCHMARK_OPTIONS* Options)
+{
+    fprintf(stderr, "Cannot capture %s, the benchmark was built without the X11 capture backend\n", Options->X11Display);
+    return false;
+}
+
+#endif
+
+//
+// Tile compression alone, into a channel that never pushes back, as the pool grows
+//
+static bool RunScaling(const BENCHMARK_OPTIONS* Options)
+{
+    static const UINT WorkerCounts[] = {1, 2, 4, 8, 16};
+
+    printf("%-12s %8s %12s %12s %10s\n", "workload", "workers", "frames/s", "raw MB/s", "ratio");
+    bool Found = false;
+    for (const WORKLOAD& Workload : Workloads)
+    {
+        if (strcmp(Options->Workload, "all") != 0 && strcmp(Options->Workload, Workload.Name) != 0)
+        {
+            continue;
+        }
+        Found = true;
+
+        for (UINT Workers : WorkerCounts)
+        {
+            BENCHMARK_OPTIONS Run = *Options;
+            Run.Stream = true;
+            Run.StreamClient = false;
+            Run.Workers = Workers;
+
+            BENCHMARK_RESULT Result;
+            if (!RunWorkload(&Workload, &Run, &Result))
+            {
+                fprintf(stderr, "Failed to allocate surfaces for %s\n", Workload.Name);
+                return false;
+            }
+            printf("%-12s %8u %12.1f %12.1f %10.2f\n", Workload.Name, Workers, Result.FramesPerSecond, Result.RawMBPerSecond, Result.CompressionRatio);
+        }
+    }
+
+    if (!Found)
+    {
+        ShowHelp();
+    }
+    return Found;
+}
+
+static bool ProcessCmdline(int Argc, char** Argv, BENCHMARK_OPTIONS* Options)
+{
+    Options->Frames = 600;
+    Options->WarmupFrames = 60;
+    Options->Width = 1920;
+    Options->Height = 1080;
+    Options->Rotation = DXGI_MODE_ROTATION_IDENTITY;
+    Options->Workload = "all";
+    Options->TileDetection = false;
+    Options->Warp = false;
+    Options->FoveationScale = 0;
+    Options->MipLevels = 1;
+    Options->Stream = false;
+    Options->StreamCodec = TILE_CODEC_LZ4;
+    Options->StreamVerify = false;
+    Options->Workers = 0;
+    Options->StreamClient = false;
+    Options->StreamPort = 0;
+    Options->Scaling = false;
+    Options->RecordPrefix = nullptr;
+    Options->PointerTrace = nullptr;
+    Options->PointerSource = false;
+    Options->Transform = false;
+    Options->Apply = false;
+    Options->TileHash = false;
+    Options->Instanced = false;
+    Options->GovernorTrace = nullptr;
+    Options->Refresh = false;
+    Options->EdidDir = nullptr;
+    Options->X11Display = nullptr;
+    Options->ProfilePath = nullptr;
+
+    for (int i = 1; i < Argc; ++i)
+    {
+        if (strcmp(Argv[i], "--workload") == 0 && i + 1 < Argc)
+        {
+            Options->Workload = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--frames") == 0 && i + 1 < Argc)
+        {
+            Options->Frames = atoi(Argv[++i]);
+            if (!Options->Frames)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(Argv[i], "--size") == 0 && i + 1 < Argc)
+        {
+            if (sscanf(Argv[++i], "%dx%d", &Options->Width, &Options->Height) != 2 || Options->Width <= 0 || Options->Height <= 0)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(Argv[i], "--tiles") == 0)
+        {
+            Options->TileDetection = true;
+        }
+        else if (strcmp(Argv[i], "--warp") == 0)
+        {
+            Options->Warp = true;
+        }
+        else if (strcmp(Argv[i], "--foveation") == 0 && i + 1 < Argc)
+        {
+            Options->FoveationScale = atoi(Argv[++i]);
+            if (Options->FoveationScale != 2 && Options->FoveationScale != 4)
+            {
+                return false;
+            }
+            Options->Warp = true;
+        }
+        else if (strcmp(Argv[i], "--mips") == 0 && i + 1 < Argc)
+        {
+            Options->MipLevels = atoi(Argv[++i]);
+            if (Options->MipLevels < 1 || Options->MipLevels > MIP_MAX_LEVELS)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(Argv[i], "--stream") == 0 && i + 1 < Argc)
+        {
+            ++i;
+            if (strcmp(Argv[i], "raw") == 0)
+            {
+                Options->StreamCodec = TILE_CODEC_RAW;
+            }
+            else if (strcmp(Argv[i], "lz4") == 0)
+            {
+                Options->StreamCodec = TILE_CODEC_LZ4;
+            }
+            else
+            {
+                return false;
+            }
+            Options->Stream = true;
+            Options->StreamClient = true;
+        }
+        else if (strcmp(Argv[i], "--tcp") == 0 && i + 1 < Argc)
+        {
+            Options->StreamPort = atoi(Argv[++i]);
+            if (!Options->StreamPort || Options->StreamPort > 65535)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(Argv[i], "--workers") == 0 && i + 1 < Argc)
+        {
+            Options->Workers = atoi(Argv[++i]);
+            if (!Options->Workers || Options->Workers > COMPRESSION_MAX_WORKERS)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(Argv[i], "--scaling") == 0)
+        {
+            Options->Scaling = true;
+        }
+        else if (strcmp(Argv[i], "--record") == 0 && i + 1 < Argc)
+        {
+            Options->RecordPrefix = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--pointertrace") == 0 && i + 1 < Argc)
+        {
+            Options->PointerTrace = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--pointersource") == 0)
+        {
+            Options->PointerSource = true;
+        }
+        else if (strcmp(Argv[i], "--transform") == 0)
+        {
+            Options->Transform = true;
+        }
+        else if (strcmp(Argv[i], "--apply") == 0)
+        {
+            Options->Apply = true;
+        }
+        else if (strcmp(Argv[i], "--tilehash") == 0)
+        {
+            Options->TileHash = true;
+        }
+        else if (strcmp(Argv[i], "--instanced") == 0)
+        {
+            Options->Instanced = true;
+        }
+        else if (strcmp(Argv[i], "--governor") == 0 && i + 1 < Argc)
+        {
+            Options->GovernorTrace = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--refresh") == 0)
+        {
+            Options->Refresh = true;
+        }
+        else if (strcmp(Argv[i], "--edid") == 0 && i + 1 < Argc)
+        {
+            Options->EdidDir = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--x11") == 0 && i + 1 < Argc)
+        {
+            Options->X11Display = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--profile") == 0 && i + 1 < Argc)
+        {
+            Options->ProfilePath = Argv[++i];
+        }
+        else if (strcmp(Argv[i], "--verify") == 0)
+        {
+            Options->StreamVerify = true;
+        }
+        else if (strcmp(Argv[i], "--rotation") == 0 && i + 1 < Argc)
+        {
+            switch (atoi(Argv[++i]))
+            {
+                case 0:
+                    Options->Rotation = DXGI_MODE_ROTATION_IDENTITY;
+                    break;
+                case 90:
+                    Options->Rotation = DXGI_MODE_ROTATION_ROTATE90;
+                    break;
+                case 180:
+                    Options->Rotation = DXGI_MODE_ROTATION_ROTATE180;
+                    break;
+                case 270:
+                    Options->Rotation = DXGI_MODE_ROTATION_ROTATE270;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int Argc, char** Argv)
+{
+    BENCHMARK_OPTIONS Options;
+    if (!ProcessCmdline(Argc, Argv, &Options))
+    {
+        ShowHelp();
+        return 1;
+    }
+
+    if (Options.PointerTrace)
+    {
+        return RunPrediction(&Options) ? 0 : 1;
+    }
+
+    if (Options.PointerSource)
+    {
+        return RunPointerSource(&Options) ? 0 : 1;
+    }
+
+    if (Options.Transform)
+    {
+        return RunTransform(&Options) ? 0 : 1;
+    }
+
+    if (Options.Apply)
+    {
+        return RunApply(&Options) ? 0 : 1;
+    }
+
+    if (Options.TileHash)
+    {
+        return RunTileHash(&Options) ? 0 : 1;
+    }
+
+    if (Options.Instanced)
+    {
+        return RunInstanced(&Options) ? 0 : 1;
+    }
+
+    if (Options.GovernorTrace)
+    {
+        return RunGovernor(&Options) ? 0 : 1;
+    }
+
+    if (Options.Refresh)
+    {
+        return RunRefresh(&Options) ? 0 : 1;
+    }
+
+    if (Options.EdidDir)
+    {
+        return RunEdid(&Options) ? 0 : 1;
+    }
+
+    if (Options.X11Display)
+    {
+        return RunX11(&Options) ? 0 : 1;
+    }
+
+    if (Options.ProfilePath)
+    {
+        return RunProfile(&Options) ? 0 : 1;
+    }
+
+    printf("%dx%d, rotation %d, %u frames per workload%s%s", Options.Width, Options.Height,
+           (Options.Rotation == DXGI_MODE_ROTATION_IDENTITY) ? 0 : (Options.Rotation - DXGI_MODE_ROTATION_IDENTITY) * 90, Options.Frames,
+           Options.TileDetection ? ", tile change detection" : "", Options.Warp ? ", full view every frame" : "");
+    if (Options.MipLevels > 1)
+    {
+        printf(", %u mip levels", Options.MipLevels);
+    }
+    if (Options.FoveationScale)
+    {
+        printf(", foveated 1/%u", Options.FoveationScale);
+    }
+    if (Options.Stream)
+    {
+        printf(", streamed %s%s%s", (Options.StreamCodec == TILE_CODEC_LZ4) ? "lz4" : "raw", Options.StreamPort ? " over TCP" : "",
+               Options.StreamVerify ? " and verified" : "");
+    }
+    if (Options.Workers)
+    {
+        printf(", %u compression workers", Options.Workers);
+    }
+    if (Options.RecordPrefix)
+    {
+        printf(", recorded");
+    }
+    printf("\n\n");
+
+    if (Options.Scaling)
+    {
+        return RunScaling(&Options) ? 0 : 1;
+    }
+
+    printf("%-12s %12s %12s %16s %14s\n", "workload", "frames/s", "ns/rect", "bytes/frame", "allocs/frame");
+
+    bool Found = false;
+    for (const WORKLOAD& Workload : Workloads)
+    {
+        if (strcmp(Options.Workload, "all") != 0 && strcmp(Options.Workload, Workload.Name) != 0)
+        {
+            continue;
+        }
+        Found = true;
+
+        BENCHMARK_RESULT Result;
+        if (!RunWorkload(&Workload, &Options, &Result))
+        {
+            fprintf(stderr, "Failed to allocate surfaces for %s\n", Workload.Name);
+            return 1;
+        }
+
+        printf("%-12s %12.1f %12.1f %16.0f %14.2f\n", Workload.Name, Result.FramesPerSecond, Result.NsPerRect, Result.BytesPerFrame, Result.AllocationsPerFrame);
+        if (Options.Stream)
+        {
+            printf("%-12s %.0f wire bytes/frame, ratio %.2f, %llu frames held, latency %.0f us (max %.0f us)%s%s\n", "",
+                   Result.WireBytesPerFrame, Result.CompressionRatio, static_cast<unsigned long long>(Result.FramesHeld), Result.LatencyUs, Result.MaxLatencyUs,
+                   Result.FramesCorrupt ? ", CORRUPT FRAMES" : "", Result.ClientFailed ? ", CLIENT FAILED" : "");
+        }
+        if (Options.RecordPrefix)
+        {
+            printf("%-12s %llu frames recorded, %llu dropped, %llu keyframes, %.0f log bytes/frame, seek %.0f us%s\n", "",
+                   static_cast<unsigned long long>(Result.FramesRecorded), static_cast<unsigned long long>(Result.FramesDropped),
+                   static_cast<unsigned long long>(Result.Keyframes), Result.LogBytesPerFrame, Result.SeekUs, Result.ReplayFailed ? ", REPLAY FAILED" : "");
+        }
+    }
+
+    if (!Found)
+    {
+        ShowHelp();
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _CAPTURETYPES_H_
+#define _CAPTURETYPES_H_
+
+//
+// What a capture backend hands the rest of the pipeline: frames, pointer shape and position, and how it failed.
+// DUPLICATIONMANAGER fills them from DXGI on Windows, X11DUPLICATIONMANAGER from an X server elsewhere.
+//
+#include "Platform.h"
+#include "PointerPredictor.h"
+
+#ifdef _WIN32
+#include <d3d11.h>
+#else
+#include "SoftwareCompositor.h"
+#endif
+
+typedef _Return_type_success_(return == DUPL_RETURN_SUCCESS) enum
+{
+    DUPL_RETURN_SUCCESS             = 0,
+    DUPL_RETURN_ERROR_EXPECTED      = 1,
+    DUPL_RETURN_ERROR_UNEXPECTED    = 2
+}DUPL_RETURN;
+
+//
+// Pointer shape buffers are never smaller than this, so common shape changes do not reallocate them
+//
+#define PTR_SHAPE_MIN_BUFFER_SIZE (64 * 1024)
+
+//
+// Holds info about the pointer/cursor. The shape is handed over under the keyed mutex, the position
+// through PTR_POSITION.
+//
+typedef struct _PTR_INFO
+{
+    _Field_size_bytes_(BufferSize) BYTE* PtrShapeBuffer;
+    DXGI_OUTDUPL_POINTER_SHAPE_INFO ShapeInfo;
+    POINT Position;
+    bool Visible;
+    UINT BufferSize;
+    UINT WhoUpdatedPositionLast;
+    LARGE_INTEGER LastTimeStamp;
+    UINT ShapeSerial;
+} PTR_INFO;
+
+//
+// Latest pointer position, published by the duplication threads and read by the presenter every refresh.
+// Frames that only move the pointer update it without the keyed mutex, so pointer motion is never held up
+// by the shared surface. The recent visible positions are kept for predicting where the pointer will be.
+//
+typedef struct _PTR_POSITION
+{
+    SRWLOCK Lock;
+    POINT Position;
+    bool Visible;
+    UINT WhoUpdatedPositionLast;
+    LARGE_INTEGER LastTimeStamp;
+    POINTER_HISTORY History;
+} PTR_POSITION;
+
+//
+// FRAME_DATA holds information about an acquired frame
+//
+typedef struct _FRAME_DATA
+{
+#ifdef _WIN32
+    ID3D11Texture2D* Frame;
+#else
+    // Captured into system memory, valid until the next GetFrame
+    SOFTWARE_SURFACE* Frame;
+#endif
+    DXGI_OUTDUPL_FRAME_INFO FrameInfo;
+    _Field_size_bytes_((MoveCount * sizeof(DXGI_OUTDUPL_MOVE_RECT)) + (DirtyCount * sizeof(RECT))) BYTE* MetaData;
+    UINT DirtyCount;
+    UINT MoveCount;
+} FRAME_DATA;
+
+#endif
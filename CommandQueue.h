@@ -0,0 +1,150 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _COMMANDQUEUE_H_
+#define _COMMANDQUEUE_H_
+
+#include <atomic>
+
+//
+// Lock-free bounded queue with a single producer and a single consumer.
+// Capacity must be a power of two.
+//
+template <typename T, unsigned int Capacity>
+class COMMANDQUEUE
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "COMMANDQUEUE capacity must be a power of two");
+
+    public:
+        COMMANDQUEUE() : m_Head(0), m_Tail(0)
+        {
+        }
+
+        //
+        // Called by the producer, fails when the queue is full
+        //
+        bool Push(const T& Item)
+        {
+            unsigned int Tail = m_Tail.load(std::memory_order_relaxed);
+            if (Tail - m_Head.load(std::memory_order_acquire) == Capacity)
+            {
+                return false;
+            }
+
+            m_Items[Tail & (Capacity - 1)] = Item;
+            m_Tail.store(Tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        //
+        // Called by the consumer, fails when the queue is empty
+        //
+        bool Pop(T* Item)
+        {
+            unsigned int Head = m_Head.load(std::memory_order_relaxed);
+            if (Head == m_Tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            *Item = m_Items[Head & (Capacity - 1)];
+            m_Head.store(Head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        T m_Items[Capacity];
+
+        // Producer and consumer indices live on separate cache lines
+        alignas(64) std::atomic<unsigned int> m_Head;
+        alignas(64) std::atomic<unsigned int> m_Tail;
+};
+
+//
+// Lock-free bounded queue with any number of producers and a single consumer. Producers never wait on each
+// other or on the consumer, a push into a full queue fails. Capacity must be a power of two.
+//
+template <typename T, unsigned int Capacity>
+class MPSCQUEUE
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "MPSCQUEUE capacity must be a power of two");
+
+    public:
+        MPSCQUEUE() : m_Head(0), m_Tail(0)
+        {
+            // A cell is free for the push at its own index and holds an item once that push bumped it by one
+            for (unsigned int i = 0; i < Capacity; ++i)
+            {
+                m_Cells[i].Sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        //
+        // Called by any producer, fails when the queue is full
+        //
+        bool Push(const T& Item)
+        {
+            unsigned int Tail = m_Tail.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                CELL* Cell = &m_Cells[Tail & (Capacity - 1)];
+                int Distance = static_cast<int>(Cell->Sequence.load(std::memory_order_acquire) - Tail);
+                if (Distance == 0)
+                {
+                    // The cell is free, claim it unless another producer got there first
+                    if (m_Tail.compare_exchange_weak(Tail, Tail + 1, std::memory_order_relaxed))
+                    {
+                        Cell->Item = Item;
+                        Cell->Sequence.store(Tail + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (Distance < 0)
+                {
+                    // Still holds the item of the previous lap
+                    return false;
+                }
+                else
+                {
+                    Tail = m_Tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //
+        // Called by the consumer, fails when the queue is empty or the oldest push is not finished yet
+        //
+        bool Pop(T* Item)
+        {
+            unsigned int Head = m_Head.load(std::memory_order_relaxed);
+            CELL* Cell = &m_Cells[Head & (Capacity - 1)];
+            if (Cell->Sequence.load(std::memory_order_acquire) != Head + 1)
+            {
+                return false;
+            }
+
+            *Item = Cell->Item;
+            Cell->Sequence.store(Head + Capacity, std::memory_order_release);
+            m_Head.store(Head + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        struct CELL
+        {
+            std::atomic<unsigned int> Sequence;
+            T Item;
+        };
+
+        CELL m_Cells[Capacity];
+
+        // Producers contend on the tail only, the consumer owns the head
+        alignas(64) std::atomic<unsigned int> m_Head;
+        alignas(64) std::atomic<unsigned int> m_Tail;
+};
+
+#endif
@@ -30,7 +30,16 @@ namespace winrt {
     using namespace winrt::Windows::Foundation::Collections;
 } // namespace winrt
 
+#include "ApplyRects.h"
+#include "CaptureTypes.h"
+#include "DirtyRects.h"
+#include "FrameGovernor.h"
+#include "FrameProfiler.h"
 #include "PixelShader.h"
+#include "PointerPredictor.h"
+#include "Resample.h"
+#include "TileHash.h"
+#include "ToneMap.h"
 #include "VertexShader.h"
 
 #define NUMVERTICES 6
@@ -44,31 +53,50 @@ extern HRESULT FrameInfoExpectedErrors[];
 extern HRESULT AcquireFrameExpectedError[];
 extern HRESULT EnumOutputsExpectedErrors[];
 
-typedef _Return_type_success_(return == DUPL_RETURN_SUCCESS) enum
+//
+// Kinds of system transitions, used to decide how much of the pipeline must be rebuilt
+//
+typedef enum
 {
-    DUPL_RETURN_SUCCESS             = 0,
-    DUPL_RETURN_ERROR_EXPECTED      = 1,
-    DUPL_RETURN_ERROR_UNEXPECTED    = 2
-}DUPL_RETURN;
+    TRANSITION_DESKTOP_SWITCH   = 0,    // Secure desktop, UAC prompt, lock screen
+    TRANSITION_ACCESS_LOST      = 1,    // Duplication interface invalidated, desktop layout unchanged
+    TRANSITION_OUTPUT_CHANGE    = 2,    // Mode change or output added/removed, desktop layout changed
+    TRANSITION_DEVICE_REMOVED   = 3,    // Duplication device lost (TDR, driver update)
+    TRANSITION_SESSION          = 4,    // Session disconnect/reconnect
+    TRANSITION_PRESENTER        = 5,    // HMD side failed, everything must be rebuilt
+    TRANSITION_COUNT            = 6
+} TRANSITION_TYPE;
 
 _Post_satisfies_(return != DUPL_RETURN_SUCCESS)
 DUPL_RETURN ProcessFailure(_In_opt_ ID3D11Device* Device, _In_ LPCWSTR Str, _In_ LPCWSTR Title, HRESULT hr, _In_opt_z_ HRESULT* ExpectedErrors = nullptr);
 
 void DisplayMsg(_In_ LPCWSTR Str, _In_ LPCWSTR Title, HRESULT hr);
 
+void ReportExpectedError(_In_ LPCWSTR Site, HRESULT hr);
+
+uint64_t QpcToNs(LONGLONG Ticks);
+
 //
-// Holds info about the pointer/cursor
+// Regions of the shared surface written by duplication threads and not yet picked up by the presenter
 //
-typedef struct _PTR_INFO
+#define DAMAGE_RECT_COUNT 32
+
+// Desktop updates kept for the presenter's refresh policy between two v-blanks
+#define DAMAGE_UPDATE_COUNT 16
+
+typedef struct _DAMAGE_INFO
 {
-    _Field_size_bytes_(BufferSize) BYTE* PtrShapeBuffer;
-    DXGI_OUTDUPL_POINTER_SHAPE_INFO ShapeInfo;
-    POINT Position;
-    bool Visible;
-    UINT BufferSize;
-    UINT WhoUpdatedPositionLast;
-    LARGE_INTEGER LastTimeStamp;
-} PTR_INFO;
+    RECT Rects[DAMAGE_RECT_COUNT];
+    UINT RectCount;
+    bool FullDamage;
+
+    // When the desktop image was updated, oldest first
+    uint64_t UpdateNs[DAMAGE_UPDATE_COUNT];
+    UINT UpdateCount;
+} DAMAGE_INFO;
+
+void AddDamage(_Inout_ DAMAGE_INFO* Damage, _In_ const RECT* Rect);
+void AddDamageUpdate(_Inout_ DAMAGE_INFO* Damage, uint64_t TimeNs);
 
 //
 // Structure that holds D3D resources not directly tied to any one thread
@@ -80,9 +108,50 @@ typedef struct _DX_RESOURCES
     ID3D11VertexShader* VertexShader;
     ID3D11PixelShader* PixelShader;
     ID3D11InputLayout* InputLayout;
+    ID3D11VertexShader* RectVertexShader;   // Instanced dirty rects, nullptr below feature level 10_0
+    ID3D11InputLayout* RectInputLayout;
     ID3D11SamplerState* SamplerLinear;
+    ID3D11ComputeShader* TileHashShader;    // nullptr below feature level 11_0
+    ID3D11ComputeShader* ApplyShader;       // nullptr where the adapter cannot write the shared surface from compute shaders
+    D3D_DRIVER_TYPE DriverType;
+    D3D_FEATURE_LEVEL FeatureLevel;
 } DX_RESOURCES;
 
+bool SupportsComputeApply(_In_ ID3D11Device* Device, DXGI_FORMAT Format);
+
+//
+// How the duplication threads process frames
+//
+typedef struct _DUPLICATION_OPTIONS
+{
+    // Hash tiles of frames reported as fully dirty to find what really changed
+    bool TileDetection;
+
+    // Capture in FP16 when an output shows HDR content, instead of letting DWM convert it to 8 bits
+    bool Hdr;
+
+    // Apply moves and dirty rects with one compute dispatch per frame on adapters that support it
+    bool ComputeApply;
+
+    // Record what the headset is shown to a frame log at this path, nullptr for none
+    const char* RecordPath;
+
+    // Stream the changed tiles of what the headset is shown to a client connecting on this TCP port, 0 for none
+    UINT StreamPort;
+
+    // Write the CPU and GPU timeline of capture and present to a trace at this path on exit, nullptr for none
+    const char* ProfilePath;
+
+    // Timeline the passes are timed onto, nullptr when not profiling
+    PROFILETIMELINE* Timeline;
+
+    // Shed work in the duplication threads and the presenter when frames run over the headset's budget
+    bool Govern;
+
+    // Governor deciding what to shed, nullptr when not governing
+    FRAMEGOVERNOR* Governor;
+} DUPLICATION_OPTIONS;
+
 //
 // Structure to pass to a new thread
 //
@@ -98,25 +167,19 @@ typedef struct _THREAD_DATA
     HANDLE TerminateThreadsEvent;
 
     HANDLE TexSharedHandle;
+
+    // Format of the shared surface, frames are requested in it so no conversion is needed before the presenter
+    DXGI_FORMAT CaptureFormat;
     UINT Output;
     INT OffsetX;
     INT OffsetY;
     PTR_INFO* PtrInfo;
+    PTR_POSITION* PtrPosition;
+    DAMAGE_INFO* Damage;
+    DUPLICATION_OPTIONS Options;
     DX_RESOURCES DxRes;
 } THREAD_DATA;
 
-//
-// FRAME_DATA holds information about an acquired frame
-//
-typedef struct _FRAME_DATA
-{
-    ID3D11Texture2D* Frame;
-    DXGI_OUTDUPL_FRAME_INFO FrameInfo;
-    _Field_size_bytes_((MoveCount * sizeof(DXGI_OUTDUPL_MOVE_RECT)) + (DirtyCount * sizeof(RECT))) BYTE* MetaData;
-    UINT DirtyCount;
-    UINT MoveCount;
-} FRAME_DATA;
-
 //
 // A vertex with a position and texture coordinate
 //
@@ -0,0 +1,375 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <string.h>
+
+#include "CompressionPool.h"
+
+#define TASK_TILE_BITS 24
+
+static inline uint32_t MakeTask(UINT Frame, UINT Tile)
+{
+    return (Frame << TASK_TILE_BITS) | Tile;
+}
+
+COMPRESSIONPOOL::COMPRESSIONPOOL() : m_WorkerCount(0),
+                                     m_FrameCount(0),
+                                     m_MaxTiles(0),
+                                     m_MaxTileSize(0),
+                                     m_QueueCapacity(0),
+                                     m_QueuedTasks(0),
+                                     m_Stop(false)
+{
+    memset(m_Codecs, 0, sizeof(m_Codecs));
+    for (UINT i = 0; i < COMPRESSION_MAX_WORKERS; ++i)
+    {
+        m_Queues[i].Tasks = nullptr;
+        m_Queues[i].Head = 0;
+        m_Queues[i].Count = 0;
+    }
+    for (UINT i = 0; i < COMPRESSION_MAX_FRAMES; ++i)
+    {
+        m_Frames[i].InUse = false;
+        m_Frames[i].TileCount = 0;
+        m_Frames[i].Tiles = nullptr;
+        m_Frames[i].Input = nullptr;
+        m_Frames[i].Output = nullptr;
+        m_Frames[i].Remaining = 0;
+    }
+}
+
+COMPRESSIONPOOL::~COMPRESSIONPOOL()
+{
+    Clean();
+}
+
+//
+// Allocate Frames slots able to hold every tile of a Width x Height frame, and start the workers.
+// Without a codec (TILE_CODEC_RAW) tiles are only copied.
+//
+bool COMPRESSIONPOOL::Initialize(UINT Workers, TILE_CODEC Codec, UINT Width, UINT Height, UINT Frames)
+{
+    Clean();
+
+    if (!Workers || Workers > COMPRESSION_MAX_WORKERS || !Frames || Frames > COMPRESSION_MAX_FRAMES)
+    {
+        return false;
+    }
+
+    m_WorkerCount = Workers;
+    m_FrameCount = Frames;
+    m_MaxTiles = ((Width + TILE_SIZE - 1) / TILE_SIZE) * ((Height + TILE_SIZE - 1) / TILE_SIZE);
+    m_MaxTileSize = TILE_SIZE * TILE_SIZE * SOFTWARE_BPP;
+    m_QueueCapacity = m_MaxTiles * Frames;
+
+    for (UINT i = 0; i < Workers; ++i)
+    {
+        if (Codec == TILE_CODEC_LZ4)
+        {
+            m_Codecs[i] = new (std::nothrow) LZ4TILECODEC();
+            if (!m_Codecs[i])
+            {
+                Clean();
+                return false;
+            }
+            if (m_Codecs[i]->GetMaxEncodedSize(TILE_SIZE, TILE_SIZE) > m_MaxTileSize)
+            {
+                m_MaxTileSize = m_Codecs[i]->GetMaxEncodedSize(TILE_SIZE, TILE_SIZE);
+            }
+        }
+
+        m_Queues[i].Tasks = new (std::nothrow) uint32_t[m_QueueCapacity];
+        if (!m_Queues[i].Tasks)
+        {
+            Clean();
+            return false;
+        }
+    }
+
+    for (UINT i = 0; i < Frames; ++i)
+    {
+        m_Frames[i].Tiles = new (std::nothrow) COMPRESSED_TILE[m_MaxTiles];
+        m_Frames[i].Input = new (std::nothrow) BYTE[static_cast<size_t>(m_MaxTiles) * TILE_SIZE * TILE_SIZE * SOFTWARE_BPP];
+        m_Frames[i].Output = new (std::nothrow) BYTE[static_cast<size_t>(m_MaxTiles) * m_MaxTileSize];
+        if (!m_Frames[i].Tiles || !m_Frames[i].Input || !m_Frames[i].Output)
+        {
+            Clean();
+            return false;
+        }
+    }
+
+    for (UINT i = 0; i < Workers; ++i)
+    {
+        m_Workers[i] = std::thread(&COMPRESSIONPOOL::WorkerThread, this, i);
+    }
+
+    return true;
+}
+
+void COMPRESSIONPOOL::Clean()
+{
+    {
+        std::lock_guard<std::mutex> Guard(m_WakeLock);
+        m_Stop = true;
+    }
+    m_Wake.notify_all();
+
+    for (UINT i = 0; i < COMPRESSION_MAX_WORKERS; ++i)
+    {
+        if (m_Workers[i].joinable())
+        {
+            m_Workers[i].join();
+        }
+        if (m_Codecs[i])
+        {
+            delete m_Codecs[i];
+            m_Codecs[i] = nullptr;
+        }
+        if (m_Queues[i].Tasks)
+        {
+            delete [] m_Queues[i].Tasks;
+            m_Queues[i].Tasks = nullptr;
+        }
+        m_Queues[i].Head = 0;
+        m_Queues[i].Count = 0;
+    }
+
+    for (UINT i = 0; i < COMPRESSION_MAX_FRAMES; ++i)
+    {
+        if (m_Frames[i].Tiles)
+        {
+            delete [] m_Frames[i].Tiles;
+            m_Frames[i].Tiles = nullptr;
+        }
+        if (m_Frames[i].Input)
+        {
+            delete [] m_Frames[i].Input;
+            m_Frames[i].Input = nullptr;
+        }
+        if (m_Frames[i].Output)
+        {
+            delete [] m_Frames[i].Output;
+            m_Frames[i].Output = nullptr;
+        }
+        m_Frames[i].InUse = false;
+        m_Frames[i].TileCount = 0;
+        m_Frames[i].Remaining = 0;
+    }
+
+    m_WorkerCount = 0;
+    m_FrameCount = 0;
+    m_QueuedTasks = 0;
+    m_Stop = false;
+}
+
+UINT COMPRESSIONPOOL::GetWorkerCount()
+{
+    return m_WorkerCount;
+}
+
+//
+// Most a compressed tile can take, raw tiles included
+//
+UINT COMPRESSIONPOOL::GetMaxTileSize()
+{
+    return m_MaxTileSize;
+}
+
+//
+// Take a free frame slot, -1 when all of them are in flight
+//
+INT COMPRESSIONPOOL::BeginFrame()
+{
+    for (UINT i = 0; i < m_FrameCount; ++i)
+    {
+        if (!m_Frames[i].InUse)
+        {
+            m_Frames[i].InUse = true;
+            m_Frames[i].TileCount = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+//
+// Copy a tile of the surface into the slot, the surface can change as soon as this returns
+//
+void COMPRESSIONPOOL::AddTile(INT Frame, const SOFTWARE_SURFACE* Surface, UINT Column, UINT Row)
+{
+    FRAME_SLOT* Slot = &m_Frames[Frame];
+    UINT Index = Slot->TileCount++;
+
+    COMPRESSED_TILE* Tile = &Slot->Tiles[Index];
+    UINT Left = Column * TILE_SIZE;
+    UINT Top = Row * TILE_SIZE;
+    Tile->Column = Column;
+    Tile->Row = Row;
+    Tile->Width = (Left + TILE_SIZE < Surface->Width) ? TILE_SIZE : Surface->Width - Left;
+    Tile->Height = (Top + TILE_SIZE < Surface->Height) ? TILE_SIZE : Surface->Height - Top;
+    Tile->Codec = TILE_CODEC_RAW;
+    Tile->Size = 0;
+    Tile->Data = nullptr;
+
+    BYTE* Pixels = Slot->Input + static_cast<size_t>(Index) * TILE_SIZE * TILE_SIZE * SOFTWARE_BPP;
+    for (UINT Y = 0; Y < Tile->Height; ++Y)
+    {
+        memcpy(Pixels + static_cast<size_t>(Y) * Tile->Width * SOFTWARE_BPP, Surface->Bits + static_cast<size_t>(Top + Y) * Surface->Pitch + Left * SOFTWARE_BPP, Tile->Width * SOFTWARE_BPP);
+    }
+}
+
+//
+// Hand the tiles of a slot to the workers. Each worker gets a run of neighbouring tiles.
+//
+void COMPRESSIONPOOL::SubmitFrame(INT Frame)
+{
+    FRAME_SLOT* Slot = &m_Frames[Frame];
+    Slot->Remaining = Slot->TileCount;
+    if (!Slot->TileCount)
+    {
+        return;
+    }
+
+    // Counted first so a worker taking one of the tasks right away never sees the count go below zero
+    m_QueuedTasks += Slot->TileCount;
+
+    for (UINT Worker = 0; Worker < m_WorkerCount; ++Worker)
+    {
+        UINT First = static_cast<UINT>(static_cast<uint64_t>(Slot->TileCount) * Worker / m_WorkerCount);
+        UINT Last = static_cast<UINT>(static_cast<uint64_t>(Slot->TileCount) * (Worker + 1) / m_WorkerCount);
+        if (First == Last)
+        {
+            continue;
+        }
+
+        // Pushed in reverse, the owner takes from the back so it walks its run in order
+        WORKER_QUEUE* Queue = &m_Queues[Worker];
+        std::lock_guard<std::mutex> Guard(Queue->Lock);
+        for (UINT Tile = Last; Tile-- > First;)
+        {
+            Queue->Tasks[(Queue->Head + Queue->Count++) % m_QueueCapacity] = MakeTask(Frame, Tile);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard(m_WakeLock);
+    }
+    m_Wake.notify_all();
+}
+
+//
+// Own queue first, newest task, then the oldest task of another worker
+//
+bool COMPRESSIONPOOL::PopTask(UINT Worker, uint32_t* Task)
+{
+    for (UINT i = 0; i < m_WorkerCount; ++i)
+    {
+        WORKER_QUEUE* Queue = &m_Queues[(Worker + i) % m_WorkerCount];
+        std::lock_guard<std::mutex> Guard(Queue->Lock);
+        if (!Queue->Count)
+        {
+            continue;
+        }
+
+        if (!i)
+        {
+            *Task = Queue->Tasks[(Queue->Head + --Queue->Count) % m_QueueCapacity];
+        }
+        else
+        {
+            *Task = Queue->Tasks[Queue->Head];
+            Queue->Head = (Queue->Head + 1) % m_QueueCapacity;
+            --Queue->Count;
+        }
+        --m_QueuedTasks;
+        return true;
+    }
+    return false;
+}
+
+//
+// Compress one tile into its place in the slot, tiles that do not shrink are passed through raw
+//
+void COMPRESSIONPOOL::RunTask(UINT Worker, uint32_t Task)
+{
+    FRAME_SLOT* Slot = &m_Frames[Task >> TASK_TILE_BITS];
+    UINT Index = Task & ((1u << TASK_TILE_BITS) - 1);
+    COMPRESSED_TILE* Tile = &Slot->Tiles[Index];
+
+    const BYTE* Pixels = Slot->Input + static_cast<size_t>(Index) * TILE_SIZE * TILE_SIZE * SOFTWARE_BPP;
+    BYTE* Output = Slot->Output + static_cast<size_t>(Index) * m_MaxTileSize;
+    UINT RawSize = Tile->Width * Tile->Height * SOFTWARE_BPP;
+
+    UINT Size = m_Codecs[Worker] ? m_Codecs[Worker]->Encode(Pixels, Tile->Width, Tile->Height, Output, m_MaxTileSize) : 0;
+    if (Size && Size < RawSize)
+    {
+        Tile->Codec = m_Codecs[Worker]->GetId();
+        Tile->Size = Size;
+        Tile->Data = Output;
+    }
+    else
+    {
+        Tile->Codec = TILE_CODEC_RAW;
+        Tile->Size = RawSize;
+        Tile->Data = Pixels;
+    }
+
+    if (Slot->Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        std::lock_guard<std::mutex> Guard(m_DoneLock);
+        m_Done.notify_all();
+    }
+}
+
+void COMPRESSIONPOOL::WorkerThread(UINT Worker)
+{
+    for (;;)
+    {
+        uint32_t Task;
+        if (PopTask(Worker, &Task))
+        {
+            RunTask(Worker, Task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Guard(m_WakeLock);
+        m_Wake.wait(Guard, [this] { return m_Stop || m_QueuedTasks.load() > 0; });
+        if (m_Stop)
+        {
+            return;
+        }
+    }
+}
+
+//
+// Block until every tile of the slot is compressed
+//
+void COMPRESSIONPOOL::WaitFrame(INT Frame)
+{
+    FRAME_SLOT* Slot = &m_Frames[Frame];
+    std::unique_lock<std::mutex> Guard(m_DoneLock);
+    m_Done.wait(Guard, [Slot] { return Slot->Remaining.load(std::memory_order_acquire) == 0; });
+}
+
+UINT COMPRESSIONPOOL::GetTileCount(INT Frame)
+{
+    return m_Frames[Frame].TileCount;
+}
+
+//
+// Results in the order the tiles were added, only once WaitFrame returned
+//
+const COMPRESSED_TILE* COMPRESSIONPOOL::GetTiles(INT Frame)
+{
+    return m_Frames[Frame].Tiles;
+}
+
+void COMPRESSIONPOOL::EndFrame(INT Frame)
+{
+    m_Frames[Frame].InUse = false;
+}
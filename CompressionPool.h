@@ -0,0 +1,109 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _COMPRESSIONPOOL_H_
+#define _COMPRESSIONPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "SoftwareCompositor.h"
+#include "TileCodec.h"
+#include "TileDetector.h"
+
+#define COMPRESSION_MAX_WORKERS 64
+#define COMPRESSION_MAX_FRAMES 8
+
+//
+// One tile of a frame after compression. Data points into the pool and stays valid until EndFrame.
+//
+typedef struct _COMPRESSED_TILE
+{
+    UINT Column;
+    UINT Row;
+    UINT Width;
+    UINT Height;
+    TILE_CODEC Codec;
+    UINT Size;
+    const BYTE* Data;
+} COMPRESSED_TILE;
+
+//
+// Compresses the tiles of frames on worker threads, for the sinks that work on CPU side pixels.
+// The capture thread copies the tiles of a frame into one of the pool's frame slots and submits them,
+// then picks the results up in the order it added the tiles. Several frames can be in flight at once.
+// Each worker takes tiles from its own queue and steals from the others once it runs dry.
+// All memory is allocated by Initialize, one input and one output buffer per tile of every slot.
+//
+class COMPRESSIONPOOL
+{
+    public:
+        COMPRESSIONPOOL();
+        ~COMPRESSIONPOOL();
+        bool Initialize(UINT Workers, TILE_CODEC Codec, UINT Width, UINT Height, UINT Frames);
+        UINT GetWorkerCount();
+        UINT GetMaxTileSize();
+        INT BeginFrame();
+        void AddTile(INT Frame, const SOFTWARE_SURFACE* Surface, UINT Column, UINT Row);
+        void SubmitFrame(INT Frame);
+        void WaitFrame(INT Frame);
+        UINT GetTileCount(INT Frame);
+        const COMPRESSED_TILE* GetTiles(INT Frame);
+        void EndFrame(INT Frame);
+        void Clean();
+
+    private:
+    // methods
+        void WorkerThread(UINT Worker);
+        bool PopTask(UINT Worker, uint32_t* Task);
+        void RunTask(UINT Worker, uint32_t Task);
+
+    // variables
+        struct FRAME_SLOT
+        {
+            bool InUse;
+            UINT TileCount;
+            COMPRESSED_TILE* Tiles;
+            BYTE* Input;
+            BYTE* Output;
+            std::atomic<UINT> Remaining;
+        };
+
+        // Tasks are a frame slot and a tile index packed together. The owner takes from the back of its
+        // queue, thieves from the front.
+        struct WORKER_QUEUE
+        {
+            std::mutex Lock;
+            uint32_t* Tasks;
+            UINT Head;
+            UINT Count;
+        };
+
+        UINT m_WorkerCount;
+        UINT m_FrameCount;
+        UINT m_MaxTiles;
+        UINT m_MaxTileSize;
+        UINT m_QueueCapacity;
+        TILECODEC* m_Codecs[COMPRESSION_MAX_WORKERS];
+        std::thread m_Workers[COMPRESSION_MAX_WORKERS];
+        WORKER_QUEUE m_Queues[COMPRESSION_MAX_WORKERS];
+        FRAME_SLOT m_Frames[COMPRESSION_MAX_FRAMES];
+
+        // Workers sleep here when every queue is empty
+        std::mutex m_WakeLock;
+        std::condition_variable m_Wake;
+        std::atomic<UINT> m_QueuedTasks;
+        bool m_Stop;
+
+        // The capture thread sleeps here waiting for a frame
+        std::mutex m_DoneLock;
+        std::condition_variable m_Done;
+};
+
+#endif
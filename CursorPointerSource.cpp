@@ -0,0 +1,123 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "CursorPointerSource.h"
+
+CURSORPOINTERSOURCE::CURSORPOINTERSOURCE() : m_Stream(nullptr),
+                                             m_Thread(nullptr),
+                                             m_StopEvent(nullptr),
+                                             m_Timer(nullptr)
+{
+}
+
+CURSORPOINTERSOURCE::~CURSORPOINTERSOURCE()
+{
+    Stop();
+}
+
+//
+// Start sampling into Stream
+//
+bool CURSORPOINTERSOURCE::Start(POINTERSTREAM* Stream)
+{
+    if (m_Thread)
+    {
+        return false;
+    }
+    m_Stream = Stream;
+
+    // A high resolution timer wakes us within the millisecond, older systems only have the default one
+    m_Timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!m_Timer)
+    {
+        m_Timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+    m_StopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (!m_Timer || !m_StopEvent)
+    {
+        Stop();
+        return false;
+    }
+
+    LARGE_INTEGER DueTime;
+    DueTime.QuadPart = -10000LL * CURSOR_POLL_INTERVAL_MS;
+    if (!SetWaitableTimer(m_Timer, &DueTime, CURSOR_POLL_INTERVAL_MS, nullptr, nullptr, FALSE))
+    {
+        Stop();
+        return false;
+    }
+
+    DWORD ThreadId;
+    m_Thread = CreateThread(nullptr, 0, PollProc, this, 0, &ThreadId);
+    if (!m_Thread)
+    {
+        Stop();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Stop sampling, the stream keeps the positions it has
+//
+void CURSORPOINTERSOURCE::Stop()
+{
+    if (m_Thread)
+    {
+        SetEvent(m_StopEvent);
+        WaitForSingleObjectEx(m_Thread, INFINITE, FALSE);
+        CloseHandle(m_Thread);
+        m_Thread = nullptr;
+    }
+
+    if (m_Timer)
+    {
+        CancelWaitableTimer(m_Timer);
+        CloseHandle(m_Timer);
+        m_Timer = nullptr;
+    }
+
+    if (m_StopEvent)
+    {
+        CloseHandle(m_StopEvent);
+        m_StopEvent = nullptr;
+    }
+}
+
+DWORD WINAPI CURSORPOINTERSOURCE::PollProc(_In_ void* Param)
+{
+    reinterpret_cast<CURSORPOINTERSOURCE*>(Param)->Poll();
+    return 0;
+}
+
+void CURSORPOINTERSOURCE::Poll()
+{
+    // Late samples are worse than none, but we must not starve the presentation thread either
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+
+    HANDLE Handles[2] = {m_StopEvent, m_Timer};
+    POINT Last = {LONG_MIN, LONG_MIN};
+    while (WaitForMultipleObjects(ARRAYSIZE(Handles), Handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+    {
+        // Physical pixels whatever our DPI awareness, like the DXGI desktop image
+        POINT Position;
+        LARGE_INTEGER Time;
+        if (!GetPhysicalCursorPos(&Position))
+        {
+            continue;
+        }
+        QueryPerformanceCounter(&Time);
+
+        // Only moves, like the DXGI pointer updates
+        if (Position.x != Last.x || Position.y != Last.y)
+        {
+            m_Stream->Push(QpcToNs(Time.QuadPart), Position.x, Position.y);
+            Last = Position;
+        }
+    }
+}
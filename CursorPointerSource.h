@@ -0,0 +1,41 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _CURSORPOINTERSOURCE_H_
+#define _CURSORPOINTERSOURCE_H_
+
+#include "CommonTypes.h"
+#include "PointerSource.h"
+
+// How often the cursor position is sampled
+#define CURSOR_POLL_INTERVAL_MS 1
+
+//
+// Samples the cursor on a thread of its own, independent of when DWM composes and DXGI reports. The
+// position is the one the cursor is drawn at, after pointer ballistics, in physical virtual screen pixels.
+//
+class CURSORPOINTERSOURCE : public POINTERSOURCE
+{
+    public:
+        CURSORPOINTERSOURCE();
+        ~CURSORPOINTERSOURCE();
+        bool Start(POINTERSTREAM* Stream) override;
+        void Stop() override;
+
+    private:
+    // methods
+        static DWORD WINAPI PollProc(_In_ void* Param);
+        void Poll();
+
+    // variables
+        POINTERSTREAM* m_Stream;
+        HANDLE m_Thread;
+        HANDLE m_StopEvent;
+        HANDLE m_Timer;
+};
+
+#endif
@@ -7,9 +7,12 @@
 
 #include <limits.h>
 
+#include "AllocationCounter.h"
 #include "DisplayManager.h"
 #include "DuplicationManager.h"
+#include "EventReporter.h"
 #include "OutputManager.h"
+#include "PresentManager.h"
 #include "ThreadManager.h"
 
 //
@@ -17,6 +20,9 @@
 //
 OUTPUTMANAGER OutMgr;
 
+// Errors and messages of every thread, shown without making the thread that reported them wait
+EVENTREPORTER EventReporter;
+
 // Below are lists of errors expect from Dxgi API calls when a transition event like mode change, PnpStop, PnpStart
 // desktop switch, TDR or session disconnect/reconnect. In all these cases we want the application to clean up the threads that process
 // the desktop updates and attempt to recreate them.
@@ -52,13 +58,13 @@ HRESULT EnumOutputsExpectedErrors[] = {
                                           S_OK                                    // Terminate list with zero valued HRESULT
                                       };
 
-
 //
 // Forward Declarations
 //
 DWORD WINAPI DDProc(_In_ void* Param);
+INT RunApplication(_In_ HINSTANCE hInstance, INT nCmdShow);
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
-bool ProcessCmdline(_Out_ INT* Output);
+bool ProcessCmdline(_Out_ INT* Output, _Out_ PRESENT_OPTIONS* PresentOptions, _Out_ HMD_OPTIONS* HmdOptions, _Out_ DUPLICATION_OPTIONS* DuplOptions, _Out_ FOVEATION_OPTIONS* FoveationOptions, _Out_ SCALING_OPTIONS* ScalingOptions, _Out_ PREDICTION_OPTIONS* PredictionOptions);
 void ShowHelp();
 
 //
@@ -79,7 +85,9 @@ class DYNAMIC_WAIT
         DYNAMIC_WAIT();
         ~DYNAMIC_WAIT();
 
-        void Wait();
+        void Start();
+        bool Expired();
+        DWORD RemainingTime();
 
     private :
 
@@ -92,6 +100,7 @@ class DYNAMIC_WAIT
     UINT                    m_WaitCountInCurrentBand;
     LARGE_INTEGER           m_QPCFrequency;
     LARGE_INTEGER           m_LastWakeUpTime;
+    LARGE_INTEGER           m_WakeUpTime;
     BOOL                    m_QPCValid;
 };
 const WAIT_BAND DYNAMIC_WAIT::m_WaitBands[WAIT_BAND_COUNT] = {
@@ -104,13 +113,17 @@ DYNAMIC_WAIT::DYNAMIC_WAIT() : m_CurrentWaitBandIdx(0), m_WaitCountInCurrentBand
 {
     m_QPCValid = QueryPerformanceFrequency(&m_QPCFrequency);
     m_LastWakeUpTime.QuadPart = 0L;
+    m_WakeUpTime.QuadPart = 0L;
 }
 
 DYNAMIC_WAIT::~DYNAMIC_WAIT()
 {
 }
 
-void DYNAMIC_WAIT::Wait()
+//
+// Start a new wait period. The caller keeps running (e.g. presenting) and polls Expired().
+//
+void DYNAMIC_WAIT::Start()
 {
     LARGE_INTEGER CurrentQPC = {0};
 
@@ -132,14 +145,184 @@ void DYNAMIC_WAIT::Wait()
         m_CurrentWaitBandIdx = 0;
     }
 
-    // Sleep for the required period of time
-    Sleep(m_WaitBands[m_CurrentWaitBandIdx].WaitTime);
-
-    // Record the time we woke up so we can detect wait sequences
-    QueryPerformanceCounter(&m_LastWakeUpTime);
+    // Record when the wait ends so we can detect wait sequences
+    m_WakeUpTime.QuadPart = CurrentQPC.QuadPart + (m_QPCFrequency.QuadPart * m_WaitBands[m_CurrentWaitBandIdx].WaitTime) / 1000;
+    m_LastWakeUpTime = m_WakeUpTime;
     m_WaitCountInCurrentBand++;
 }
 
+//
+// Whether the current wait period is over
+//
+bool DYNAMIC_WAIT::Expired()
+{
+    return RemainingTime() == 0;
+}
+
+//
+// Milliseconds left in the current wait period
+//
+DWORD DYNAMIC_WAIT::RemainingTime()
+{
+    if (!m_QPCValid)
+    {
+        return 0;
+    }
+
+    LARGE_INTEGER CurrentQPC = {0};
+    QueryPerformanceCounter(&CurrentQPC);
+    if (CurrentQPC.QuadPart >= m_WakeUpTime.QuadPart)
+    {
+        return 0;
+    }
+
+    return static_cast<DWORD>(((m_WakeUpTime.QuadPart - CurrentQPC.QuadPart) * 1000) / m_QPCFrequency.QuadPart) + 1;
+}
+
+
+//
+// Class measuring how long it takes to recover from each kind of transition
+//
+class TRANSITION_STATS
+{
+    public :
+        TRANSITION_STATS();
+        ~TRANSITION_STATS();
+
+        void Begin(TRANSITION_TYPE Type);
+        void Reclassify(TRANSITION_TYPE Type);
+        void End();
+
+    private :
+
+    static const LPCWSTR    m_TransitionNames[TRANSITION_COUNT];
+
+    LARGE_INTEGER           m_QPCFrequency;
+    LARGE_INTEGER           m_StartTime;
+    TRANSITION_TYPE         m_CurrentType;
+    bool                    m_Pending;
+    UINT                    m_Count[TRANSITION_COUNT];
+    double                  m_TotalMs[TRANSITION_COUNT];
+    double                  m_MaxMs[TRANSITION_COUNT];
+};
+const LPCWSTR TRANSITION_STATS::m_TransitionNames[TRANSITION_COUNT] = {
+                                                                          L"desktop switch",
+                                                                          L"access lost",
+                                                                          L"output change",
+                                                                          L"device removed",
+                                                                          L"session change",
+                                                                          L"presenter failure"
+                                                                      };
+
+TRANSITION_STATS::TRANSITION_STATS() : m_CurrentType(TRANSITION_PRESENTER), m_Pending(false)
+{
+    QueryPerformanceFrequency(&m_QPCFrequency);
+    m_StartTime.QuadPart = 0;
+    RtlZeroMemory(m_Count, sizeof(m_Count));
+    RtlZeroMemory(m_TotalMs, sizeof(m_TotalMs));
+    RtlZeroMemory(m_MaxMs, sizeof(m_MaxMs));
+}
+
+TRANSITION_STATS::~TRANSITION_STATS()
+{
+}
+
+//
+// Called when a transition is detected, retries of a transition still being recovered are folded into it
+//
+void TRANSITION_STATS::Begin(TRANSITION_TYPE Type)
+{
+    if (!m_Pending)
+    {
+        QueryPerformanceCounter(&m_StartTime);
+        m_Pending = true;
+    }
+    m_CurrentType = Type;
+}
+
+void TRANSITION_STATS::Reclassify(TRANSITION_TYPE Type)
+{
+    m_CurrentType = Type;
+}
+
+//
+// Called once duplication is running again
+//
+void TRANSITION_STATS::End()
+{
+    if (!m_Pending)
+    {
+        return;
+    }
+    m_Pending = false;
+
+    LARGE_INTEGER CurrentQPC;
+    QueryPerformanceCounter(&CurrentQPC);
+    double ElapsedMs = (CurrentQPC.QuadPart - m_StartTime.QuadPart) * 1000.0 / m_QPCFrequency.QuadPart;
+
+    m_Count[m_CurrentType]++;
+    m_TotalMs[m_CurrentType] += ElapsedMs;
+    m_MaxMs[m_CurrentType] = max(m_MaxMs[m_CurrentType], ElapsedMs);
+
+    wchar_t Msg[160];
+    swprintf_s(Msg, L"Recovered from %s in %.1f ms (count %u, average %.1f ms, max %.1f ms)\n",
+               m_TransitionNames[m_CurrentType], ElapsedMs, m_Count[m_CurrentType],
+               m_TotalMs[m_CurrentType] / m_Count[m_CurrentType], m_MaxMs[m_CurrentType]);
+    OutputDebugStringW(Msg);
+}
+
+//
+// Map an expected error to the kind of transition it is a sign of
+//
+TRANSITION_TYPE ClassifyExpectedError(HRESULT hr)
+{
+    switch (hr)
+    {
+        case DXGI_ERROR_ACCESS_LOST :
+            return TRANSITION_ACCESS_LOST;
+
+        case DXGI_ERROR_DEVICE_REMOVED :
+            return TRANSITION_DEVICE_REMOVED;
+
+        case DXGI_ERROR_NOT_FOUND :
+            return TRANSITION_OUTPUT_CHANGE;
+
+        case DXGI_ERROR_SESSION_DISCONNECTED :
+        case DXGI_ERROR_UNSUPPORTED :
+            return TRANSITION_SESSION;
+
+        case E_ACCESSDENIED :
+        case static_cast<HRESULT>(WAIT_ABANDONED) :
+        default :
+            return TRANSITION_DESKTOP_SWITCH;
+    }
+}
+
+//
+// Decide what kind of transition is being handled from the expected errors reported since the last one.
+// A transition shows up as errors of lesser kinds too (a removed device also loses access), the most severe
+// kind reported wins.
+//
+TRANSITION_TYPE ClassifyTransition(bool PresenterFailed, _Inout_updates_(TRANSITION_COUNT) UINT* HandledCounts)
+{
+    static const TRANSITION_TYPE Severity[] = {TRANSITION_DEVICE_REMOVED, TRANSITION_SESSION, TRANSITION_OUTPUT_CHANGE, TRANSITION_ACCESS_LOST, TRANSITION_DESKTOP_SWITCH};
+
+    UINT Counts[TRANSITION_COUNT];
+    EventReporter.GetTransitionCounts(Counts);
+    TRANSITION_TYPE Transition = TRANSITION_DESKTOP_SWITCH;
+    for (TRANSITION_TYPE Type : Severity)
+    {
+        if (Counts[Type] != HandledCounts[Type])
+        {
+            Transition = Type;
+            break;
+        }
+    }
+    RtlCopyMemory(HandledCounts, Counts, sizeof(Counts));
+
+    return PresenterFailed ? TRANSITION_PRESENTER : Transition;
+}
+
 
 //
 // Program entry point
@@ -149,7 +332,32 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
     UNREFERENCED_PARAMETER(hPrevInstance);
     UNREFERENCED_PARAMETER(lpCmdLine);
 
+    // Debug builds check that the frame loops stay off the heap
+    InstallAllocationHook();
+
+    // Without the reporting thread events are only shown once we stop it
+    EventReporter.Start();
+
+    INT Result = RunApplication(hInstance, nCmdShow);
+
+    // The user still gets to read why we exit
+    EventReporter.Stop();
+
+    return Result;
+}
+
+//
+// Everything between starting and stopping the event reporter
+//
+INT RunApplication(_In_ HINSTANCE hInstance, INT nCmdShow)
+{
     INT SingleOutput;
+    PRESENT_OPTIONS PresentOptions;
+    HMD_OPTIONS HmdOptions;
+    DUPLICATION_OPTIONS DuplOptions;
+    FOVEATION_OPTIONS FoveationOptions;
+    SCALING_OPTIONS ScalingOptions;
+    PREDICTION_OPTIONS PredictionOptions;
 
     // Synchronization
     HANDLE UnexpectedErrorEvent = nullptr;
@@ -159,7 +367,7 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
     // Window
     HWND WindowHandle = nullptr;
 
-    bool CmdResult = ProcessCmdline(&SingleOutput);
+    bool CmdResult = ProcessCmdline(&SingleOutput, &PresentOptions, &HmdOptions, &DuplOptions, &FoveationOptions, &ScalingOptions, &PredictionOptions);
     if (!CmdResult)
     {
         ShowHelp();
@@ -235,17 +443,56 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 
     DestroyCursor(Cursor);
 
+    // Every thread times its passes onto one timeline, written out when we exit. The governor reads the GPU
+    // timings off it too and the refresh policy's GPU time per hour is summed from it, neither keeps the events.
+    PROFILETIMELINE Timeline;
+    if (DuplOptions.ProfilePath || DuplOptions.Govern || HmdOptions.Policy == MODE_POLICY_CONTENT)
+    {
+        if (!Timeline.Initialize(DuplOptions.ProfilePath ? PROFILE_EVENT_CAPACITY : 0))
+        {
+            ProcessFailure(nullptr, L"Failed to allocate the profiling timeline", L"Error", E_OUTOFMEMORY);
+            return 0;
+        }
+        DuplOptions.Timeline = &Timeline;
+        PresentOptions.Timeline = &Timeline;
+    }
+
+    // Sheds work while the presenter runs over its budget
+    FRAMEGOVERNOR Governor;
+    if (DuplOptions.Govern)
+    {
+        DuplOptions.Governor = &Governor;
+        PresentOptions.Governor = &Governor;
+    }
+
     ShowWindow(WindowHandle, nCmdShow);
     UpdateWindow(WindowHandle);
 
+    OutMgr.SetHmdOptions(&HmdOptions);
+    OutMgr.SetDuplicationOptions(&DuplOptions);
+    OutMgr.SetFoveationOptions(&FoveationOptions);
+    OutMgr.SetScalingOptions(&ScalingOptions);
+    OutMgr.SetPredictionOptions(&PredictionOptions);
+
     THREADMANAGER ThreadMgr;
+    ThreadMgr.SetOptions(&DuplOptions);
     RECT DeskBounds;
     UINT OutputCount;
 
+    // The presenter starts paused and is resumed once the HMD side is up
+    PRESENTMANAGER Presenter;
+    if (Presenter.Initialize(&OutMgr, &ThreadMgr, &PresentOptions, UnexpectedErrorEvent, ExpectedErrorEvent) != DUPL_RETURN_SUCCESS)
+    {
+        return 0;
+    }
+
     // Message loop (attempts to update screen when no other messages to process)
     MSG msg = {0};
-    bool FirstTime = true;
+    bool RetryPending = true;
+    bool FullReset = true;
     DYNAMIC_WAIT DynamicWait;
+    TRANSITION_STATS TransitionStats;
+    UINT HandledErrorCounts[TRANSITION_COUNT] = {};
 
     while (WM_QUIT != msg.message)
     {
@@ -261,38 +508,82 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
             // Unexpected error occurred so exit the application
             break;
         }
-        else if (FirstTime || WaitForSingleObjectEx(ExpectedErrorEvent, 0, FALSE) == WAIT_OBJECT_0)
+        else if (WaitForSingleObjectEx(ExpectedErrorEvent, 0, FALSE) == WAIT_OBJECT_0)
         {
-            if (!FirstTime)
+            // Terminate other threads
+            SetEvent(TerminateThreadsEvent);
+            ThreadMgr.WaitForThreadTermination();
+            ResetEvent(TerminateThreadsEvent);
+            ResetEvent(ExpectedErrorEvent);
+
+            // Only rebuild the direct display output when the HMD side itself went away, otherwise
+            // the scanout surfaces and fences are kept and only duplication is restarted
+            TRANSITION_TYPE Transition = ClassifyTransition(Presenter.CheckFailed(), HandledErrorCounts);
+            if (FullReset || OutMgr.IsOutputLost())
             {
-                // Terminate other threads
-                SetEvent(TerminateThreadsEvent);
-                ThreadMgr.WaitForThreadTermination();
-                ResetEvent(TerminateThreadsEvent);
-                ResetEvent(ExpectedErrorEvent);
+                Transition = TRANSITION_PRESENTER;
+            }
+            FullReset = (Transition == TRANSITION_PRESENTER);
+            TransitionStats.Begin(Transition);
 
-                // Clean up
-                ThreadMgr.Clean();
+            // Clean up. The presenter reads the damage list so it is held for the time it takes.
+            Presenter.Pause();
+            ThreadMgr.Clean();
+            if (FullReset)
+            {
                 OutMgr.CleanRefs();
-
-                // As we have encountered an error due to a system transition we wait before trying again, using this dynamic wait
-                // the wait periods will get progressively long to avoid wasting too much system resource if this state lasts a long time
-                DynamicWait.Wait();
             }
             else
             {
-                // First time through the loop so nothing to clean up
-                FirstTime = false;
+                Presenter.Resume();
             }
 
+            // As we have encountered an error due to a system transition we wait before trying again, using this dynamic wait
+            // the wait periods will get progressively long to avoid wasting too much system resource if this state lasts a long time.
+            // Unless the HMD side went away, we keep presenting the last frame in the meantime.
+            DynamicWait.Start();
+            RetryPending = true;
+        }
+        else if (RetryPending && DynamicWait.Expired())
+        {
+            RetryPending = false;
+
             // Re-initialize
-            Ret = OutMgr.InitOutput(SingleOutput, &OutputCount, &DeskBounds);
+            if (FullReset)
+            {
+                Ret = OutMgr.InitOutput(SingleOutput, &OutputCount, &DeskBounds);
+            }
+            else
+            {
+                bool SurfaceRecreated;
+                Presenter.Pause();
+                Ret = OutMgr.ResetDesktop(SingleOutput, &OutputCount, &DeskBounds, &SurfaceRecreated);
+                if (Ret == DUPL_RETURN_SUCCESS)
+                {
+                    Presenter.Resume();
+                }
+                else
+                {
+                    // The shared surface may be gone, so the presenter stays paused until a full reset rebuilds it
+                    FullReset = true;
+                }
+                if (SurfaceRecreated)
+                {
+                    TransitionStats.Reclassify(TRANSITION_OUTPUT_CHANGE);
+                }
+            }
             if (Ret == DUPL_RETURN_SUCCESS)
             {
+                if (FullReset)
+                {
+                    FullReset = false;
+                    Presenter.Resume();
+                }
+
                 HANDLE SharedHandle = OutMgr.GetSharedHandle();
                 if (SharedHandle)
                 {
-                    Ret = ThreadMgr.Initialize(SingleOutput, OutputCount, UnexpectedErrorEvent, ExpectedErrorEvent, TerminateThreadsEvent, SharedHandle, &DeskBounds);
+                    Ret = ThreadMgr.Initialize(SingleOutput, OutputCount, UnexpectedErrorEvent, ExpectedErrorEvent, TerminateThreadsEvent, SharedHandle, OutMgr.GetSharedFormat(), OutMgr.GetAdapterLuid(), &DeskBounds);
                 }
                 else
                 {
@@ -300,12 +591,21 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
                     Ret = DUPL_RETURN_ERROR_UNEXPECTED;
                 }
             }
+            if (Ret == DUPL_RETURN_SUCCESS)
+            {
+                TransitionStats.End();
+            }
+        }
+        else if (FullReset || Presenter.IsThreaded())
+        {
+            // Nothing to do here until a thread reports an error, the retry is due or a window message arrives
+            HANDLE Events[] = {UnexpectedErrorEvent, ExpectedErrorEvent};
+            MsgWaitForMultipleObjectsEx(ARRAYSIZE(Events), Events, RetryPending ? DynamicWait.RemainingTime() : INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
         }
         else
         {
-            // Nothing else to do, so try to present to write out to window if not occluded
-            OutMgr.WaitNextVBlank();
-            Ret = OutMgr.UpdateApplicationWindow(ThreadMgr.GetPointerInfo());
+            // Nothing else to do, so present. This keeps going with the last good frame while duplication restarts.
+            Ret = Presenter.PresentOnce();
         }
 
         // Check if for errors
@@ -324,12 +624,20 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
         }
     }
 
+    // Stop presenting before the output goes away
+    Presenter.Terminate();
+
     // Make sure all other threads have exited
     if (SetEvent(TerminateThreadsEvent))
     {
         ThreadMgr.WaitForThreadTermination();
     }
 
+    if (DuplOptions.ProfilePath && !Timeline.Export(DuplOptions.ProfilePath))
+    {
+        OutputDebugStringW(L"Failed to write the profiling trace\n");
+    }
+
     // Clean up
     CloseHandle(UnexpectedErrorEvent);
     CloseHandle(ExpectedErrorEvent);
@@ -349,16 +657,32 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 //
 void ShowHelp()
 {
-    DisplayMsg(L"The following optional parameters can be used -\n  /output [all | n]\t\tto duplicate all outputs or the nth output\n  /?\t\t\tto display this help section",
+    DisplayMsg(L"The following optional parameters can be used -\n  /output [all | n]\t\tto duplicate all outputs or the nth output\n  /inlinepresent\t\tto present from the message loop instead of a dedicated thread\n  /mmcss [games | proaudio | none]\tto pick the MMCSS task of the presentation thread\n  /realtime\t\tto run the presentation thread at time critical priority\n  /tiledetect\t\tto find what really changed in frames reported as fully dirty\n  /hdr\t\t\tto capture HDR desktops in FP16 and tone map them onto the headset\n  /computeapply\t\tto apply moves and dirty rects with one compute dispatch per frame where the adapter supports it\n  /record file\t\tto record what the headset shows to a frame log for reproducing glitches\n  /stream port\t\tto stream what the headset shows as LZ4 tiles to a client connecting on this TCP port\n  /profile file\t\tto time every capture and present pass on the CPU and GPU and write a trace of the last few minutes on exit\n  /governor\t\tto shed capture and filtering work while the headset frames run over their budget\n  /hmd vid:pid\t\tto drive the headset with these hexadecimal EDID vendor and product IDs\n  /refresh hz\t\tto override the refresh rate of the headset profile\n  /modepolicy [profile | refresh | latency | content]\tto pick the profile mode, the highest refresh rate, the lowest latency mode or a refresh rate following the desktop: low when idle, a multiple of a playing video's and highest while the pointer moves\n  /scanouts n\t\tto set the number of scanout surfaces (2 to 4)\n  /pacing us\t\tto set how early before v-blank to present\n  /mipmaps\t\tto keep mip maps of the desktop so it does not alias when shown smaller\n  /filter [bilinear | bicubic | lanczos]\tto pick the filter used to resample the desktop onto the headset\n  /foveation [off | center | pointer]\tto show only a region around the center or the pointer at full resolution\n  /foveascale [2 | 4]\tto set how much the rest of the desktop is downscaled\n  /foveasize percent\tto set the size of the full resolution region\n  /predict [off | velocity | kalman]\tto pick how the pointer is extrapolated to when the headset shows it\n  /pointertrace file\tto write the pointer updates to a trace for tuning the prediction\n  /pointersource [dxgi | cursor]\tto take pointer positions from DXGI or from sampling the cursor at 1 kHz\n  /?\t\t\tto display this help section",
                L"Proper usage", S_OK);
 }
 
 //
 // Process command line parameters
 //
-bool ProcessCmdline(_Out_ INT* Output)
+bool ProcessCmdline(_Out_ INT* Output, _Out_ PRESENT_OPTIONS* PresentOptions, _Out_ HMD_OPTIONS* HmdOptions, _Out_ DUPLICATION_OPTIONS* DuplOptions, _Out_ FOVEATION_OPTIONS* FoveationOptions, _Out_ SCALING_OPTIONS* ScalingOptions, _Out_ PREDICTION_OPTIONS* PredictionOptions)
 {
     *Output = 0;
+    RtlZeroMemory(HmdOptions, sizeof(HMD_OPTIONS));
+    HmdOptions->Policy = MODE_POLICY_PROFILE;
+    PresentOptions->PresentThread = true;
+    PresentOptions->MmcssTask = L"Games";
+    PresentOptions->RealTime = false;
+    PresentOptions->Timeline = nullptr;
+    PresentOptions->Governor = nullptr;
+    RtlZeroMemory(DuplOptions, sizeof(DUPLICATION_OPTIONS));
+    FoveationOptions->Mode = FOVEATION_OFF;
+    FoveationOptions->Scale = FOVEATION_DEFAULT_SCALE;
+    FoveationOptions->FoveaPercent = FOVEATION_DEFAULT_PERCENT;
+    ScalingOptions->MipLevels = 1;
+    ScalingOptions->Filter = SCALING_FILTER_BILINEAR;
+    PredictionOptions->Mode = PREDICTION_KALMAN;
+    PredictionOptions->Source = POINTER_SOURCE_CURSOR;
+    PredictionOptions->TracePath = nullptr;
 
     // __argv and __argc are global vars set by system
     for (UINT i = 1; i < static_cast<UINT>(__argc); ++i)
@@ -381,6 +705,345 @@ bool ProcessCmdline(_Out_ INT* Output)
             }
             continue;
         }
+        else if ((strcmp(__argv[i], "-inlinepresent") == 0) ||
+                 (strcmp(__argv[i], "/inlinepresent") == 0))
+        {
+            PresentOptions->PresentThread = false;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-mmcss") == 0) ||
+                 (strcmp(__argv[i], "/mmcss") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            if (strcmp(__argv[i], "games") == 0)
+            {
+                PresentOptions->MmcssTask = L"Games";
+            }
+            else if (strcmp(__argv[i], "proaudio") == 0)
+            {
+                PresentOptions->MmcssTask = L"Pro Audio";
+            }
+            else if (strcmp(__argv[i], "none") == 0)
+            {
+                PresentOptions->MmcssTask = nullptr;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-realtime") == 0) ||
+                 (strcmp(__argv[i], "/realtime") == 0))
+        {
+            PresentOptions->RealTime = true;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-tiledetect") == 0) ||
+                 (strcmp(__argv[i], "/tiledetect") == 0))
+        {
+            DuplOptions->TileDetection = true;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-hdr") == 0) ||
+                 (strcmp(__argv[i], "/hdr") == 0))
+        {
+            DuplOptions->Hdr = true;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-computeapply") == 0) ||
+                 (strcmp(__argv[i], "/computeapply") == 0))
+        {
+            DuplOptions->ComputeApply = true;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-record") == 0) ||
+                 (strcmp(__argv[i], "/record") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+            DuplOptions->RecordPath = __argv[i];
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-stream") == 0) ||
+                 (strcmp(__argv[i], "/stream") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+            INT Port = atoi(__argv[i]);
+            if (Port <= 0 || Port > 65535)
+            {
+                return false;
+            }
+            DuplOptions->StreamPort = static_cast<UINT>(Port);
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-profile") == 0) ||
+                 (strcmp(__argv[i], "/profile") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+            DuplOptions->ProfilePath = __argv[i];
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-governor") == 0) ||
+                 (strcmp(__argv[i], "/governor") == 0))
+        {
+            DuplOptions->Govern = true;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-hmd") == 0) ||
+                 (strcmp(__argv[i], "/hmd") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            UINT VendorId;
+            UINT ProductId;
+            if (sscanf_s(__argv[i], "%x:%x", &VendorId, &ProductId) != 2 || VendorId > 0xFFFF || ProductId > 0xFFFF)
+            {
+                return false;
+            }
+            HmdOptions->OverrideTarget = true;
+            HmdOptions->VendorId = static_cast<uint16_t>(VendorId);
+            HmdOptions->ProductId = static_cast<uint16_t>(ProductId);
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-refresh") == 0) ||
+                 (strcmp(__argv[i], "/refresh") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            HmdOptions->RefreshRate = atof(__argv[i]);
+            if (HmdOptions->RefreshRate <= 0)
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-modepolicy") == 0) ||
+                 (strcmp(__argv[i], "/modepolicy") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            if (strcmp(__argv[i], "profile") == 0)
+            {
+                HmdOptions->Policy = MODE_POLICY_PROFILE;
+            }
+            else if (strcmp(__argv[i], "refresh") == 0)
+            {
+                HmdOptions->Policy = MODE_POLICY_HIGHEST_REFRESH;
+            }
+            else if (strcmp(__argv[i], "latency") == 0)
+            {
+                HmdOptions->Policy = MODE_POLICY_LOWEST_LATENCY;
+            }
+            else if (strcmp(__argv[i], "content") == 0)
+            {
+                HmdOptions->Policy = MODE_POLICY_CONTENT;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-scanouts") == 0) ||
+                 (strcmp(__argv[i], "/scanouts") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            HmdOptions->ScanoutCount = atoi(__argv[i]);
+            if (HmdOptions->ScanoutCount < HMD_MIN_SCANOUT_COUNT || HmdOptions->ScanoutCount > HMD_MAX_SCANOUT_COUNT)
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-pacing") == 0) ||
+                 (strcmp(__argv[i], "/pacing") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            INT PacingUs = atoi(__argv[i]);
+            if (PacingUs <= 0)
+            {
+                return false;
+            }
+            HmdOptions->PacingOffsetNs = static_cast<uint64_t>(PacingUs) * 1000;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-mipmaps") == 0) ||
+                 (strcmp(__argv[i], "/mipmaps") == 0))
+        {
+            ScalingOptions->MipLevels = MIP_MAX_LEVELS;
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-filter") == 0) ||
+                 (strcmp(__argv[i], "/filter") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            if (strcmp(__argv[i], "bilinear") == 0)
+            {
+                ScalingOptions->Filter = SCALING_FILTER_BILINEAR;
+            }
+            else if (strcmp(__argv[i], "bicubic") == 0)
+            {
+                ScalingOptions->Filter = SCALING_FILTER_BICUBIC;
+            }
+            else if (strcmp(__argv[i], "lanczos") == 0)
+            {
+                ScalingOptions->Filter = SCALING_FILTER_LANCZOS;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-foveation") == 0) ||
+                 (strcmp(__argv[i], "/foveation") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            if (strcmp(__argv[i], "off") == 0)
+            {
+                FoveationOptions->Mode = FOVEATION_OFF;
+            }
+            else if (strcmp(__argv[i], "center") == 0)
+            {
+                FoveationOptions->Mode = FOVEATION_CENTER;
+            }
+            else if (strcmp(__argv[i], "pointer") == 0)
+            {
+                FoveationOptions->Mode = FOVEATION_POINTER;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-foveascale") == 0) ||
+                 (strcmp(__argv[i], "/foveascale") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            FoveationOptions->Scale = atoi(__argv[i]);
+            if (FoveationOptions->Scale != 2 && FoveationOptions->Scale != 4)
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-foveasize") == 0) ||
+                 (strcmp(__argv[i], "/foveasize") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            INT Percent = atoi(__argv[i]);
+            if (Percent < 10 || Percent > 100)
+            {
+                return false;
+            }
+            FoveationOptions->FoveaPercent = static_cast<UINT>(Percent);
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-predict") == 0) ||
+                 (strcmp(__argv[i], "/predict") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            if (strcmp(__argv[i], "off") == 0)
+            {
+                PredictionOptions->Mode = PREDICTION_OFF;
+            }
+            else if (strcmp(__argv[i], "velocity") == 0)
+            {
+                PredictionOptions->Mode = PREDICTION_VELOCITY;
+            }
+            else if (strcmp(__argv[i], "kalman") == 0)
+            {
+                PredictionOptions->Mode = PREDICTION_KALMAN;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-pointertrace") == 0) ||
+                 (strcmp(__argv[i], "/pointertrace") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+            PredictionOptions->TracePath = __argv[i];
+            continue;
+        }
+        else if ((strcmp(__argv[i], "-pointersource") == 0) ||
+                 (strcmp(__argv[i], "/pointersource") == 0))
+        {
+            if (++i >= static_cast<UINT>(__argc))
+            {
+                return false;
+            }
+
+            if (strcmp(__argv[i], "dxgi") == 0)
+            {
+                PredictionOptions->Source = POINTER_SOURCE_DXGI;
+            }
+            else if (strcmp(__argv[i], "cursor") == 0)
+            {
+                PredictionOptions->Source = POINTER_SOURCE_CURSOR;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
         else
         {
             return false;
@@ -416,6 +1079,12 @@ DWORD WINAPI DDProc(_In_ void* Param)
     // Classes
     DISPLAYMANAGER DispMgr;
     DUPLICATIONMANAGER DuplMgr;
+    GPUPROFILER Profiler;
+    uint64_t FrameCount = 0;
+
+    // Per-frame CPU data, reset when a new frame is acquired
+    FRAMEARENA Arena;
+    ALLOCATIONCOUNTER AllocCounter(L"DDProc");
 
     // D3D objects
     ID3D11Texture2D* SharedSurf = nullptr;
@@ -431,6 +1100,7 @@ DWORD WINAPI DDProc(_In_ void* Param)
     if (!CurrentDesktop)
     {
         // We do not have access to the desktop so request a retry
+        ReportExpectedError(L"Failed to open the input desktop", E_ACCESSDENIED);
         SetEvent(TData->ExpectedErrorEvent);
         Ret = DUPL_RETURN_ERROR_EXPECTED;
         goto Exit;
@@ -443,12 +1113,17 @@ DWORD WINAPI DDProc(_In_ void* Param)
     if (!DesktopAttached)
     {
         // We do not have access to the desktop so request a retry
+        ReportExpectedError(L"Failed to attach to the input desktop", E_ACCESSDENIED);
         Ret = DUPL_RETURN_ERROR_EXPECTED;
         goto Exit;
     }
 
     // New display manager
-    DispMgr.InitD3D(&TData->DxRes);
+    DispMgr.InitD3D(&TData->DxRes, &TData->Options);
+
+    // GPU time of the copies goes on this output's lane of the timeline
+    Profiler.Initialize(TData->DxRes.Device, TData->DxRes.Context, TData->Options.Timeline, TData->Output + 1);
+    DispMgr.SetProfiler(&Profiler);
 
     // Obtain handle to sync shared Surface
     HRESULT hr = TData->DxRes.Device->OpenSharedResource(TData->TexSharedHandle, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&SharedSurf));
@@ -466,7 +1141,7 @@ DWORD WINAPI DDProc(_In_ void* Param)
     }
 
     // Make duplication manager
-    Ret = DuplMgr.InitDupl(TData->DxRes.Device, TData->Output);
+    Ret = DuplMgr.InitDupl(TData->DxRes.Device, TData->Output, TData->CaptureFormat);
     if (Ret != DUPL_RETURN_SUCCESS)
     {
         goto Exit;
@@ -480,14 +1155,38 @@ DWORD WINAPI DDProc(_In_ void* Param)
     // Main duplication loop
     bool WaitToProcessCurrentFrame = false;
     FRAME_DATA CurrentData;
+    uint64_t LastCaptureNs = 0;
 
     while ((WaitForSingleObjectEx(TData->TerminateThreadsEvent, 0, FALSE) == WAIT_TIMEOUT))
     {
         if (!WaitToProcessCurrentFrame)
         {
+            // Shedding work, this output is captured at a reduced rate. DXGI gathers whatever changes meanwhile
+            // into the next frame, pointer moves onto the output included.
+            if (TData->Options.Governor)
+            {
+                AcquireSRWLockShared(&TData->PtrPosition->Lock);
+                bool PointerHere = (TData->PtrPosition->WhoUpdatedPositionLast == TData->Output);
+                ReleaseSRWLockShared(&TData->PtrPosition->Lock);
+
+                uint64_t IntervalNs = TData->Options.Governor->GetCaptureIntervalNs(PointerHere);
+                LARGE_INTEGER Now;
+                QueryPerformanceCounter(&Now);
+                uint64_t NowNs = QpcToNs(Now.QuadPart);
+                if (IntervalNs && NowNs - LastCaptureNs < IntervalNs)
+                {
+                    WaitForSingleObjectEx(TData->TerminateThreadsEvent, static_cast<DWORD>((IntervalNs - (NowNs - LastCaptureNs)) / 1000000) + 1, FALSE);
+                    continue;
+                }
+            }
+
+            // Previous frame is done with, start over
+            Arena.Reset();
+            AllocCounter.BeginFrame();
+
             // Get new frame from desktop duplication
             bool TimeOut;
-            Ret = DuplMgr.GetFrame(&CurrentData, &TimeOut);
+            Ret = DuplMgr.GetFrame(&CurrentData, &Arena, &TimeOut);
             if (Ret != DUPL_RETURN_SUCCESS)
             {
                 // An error occurred getting the next frame drop out of loop which
@@ -501,6 +1200,24 @@ DWORD WINAPI DDProc(_In_ void* Param)
                 // No new frame at the moment
                 continue;
             }
+
+            LARGE_INTEGER CaptureTime;
+            QueryPerformanceCounter(&CaptureTime);
+            LastCaptureNs = QpcToNs(CaptureTime.QuadPart);
+
+            // Nothing changed but the pointer position: publish it and skip the shared surface, the presenter
+            // only redraws the cursor
+            if (!CurrentData.FrameInfo.TotalMetadataBufferSize && !CurrentData.FrameInfo.PointerShapeBufferSize)
+            {
+                DuplMgr.UpdatePointerPosition(TData->PtrPosition, &(CurrentData.FrameInfo), TData->OffsetX, TData->OffsetY);
+                Ret = DuplMgr.DoneWithFrame();
+                if (Ret != DUPL_RETURN_SUCCESS)
+                {
+                    break;
+                }
+                AllocCounter.EndFrame();
+                continue;
+            }
         }
 
         // We have a new frame so try and process it
@@ -524,7 +1241,7 @@ DWORD WINAPI DDProc(_In_ void* Param)
         WaitToProcessCurrentFrame = false;
 
         // Get mouse info
-        Ret = DuplMgr.GetMouse(TData->PtrInfo, &(CurrentData.FrameInfo), TData->OffsetX, TData->OffsetY);
+        Ret = DuplMgr.GetMouse(TData->PtrInfo, TData->PtrPosition, &(CurrentData.FrameInfo), TData->OffsetX, TData->OffsetY);
         if (Ret != DUPL_RETURN_SUCCESS)
         {
             DuplMgr.DoneWithFrame();
@@ -533,7 +1250,9 @@ DWORD WINAPI DDProc(_In_ void* Param)
         }
 
         // Process new frame
-        Ret = DispMgr.ProcessFrame(&CurrentData, SharedSurf, TData->OffsetX, TData->OffsetY, &DesktopDesc);
+        Profiler.BeginFrame(FrameCount++);
+        Ret = DispMgr.ProcessFrame(&CurrentData, SharedSurf, TData->OffsetX, TData->OffsetY, &DesktopDesc, &Arena, TData->Damage);
+        Profiler.EndFrame();
         if (Ret != DUPL_RETURN_SUCCESS)
         {
             DuplMgr.DoneWithFrame();
@@ -556,6 +1275,8 @@ DWORD WINAPI DDProc(_In_ void* Param)
         {
             break;
         }
+
+        AllocCounter.EndFrame();
     }
 
 Exit:
@@ -638,40 +1359,45 @@ DUPL_RETURN ProcessFailure(_In_opt_ ID3D11Device* Device, _In_ LPCWSTR Str, _In_
         {
             if (*(CurrentResult++) == TranslatedHr)
             {
+                ReportExpectedError(Str, TranslatedHr);
                 return DUPL_RETURN_ERROR_EXPECTED;
             }
         }
     }
 
-    // Error was not expected so display the message box
-    DisplayMsg(Str, Title, TranslatedHr);
+    // Error was not expected, the reporting thread shows it while we exit
+    EventReporter.Report(EVENT_UNEXPECTED, TRANSITION_DESKTOP_SWITCH, TranslatedHr, Str, Title);
 
     return DUPL_RETURN_ERROR_UNEXPECTED;
 }
 
 //
-// Displays a message
+// Count an expected error towards the kind of transition it is a sign of, so the main loop can tell what occurred
 //
-void DisplayMsg(_In_ LPCWSTR Str, _In_ LPCWSTR Title, HRESULT hr)
+void ReportExpectedError(_In_ LPCWSTR Site, HRESULT hr)
 {
-    if (SUCCEEDED(hr))
-    {
-        MessageBoxW(nullptr, Str, Title, MB_OK);
-        return;
-    }
-
-    const UINT StringLen = (UINT)(wcslen(Str) + sizeof(" with HRESULT 0x########."));
-    wchar_t* OutStr = new wchar_t[StringLen];
-    if (!OutStr)
-    {
-        return;
-    }
+    EventReporter.Report(EVENT_EXPECTED, ClassifyExpectedError(hr), hr, Site, L"Transition");
+}
 
-    INT LenWritten = swprintf_s(OutStr, StringLen, L"%s with 0x%X.", Str, hr);
-    if (LenWritten != -1)
-    {
-        MessageBoxW(nullptr, OutStr, Title, MB_OK);
-    }
+//
+// Convert a QueryPerformanceCounter value to nanoseconds, the clock of the pointer history
+//
+uint64_t QpcToNs(LONGLONG Ticks)
+{
+    // Fixed at boot, and reading it is cheap
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency(&Frequency);
+
+    // Split so the multiplication does not overflow after a few days of uptime
+    uint64_t Seconds = static_cast<uint64_t>(Ticks / Frequency.QuadPart);
+    uint64_t Remainder = static_cast<uint64_t>(Ticks % Frequency.QuadPart);
+    return Seconds * 1000000000ull + Remainder * 1000000000ull / static_cast<uint64_t>(Frequency.QuadPart);
+}
 
-    delete [] OutStr;
+//
+// Displays a message from the reporting thread, Str and Title must be static strings
+//
+void DisplayMsg(_In_ LPCWSTR Str, _In_ LPCWSTR Title, HRESULT hr)
+{
+    EventReporter.Report(FAILED(hr) ? EVENT_UNEXPECTED : EVENT_MESSAGE, TRANSITION_DESKTOP_SWITCH, hr, Str, Title);
 }
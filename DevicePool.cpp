@@ -0,0 +1,377 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "DevicePool.h"
+
+DEVICEPOOL::DEVICEPOOL()
+{
+}
+
+DEVICEPOOL::~DEVICEPOOL()
+{
+    Clean();
+}
+
+//
+// Release every pooled device
+//
+void DEVICEPOOL::Clean()
+{
+    for (auto& Entry : m_Entries)
+    {
+        CleanEntry(&Entry);
+    }
+    m_Entries.clear();
+}
+
+void DEVICEPOOL::CleanEntry(_Inout_ POOL_ENTRY* Entry)
+{
+    CleanDx(&Entry->DxRes);
+}
+
+//
+// Get references to the shared resources for the given adapter, creating them on first use
+//
+DUPL_RETURN DEVICEPOOL::GetResources(LUID AdapterLuid, _Out_ DX_RESOURCES* Data)
+{
+    RtlZeroMemory(Data, sizeof(DX_RESOURCES));
+
+    for (auto Entry = m_Entries.begin(); Entry != m_Entries.end(); ++Entry)
+    {
+        if (Entry->AdapterLuid.LowPart != AdapterLuid.LowPart || Entry->AdapterLuid.HighPart != AdapterLuid.HighPart)
+        {
+            continue;
+        }
+
+        // A device that went away during a transition cannot be handed out again
+        if (Entry->DxRes.Device->GetDeviceRemovedReason() != S_OK)
+        {
+            CleanEntry(&(*Entry));
+            m_Entries.erase(Entry);
+            break;
+        }
+
+        *Data = Entry->DxRes;
+        AddRefDx(Data);
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    POOL_ENTRY NewEntry;
+    RtlZeroMemory(&NewEntry, sizeof(NewEntry));
+    NewEntry.AdapterLuid = AdapterLuid;
+
+    DUPL_RETURN Ret = CreateDevice(AdapterLuid, &NewEntry.DxRes);
+    if (Ret == DUPL_RETURN_SUCCESS)
+    {
+        Ret = CreateSharedState(&NewEntry.DxRes);
+    }
+    if (Ret != DUPL_RETURN_SUCCESS)
+    {
+        CleanEntry(&NewEntry);
+        return Ret;
+    }
+
+    m_Entries.push_back(NewEntry);
+
+    *Data = NewEntry.DxRes;
+    AddRefDx(Data);
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Create the device on the requested adapter
+//
+DUPL_RETURN DEVICEPOOL::CreateDevice(LUID AdapterLuid, _Inout_ DX_RESOURCES* Data)
+{
+    HRESULT hr = S_OK;
+
+    // Feature levels supported
+    D3D_FEATURE_LEVEL FeatureLevels[] =
+    {
+        D3D_FEATURE_LEVEL_11_0,
+        D3D_FEATURE_LEVEL_10_1,
+        D3D_FEATURE_LEVEL_10_0,
+        D3D_FEATURE_LEVEL_9_1
+    };
+    UINT NumFeatureLevels = ARRAYSIZE(FeatureLevels);
+
+    // Outputs can only be duplicated from a device living on the adapter they are attached to, so
+    // when we know that adapter we never fall back to a software device. Nor do we duplicate on it when
+    // the adapter itself is a software one.
+    IDXGIAdapter1* DxgiAdapter = nullptr;
+    if (AdapterLuid.LowPart || AdapterLuid.HighPart)
+    {
+        IDXGIFactory4* DxgiFactory = nullptr;
+        hr = CreateDXGIFactory2(0, __uuidof(IDXGIFactory4), reinterpret_cast<void**>(&DxgiFactory));
+        if (FAILED(hr))
+        {
+            return ProcessFailure(nullptr, L"Failed to create DXGI Factory in DEVICEPOOL", L"Error", hr);
+        }
+
+        hr = DxgiFactory->EnumAdapterByLuid(AdapterLuid, __uuidof(IDXGIAdapter1), reinterpret_cast<void**>(&DxgiAdapter));
+        DxgiFactory->Release();
+        DxgiFactory = nullptr;
+        if (FAILED(hr))
+        {
+            return ProcessFailure(nullptr, L"Failed to find adapter in DEVICEPOOL", L"Error", hr, EnumOutputsExpectedErrors);
+        }
+
+        DXGI_ADAPTER_DESC1 AdapterDesc;
+        hr = DxgiAdapter->GetDesc1(&AdapterDesc);
+        if (SUCCEEDED(hr) && (AdapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE))
+        {
+            hr = DXGI_ERROR_UNSUPPORTED;
+        }
+        if (FAILED(hr))
+        {
+            DxgiAdapter->Release();
+            DxgiAdapter = nullptr;
+            return ProcessFailure(nullptr, L"The adapter driving the headset is a software adapter, DEVICEPOOL will not duplicate on it", L"Error", hr);
+        }
+
+        hr = D3D11CreateDevice(DxgiAdapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0, FeatureLevels, NumFeatureLevels,
+                               D3D11_SDK_VERSION, &Data->Device, &Data->FeatureLevel, &Data->Context);
+        DxgiAdapter->Release();
+        DxgiAdapter = nullptr;
+
+        // Creating on an explicit adapter is always a hardware device
+        Data->DriverType = D3D_DRIVER_TYPE_HARDWARE;
+    }
+    else
+    {
+        // Driver types supported
+        D3D_DRIVER_TYPE DriverTypes[] =
+        {
+            D3D_DRIVER_TYPE_HARDWARE,
+            D3D_DRIVER_TYPE_WARP,
+            D3D_DRIVER_TYPE_REFERENCE,
+        };
+        UINT NumDriverTypes = ARRAYSIZE(DriverTypes);
+
+        for (UINT DriverTypeIndex = 0; DriverTypeIndex < NumDriverTypes; ++DriverTypeIndex)
+        {
+            hr = D3D11CreateDevice(nullptr, DriverTypes[DriverTypeIndex], nullptr, 0, FeatureLevels, NumFeatureLevels,
+                                   D3D11_SDK_VERSION, &Data->Device, &Data->FeatureLevel, &Data->Context);
+            if (SUCCEEDED(hr))
+            {
+                // Device creation success, no need to loop anymore
+                Data->DriverType = DriverTypes[DriverTypeIndex];
+                break;
+            }
+        }
+    }
+    if (FAILED(hr))
+    {
+        return ProcessFailure(nullptr, L"Failed to create device in DEVICEPOOL", L"Error", hr);
+    }
+
+    if (Data->DriverType != D3D_DRIVER_TYPE_HARDWARE)
+    {
+        DisplayMsg(L"No hardware device available, duplicating with a software device. Expect frames to run well over budget.", L"Warning", S_OK);
+    }
+
+    // All duplication threads issue commands on this device's immediate context
+    ID3D11Multithread* Multithread = nullptr;
+    hr = Data->Context->QueryInterface(__uuidof(ID3D11Multithread), reinterpret_cast<void**>(&Multithread));
+    if (FAILED(hr))
+    {
+        return ProcessFailure(nullptr, L"Failed to QI for ID3D11Multithread in DEVICEPOOL", L"Error", hr);
+    }
+    Multithread->SetMultithreadProtected(TRUE);
+    Multithread->Release();
+    Multithread = nullptr;
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Create shaders and state objects shared by every user of the device
+//
+DUPL_RETURN DEVICEPOOL::CreateSharedState(_Inout_ DX_RESOURCES* Data)
+{
+    // VERTEX shader
+    UINT Size = ARRAYSIZE(g_VS);
+    HRESULT hr = Data->Device->CreateVertexShader(g_VS, Size, nullptr, &Data->VertexShader);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(Data->Device, L"Failed to create vertex shader in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    // Input layout
+    D3D11_INPUT_ELEMENT_DESC Layout[] =
+    {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
+    };
+    UINT NumElements = ARRAYSIZE(Layout);
+    hr = Data->Device->CreateInputLayout(Layout, NumElements, g_VS, Size, &Data->InputLayout);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(Data->Device, L"Failed to create input layout in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    // Pixel shader
+    Size = ARRAYSIZE(g_PS);
+    hr = Data->Device->CreatePixelShader(g_PS, Size, nullptr, &Data->PixelShader);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(Data->Device, L"Failed to create pixel shader in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    // Dirty rects expanded from one instance per rect need integer vertex input and SV_VertexID
+    if (Data->FeatureLevel >= D3D_FEATURE_LEVEL_10_0)
+    {
+        Size = ARRAYSIZE(g_VS_DirtyRects);
+        hr = Data->Device->CreateVertexShader(g_VS_DirtyRects, Size, nullptr, &Data->RectVertexShader);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(Data->Device, L"Failed to create dirty rect vertex shader in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+
+        D3D11_INPUT_ELEMENT_DESC RectLayout[] =
+        {
+            {"RECT", 0, DXGI_FORMAT_R32G32B32A32_SINT, 0, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+        };
+        hr = Data->Device->CreateInputLayout(RectLayout, ARRAYSIZE(RectLayout), g_VS_DirtyRects, Size, &Data->RectInputLayout);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(Data->Device, L"Failed to create dirty rect input layout in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    // Tile hashing for change detection needs compute shaders with typed loads and structured buffers
+    if (Data->FeatureLevel >= D3D_FEATURE_LEVEL_11_0)
+    {
+        Size = ARRAYSIZE(g_CS);
+        hr = Data->Device->CreateComputeShader(g_CS, Size, nullptr, &Data->TileHashShader);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(Data->Device, L"Failed to create tile hash shader in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    // Applying rects from a compute shader also needs typed stores to the 8 bit desktop format, FP16 always has them
+    if (SupportsComputeApply(Data->Device, DXGI_FORMAT_B8G8R8A8_UNORM))
+    {
+        Size = ARRAYSIZE(g_CS_ApplyRects);
+        hr = Data->Device->CreateComputeShader(g_CS_ApplyRects, Size, nullptr, &Data->ApplyShader);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(Data->Device, L"Failed to create rect apply shader in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    // Set up sampler
+    D3D11_SAMPLER_DESC SampDesc;
+    RtlZeroMemory(&SampDesc, sizeof(SampDesc));
+    SampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    SampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+    SampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+    SampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    SampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+    SampDesc.MinLOD = 0;
+    SampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+    hr = Data->Device->CreateSamplerState(&SampDesc, &Data->SamplerLinear);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(Data->Device, L"Failed to create sampler state in DEVICEPOOL", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Take a reference on every object in DX_RESOURCES
+//
+void AddRefDx(_Inout_ DX_RESOURCES* Data)
+{
+    Data->Device->AddRef();
+    Data->Context->AddRef();
+    Data->VertexShader->AddRef();
+    Data->PixelShader->AddRef();
+    Data->InputLayout->AddRef();
+    Data->SamplerLinear->AddRef();
+    if (Data->RectVertexShader)
+    {
+        Data->RectVertexShader->AddRef();
+        Data->RectInputLayout->AddRef();
+    }
+    if (Data->TileHashShader)
+    {
+        Data->TileHashShader->AddRef();
+    }
+    if (Data->ApplyShader)
+    {
+        Data->ApplyShader->AddRef();
+    }
+}
+
+//
+// Clean up DX_RESOURCES
+//
+void CleanDx(_Inout_ DX_RESOURCES* Data)
+{
+    if (Data->Device)
+    {
+        Data->Device->Release();
+        Data->Device = nullptr;
+    }
+
+    if (Data->Context)
+    {
+        Data->Context->Release();
+        Data->Context = nullptr;
+    }
+
+    if (Data->VertexShader)
+    {
+        Data->VertexShader->Release();
+        Data->VertexShader = nullptr;
+    }
+
+    if (Data->PixelShader)
+    {
+        Data->PixelShader->Release();
+        Data->PixelShader = nullptr;
+    }
+
+    if (Data->InputLayout)
+    {
+        Data->InputLayout->Release();
+        Data->InputLayout = nullptr;
+    }
+
+    if (Data->RectVertexShader)
+    {
+        Data->RectVertexShader->Release();
+        Data->RectVertexShader = nullptr;
+    }
+
+    if (Data->RectInputLayout)
+    {
+        Data->RectInputLayout->Release();
+        Data->RectInputLayout = nullptr;
+    }
+
+    if (Data->SamplerLinear)
+    {
+        Data->SamplerLinear->Release();
+        Data->SamplerLinear = nullptr;
+    }
+
+    if (Data->TileHashShader)
+    {
+        Data->TileHashShader->Release();
+        Data->TileHashShader = nullptr;
+    }
+
+    if (Data->ApplyShader)
+    {
+        Data->ApplyShader->Release();
+        Data->ApplyShader = nullptr;
+    }
+}
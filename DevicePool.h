@@ -0,0 +1,47 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _DEVICEPOOL_H_
+#define _DEVICEPOOL_H_
+
+#include <vector>
+
+#include "CommonTypes.h"
+
+//
+// Hands out D3D resources shared by all duplication threads running on the same adapter.
+// The device, shaders, input layout and sampler are created once per adapter LUID and every
+// caller gets its own references to them.
+//
+class DEVICEPOOL
+{
+    public:
+        DEVICEPOOL();
+        ~DEVICEPOOL();
+        DUPL_RETURN GetResources(LUID AdapterLuid, _Out_ DX_RESOURCES* Data);
+        void Clean();
+
+    private:
+        typedef struct _POOL_ENTRY
+        {
+            LUID AdapterLuid;
+            DX_RESOURCES DxRes;
+        } POOL_ENTRY;
+
+    // methods
+        DUPL_RETURN CreateDevice(LUID AdapterLuid, _Inout_ DX_RESOURCES* Data);
+        DUPL_RETURN CreateSharedState(_Inout_ DX_RESOURCES* Data);
+        void CleanEntry(_Inout_ POOL_ENTRY* Entry);
+
+    // variables
+        std::vector<POOL_ENTRY> m_Entries;
+};
+
+void AddRefDx(_Inout_ DX_RESOURCES* Data);
+void CleanDx(_Inout_ DX_RESOURCES* Data);
+
+#endif
@@ -0,0 +1,71 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+//----------------------------------------------------------------------
+
+// Must match RECT_CONSTANTS in RectTransform.h
+cbuffer RectConstants : register( b0 )
+{
+    int4 Output;        // Width, Height, OriginX, OriginY
+    float4 PosMap;      // PosScaleX, PosOffsetX, PosScaleY, PosOffsetY
+    float2 TexScale;
+    uint Rotation;      // DXGI_MODE_ROTATION
+    uint Corners;       // Frame rect corner sampled by each strip vertex, two bits each
+};
+
+struct VS_INPUT
+{
+    int4 Rect : RECT;
+    uint Vertex : SV_VertexID;
+};
+
+struct VS_OUTPUT
+{
+    float4 Pos : SV_POSITION;
+    float2 Tex : TEXCOORD;
+};
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader: one instance per dirty rect of the frame, drawn as a four vertex strip. Places the rect on
+// the shared surface the way TransformDirtyRects in RectTransform.cpp does on the CPU.
+//--------------------------------------------------------------------------------------
+VS_OUTPUT VS_DirtyRects(VS_INPUT input)
+{
+    int4 r = input.Rect;
+    int W = Output.x;
+    int H = Output.y;
+
+    int4 Dest;
+    switch (Rotation)
+    {
+        case 2:
+            Dest = int4(W - r.w, r.x, W - r.y, r.z);
+            break;
+        case 3:
+            Dest = int4(W - r.z, H - r.w, W - r.x, H - r.y);
+            break;
+        case 4:
+            Dest = int4(r.y, H - r.z, r.w, H - r.x);
+            break;
+        default:
+            Dest = r;
+            break;
+    }
+    Dest += Output.zwzw;
+
+    uint v = input.Vertex;
+    float X = (v & 2) ? Dest.z : Dest.x;
+    float Y = (v & 1) ? Dest.y : Dest.w;
+
+    uint Corner = (Corners >> (2 * v)) & 3;
+    float TexX = (Corner & 1) ? r.z : r.x;
+    float TexY = (Corner & 2) ? r.w : r.y;
+
+    VS_OUTPUT output;
+    output.Pos = float4(X * PosMap.x + PosMap.y, Y * PosMap.z + PosMap.w, 0.0f, 1.0f);
+    output.Tex = float2(TexX, TexY) * TexScale;
+    return output;
+}
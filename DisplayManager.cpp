@@ -8,6 +8,10 @@
 #include "DisplayManager.h"
 using namespace DirectX;
 
+static_assert(sizeof(RECT_VERTEX) == sizeof(VERTEX), "RECT_VERTEX must match the layout of VERTEX");
+static_assert(sizeof(RECT_CONSTANTS) == 48, "RECT_CONSTANTS must match DirtyRects.hlsl");
+static_assert(sizeof(APPLY_RECT) == 48 && sizeof(APPLY_TILE) == 16, "APPLY_RECT and APPLY_TILE must match ApplyRects.hlsl");
+
 //
 // Constructor NULLs out vars
 //
@@ -19,9 +23,26 @@ DISPLAYMANAGER::DISPLAYMANAGER() : m_Device(nullptr),
                                    m_InputLayout(nullptr),
                                    m_RTV(nullptr),
                                    m_SamplerLinear(nullptr),
-                                   m_DirtyVertexBufferAlloc(nullptr),
-                                   m_DirtyVertexBufferAllocSize(0)
+                                   m_RectVertexShader(nullptr),
+                                   m_RectInputLayout(nullptr),
+                                   m_RectBuffer(nullptr),
+                                   m_RectCapacity(0),
+                                   m_RectConstants(nullptr),
+                                   m_TileDetection(false),
+                                   m_TileHashShader(nullptr),
+                                   m_TileHashBuffer(nullptr),
+                                   m_TileHashUAV(nullptr),
+                                   m_TileHashStaging(nullptr),
+                                   m_ComputeApply(false),
+                                   m_ApplyShader(nullptr),
+                                   m_ApplyUAV(nullptr),
+                                   m_MoveSRV(nullptr),
+                                   m_Profiler(nullptr),
+                                   m_Governor(nullptr)
 {
+    RtlZeroMemory(&m_ApplyRects, sizeof(m_ApplyRects));
+    RtlZeroMemory(&m_ApplyTiles, sizeof(m_ApplyTiles));
+    RtlZeroMemory(&m_ApplyTileRects, sizeof(m_ApplyTileRects));
 }
 
 //
@@ -30,18 +51,12 @@ DISPLAYMANAGER::DISPLAYMANAGER() : m_Device(nullptr),
 DISPLAYMANAGER::~DISPLAYMANAGER()
 {
     CleanRefs();
-
-    if (m_DirtyVertexBufferAlloc)
-    {
-        delete [] m_DirtyVertexBufferAlloc;
-        m_DirtyVertexBufferAlloc = nullptr;
-    }
 }
 
 //
 // Initialize D3D variables
 //
-void DISPLAYMANAGER::InitD3D(DX_RESOURCES* Data)
+void DISPLAYMANAGER::InitD3D(DX_RESOURCES* Data, _In_ const DUPLICATION_OPTIONS* Options)
 {
     m_Device = Data->Device;
     m_DeviceContext = Data->Context;
@@ -56,33 +71,137 @@ void DISPLAYMANAGER::InitD3D(DX_RESOURCES* Data)
     m_PixelShader->AddRef();
     m_InputLayout->AddRef();
     m_SamplerLinear->AddRef();
+
+    // Dirty rects go up as one instance each where the device can expand them, as six vertices otherwise
+    m_RectVertexShader = Data->RectVertexShader;
+    m_RectInputLayout = Data->RectInputLayout;
+    if (m_RectVertexShader)
+    {
+        m_RectVertexShader->AddRef();
+        m_RectInputLayout->AddRef();
+    }
+
+    // Change detection needs the compute shader, which the device may not support
+    m_TileHashShader = Data->TileHashShader;
+    if (m_TileHashShader)
+    {
+        m_TileHashShader->AddRef();
+    }
+    m_TileDetection = Options->TileDetection && m_TileHashShader;
+
+    // So does the apply engine, the device pool only makes its shader for adapters that can run it
+    m_ApplyShader = Data->ApplyShader;
+    if (m_ApplyShader)
+    {
+        m_ApplyShader->AddRef();
+    }
+    m_ComputeApply = Options->ComputeApply && m_ApplyShader;
+
+    m_Governor = Options->Governor;
 }
 
 //
-// Process a given frame and its metadata
+// Process a given frame and its metadata, per-frame CPU data comes from Arena
 //
-DUPL_RETURN DISPLAYMANAGER::ProcessFrame(_In_ FRAME_DATA* Data, _Inout_ ID3D11Texture2D* SharedSurf, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc)
+DUPL_RETURN DISPLAYMANAGER::ProcessFrame(_In_ FRAME_DATA* Data, _Inout_ ID3D11Texture2D* SharedSurf, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage)
 {
     DUPL_RETURN Ret = DUPL_RETURN_SUCCESS;
 
+    // When the desktop image was last updated, zero for pointer only updates
+    if (Data->FrameInfo.LastPresentTime.QuadPart)
+    {
+        AddDamageUpdate(Damage, QpcToNs(Data->FrameInfo.LastPresentTime.QuadPart));
+    }
+
     // Process dirties and moves
     if (Data->FrameInfo.TotalMetadataBufferSize)
     {
         D3D11_TEXTURE2D_DESC Desc;
         Data->Frame->GetDesc(&Desc);
 
-        if (Data->MoveCount)
+        D3D11_TEXTURE2D_DESC FullDesc;
+        SharedSurf->GetDesc(&FullDesc);
+
+        // Rotation, placement and scale of this output's rects, for all of them at once
+        RECT_TRANSFORM Transform;
+        InitRectTransform(&Transform, DeskDesc->Rotation,
+                          DeskDesc->DesktopCoordinates.right - DeskDesc->DesktopCoordinates.left, DeskDesc->DesktopCoordinates.bottom - DeskDesc->DesktopCoordinates.top,
+                          DeskDesc->DesktopCoordinates.left - OffsetX, DeskDesc->DesktopCoordinates.top - OffsetY,
+                          Desc.Width, Desc.Height, FullDesc.Width, FullDesc.Height);
+
+        DXGI_OUTDUPL_MOVE_RECT* MoveBuffer = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(Data->MetaData);
+        RECT* DirtyBuffer = reinterpret_cast<RECT*>(Data->MetaData + (Data->MoveCount * sizeof(DXGI_OUTDUPL_MOVE_RECT)));
+        UINT MoveCount = Data->MoveCount;
+        UINT DirtyCount = Data->DirtyCount;
+
+        if (m_Governor && m_Governor->CopiesFullFrames())
         {
-            Ret = CopyMove(SharedSurf, reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(Data->MetaData), Data->MoveCount, OffsetX, OffsetY, DeskDesc, Desc.Width, Desc.Height);
+            // Shedding work: the frame goes over whole in one rect, whatever moved is already in it
+            DirtyBuffer = Arena->AllocArray<RECT>(1);
+            if (!DirtyBuffer)
+            {
+                return ProcessFailure(nullptr, L"Failed to allocate memory for the full frame rect.", L"Error", E_OUTOFMEMORY);
+            }
+            DirtyBuffer[0] = {0, 0, static_cast<LONG>(Desc.Width), static_cast<LONG>(Desc.Height)};
+            DirtyCount = 1;
+            MoveCount = 0;
+
+            // Frames change behind the detector's back while it is not asked
+            if (m_TileDetection)
+            {
+                m_TileDetector.Invalidate();
+            }
+        }
+        else if (m_TileDetection)
+        {
+            // Only a lone dirty rect covering the whole frame is worth looking into, anything else
+            // changes the frame behind the detector's back
+            bool FullFrame = !MoveCount && DirtyCount == 1 &&
+                             DirtyBuffer[0].left <= 0 && DirtyBuffer[0].top <= 0 &&
+                             DirtyBuffer[0].right >= static_cast<LONG>(Desc.Width) && DirtyBuffer[0].bottom >= static_cast<LONG>(Desc.Height);
+            if (!FullFrame)
+            {
+                m_TileDetector.Invalidate();
+            }
+            else if (m_TileDetector.ShouldDetect() || m_TileDetector.GetWidth() != Desc.Width || m_TileDetector.GetHeight() != Desc.Height)
+            {
+                Ret = DetectChangedTiles(Data->Frame, &Desc, Arena, &DirtyBuffer, &DirtyCount);
+                if (Ret != DUPL_RETURN_SUCCESS)
+                {
+                    return Ret;
+                }
+            }
+        }
+
+        if (m_ComputeApply)
+        {
+            bool Applied;
+            BeginPass(PROFILE_PASS_APPLY_RECTS);
+            Ret = ApplyRects(Data->Frame, SharedSurf, &Desc, &FullDesc, MoveBuffer, MoveCount, DirtyBuffer, DirtyCount, &Transform, Arena, Damage, &Applied);
+            EndPass();
+            if (Ret != DUPL_RETURN_SUCCESS || Applied)
+            {
+                return Ret;
+            }
+        }
+
+        // Moves go first, dirty rects may be drawn over what they moved
+        if (MoveCount)
+        {
+            BeginPass(PROFILE_PASS_COPY_MOVE);
+            Ret = CopyMove(SharedSurf, &FullDesc, MoveBuffer, MoveCount, &Transform, Arena, Damage);
+            EndPass();
             if (Ret != DUPL_RETURN_SUCCESS)
             {
                 return Ret;
             }
         }
 
-        if (Data->DirtyCount)
+        if (DirtyCount)
         {
-            Ret = CopyDirty(Data->Frame, SharedSurf, reinterpret_cast<RECT*>(Data->MetaData + (Data->MoveCount * sizeof(DXGI_OUTDUPL_MOVE_RECT))), Data->DirtyCount, OffsetX, OffsetY, DeskDesc);
+            BeginPass(PROFILE_PASS_COPY_DIRTY);
+            Ret = CopyDirty(Data->Frame, SharedSurf, &FullDesc, DirtyBuffer, DirtyCount, &Transform, Arena, Damage);
+            EndPass();
         }
     }
 
@@ -98,109 +217,64 @@ ID3D11Device* DISPLAYMANAGER::GetDevice()
 }
 
 //
-// Set appropriate source and destination rects for move rects
+// Time the copies of each frame with this profiler, nullptr for none
+//
+void DISPLAYMANAGER::SetProfiler(_In_opt_ GPUPROFILER* Profiler)
+{
+    m_Profiler = Profiler;
+}
+
+//
+// Mark the start and end of a pass for the profiler, if there is one
 //
-void DISPLAYMANAGER::SetMoveRect(_Out_ RECT* SrcRect, _Out_ RECT* DestRect, _In_ DXGI_OUTPUT_DESC* DeskDesc, _In_ DXGI_OUTDUPL_MOVE_RECT* MoveRect, INT TexWidth, INT TexHeight)
+void DISPLAYMANAGER::BeginPass(PROFILE_PASS Pass)
 {
-    switch (DeskDesc->Rotation)
+    if (m_Profiler)
     {
-        case DXGI_MODE_ROTATION_UNSPECIFIED:
-        case DXGI_MODE_ROTATION_IDENTITY:
-        {
-            SrcRect->left = MoveRect->SourcePoint.x;
-            SrcRect->top = MoveRect->SourcePoint.y;
-            SrcRect->right = MoveRect->SourcePoint.x + MoveRect->DestinationRect.right - MoveRect->DestinationRect.left;
-            SrcRect->bottom = MoveRect->SourcePoint.y + MoveRect->DestinationRect.bottom - MoveRect->DestinationRect.top;
+        m_Profiler->BeginPass(Pass);
+    }
+}
 
-            *DestRect = MoveRect->DestinationRect;
-            break;
-        }
-        case DXGI_MODE_ROTATION_ROTATE90:
-        {
-            SrcRect->left = TexHeight - (MoveRect->SourcePoint.y + MoveRect->DestinationRect.bottom - MoveRect->DestinationRect.top);
-            SrcRect->top = MoveRect->SourcePoint.x;
-            SrcRect->right = TexHeight - MoveRect->SourcePoint.y;
-            SrcRect->bottom = MoveRect->SourcePoint.x + MoveRect->DestinationRect.right - MoveRect->DestinationRect.left;
-
-            DestRect->left = TexHeight - MoveRect->DestinationRect.bottom;
-            DestRect->top = MoveRect->DestinationRect.left;
-            DestRect->right = TexHeight - MoveRect->DestinationRect.top;
-            DestRect->bottom = MoveRect->DestinationRect.right;
-            break;
-        }
-        case DXGI_MODE_ROTATION_ROTATE180:
-        {
-            SrcRect->left = TexWidth - (MoveRect->SourcePoint.x + MoveRect->DestinationRect.right - MoveRect->DestinationRect.left);
-            SrcRect->top = TexHeight - (MoveRect->SourcePoint.y + MoveRect->DestinationRect.bottom - MoveRect->DestinationRect.top);
-            SrcRect->right = TexWidth - MoveRect->SourcePoint.x;
-            SrcRect->bottom = TexHeight - MoveRect->SourcePoint.y;
-
-            DestRect->left = TexWidth - MoveRect->DestinationRect.right;
-            DestRect->top = TexHeight - MoveRect->DestinationRect.bottom;
-            DestRect->right = TexWidth - MoveRect->DestinationRect.left;
-            DestRect->bottom =  TexHeight - MoveRect->DestinationRect.top;
-            break;
-        }
-        case DXGI_MODE_ROTATION_ROTATE270:
-        {
-            SrcRect->left = MoveRect->SourcePoint.x;
-            SrcRect->top = TexWidth - (MoveRect->SourcePoint.x + MoveRect->DestinationRect.right - MoveRect->DestinationRect.left);
-            SrcRect->right = MoveRect->SourcePoint.y + MoveRect->DestinationRect.bottom - MoveRect->DestinationRect.top;
-            SrcRect->bottom = TexWidth - MoveRect->SourcePoint.x;
-
-            DestRect->left = MoveRect->DestinationRect.top;
-            DestRect->top = TexWidth - MoveRect->DestinationRect.right;
-            DestRect->right = MoveRect->DestinationRect.bottom;
-            DestRect->bottom =  TexWidth - MoveRect->DestinationRect.left;
-            break;
-        }
-        default:
-        {
-            RtlZeroMemory(DestRect, sizeof(RECT));
-            RtlZeroMemory(SrcRect, sizeof(RECT));
-            break;
-        }
+void DISPLAYMANAGER::EndPass()
+{
+    if (m_Profiler)
+    {
+        m_Profiler->EndPass();
     }
 }
 
 //
 // Copy move rectangles
 //
-DUPL_RETURN DISPLAYMANAGER::CopyMove(_Inout_ ID3D11Texture2D* SharedSurf, _In_reads_(MoveCount) DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc, INT TexWidth, INT TexHeight)
+DUPL_RETURN DISPLAYMANAGER::CopyMove(_Inout_ ID3D11Texture2D* SharedSurf, _In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_reads_(MoveCount) DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage)
 {
-    D3D11_TEXTURE2D_DESC FullDesc;
-    SharedSurf->GetDesc(&FullDesc);
-
-    // Make new intermediate surface to copy into for moving
-    if (!m_MoveSurf)
-    {
-        D3D11_TEXTURE2D_DESC MoveDesc;
-        MoveDesc = FullDesc;
-        MoveDesc.Width = DeskDesc->DesktopCoordinates.right - DeskDesc->DesktopCoordinates.left;
-        MoveDesc.Height = DeskDesc->DesktopCoordinates.bottom - DeskDesc->DesktopCoordinates.top;
-        MoveDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
-        MoveDesc.MiscFlags = 0;
-        HRESULT hr = m_Device->CreateTexture2D(&MoveDesc, nullptr, &m_MoveSurf);
-        if (FAILED(hr))
-        {
-            return ProcessFailure(m_Device, L"Failed to create staging texture for move rects", L"Error", hr, SystemTransitionsExpectedErrors);
-        }
+    DUPL_RETURN Ret = CreateMoveSurf(FullDesc, Transform);
+    if (Ret != DUPL_RETURN_SUCCESS)
+    {
+        return Ret;
     }
 
-    for (UINT i = 0; i < MoveCount; ++i)
+    // Source and destination of every move in one go
+    RECT* SrcRects = Arena->AllocArray<RECT>(MoveCount * 2);
+    if (!SrcRects)
     {
-        RECT SrcRect;
-        RECT DestRect;
+        return ProcessFailure(nullptr, L"Failed to allocate memory for move rects.", L"Error", E_OUTOFMEMORY);
+    }
+    RECT* DestRects = SrcRects + MoveCount;
+    TransformMoveRects(Transform, MoveBuffer, MoveCount, SrcRects, DestRects);
 
-        SetMoveRect(&SrcRect, &DestRect, DeskDesc, &(MoveBuffer[i]), TexWidth, TexHeight);
+    for (UINT i = 0; i < MoveCount; ++i)
+    {
+        RECT SrcRect = SrcRects[i];
+        RECT DestRect = DestRects[i];
 
         // Copy rect out of shared surface
         D3D11_BOX Box;
-        Box.left = SrcRect.left + DeskDesc->DesktopCoordinates.left - OffsetX;
-        Box.top = SrcRect.top + DeskDesc->DesktopCoordinates.top - OffsetY;
+        Box.left = SrcRect.left + Transform->OriginX;
+        Box.top = SrcRect.top + Transform->OriginY;
         Box.front = 0;
-        Box.right = SrcRect.right + DeskDesc->DesktopCoordinates.left - OffsetX;
-        Box.bottom = SrcRect.bottom + DeskDesc->DesktopCoordinates.top - OffsetY;
+        Box.right = SrcRect.right + Transform->OriginX;
+        Box.bottom = SrcRect.bottom + Transform->OriginY;
         Box.back = 1;
         m_DeviceContext->CopySubresourceRegion(m_MoveSurf, 0, SrcRect.left, SrcRect.top, 0, SharedSurf, 0, &Box);
 
@@ -211,116 +285,224 @@ DUPL_RETURN DISPLAYMANAGER::CopyMove(_Inout_ ID3D11Texture2D* SharedSurf, _In_re
         Box.right = SrcRect.right;
         Box.bottom = SrcRect.bottom;
         Box.back = 1;
-        m_DeviceContext->CopySubresourceRegion(SharedSurf, 0, DestRect.left + DeskDesc->DesktopCoordinates.left - OffsetX, DestRect.top + DeskDesc->DesktopCoordinates.top - OffsetY, 0, m_MoveSurf, 0, &Box);
+        m_DeviceContext->CopySubresourceRegion(SharedSurf, 0, DestRect.left + Transform->OriginX, DestRect.top + Transform->OriginY, 0, m_MoveSurf, 0, &Box);
+
+        // Let the presenter know this part of the shared surface changed
+        OffsetRect(&DestRect, Transform->OriginX, Transform->OriginY);
+        AddDamage(Damage, &DestRect);
     }
 
     return DUPL_RETURN_SUCCESS;
 }
 
 //
-// Sets up vertices for dirty rects for rotated desktops
+// Make the intermediate surface moves are copied through, the size of the output
 //
-#pragma warning(push)
-#pragma warning(disable:__WARNING_USING_UNINIT_VAR) // false positives in SetDirtyVert due to tool bug
-
-void DISPLAYMANAGER::SetDirtyVert(_Out_writes_(NUMVERTICES) VERTEX* Vertices, _In_ RECT* Dirty, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc, _In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_ D3D11_TEXTURE2D_DESC* ThisDesc)
+DUPL_RETURN DISPLAYMANAGER::CreateMoveSurf(_In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_ const RECT_TRANSFORM* Transform)
 {
-    INT CenterX = FullDesc->Width / 2;
-    INT CenterY = FullDesc->Height / 2;
+    if (m_MoveSurf)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
 
-    INT Width = DeskDesc->DesktopCoordinates.right - DeskDesc->DesktopCoordinates.left;
-    INT Height = DeskDesc->DesktopCoordinates.bottom - DeskDesc->DesktopCoordinates.top;
+    // The apply engine reads it from its compute shader
+    D3D11_TEXTURE2D_DESC MoveDesc;
+    MoveDesc = *FullDesc;
+    MoveDesc.Width = Transform->Width;
+    MoveDesc.Height = Transform->Height;
+    MoveDesc.BindFlags = D3D11_BIND_RENDER_TARGET | (m_ComputeApply ? D3D11_BIND_SHADER_RESOURCE : 0);
+    MoveDesc.MiscFlags = 0;
+    HRESULT hr = m_Device->CreateTexture2D(&MoveDesc, nullptr, &m_MoveSurf);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create staging texture for move rects", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
 
-    // Rotation compensated destination rect
-    RECT DestDirty = *Dirty;
+//
+// Apply all moves and dirty rects of a frame with one compute dispatch over the tiles they touch. Applied is
+// false when the frame has to take the draw and copy path instead: the rect list cannot express it, or the
+// shared surface turns out not to be writable from a compute shader on this adapter.
+//
+DUPL_RETURN DISPLAYMANAGER::ApplyRects(_In_ ID3D11Texture2D* SrcSurface, _Inout_ ID3D11Texture2D* SharedSurf, _In_ D3D11_TEXTURE2D_DESC* FrameDesc, _In_ D3D11_TEXTURE2D_DESC* FullDesc,
+                                       _In_reads_(MoveCount) DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, _In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount,
+                                       _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage, _Out_ bool* Applied)
+{
+    *Applied = false;
 
-    // Set appropriate coordinates compensated for rotation
-    switch (DeskDesc->Rotation)
+    // The output manager only allows unordered access to the shared surface where its own device can store the format
+    if (!m_ApplyUAV)
     {
-        case DXGI_MODE_ROTATION_ROTATE90:
+        if (!(FullDesc->BindFlags & D3D11_BIND_UNORDERED_ACCESS) || !SupportsComputeApply(m_Device, FullDesc->Format))
         {
-            DestDirty.left = Width - Dirty->bottom;
-            DestDirty.top = Dirty->left;
-            DestDirty.right = Width - Dirty->top;
-            DestDirty.bottom = Dirty->right;
-
-            Vertices[0].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[1].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[2].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[5].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            break;
+            OutputDebugStringW(L"DISPLAYMANAGER: shared surface cannot be written from a compute shader, applying rects with draws and copies\n");
+            m_ComputeApply = false;
+            return DUPL_RETURN_SUCCESS;
         }
-        case DXGI_MODE_ROTATION_ROTATE180:
+
+        HRESULT hr = m_Device->CreateUnorderedAccessView(SharedSurf, nullptr, &m_ApplyUAV);
+        if (FAILED(hr))
         {
-            DestDirty.left = Width - Dirty->right;
-            DestDirty.top = Height - Dirty->bottom;
-            DestDirty.right = Width - Dirty->left;
-            DestDirty.bottom = Height - Dirty->top;
-
-            Vertices[0].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[1].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[2].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[5].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            break;
+            return ProcessFailure(m_Device, L"Failed to create unordered access view for applying rects", L"Error", hr, SystemTransitionsExpectedErrors);
         }
-        case DXGI_MODE_ROTATION_ROTATE270:
+    }
+
+    APPLY_LIST List;
+    if (!BuildApplyList(Transform, FrameDesc->Width, FrameDesc->Height, MoveBuffer, MoveCount, DirtyBuffer, DirtyCount, Arena, &List) ||
+        List.TileCount > D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+    *Applied = true;
+
+    if (!List.TileCount)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    // Moves read one copy of everything they cover, taken before the dispatch writes anything
+    if (List.MoveCount)
+    {
+        DUPL_RETURN Ret = CreateMoveSurf(FullDesc, Transform);
+        if (Ret != DUPL_RETURN_SUCCESS)
         {
-            DestDirty.left = Dirty->top;
-            DestDirty.top = Height - Dirty->right;
-            DestDirty.right = Dirty->bottom;
-            DestDirty.bottom = Height - Dirty->left;
-
-            Vertices[0].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[1].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[2].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[5].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            break;
+            return Ret;
         }
-        default:
-            assert(false); // drop through
-        case DXGI_MODE_ROTATION_UNSPECIFIED:
-        case DXGI_MODE_ROTATION_IDENTITY:
+
+        if (!m_MoveSRV)
         {
-            Vertices[0].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[1].TexCoord = XMFLOAT2(Dirty->left / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[2].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->bottom / static_cast<FLOAT>(ThisDesc->Height));
-            Vertices[5].TexCoord = XMFLOAT2(Dirty->right / static_cast<FLOAT>(ThisDesc->Width), Dirty->top / static_cast<FLOAT>(ThisDesc->Height));
-            break;
+            HRESULT hr = m_Device->CreateShaderResourceView(m_MoveSurf, nullptr, &m_MoveSRV);
+            if (FAILED(hr))
+            {
+                return ProcessFailure(m_Device, L"Failed to create shader resource view for move rects", L"Error", hr, SystemTransitionsExpectedErrors);
+            }
         }
+
+        D3D11_BOX Box;
+        Box.left = List.MoveSource.left + Transform->OriginX;
+        Box.top = List.MoveSource.top + Transform->OriginY;
+        Box.front = 0;
+        Box.right = List.MoveSource.right + Transform->OriginX;
+        Box.bottom = List.MoveSource.bottom + Transform->OriginY;
+        Box.back = 1;
+        m_DeviceContext->CopySubresourceRegion(m_MoveSurf, 0, List.MoveSource.left, List.MoveSource.top, 0, SharedSurf, 0, &Box);
+    }
+
+    DUPL_RETURN Ret = UploadApplyBuffer(&m_ApplyRects, List.Rects, List.RectCount, sizeof(APPLY_RECT));
+    if (Ret == DUPL_RETURN_SUCCESS)
+    {
+        Ret = UploadApplyBuffer(&m_ApplyTiles, List.Tiles, List.TileCount, sizeof(APPLY_TILE));
+    }
+    if (Ret == DUPL_RETURN_SUCCESS)
+    {
+        Ret = UploadApplyBuffer(&m_ApplyTileRects, List.TileRects, List.TileRectCount, sizeof(UINT));
+    }
+    if (Ret != DUPL_RETURN_SUCCESS)
+    {
+        return Ret;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC ShaderDesc;
+    ShaderDesc.Format = FrameDesc->Format;
+    ShaderDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    ShaderDesc.Texture2D.MostDetailedMip = FrameDesc->MipLevels - 1;
+    ShaderDesc.Texture2D.MipLevels = FrameDesc->MipLevels;
+
+    ID3D11ShaderResourceView* ShaderResource = nullptr;
+    HRESULT hr = m_Device->CreateShaderResourceView(SrcSurface, &ShaderDesc, &ShaderResource);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create shader resource view for applying rects", L"Error", hr, SystemTransitionsExpectedErrors);
     }
 
-    // Set positions
-    Vertices[0].Pos = XMFLOAT3((DestDirty.left + DeskDesc->DesktopCoordinates.left - OffsetX - CenterX) / static_cast<FLOAT>(CenterX),
-                             -1 * (DestDirty.bottom + DeskDesc->DesktopCoordinates.top - OffsetY - CenterY) / static_cast<FLOAT>(CenterY),
-                             0.0f);
-    Vertices[1].Pos = XMFLOAT3((DestDirty.left + DeskDesc->DesktopCoordinates.left - OffsetX - CenterX) / static_cast<FLOAT>(CenterX),
-                             -1 * (DestDirty.top + DeskDesc->DesktopCoordinates.top - OffsetY - CenterY) / static_cast<FLOAT>(CenterY),
-                             0.0f);
-    Vertices[2].Pos = XMFLOAT3((DestDirty.right + DeskDesc->DesktopCoordinates.left - OffsetX - CenterX) / static_cast<FLOAT>(CenterX),
-                             -1 * (DestDirty.bottom + DeskDesc->DesktopCoordinates.top - OffsetY - CenterY) / static_cast<FLOAT>(CenterY),
-                             0.0f);
-    Vertices[3].Pos = Vertices[2].Pos;
-    Vertices[4].Pos = Vertices[1].Pos;
-    Vertices[5].Pos = XMFLOAT3((DestDirty.right + DeskDesc->DesktopCoordinates.left - OffsetX - CenterX) / static_cast<FLOAT>(CenterX),
-                             -1 * (DestDirty.top + DeskDesc->DesktopCoordinates.top - OffsetY - CenterY) / static_cast<FLOAT>(CenterY),
-                             0.0f);
-
-    Vertices[3].TexCoord = Vertices[2].TexCoord;
-    Vertices[4].TexCoord = Vertices[1].TexCoord;
+    // The shared surface may still be bound as the target of earlier draws
+    ID3D11ShaderResourceView* Views[5] = {ShaderResource, m_MoveSRV, m_ApplyRects.View, m_ApplyTiles.View, m_ApplyTileRects.View};
+    ID3D11ShaderResourceView* NullViews[5] = {};
+    ID3D11UnorderedAccessView* NullUAV = nullptr;
+    m_DeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+    m_DeviceContext->CSSetShader(m_ApplyShader, nullptr, 0);
+    m_DeviceContext->CSSetShaderResources(0, ARRAYSIZE(Views), Views);
+    m_DeviceContext->CSSetUnorderedAccessViews(0, 1, &m_ApplyUAV, nullptr);
+    m_DeviceContext->Dispatch(List.TileCount, 1, 1);
+    m_DeviceContext->CSSetUnorderedAccessViews(0, 1, &NullUAV, nullptr);
+    m_DeviceContext->CSSetShaderResources(0, ARRAYSIZE(NullViews), NullViews);
+    m_DeviceContext->CSSetShader(nullptr, nullptr, 0);
+
+    ShaderResource->Release();
+    ShaderResource = nullptr;
+
+    for (UINT i = 0; i < List.RectCount; ++i)
+    {
+        AddDamage(Damage, &List.Rects[i].Dest);
+    }
+
+    return DUPL_RETURN_SUCCESS;
 }
 
-#pragma warning(pop) // re-enable __WARNING_USING_UNINIT_VAR
+//
+// Copy Count elements into a structured buffer, growing it first if they do not fit
+//
+DUPL_RETURN DISPLAYMANAGER::UploadApplyBuffer(_Inout_ APPLY_BUFFER* Buffer, _In_reads_bytes_(Count * Stride) const void* Data, UINT Count, UINT Stride)
+{
+    if (Count > Buffer->Capacity)
+    {
+        if (Buffer->View)
+        {
+            Buffer->View->Release();
+            Buffer->View = nullptr;
+        }
+        if (Buffer->Buffer)
+        {
+            Buffer->Buffer->Release();
+            Buffer->Buffer = nullptr;
+        }
+        Buffer->Capacity = 0;
+
+        // Some headroom so a slowly growing frame does not recreate it every time
+        UINT Capacity = Count + Count / 2;
+        D3D11_BUFFER_DESC BufferDesc;
+        RtlZeroMemory(&BufferDesc, sizeof(BufferDesc));
+        BufferDesc.ByteWidth = Capacity * Stride;
+        BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        BufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        BufferDesc.StructureByteStride = Stride;
+        HRESULT hr = m_Device->CreateBuffer(&BufferDesc, nullptr, &Buffer->Buffer);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create rect apply buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+
+        hr = m_Device->CreateShaderResourceView(Buffer->Buffer, nullptr, &Buffer->View);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create rect apply buffer view", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+        Buffer->Capacity = Capacity;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    HRESULT hr = m_DeviceContext->Map(Buffer->Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to map rect apply buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    memcpy(Mapped.pData, Data, static_cast<size_t>(Count) * Stride);
+    m_DeviceContext->Unmap(Buffer->Buffer, 0);
+
+    return DUPL_RETURN_SUCCESS;
+}
 
 //
 // Copies dirty rectangles
 //
-DUPL_RETURN DISPLAYMANAGER::CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_ ID3D11Texture2D* SharedSurf, _In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc)
+DUPL_RETURN DISPLAYMANAGER::CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_ ID3D11Texture2D* SharedSurf, _In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage)
 {
     HRESULT hr;
 
-    D3D11_TEXTURE2D_DESC FullDesc;
-    SharedSurf->GetDesc(&FullDesc);
-
     D3D11_TEXTURE2D_DESC ThisDesc;
     SrcSurface->GetDesc(&ThisDesc);
 
@@ -350,36 +532,51 @@ DUPL_RETURN DISPLAYMANAGER::CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_
     FLOAT BlendFactor[4] = {0.f, 0.f, 0.f, 0.f};
     m_DeviceContext->OMSetBlendState(nullptr, BlendFactor, 0xFFFFFFFF);
     m_DeviceContext->OMSetRenderTargets(1, &m_RTV, nullptr);
-    m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
     m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
     m_DeviceContext->PSSetShaderResources(0, 1, &ShaderResource);
     m_DeviceContext->PSSetSamplers(0, 1, &m_SamplerLinear);
+
+    D3D11_VIEWPORT VP;
+    VP.Width = static_cast<FLOAT>(FullDesc->Width);
+    VP.Height = static_cast<FLOAT>(FullDesc->Height);
+    VP.MinDepth = 0.0f;
+    VP.MaxDepth = 1.0f;
+    VP.TopLeftX = 0.0f;
+    VP.TopLeftY = 0.0f;
+    m_DeviceContext->RSSetViewports(1, &VP);
+
+    DUPL_RETURN Ret = m_RectVertexShader ? DrawDirtyInstances(DirtyBuffer, DirtyCount, Transform, Arena, Damage) :
+                                           DrawDirtyVertices(DirtyBuffer, DirtyCount, Transform, Arena, Damage);
+
+    ShaderResource->Release();
+    ShaderResource = nullptr;
+
+    return Ret;
+}
+
+//
+// Draw the dirty rects as six vertices each, worked out on the CPU
+//
+DUPL_RETURN DISPLAYMANAGER::DrawDirtyVertices(_In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage)
+{
+    m_DeviceContext->IASetInputLayout(m_InputLayout);
+    m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
     m_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    // Create space for vertices for the dirty rects if the current space isn't large enough
+    // Space for the vertices of the dirty rects and where they land
     UINT BytesNeeded = sizeof(VERTEX) * NUMVERTICES * DirtyCount;
-    if (BytesNeeded > m_DirtyVertexBufferAllocSize)
+    VERTEX* DirtyVertices = Arena->AllocArray<VERTEX>(NUMVERTICES * DirtyCount);
+    RECT* DestRects = Arena->AllocArray<RECT>(DirtyCount);
+    if (!DirtyVertices || !DestRects)
     {
-        if (m_DirtyVertexBufferAlloc)
-        {
-            delete [] m_DirtyVertexBufferAlloc;
-        }
-
-        m_DirtyVertexBufferAlloc = new (std::nothrow) BYTE[BytesNeeded];
-        if (!m_DirtyVertexBufferAlloc)
-        {
-            m_DirtyVertexBufferAllocSize = 0;
-            return ProcessFailure(nullptr, L"Failed to allocate memory for dirty vertex buffer.", L"Error", E_OUTOFMEMORY);
-        }
-
-        m_DirtyVertexBufferAllocSize = BytesNeeded;
+        return ProcessFailure(nullptr, L"Failed to allocate memory for dirty vertex buffer.", L"Error", E_OUTOFMEMORY);
     }
 
-    // Fill them in
-    VERTEX* DirtyVertex = reinterpret_cast<VERTEX*>(m_DirtyVertexBufferAlloc);
-    for (UINT i = 0; i < DirtyCount; ++i, DirtyVertex += NUMVERTICES)
+    // Fill them in, all rects of the frame at once
+    TransformDirtyRects(Transform, DirtyBuffer, DirtyCount, reinterpret_cast<RECT_VERTEX*>(DirtyVertices), DestRects);
+    for (UINT i = 0; i < DirtyCount; ++i)
     {
-        SetDirtyVert(DirtyVertex, &(DirtyBuffer[i]), OffsetX, OffsetY, DeskDesc, &FullDesc, &ThisDesc);
+        AddDamage(Damage, &DestRects[i]);
     }
 
     // Create vertex buffer
@@ -391,10 +588,10 @@ DUPL_RETURN DISPLAYMANAGER::CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_
     BufferDesc.CPUAccessFlags = 0;
     D3D11_SUBRESOURCE_DATA InitData;
     RtlZeroMemory(&InitData, sizeof(InitData));
-    InitData.pSysMem = m_DirtyVertexBufferAlloc;
+    InitData.pSysMem = DirtyVertices;
 
     ID3D11Buffer* VertBuf = nullptr;
-    hr = m_Device->CreateBuffer(&BufferDesc, &InitData, &VertBuf);
+    HRESULT hr = m_Device->CreateBuffer(&BufferDesc, &InitData, &VertBuf);
     if (FAILED(hr))
     {
         return ProcessFailure(m_Device, L"Failed to create vertex buffer in dirty rect processing", L"Error", hr, SystemTransitionsExpectedErrors);
@@ -403,26 +600,155 @@ DUPL_RETURN DISPLAYMANAGER::CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_
     UINT Offset = 0;
     m_DeviceContext->IASetVertexBuffers(0, 1, &VertBuf, &Stride, &Offset);
 
-    D3D11_VIEWPORT VP;
-    VP.Width = static_cast<FLOAT>(FullDesc.Width);
-    VP.Height = static_cast<FLOAT>(FullDesc.Height);
-    VP.MinDepth = 0.0f;
-    VP.MaxDepth = 1.0f;
-    VP.TopLeftX = 0.0f;
-    VP.TopLeftY = 0.0f;
-    m_DeviceContext->RSSetViewports(1, &VP);
-
     m_DeviceContext->Draw(NUMVERTICES * DirtyCount, 0);
 
     VertBuf->Release();
     VertBuf = nullptr;
 
-    ShaderResource->Release();
-    ShaderResource = nullptr;
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Draw the dirty rects as one instance each, uploading the frame's rects as they are and letting the vertex
+// shader rotate and expand them: 16 bytes a rect rather than the 120 of six vertices
+//
+DUPL_RETURN DISPLAYMANAGER::DrawDirtyInstances(_In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage)
+{
+    // The presenter still needs to know where they land
+    RECT* DestRects = Arena->AllocArray<RECT>(DirtyCount);
+    if (!DestRects)
+    {
+        return ProcessFailure(nullptr, L"Failed to allocate memory for dirty rects.", L"Error", E_OUTOFMEMORY);
+    }
+    TransformDirtyDestRects(Transform, DirtyBuffer, DirtyCount, DestRects);
+    for (UINT i = 0; i < DirtyCount; ++i)
+    {
+        AddDamage(Damage, &DestRects[i]);
+    }
+
+    HRESULT hr;
+    if (!m_RectConstants)
+    {
+        D3D11_BUFFER_DESC ConstantDesc;
+        RtlZeroMemory(&ConstantDesc, sizeof(ConstantDesc));
+        ConstantDesc.ByteWidth = sizeof(RECT_CONSTANTS);
+        ConstantDesc.Usage = D3D11_USAGE_DYNAMIC;
+        ConstantDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        ConstantDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        hr = m_Device->CreateBuffer(&ConstantDesc, nullptr, &m_RectConstants);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create dirty rect constant buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    if (DirtyCount > m_RectCapacity)
+    {
+        if (m_RectBuffer)
+        {
+            m_RectBuffer->Release();
+            m_RectBuffer = nullptr;
+        }
+        m_RectCapacity = 0;
+
+        // Some headroom so a slowly growing frame does not recreate it every time
+        UINT Capacity = DirtyCount + DirtyCount / 2;
+        D3D11_BUFFER_DESC BufferDesc;
+        RtlZeroMemory(&BufferDesc, sizeof(BufferDesc));
+        BufferDesc.ByteWidth = Capacity * sizeof(RECT);
+        BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        hr = m_Device->CreateBuffer(&BufferDesc, nullptr, &m_RectBuffer);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create dirty rect instance buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+        m_RectCapacity = Capacity;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    hr = m_DeviceContext->Map(m_RectBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to map dirty rect instance buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    memcpy(Mapped.pData, DirtyBuffer, static_cast<size_t>(DirtyCount) * sizeof(RECT));
+    m_DeviceContext->Unmap(m_RectBuffer, 0);
+
+    // Outputs sharing the device each have their own rotation and origin, so the constants go up every frame
+    hr = m_DeviceContext->Map(m_RectConstants, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to map dirty rect constant buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    InitRectConstants(Transform, reinterpret_cast<RECT_CONSTANTS*>(Mapped.pData));
+    m_DeviceContext->Unmap(m_RectConstants, 0);
+
+    UINT Stride = sizeof(RECT);
+    UINT Offset = 0;
+    m_DeviceContext->IASetVertexBuffers(0, 1, &m_RectBuffer, &Stride, &Offset);
+    m_DeviceContext->IASetInputLayout(m_RectInputLayout);
+    m_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    m_DeviceContext->VSSetShader(m_RectVertexShader, nullptr, 0);
+    m_DeviceContext->VSSetConstantBuffers(0, 1, &m_RectConstants);
+
+    m_DeviceContext->DrawInstanced(RECT_INSTANCE_VERTICES, DirtyCount, 0, 0);
 
     return DUPL_RETURN_SUCCESS;
 }
 
+//
+// Record a changed region of the shared surface, folding it into the last entry once the list is full
+//
+void AddDamage(_Inout_ DAMAGE_INFO* Damage, _In_ const RECT* Rect)
+{
+    if (Damage->FullDamage || IsRectEmpty(Rect))
+    {
+        return;
+    }
+
+    if (Damage->RectCount < DAMAGE_RECT_COUNT)
+    {
+        Damage->Rects[Damage->RectCount++] = *Rect;
+    }
+    else
+    {
+        UnionRect(&Damage->Rects[DAMAGE_RECT_COUNT - 1], &Damage->Rects[DAMAGE_RECT_COUNT - 1], Rect);
+    }
+}
+
+//
+// Record when the desktop image was updated, dropping the oldest update once the list is full
+//
+void AddDamageUpdate(_Inout_ DAMAGE_INFO* Damage, uint64_t TimeNs)
+{
+    if (Damage->UpdateCount == DAMAGE_UPDATE_COUNT)
+    {
+        memmove(&Damage->UpdateNs[0], &Damage->UpdateNs[1], (DAMAGE_UPDATE_COUNT - 1) * sizeof(Damage->UpdateNs[0]));
+        --Damage->UpdateCount;
+    }
+    Damage->UpdateNs[Damage->UpdateCount++] = TimeNs;
+}
+
+//
+// Whether the rect apply engine can write a surface of this format on this device: compute shaders with
+// structured buffers, and typed stores to the format
+//
+bool SupportsComputeApply(_In_ ID3D11Device* Device, DXGI_FORMAT Format)
+{
+    if (Device->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0)
+    {
+        return false;
+    }
+
+    D3D11_FEATURE_DATA_FORMAT_SUPPORT2 Support;
+    Support.InFormat = Format;
+    Support.OutFormatSupport2 = 0;
+    return SUCCEEDED(Device->CheckFeatureSupport(D3D11_FEATURE_FORMAT_SUPPORT2, &Support, sizeof(Support))) &&
+           (Support.OutFormatSupport2 & D3D11_FORMAT_SUPPORT2_UAV_TYPED_STORE);
+}
+
 //
 // Clean all references
 //
@@ -475,4 +801,219 @@ void DISPLAYMANAGER::CleanRefs()
         m_RTV->Release();
         m_RTV = nullptr;
     }
+
+    if (m_RectVertexShader)
+    {
+        m_RectVertexShader->Release();
+        m_RectVertexShader = nullptr;
+    }
+
+    if (m_RectInputLayout)
+    {
+        m_RectInputLayout->Release();
+        m_RectInputLayout = nullptr;
+    }
+
+    if (m_RectBuffer)
+    {
+        m_RectBuffer->Release();
+        m_RectBuffer = nullptr;
+    }
+    m_RectCapacity = 0;
+
+    if (m_RectConstants)
+    {
+        m_RectConstants->Release();
+        m_RectConstants = nullptr;
+    }
+
+    CleanTileResources();
+
+    if (m_TileHashShader)
+    {
+        m_TileHashShader->Release();
+        m_TileHashShader = nullptr;
+    }
+
+    CleanApplyResources();
+
+    if (m_ApplyShader)
+    {
+        m_ApplyShader->Release();
+        m_ApplyShader = nullptr;
+    }
+}
+
+//
+// Hash the tiles of a frame reported as fully dirty on the GPU and replace its dirty rect with the tiles
+// that changed since the previous frame. The dirty rects are left alone when the detector cannot tell.
+//
+DUPL_RETURN DISPLAYMANAGER::DetectChangedTiles(_In_ ID3D11Texture2D* Frame, _In_ D3D11_TEXTURE2D_DESC* FrameDesc, _Inout_ FRAMEARENA* Arena, _Inout_ RECT** DirtyBuffer, _Inout_ UINT* DirtyCount)
+{
+    // Output size changed, start over
+    if (!m_TileHashBuffer || m_TileDetector.GetWidth() != FrameDesc->Width || m_TileDetector.GetHeight() != FrameDesc->Height)
+    {
+        DUPL_RETURN Ret = CreateTileResources(FrameDesc->Width, FrameDesc->Height);
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            return Ret;
+        }
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC ShaderDesc;
+    ShaderDesc.Format = FrameDesc->Format;
+    ShaderDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    ShaderDesc.Texture2D.MostDetailedMip = FrameDesc->MipLevels - 1;
+    ShaderDesc.Texture2D.MipLevels = FrameDesc->MipLevels;
+
+    ID3D11ShaderResourceView* ShaderResource = nullptr;
+    HRESULT hr = m_Device->CreateShaderResourceView(Frame, &ShaderDesc, &ShaderResource);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create shader resource view for tile hashing", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    // One group per tile
+    ID3D11UnorderedAccessView* NullUAV = nullptr;
+    ID3D11ShaderResourceView* NullSRV = nullptr;
+    m_DeviceContext->CSSetShader(m_TileHashShader, nullptr, 0);
+    m_DeviceContext->CSSetShaderResources(0, 1, &ShaderResource);
+    m_DeviceContext->CSSetUnorderedAccessViews(0, 1, &m_TileHashUAV, nullptr);
+    m_DeviceContext->Dispatch(m_TileDetector.GetColumns(), m_TileDetector.GetRows(), 1);
+    m_DeviceContext->CSSetUnorderedAccessViews(0, 1, &NullUAV, nullptr);
+    m_DeviceContext->CSSetShaderResources(0, 1, &NullSRV);
+    m_DeviceContext->CSSetShader(nullptr, nullptr, 0);
+
+    ShaderResource->Release();
+    ShaderResource = nullptr;
+
+    // The hashes are tiny, reading them back right away costs less than the copy we may save
+    m_DeviceContext->CopyResource(m_TileHashStaging, m_TileHashBuffer);
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    hr = m_DeviceContext->Map(m_TileHashStaging, 0, D3D11_MAP_READ, 0, &Mapped);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to map tile hashes", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    UINT TileCount = m_TileDetector.GetColumns() * m_TileDetector.GetRows();
+    uint64_t* Hashes = m_TileDetector.GetHashes();
+    const UINT* Source = reinterpret_cast<const UINT*>(Mapped.pData);
+    for (UINT i = 0; i < TileCount; ++i)
+    {
+        Hashes[i] = (static_cast<uint64_t>(Source[i * 2 + 1]) << 32) | Source[i * 2];
+    }
+    m_DeviceContext->Unmap(m_TileHashStaging, 0);
+
+    RECT* Rects = Arena->AllocArray<RECT>(TILE_MAX_RECTS);
+    if (!Rects)
+    {
+        return ProcessFailure(nullptr, L"Failed to allocate memory for changed tiles.", L"Error", E_OUTOFMEMORY);
+    }
+
+    UINT RectCount;
+    if (m_TileDetector.BuildDirtyRects(Rects, TILE_MAX_RECTS, &RectCount))
+    {
+        *DirtyBuffer = Rects;
+        *DirtyCount = RectCount;
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Size the detector and the GPU buffers the tile hashes go through for a frame of this size
+//
+DUPL_RETURN DISPLAYMANAGER::CreateTileResources(UINT Width, UINT Height)
+{
+    CleanTileResources();
+
+    if (!m_TileDetector.Initialize(Width, Height))
+    {
+        return ProcessFailure(nullptr, L"Failed to allocate memory for tile hashes.", L"Error", E_OUTOFMEMORY);
+    }
+
+    D3D11_BUFFER_DESC BufferDesc;
+    RtlZeroMemory(&BufferDesc, sizeof(BufferDesc));
+    BufferDesc.ByteWidth = m_TileDetector.GetColumns() * m_TileDetector.GetRows() * 2 * sizeof(UINT);
+    BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    BufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    BufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    BufferDesc.StructureByteStride = 2 * sizeof(UINT);
+    HRESULT hr = m_Device->CreateBuffer(&BufferDesc, nullptr, &m_TileHashBuffer);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create tile hash buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    hr = m_Device->CreateUnorderedAccessView(m_TileHashBuffer, nullptr, &m_TileHashUAV);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create tile hash view", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    BufferDesc.Usage = D3D11_USAGE_STAGING;
+    BufferDesc.BindFlags = 0;
+    BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    hr = m_Device->CreateBuffer(&BufferDesc, nullptr, &m_TileHashStaging);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create tile hash staging buffer", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+void DISPLAYMANAGER::CleanTileResources()
+{
+    if (m_TileHashUAV)
+    {
+        m_TileHashUAV->Release();
+        m_TileHashUAV = nullptr;
+    }
+
+    if (m_TileHashBuffer)
+    {
+        m_TileHashBuffer->Release();
+        m_TileHashBuffer = nullptr;
+    }
+
+    if (m_TileHashStaging)
+    {
+        m_TileHashStaging->Release();
+        m_TileHashStaging = nullptr;
+    }
+}
+
+void DISPLAYMANAGER::CleanApplyResources()
+{
+    if (m_ApplyUAV)
+    {
+        m_ApplyUAV->Release();
+        m_ApplyUAV = nullptr;
+    }
+
+    if (m_MoveSRV)
+    {
+        m_MoveSRV->Release();
+        m_MoveSRV = nullptr;
+    }
+
+    APPLY_BUFFER* Buffers[3] = {&m_ApplyRects, &m_ApplyTiles, &m_ApplyTileRects};
+    for (APPLY_BUFFER* Buffer : Buffers)
+    {
+        if (Buffer->View)
+        {
+            Buffer->View->Release();
+            Buffer->View = nullptr;
+        }
+
+        if (Buffer->Buffer)
+        {
+            Buffer->Buffer->Release();
+            Buffer->Buffer = nullptr;
+        }
+        Buffer->Capacity = 0;
+    }
 }
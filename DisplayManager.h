@@ -9,6 +9,11 @@
 #define _DISPLAYMANAGER_H_
 
 #include "CommonTypes.h"
+#include "FrameArena.h"
+#include "GpuProfiler.h"
+#include "RectApply.h"
+#include "RectTransform.h"
+#include "TileDetector.h"
 
 //
 // Handles the task of processing frames
@@ -18,17 +23,37 @@ class DISPLAYMANAGER
     public:
         DISPLAYMANAGER();
         ~DISPLAYMANAGER();
-        void InitD3D(DX_RESOURCES* Data);
+        void InitD3D(DX_RESOURCES* Data, _In_ const DUPLICATION_OPTIONS* Options);
         ID3D11Device* GetDevice();
-        DUPL_RETURN ProcessFrame(_In_ FRAME_DATA* Data, _Inout_ ID3D11Texture2D* SharedSurf, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc);
+        void SetProfiler(_In_opt_ GPUPROFILER* Profiler);
+        DUPL_RETURN ProcessFrame(_In_ FRAME_DATA* Data, _Inout_ ID3D11Texture2D* SharedSurf, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage);
         void CleanRefs();
 
     private:
+        // A dynamic structured buffer the apply dispatch reads, grown as frames need
+        typedef struct _APPLY_BUFFER
+        {
+            ID3D11Buffer* Buffer;
+            ID3D11ShaderResourceView* View;
+            UINT Capacity;
+        } APPLY_BUFFER;
+
     // methods
-        DUPL_RETURN CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_ ID3D11Texture2D* SharedSurf, _In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc);
-        DUPL_RETURN CopyMove(_Inout_ ID3D11Texture2D* SharedSurf, _In_reads_(MoveCount) DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc, INT TexWidth, INT TexHeight);
-        void SetDirtyVert(_Out_writes_(NUMVERTICES) VERTEX* Vertices, _In_ RECT* Dirty, INT OffsetX, INT OffsetY, _In_ DXGI_OUTPUT_DESC* DeskDesc, _In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_ D3D11_TEXTURE2D_DESC* ThisDesc);
-        void SetMoveRect(_Out_ RECT* SrcRect, _Out_ RECT* DestRect, _In_ DXGI_OUTPUT_DESC* DeskDesc, _In_ DXGI_OUTDUPL_MOVE_RECT* MoveRect, INT TexWidth, INT TexHeight);
+        DUPL_RETURN CopyDirty(_In_ ID3D11Texture2D* SrcSurface, _Inout_ ID3D11Texture2D* SharedSurf, _In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage);
+        DUPL_RETURN DrawDirtyVertices(_In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage);
+        DUPL_RETURN DrawDirtyInstances(_In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage);
+        DUPL_RETURN CopyMove(_Inout_ ID3D11Texture2D* SharedSurf, _In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_reads_(MoveCount) DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage);
+        DUPL_RETURN CreateMoveSurf(_In_ D3D11_TEXTURE2D_DESC* FullDesc, _In_ const RECT_TRANSFORM* Transform);
+        DUPL_RETURN ApplyRects(_In_ ID3D11Texture2D* SrcSurface, _Inout_ ID3D11Texture2D* SharedSurf, _In_ D3D11_TEXTURE2D_DESC* FrameDesc, _In_ D3D11_TEXTURE2D_DESC* FullDesc,
+                               _In_reads_(MoveCount) DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, _In_reads_(DirtyCount) RECT* DirtyBuffer, UINT DirtyCount,
+                               _In_ const RECT_TRANSFORM* Transform, _Inout_ FRAMEARENA* Arena, _Inout_ DAMAGE_INFO* Damage, _Out_ bool* Applied);
+        DUPL_RETURN DetectChangedTiles(_In_ ID3D11Texture2D* Frame, _In_ D3D11_TEXTURE2D_DESC* FrameDesc, _Inout_ FRAMEARENA* Arena, _Inout_ RECT** DirtyBuffer, _Inout_ UINT* DirtyCount);
+        DUPL_RETURN CreateTileResources(UINT Width, UINT Height);
+        void CleanTileResources();
+        void CleanApplyResources();
+        void BeginPass(PROFILE_PASS Pass);
+        void EndPass();
+        DUPL_RETURN UploadApplyBuffer(_Inout_ APPLY_BUFFER* Buffer, _In_reads_bytes_(Count * Stride) const void* Data, UINT Count, UINT Stride);
 
     // variables
         ID3D11Device* m_Device;
@@ -39,8 +64,36 @@ class DISPLAYMANAGER
         ID3D11InputLayout* m_InputLayout;
         ID3D11RenderTargetView* m_RTV;
         ID3D11SamplerState* m_SamplerLinear;
-        BYTE* m_DirtyVertexBufferAlloc;
-        UINT m_DirtyVertexBufferAllocSize;
+
+        // Instanced dirty rects, nullptr where the device only takes expanded vertices
+        ID3D11VertexShader* m_RectVertexShader;
+        ID3D11InputLayout* m_RectInputLayout;
+        ID3D11Buffer* m_RectBuffer;
+        UINT m_RectCapacity;
+        ID3D11Buffer* m_RectConstants;
+
+        // Change detection for frames reported as fully dirty
+        bool m_TileDetection;
+        TILEDETECTOR m_TileDetector;
+        ID3D11ComputeShader* m_TileHashShader;
+        ID3D11Buffer* m_TileHashBuffer;
+        ID3D11UnorderedAccessView* m_TileHashUAV;
+        ID3D11Buffer* m_TileHashStaging;
+
+        // Compute apply engine, falls back to draws and copies when off or unsupported
+        bool m_ComputeApply;
+        ID3D11ComputeShader* m_ApplyShader;
+        ID3D11UnorderedAccessView* m_ApplyUAV;
+        ID3D11ShaderResourceView* m_MoveSRV;
+        APPLY_BUFFER m_ApplyRects;
+        APPLY_BUFFER m_ApplyTiles;
+        APPLY_BUFFER m_ApplyTileRects;
+
+        // Times the copies of each frame on the GPU, owned by the duplication thread
+        GPUPROFILER* m_Profiler;
+
+        // Says when to copy whole frames instead of their rects, nullptr when never
+        FRAMEGOVERNOR* m_Governor;
 };
 
 #endif
@@ -12,8 +12,6 @@
 //
 DUPLICATIONMANAGER::DUPLICATIONMANAGER() : m_DeskDupl(nullptr),
                                            m_AcquiredDesktopImage(nullptr),
-                                           m_MetaDataBuffer(nullptr),
-                                           m_MetaDataSize(0),
                                            m_OutputNumber(0),
                                            m_Device(nullptr)
 {
@@ -37,12 +35,6 @@ DUPLICATIONMANAGER::~DUPLICATIONMANAGER()
         m_AcquiredDesktopImage = nullptr;
     }
 
-    if (m_MetaDataBuffer)
-    {
-        delete [] m_MetaDataBuffer;
-        m_MetaDataBuffer = nullptr;
-    }
-
     if (m_Device)
     {
         m_Device->Release();
@@ -53,7 +45,7 @@ DUPLICATIONMANAGER::~DUPLICATIONMANAGER()
 //
 // Initialize duplication interfaces
 //
-DUPL_RETURN DUPLICATIONMANAGER::InitDupl(_In_ ID3D11Device* Device, UINT Output)
+DUPL_RETURN DUPLICATIONMANAGER::InitDupl(_In_ ID3D11Device* Device, UINT Output, DXGI_FORMAT Format)
 {
     m_OutputNumber = Output;
 
@@ -91,25 +83,46 @@ DUPL_RETURN DUPLICATIONMANAGER::InitDupl(_In_ ID3D11Device* Device, UINT Output)
 
     DxgiOutput->GetDesc(&m_OutputDesc);
 
-    // QI for Output 1
-    IDXGIOutput1* DxgiOutput1 = nullptr;
-    hr = DxgiOutput->QueryInterface(__uuidof(DxgiOutput1), reinterpret_cast<void**>(&DxgiOutput1));
-    DxgiOutput->Release();
-    DxgiOutput = nullptr;
-    if (FAILED(hr))
+    // Ask for frames in the format of the shared surface, DWM converts for us if the output shows something else
+    IDXGIOutput5* DxgiOutput5 = nullptr;
+    if (Format != DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        hr = DxgiOutput->QueryInterface(__uuidof(DxgiOutput5), reinterpret_cast<void**>(&DxgiOutput5));
+        if (SUCCEEDED(hr))
+        {
+            DxgiOutput->Release();
+            DxgiOutput = nullptr;
+
+            hr = DxgiOutput5->DuplicateOutput1(m_Device, 0, 1, &Format, &m_DeskDupl);
+            DxgiOutput5->Release();
+            DxgiOutput5 = nullptr;
+        }
+    }
+
+    // Older systems only give 8 bit frames, the copy into the shared surface converts them
+    if (DxgiOutput)
     {
-        return ProcessFailure(nullptr, L"Failed to QI for DxgiOutput1 in DUPLICATIONMANAGER", L"Error", hr);
+        // QI for Output 1
+        IDXGIOutput1* DxgiOutput1 = nullptr;
+        hr = DxgiOutput->QueryInterface(__uuidof(DxgiOutput1), reinterpret_cast<void**>(&DxgiOutput1));
+        DxgiOutput->Release();
+        DxgiOutput = nullptr;
+        if (FAILED(hr))
+        {
+            return ProcessFailure(nullptr, L"Failed to QI for DxgiOutput1 in DUPLICATIONMANAGER", L"Error", hr);
+        }
+
+        // Create desktop duplication
+        hr = DxgiOutput1->DuplicateOutput(m_Device, &m_DeskDupl);
+        DxgiOutput1->Release();
+        DxgiOutput1 = nullptr;
     }
 
-    // Create desktop duplication
-    hr = DxgiOutput1->DuplicateOutput(m_Device, &m_DeskDupl);
-    DxgiOutput1->Release();
-    DxgiOutput1 = nullptr;
     if (FAILED(hr))
     {
         if (hr == DXGI_ERROR_NOT_CURRENTLY_AVAILABLE)
         {
-            MessageBoxW(nullptr, L"There is already the maximum number of applications using the Desktop Duplication API running, please close one of those applications and then try again.", L"Error", MB_OK);
+            DisplayMsg(L"There is already the maximum number of applications using the Desktop Duplication API running, please close one of those applications and then try again.", L"Error", S_OK);
             return DUPL_RETURN_ERROR_UNEXPECTED;
         }
         return ProcessFailure(m_Device, L"Failed to get duplicate output in DUPLICATIONMANAGER", L"Error", hr, CreateDuplicationExpectedErrors);
@@ -119,28 +132,30 @@ DUPL_RETURN DUPLICATIONMANAGER::InitDupl(_In_ ID3D11Device* Device, UINT Output)
 }
 
 //
-// Retrieves mouse info and write it into PtrInfo
+// Publish the pointer position of a frame, needs neither the keyed mutex nor the frame itself
 //
-DUPL_RETURN DUPLICATIONMANAGER::GetMouse(_Inout_ PTR_INFO* PtrInfo, _In_ DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY)
+void DUPLICATIONMANAGER::UpdatePointerPosition(_Inout_ PTR_POSITION* PtrPosition, _In_ DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY)
 {
-    // A non-zero mouse update timestamp indicates that there is a mouse position update and optionally a shape change
+    // A non-zero mouse update timestamp indicates that there is a mouse position update
     if (FrameInfo->LastMouseUpdateTime.QuadPart == 0)
     {
-        return DUPL_RETURN_SUCCESS;
+        return;
     }
 
+    AcquireSRWLockExclusive(&PtrPosition->Lock);
+
     bool UpdatePosition = true;
 
     // Make sure we don't update pointer position wrongly
     // If pointer is invisible, make sure we did not get an update from another output that the last time that said pointer
     // was visible, if so, don't set it to invisible or update.
-    if (!FrameInfo->PointerPosition.Visible && (PtrInfo->WhoUpdatedPositionLast != m_OutputNumber))
+    if (!FrameInfo->PointerPosition.Visible && (PtrPosition->WhoUpdatedPositionLast != m_OutputNumber))
     {
         UpdatePosition = false;
     }
 
     // If two outputs both say they have a visible, only update if new update has newer timestamp
-    if (FrameInfo->PointerPosition.Visible && PtrInfo->Visible && (PtrInfo->WhoUpdatedPositionLast != m_OutputNumber) && (PtrInfo->LastTimeStamp.QuadPart > FrameInfo->LastMouseUpdateTime.QuadPart))
+    if (FrameInfo->PointerPosition.Visible && PtrPosition->Visible && (PtrPosition->WhoUpdatedPositionLast != m_OutputNumber) && (PtrPosition->LastTimeStamp.QuadPart > FrameInfo->LastMouseUpdateTime.QuadPart))
     {
         UpdatePosition = false;
     }
@@ -148,28 +163,44 @@ DUPL_RETURN DUPLICATIONMANAGER::GetMouse(_Inout_ PTR_INFO* PtrInfo, _In_ DXGI_OU
     // Update position
     if (UpdatePosition)
     {
-        PtrInfo->Position.x = FrameInfo->PointerPosition.Position.x + m_OutputDesc.DesktopCoordinates.left - OffsetX;
-        PtrInfo->Position.y = FrameInfo->PointerPosition.Position.y + m_OutputDesc.DesktopCoordinates.top - OffsetY;
-        PtrInfo->WhoUpdatedPositionLast = m_OutputNumber;
-        PtrInfo->LastTimeStamp = FrameInfo->LastMouseUpdateTime;
-        PtrInfo->Visible = FrameInfo->PointerPosition.Visible != 0;
+        PtrPosition->Position.x = FrameInfo->PointerPosition.Position.x + m_OutputDesc.DesktopCoordinates.left - OffsetX;
+        PtrPosition->Position.y = FrameInfo->PointerPosition.Position.y + m_OutputDesc.DesktopCoordinates.top - OffsetY;
+        PtrPosition->WhoUpdatedPositionLast = m_OutputNumber;
+        PtrPosition->LastTimeStamp = FrameInfo->LastMouseUpdateTime;
+        PtrPosition->Visible = FrameInfo->PointerPosition.Visible != 0;
+        if (PtrPosition->Visible)
+        {
+            AddPointerSample(&PtrPosition->History, QpcToNs(FrameInfo->LastMouseUpdateTime.QuadPart), PtrPosition->Position.x, PtrPosition->Position.y);
+        }
     }
 
+    ReleaseSRWLockExclusive(&PtrPosition->Lock);
+}
+
+//
+// Retrieves mouse info, the position into PtrPosition and a new shape into PtrInfo. Must hold the keyed mutex
+// when the frame has a new shape.
+//
+DUPL_RETURN DUPLICATIONMANAGER::GetMouse(_Inout_ PTR_INFO* PtrInfo, _Inout_ PTR_POSITION* PtrPosition, _In_ DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY)
+{
+    UpdatePointerPosition(PtrPosition, FrameInfo, OffsetX, OffsetY);
+
     // No new shape
     if (FrameInfo->PointerShapeBufferSize == 0)
     {
         return DUPL_RETURN_SUCCESS;
     }
 
-    // Old buffer too small
+    // Old buffer too small, grow it well past the request so new shapes rarely reallocate it
     if (FrameInfo->PointerShapeBufferSize > PtrInfo->BufferSize)
     {
+        UINT NewSize = max(max(FrameInfo->PointerShapeBufferSize, PtrInfo->BufferSize * 2), static_cast<UINT>(PTR_SHAPE_MIN_BUFFER_SIZE));
         if (PtrInfo->PtrShapeBuffer)
         {
             delete [] PtrInfo->PtrShapeBuffer;
             PtrInfo->PtrShapeBuffer = nullptr;
         }
-        PtrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[FrameInfo->PointerShapeBufferSize];
+        PtrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[NewSize];
         if (!PtrInfo->PtrShapeBuffer)
         {
             PtrInfo->BufferSize = 0;
@@ -177,7 +208,7 @@ DUPL_RETURN DUPLICATIONMANAGER::GetMouse(_Inout_ PTR_INFO* PtrInfo, _In_ DXGI_OU
         }
 
         // Update buffer size
-        PtrInfo->BufferSize = FrameInfo->PointerShapeBufferSize;
+        PtrInfo->BufferSize = NewSize;
     }
 
     // Get shape
@@ -191,15 +222,18 @@ DUPL_RETURN DUPLICATIONMANAGER::GetMouse(_Inout_ PTR_INFO* PtrInfo, _In_ DXGI_OU
         return ProcessFailure(m_Device, L"Failed to get frame pointer shape in DUPLICATIONMANAGER", L"Error", hr, FrameInfoExpectedErrors);
     }
 
+    // Let the presenter know it must pick up the new shape
+    PtrInfo->ShapeSerial++;
+
     return DUPL_RETURN_SUCCESS;
 }
 
 
 //
-// Get next frame and write it into Data
+// Get next frame and write it into Data, the metadata is placed in Arena
 //
 _Success_(*Timeout == false && return == DUPL_RETURN_SUCCESS)
-DUPL_RETURN DUPLICATIONMANAGER::GetFrame(_Out_ FRAME_DATA* Data, _Out_ bool* Timeout)
+DUPL_RETURN DUPLICATIONMANAGER::GetFrame(_Out_ FRAME_DATA* Data, _Inout_ FRAMEARENA* Arena, _Out_ bool* Timeout)
 {
     IDXGIResource* DesktopResource = nullptr;
     DXGI_OUTDUPL_FRAME_INFO FrameInfo;
@@ -237,29 +271,18 @@ DUPL_RETURN DUPLICATIONMANAGER::GetFrame(_Out_ FRAME_DATA* Data, _Out_ bool* Tim
     // Get metadata
     if (FrameInfo.TotalMetadataBufferSize)
     {
-        // Old buffer too small
-        if (FrameInfo.TotalMetadataBufferSize > m_MetaDataSize)
+        BYTE* MetaDataBuffer = Arena->AllocArray<BYTE>(FrameInfo.TotalMetadataBufferSize);
+        if (!MetaDataBuffer)
         {
-            if (m_MetaDataBuffer)
-            {
-                delete [] m_MetaDataBuffer;
-                m_MetaDataBuffer = nullptr;
-            }
-            m_MetaDataBuffer = new (std::nothrow) BYTE[FrameInfo.TotalMetadataBufferSize];
-            if (!m_MetaDataBuffer)
-            {
-                m_MetaDataSize = 0;
-                Data->MoveCount = 0;
-                Data->DirtyCount = 0;
-                return ProcessFailure(nullptr, L"Failed to allocate memory for metadata in DUPLICATIONMANAGER", L"Error", E_OUTOFMEMORY);
-            }
-            m_MetaDataSize = FrameInfo.TotalMetadataBufferSize;
+            Data->MoveCount = 0;
+            Data->DirtyCount = 0;
+            return ProcessFailure(nullptr, L"Failed to allocate memory for metadata in DUPLICATIONMANAGER", L"Error", E_OUTOFMEMORY);
         }
 
         UINT BufSize = FrameInfo.TotalMetadataBufferSize;
 
         // Get move rectangles
-        hr = m_DeskDupl->GetFrameMoveRects(BufSize, reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(m_MetaDataBuffer), &BufSize);
+        hr = m_DeskDupl->GetFrameMoveRects(BufSize, reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(MetaDataBuffer), &BufSize);
         if (FAILED(hr))
         {
             Data->MoveCount = 0;
@@ -268,7 +291,7 @@ DUPL_RETURN DUPLICATIONMANAGER::GetFrame(_Out_ FRAME_DATA* Data, _Out_ bool* Tim
         }
         Data->MoveCount = BufSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
 
-        BYTE* DirtyRects = m_MetaDataBuffer + BufSize;
+        BYTE* DirtyRects = MetaDataBuffer + BufSize;
         BufSize = FrameInfo.TotalMetadataBufferSize - BufSize;
 
         // Get dirty rectangles
@@ -281,7 +304,7 @@ DUPL_RETURN DUPLICATIONMANAGER::GetFrame(_Out_ FRAME_DATA* Data, _Out_ bool* Tim
         }
         Data->DirtyCount = BufSize / sizeof(RECT);
 
-        Data->MetaData = m_MetaDataBuffer;
+        Data->MetaData = MetaDataBuffer;
     }
 
     Data->Frame = m_AcquiredDesktopImage;
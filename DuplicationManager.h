@@ -9,6 +9,7 @@
 #define _DUPLICATIONMANAGER_H_
 
 #include "CommonTypes.h"
+#include "FrameArena.h"
 
 //
 // Handles the task of duplicating an output.
@@ -18,10 +19,11 @@ class DUPLICATIONMANAGER
     public:
         DUPLICATIONMANAGER();
         ~DUPLICATIONMANAGER();
-        _Success_(*Timeout == false && return == DUPL_RETURN_SUCCESS) DUPL_RETURN GetFrame(_Out_ FRAME_DATA* Data, _Out_ bool* Timeout);
+        _Success_(*Timeout == false && return == DUPL_RETURN_SUCCESS) DUPL_RETURN GetFrame(_Out_ FRAME_DATA* Data, _Inout_ FRAMEARENA* Arena, _Out_ bool* Timeout);
         DUPL_RETURN DoneWithFrame();
-        DUPL_RETURN InitDupl(_In_ ID3D11Device* Device, UINT Output);
-        DUPL_RETURN GetMouse(_Inout_ PTR_INFO* PtrInfo, _In_ DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY);
+        DUPL_RETURN InitDupl(_In_ ID3D11Device* Device, UINT Output, DXGI_FORMAT Format);
+        DUPL_RETURN GetMouse(_Inout_ PTR_INFO* PtrInfo, _Inout_ PTR_POSITION* PtrPosition, _In_ DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY);
+        void UpdatePointerPosition(_Inout_ PTR_POSITION* PtrPosition, _In_ DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY);
         void GetOutputDesc(_Out_ DXGI_OUTPUT_DESC* DescPtr);
 
     private:
@@ -29,8 +31,6 @@ class DUPLICATIONMANAGER
     // vars
         IDXGIOutputDuplication* m_DeskDupl;
         ID3D11Texture2D* m_AcquiredDesktopImage;
-        _Field_size_bytes_(m_MetaDataSize) BYTE* m_MetaDataBuffer;
-        UINT m_MetaDataSize;
         UINT m_OutputNumber;
         DXGI_OUTPUT_DESC m_OutputDesc;
         ID3D11Device* m_Device;
@@ -0,0 +1,312 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <string.h>
+
+#include "EdidParser.h"
+
+static const uint8_t EdidHeader[8] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+#define EDID_EXT_CTA            0x02
+#define EDID_EXT_DISPLAYID      0x70
+
+#define DESCRIPTOR_NAME         0xFC
+#define DESCRIPTOR_RANGE        0xFD
+
+#define DISPLAYID_TYPE_I        0x03
+#define DISPLAYID_TYPE_VII      0x22
+
+#define CTA_BLOCK_VIDEO         0x02
+
+//
+// CTA-861 timing of a video identification code, vertical values per field like a detailed timing
+//
+typedef struct _CTA_VIC_TIMING
+{
+    uint8_t Vic;
+    uint32_t PixelClockKHz;
+    uint16_t Width;
+    uint16_t Height;
+    uint16_t HBlank;
+    uint16_t VBlank;
+    bool Interlaced;
+} CTA_VIC_TIMING;
+
+// The codes displays commonly list, others are skipped
+static const CTA_VIC_TIMING CtaVicTimings[] =
+{
+    {1,  25175,  640,  480,  160,  45, false},
+    {2,  27000,  720,  480,  138,  45, false},
+    {3,  27000,  720,  480,  138,  45, false},
+    {4,  74250,  1280, 720,  370,  30, false},
+    {5,  74250,  1920, 540,  280,  22, true},
+    {16, 148500, 1920, 1080, 280,  45, false},
+    {17, 27000,  720,  576,  144,  49, false},
+    {18, 27000,  720,  576,  144,  49, false},
+    {19, 74250,  1280, 720,  700,  30, false},
+    {20, 74250,  1920, 540,  720,  22, true},
+    {31, 148500, 1920, 1080, 720,  45, false},
+    {32, 74250,  1920, 1080, 830,  45, false},
+    {33, 74250,  1920, 1080, 720,  45, false},
+    {34, 74250,  1920, 1080, 280,  45, false},
+    {63, 297000, 1920, 1080, 280,  45, false},
+    {64, 297000, 1920, 1080, 720,  45, false},
+    {93, 297000, 3840, 2160, 1660, 90, false},
+    {94, 297000, 3840, 2160, 1440, 90, false},
+    {95, 297000, 3840, 2160, 560,  90, false},
+    {96, 594000, 3840, 2160, 1440, 90, false},
+    {97, 594000, 3840, 2160, 560,  90, false},
+};
+
+//
+// Every EDID block sums to zero
+//
+static bool IsBlockValid(const uint8_t* Block)
+{
+    uint8_t Sum = 0;
+    for (size_t i = 0; i < EDID_BLOCK_SIZE; ++i)
+    {
+        Sum += Block[i];
+    }
+    return Sum == 0;
+}
+
+static void AddTiming(EDID_INFO* Info, uint32_t PixelClockKHz, uint32_t Width, uint32_t Height, uint32_t HBlank, uint32_t VBlank, bool Interlaced)
+{
+    if (Info->TimingCount >= EDID_MAX_TIMINGS || !PixelClockKHz || !Width || !Height)
+    {
+        return;
+    }
+
+    // Short video descriptors mostly repeat detailed timings, keep the first
+    for (uint32_t i = 0; i < Info->TimingCount; ++i)
+    {
+        const EDID_TIMING* Known = &Info->Timings[i];
+        if (Known->PixelClockKHz == PixelClockKHz && Known->Width == Width && Known->HTotal == Width + HBlank && Known->Interlaced == Interlaced &&
+            Known->Height == (Interlaced ? Height * 2 : Height))
+        {
+            return;
+        }
+    }
+
+    // The vertical values of an interlaced timing are per field, so this is the field rate, 60 for 1080i60
+    EDID_TIMING* Timing = &Info->Timings[Info->TimingCount++];
+    Timing->PixelClockKHz = PixelClockKHz;
+    Timing->Width = Width;
+    Timing->HTotal = Width + HBlank;
+    Timing->Interlaced = Interlaced;
+    Timing->RefreshRate = (PixelClockKHz * 1000.0) / (static_cast<double>(Timing->HTotal) * (Height + VBlank));
+
+    // Two fields make a frame, one of them a line longer, report the frame like the modes of the display manager
+    Timing->Height = Interlaced ? Height * 2 : Height;
+    Timing->VTotal = Interlaced ? (Height + VBlank) * 2 + 1 : Height + VBlank;
+}
+
+//
+// 18 byte detailed timing or display descriptor, used by the base block and CTA-861 extensions
+//
+static void ParseDescriptor(const uint8_t* Desc, EDID_INFO* Info)
+{
+    uint32_t PixelClock = Desc[0] | (Desc[1] << 8);
+    if (PixelClock)
+    {
+        uint32_t Width = Desc[2] | ((Desc[4] & 0xF0) << 4);
+        uint32_t HBlank = Desc[3] | ((Desc[4] & 0x0F) << 8);
+        uint32_t Height = Desc[5] | ((Desc[7] & 0xF0) << 4);
+        uint32_t VBlank = Desc[6] | ((Desc[7] & 0x0F) << 8);
+        AddTiming(Info, PixelClock * 10, Width, Height, HBlank, VBlank, (Desc[17] & 0x80) != 0);
+        return;
+    }
+
+    switch (Desc[3])
+    {
+        case DESCRIPTOR_NAME:
+        {
+            size_t Length = 0;
+            while (Length < 13 && Desc[5 + Length] != 0x0A)
+            {
+                Info->Name[Length] = static_cast<char>(Desc[5 + Length]);
+                ++Length;
+            }
+            Info->Name[Length] = '\0';
+            break;
+        }
+        case DESCRIPTOR_RANGE:
+        {
+            // EDID 1.4 can push either limit past 255 Hz with the offset flags
+            Info->MinRefreshRate = Desc[5] + (((Desc[4] & 0x03) == 0x03) ? 255 : 0);
+            Info->MaxRefreshRate = Desc[6] + ((Desc[4] & 0x02) ? 255 : 0);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+//
+// Video data block of a CTA-861 extension, one video identification code per byte
+//
+static void ParseCtaVideoBlock(const uint8_t* Svds, uint32_t Count, EDID_INFO* Info)
+{
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        // Codes 1 to 64 may carry a native flag in bit 7, codes from 193 on are plain 8 bit codes
+        uint8_t Vic = Svds[i];
+        if (Vic >= 129 && Vic <= 192)
+        {
+            Vic &= 0x7F;
+        }
+
+        for (size_t Known = 0; Known < sizeof(CtaVicTimings) / sizeof(CtaVicTimings[0]); ++Known)
+        {
+            const CTA_VIC_TIMING* Timing = &CtaVicTimings[Known];
+            if (Timing->Vic == Vic)
+            {
+                AddTiming(Info, Timing->PixelClockKHz, Timing->Width, Timing->Height, Timing->HBlank, Timing->VBlank, Timing->Interlaced);
+                break;
+            }
+        }
+    }
+}
+
+static void ParseCtaExtension(const uint8_t* Block, EDID_INFO* Info)
+{
+    // Byte 2 is where the detailed timings start, they run until a zero pixel clock or the checksum
+    uint32_t Offset = Block[2];
+    if (Offset < 4)
+    {
+        return;
+    }
+    uint32_t DtdStart = (Offset > EDID_BLOCK_SIZE - 1) ? EDID_BLOCK_SIZE - 1 : Offset;
+
+    // Detailed timings come first, they say more than the codes repeating them
+    for (; Offset + 18 <= EDID_BLOCK_SIZE - 1; Offset += 18)
+    {
+        if (!Block[Offset] && !Block[Offset + 1])
+        {
+            break;
+        }
+        ParseDescriptor(Block + Offset, Info);
+    }
+
+    // The data blocks sit between the 4 byte header and the detailed timings, each led by a tag and length byte
+    for (uint32_t Data = 4; Data < DtdStart;)
+    {
+        uint8_t Tag = Block[Data] >> 5;
+        uint32_t Length = Block[Data] & 0x1F;
+        if (Data + 1 + Length > DtdStart)
+        {
+            break;
+        }
+        if (Tag == CTA_BLOCK_VIDEO)
+        {
+            ParseCtaVideoBlock(Block + Data + 1, Length, Info);
+        }
+        Data += 1 + Length;
+    }
+}
+
+//
+// DisplayID is where most headsets describe their high refresh modes
+//
+static void ParseDisplayIdExtension(const uint8_t* Block, EDID_INFO* Info)
+{
+    // The section starts after the extension tag, its payload follows a 4 byte header
+    const uint8_t* Section = Block + 1;
+    uint32_t SectionEnd = 4 + Section[1];
+    if (SectionEnd > EDID_BLOCK_SIZE - 2)
+    {
+        SectionEnd = EDID_BLOCK_SIZE - 2;
+    }
+
+    uint32_t Offset = 4;
+    while (Offset + 3 <= SectionEnd)
+    {
+        uint8_t Tag = Section[Offset];
+        uint32_t Length = Section[Offset + 2];
+        const uint8_t* Payload = Section + Offset + 3;
+        if (Offset + 3 + Length > SectionEnd)
+        {
+            break;
+        }
+
+        if (Tag == DISPLAYID_TYPE_I || Tag == DISPLAYID_TYPE_VII)
+        {
+            for (uint32_t Desc = 0; Desc + 20 <= Length; Desc += 20)
+            {
+                const uint8_t* Timing = Payload + Desc;
+                uint32_t PixelClock = (Timing[0] | (Timing[1] << 8) | (Timing[2] << 16)) + 1;
+                uint32_t Width = (Timing[4] | (Timing[5] << 8)) + 1;
+                uint32_t HBlank = (Timing[6] | (Timing[7] << 8)) + 1;
+                uint32_t Height = (Timing[12] | (Timing[13] << 8)) + 1;
+                uint32_t VBlank = (Timing[14] | (Timing[15] << 8)) + 1;
+
+                // Type I counts in 10 kHz units, type VII in 1 kHz units
+                uint32_t PixelClockKHz = (Tag == DISPLAYID_TYPE_I) ? PixelClock * 10 : PixelClock;
+                AddTiming(Info, PixelClockKHz, Width, Height, HBlank, VBlank, (Timing[3] & 0x10) != 0);
+            }
+        }
+
+        Offset += 3 + Length;
+    }
+}
+
+//
+// Parse the base block and known extensions. Fails when the base block is truncated or corrupt,
+// extension blocks that fail their checksum are skipped.
+//
+bool ParseEdid(const uint8_t* Data, size_t Size, EDID_INFO* Info)
+{
+    memset(Info, 0, sizeof(EDID_INFO));
+
+    if (!Data || Size < EDID_BLOCK_SIZE || memcmp(Data, EdidHeader, sizeof(EdidHeader)) != 0 || !IsBlockValid(Data))
+    {
+        return false;
+    }
+
+    Info->VendorId = static_cast<uint16_t>(Data[8] | (Data[9] << 8));
+    Info->ProductId = static_cast<uint16_t>(Data[10] | (Data[11] << 8));
+    Info->SerialNumber = Data[12] | (Data[13] << 8) | (Data[14] << 16) | (static_cast<uint32_t>(Data[15]) << 24);
+    Info->Version = Data[18];
+    Info->Revision = Data[19];
+
+    // Manufacturer is three 5 bit letters, big endian
+    uint16_t Packed = static_cast<uint16_t>((Data[8] << 8) | Data[9]);
+    Info->Manufacturer[0] = static_cast<char>('A' - 1 + ((Packed >> 10) & 0x1F));
+    Info->Manufacturer[1] = static_cast<char>('A' - 1 + ((Packed >> 5) & 0x1F));
+    Info->Manufacturer[2] = static_cast<char>('A' - 1 + (Packed & 0x1F));
+    Info->Manufacturer[3] = '\0';
+
+    for (uint32_t Desc = 0; Desc < 4; ++Desc)
+    {
+        ParseDescriptor(Data + 54 + Desc * 18, Info);
+    }
+
+    size_t ExtensionCount = Data[126];
+    for (size_t Ext = 1; Ext <= ExtensionCount && (Ext + 1) * EDID_BLOCK_SIZE <= Size; ++Ext)
+    {
+        const uint8_t* Block = Data + Ext * EDID_BLOCK_SIZE;
+        if (!IsBlockValid(Block))
+        {
+            continue;
+        }
+
+        switch (Block[0])
+        {
+            case EDID_EXT_CTA:
+                ParseCtaExtension(Block, Info);
+                break;
+            case EDID_EXT_DISPLAYID:
+                ParseDisplayIdExtension(Block, Info);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,63 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _EDIDPARSER_H_
+#define _EDIDPARSER_H_
+
+// This file is kept free of Windows headers so it can be built and fed captured EDID blobs on any platform
+#include <stddef.h>
+#include <stdint.h>
+
+#define EDID_BLOCK_SIZE     128
+#define EDID_MAX_TIMINGS    32
+
+//
+// One video timing advertised by the display. Sizes are of whole frames, the refresh rate of an interlaced
+// timing is its field rate.
+//
+typedef struct _EDID_TIMING
+{
+    uint32_t PixelClockKHz;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t HTotal;
+    uint32_t VTotal;
+    double RefreshRate;
+    bool Interlaced;
+} EDID_TIMING;
+
+//
+// What we need to know about a display from its EDID
+//
+typedef struct _EDID_INFO
+{
+    // Bytes 8-11 read as little endian words, which is how HMD profiles are keyed
+    uint16_t VendorId;
+    uint16_t ProductId;
+
+    // Three letter PNP manufacturer ID decoded from VendorId, e.g. "SNY"
+    char Manufacturer[4];
+    uint32_t SerialNumber;
+    uint8_t Version;
+    uint8_t Revision;
+
+    // Monitor name descriptor, empty when absent
+    char Name[14];
+
+    // Vertical rate limits from the range descriptor, zero when absent
+    uint32_t MinRefreshRate;
+    uint32_t MaxRefreshRate;
+
+    // Detailed timings of the base block, then of each extension in turn: CTA-861 detailed timings and the
+    // video codes not already listed, DisplayID type I and VII timings. The first one is the preferred timing.
+    EDID_TIMING Timings[EDID_MAX_TIMINGS];
+    uint32_t TimingCount;
+} EDID_INFO;
+
+bool ParseEdid(const uint8_t* Data, size_t Size, EDID_INFO* Info);
+
+#endif
@@ -0,0 +1,183 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "EventReporter.h"
+
+EVENTREPORTER::EVENTREPORTER() : m_Dropped(0),
+                                 m_DroppedShown(0),
+                                 m_StartTime(0),
+                                 m_Thread(nullptr),
+                                 m_WakeEvent(nullptr),
+                                 m_Stopping(FALSE)
+{
+    RtlZeroMemory(const_cast<LONG*>(m_TransitionCounts), sizeof(m_TransitionCounts));
+}
+
+EVENTREPORTER::~EVENTREPORTER()
+{
+    Stop();
+}
+
+//
+// Start showing events as they come. Until then, or if this fails, they wait in the queue for Stop.
+//
+bool EVENTREPORTER::Start()
+{
+    if (m_Thread)
+    {
+        return true;
+    }
+
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+    m_StartTime = QpcToNs(Now.QuadPart);
+
+    m_WakeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (!m_WakeEvent)
+    {
+        return false;
+    }
+
+    InterlockedExchange(&m_Stopping, FALSE);
+    DWORD ThreadId;
+    m_Thread = CreateThread(nullptr, 0, ReportProc, this, 0, &ThreadId);
+    if (!m_Thread)
+    {
+        CloseHandle(m_WakeEvent);
+        m_WakeEvent = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Show everything still queued, waiting for the user if need be, and stop the thread. Called once the
+// threads that report have stopped.
+//
+void EVENTREPORTER::Stop()
+{
+    if (m_Thread)
+    {
+        InterlockedExchange(&m_Stopping, TRUE);
+        SetEvent(m_WakeEvent);
+        WaitForSingleObjectEx(m_Thread, INFINITE, FALSE);
+        CloseHandle(m_Thread);
+        m_Thread = nullptr;
+    }
+
+    if (m_WakeEvent)
+    {
+        CloseHandle(m_WakeEvent);
+        m_WakeEvent = nullptr;
+    }
+
+    // Whatever was reported without the thread, or after it last looked
+    Drain();
+}
+
+//
+// Queue an event, from any thread. Never waits: a full queue drops the event but it still counts.
+//
+void EVENTREPORTER::Report(EVENT_KIND Kind, TRANSITION_TYPE Transition, HRESULT hr, _In_ LPCWSTR Site, _In_ LPCWSTR Title)
+{
+    if (Kind == EVENT_EXPECTED)
+    {
+        InterlockedIncrement(&m_TransitionCounts[Transition]);
+    }
+
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+
+    REPORTED_EVENT Event;
+    Event.Time = QpcToNs(Now.QuadPart);
+    Event.Kind = Kind;
+    Event.Transition = Transition;
+    Event.hr = hr;
+    Event.Site = Site;
+    Event.Title = Title;
+    if (!m_Events.Push(Event))
+    {
+        InterlockedIncrement(&m_Dropped);
+        return;
+    }
+
+    HANDLE WakeEvent = m_WakeEvent;
+    if (WakeEvent)
+    {
+        SetEvent(WakeEvent);
+    }
+}
+
+//
+// Expected errors reported so far for each kind of transition, they only ever grow
+//
+void EVENTREPORTER::GetTransitionCounts(_Out_writes_(TRANSITION_COUNT) UINT* Counts)
+{
+    for (UINT i = 0; i < TRANSITION_COUNT; ++i)
+    {
+        Counts[i] = static_cast<UINT>(InterlockedCompareExchange(&m_TransitionCounts[i], 0, 0));
+    }
+}
+
+DWORD WINAPI EVENTREPORTER::ReportProc(_In_ void* Param)
+{
+    EVENTREPORTER* Reporter = reinterpret_cast<EVENTREPORTER*>(Param);
+    while (!InterlockedCompareExchange(&Reporter->m_Stopping, FALSE, FALSE))
+    {
+        WaitForSingleObjectEx(Reporter->m_WakeEvent, INFINITE, FALSE);
+        Reporter->Drain();
+    }
+    return 0;
+}
+
+//
+// Show the queued events in the order they were reported, only ever from one thread at a time
+//
+void EVENTREPORTER::Drain()
+{
+    REPORTED_EVENT Event;
+    while (m_Events.Pop(&Event))
+    {
+        Show(&Event);
+    }
+
+    LONG Dropped = InterlockedCompareExchange(&m_Dropped, 0, 0);
+    if (Dropped != m_DroppedShown)
+    {
+        wchar_t Msg[64];
+        swprintf_s(Msg, L"%d events dropped, the queue was full\n", Dropped - m_DroppedShown);
+        OutputDebugStringW(Msg);
+        m_DroppedShown = Dropped;
+    }
+}
+
+//
+// Everything goes to the debugger, messages and errors we exit on also to the user
+//
+void EVENTREPORTER::Show(_In_ const REPORTED_EVENT* Event)
+{
+    // Format on the stack, an overly long message is truncated
+    LPCWSTR Text = Event->Site;
+    wchar_t OutStr[512];
+    if (FAILED(Event->hr))
+    {
+        _snwprintf_s(OutStr, _countof(OutStr), _TRUNCATE, L"%s with 0x%X.", Event->Site, Event->hr);
+        Text = OutStr;
+    }
+
+    wchar_t DebugStr[600];
+    double Seconds = (Event->Time >= m_StartTime) ? (Event->Time - m_StartTime) / 1e9 : 0.0;
+    _snwprintf_s(DebugStr, _countof(DebugStr), _TRUNCATE, L"[%.3f s] %s: %s\n", Seconds,
+                 (Event->Kind == EVENT_EXPECTED) ? L"Transition" : Event->Title, Text);
+    OutputDebugStringW(DebugStr);
+
+    if (Event->Kind != EVENT_EXPECTED)
+    {
+        MessageBoxW(nullptr, Text, Event->Title, MB_OK);
+    }
+}
@@ -0,0 +1,72 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _EVENTREPORTER_H_
+#define _EVENTREPORTER_H_
+
+#include "CommandQueue.h"
+#include "CommonTypes.h"
+
+// Events waiting to be shown, more than this are dropped and counted
+#define EVENT_QUEUE_SIZE 256
+
+typedef enum
+{
+    EVENT_MESSAGE       = 0,    // Shown to the user, not an error of ours
+    EVENT_EXPECTED      = 1,    // Error of a system transition, duplication is restarted
+    EVENT_UNEXPECTED    = 2     // Error the application exits on
+} EVENT_KIND;
+
+typedef struct _REPORTED_EVENT
+{
+    // Nanoseconds on the QPC clock
+    uint64_t Time;
+    EVENT_KIND Kind;
+
+    // Expected errors only, the transition the error is a sign of
+    TRANSITION_TYPE Transition;
+    HRESULT hr;
+
+    // Static strings, reporting copies nothing
+    LPCWSTR Site;
+    LPCWSTR Title;
+} REPORTED_EVENT;
+
+//
+// Takes errors and messages from any thread without blocking it and shows them from a thread of its own,
+// so a thread that fails never sits in a message box holding the keyed mutex. Keeps count of the expected
+// errors of each kind of transition for the recovery logic.
+//
+class EVENTREPORTER
+{
+    public:
+        EVENTREPORTER();
+        ~EVENTREPORTER();
+        bool Start();
+        void Stop();
+        void Report(EVENT_KIND Kind, TRANSITION_TYPE Transition, HRESULT hr, _In_ LPCWSTR Site, _In_ LPCWSTR Title);
+        void GetTransitionCounts(_Out_writes_(TRANSITION_COUNT) UINT* Counts);
+
+    private:
+    // methods
+        static DWORD WINAPI ReportProc(_In_ void* Param);
+        void Drain();
+        void Show(_In_ const REPORTED_EVENT* Event);
+
+    // variables
+        MPSCQUEUE<REPORTED_EVENT, EVENT_QUEUE_SIZE> m_Events;
+        volatile LONG m_TransitionCounts[TRANSITION_COUNT];
+        volatile LONG m_Dropped;
+        LONG m_DroppedShown;
+        uint64_t m_StartTime;
+
+        HANDLE m_Thread;
+        HANDLE m_WakeEvent;
+        volatile LONG m_Stopping;
+};
+
+#endif
@@ -0,0 +1,67 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "Foveation.h"
+
+static LONG Clamp(LONG Value, LONG Low, LONG High)
+{
+    return (Value < Low) ? Low : ((Value > High) ? High : Value);
+}
+
+//
+// Desktop region shown at full resolution, the rest of the view comes from the peripheral copy.
+// The rect lies on the FOVEATION_GRANULARITY grid (and so on the peripheral texel grid) and inside the desktop.
+//
+void GetFoveaRect(const FOVEATION_OPTIONS* Options, UINT Width, UINT Height, POINT Pointer, RECT* Fovea)
+{
+    LONG FoveaWidth = static_cast<LONG>(Width * Options->FoveaPercent / 100);
+    LONG FoveaHeight = static_cast<LONG>(Height * Options->FoveaPercent / 100);
+
+    LONG CenterX = static_cast<LONG>(Width / 2);
+    LONG CenterY = static_cast<LONG>(Height / 2);
+    if (Options->Mode == FOVEATION_POINTER)
+    {
+        CenterX = Pointer.x;
+        CenterY = Pointer.y;
+    }
+
+    LONG Left = Clamp(CenterX - FoveaWidth / 2, 0, static_cast<LONG>(Width) - FoveaWidth);
+    LONG Top = Clamp(CenterY - FoveaHeight / 2, 0, static_cast<LONG>(Height) - FoveaHeight);
+
+    Fovea->left = Left / FOVEATION_GRANULARITY * FOVEATION_GRANULARITY;
+    Fovea->top = Top / FOVEATION_GRANULARITY * FOVEATION_GRANULARITY;
+    Fovea->right = Clamp((Left + FoveaWidth + FOVEATION_GRANULARITY - 1) / FOVEATION_GRANULARITY * FOVEATION_GRANULARITY, 0, static_cast<LONG>(Width));
+    Fovea->bottom = Clamp((Top + FoveaHeight + FOVEATION_GRANULARITY - 1) / FOVEATION_GRANULARITY * FOVEATION_GRANULARITY, 0, static_cast<LONG>(Height));
+}
+
+//
+// Grow a desktop rect to whole texels of a copy downscaled Scale times, and clip it to the part of the desktop
+// that copy covers. Returns false if nothing is left.
+//
+bool AlignToScale(const RECT* Rect, UINT Scale, UINT Width, UINT Height, RECT* Aligned)
+{
+    LONG S = static_cast<LONG>(Scale);
+    Aligned->left = Clamp(Rect->left, 0, static_cast<LONG>(Width)) / S * S;
+    Aligned->top = Clamp(Rect->top, 0, static_cast<LONG>(Height)) / S * S;
+    Aligned->right = Clamp((Clamp(Rect->right, 0, static_cast<LONG>(Width)) + S - 1) / S * S, 0, static_cast<LONG>(Width / Scale * Scale));
+    Aligned->bottom = Clamp((Clamp(Rect->bottom, 0, static_cast<LONG>(Height)) + S - 1) / S * S, 0, static_cast<LONG>(Height / Scale * Scale));
+
+    return (Aligned->right > Aligned->left) && (Aligned->bottom > Aligned->top);
+}
+
+//
+// Mip level of the desktop the periphery is sampled from
+//
+UINT GetFoveationLevel(const FOVEATION_OPTIONS* Options)
+{
+    UINT Level = 0;
+    while ((1u << Level) < Options->Scale)
+    {
+        ++Level;
+    }
+    return Level;
+}
@@ -0,0 +1,44 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _FOVEATION_H_
+#define _FOVEATION_H_
+
+#include "Platform.h"
+
+//
+// Where the sharp region of the headset view is
+//
+typedef enum
+{
+    FOVEATION_OFF       = 0,    // Everything at full resolution
+    FOVEATION_CENTER    = 1,    // Around the center of the virtual screen
+    FOVEATION_POINTER   = 2     // Around the pointer, our best guess at where the user looks
+} FOVEATION_MODE;
+
+#define FOVEATION_DEFAULT_SCALE     4
+#define FOVEATION_DEFAULT_PERCENT   40
+
+// The fovea moves in steps of this many desktop pixels so it does not shimmer with small pointer moves
+#define FOVEATION_GRANULARITY       64
+
+typedef struct _FOVEATION_OPTIONS
+{
+    FOVEATION_MODE Mode;
+
+    // Downscale factor of the peripheral copy on each axis, 2 or 4. The copy is this mip level of the desktop.
+    UINT Scale;
+
+    // Size of the sharp region on each axis, in percent of the desktop
+    UINT FoveaPercent;
+} FOVEATION_OPTIONS;
+
+void GetFoveaRect(const FOVEATION_OPTIONS* Options, UINT Width, UINT Height, POINT Pointer, RECT* Fovea);
+bool AlignToScale(const RECT* Rect, UINT Scale, UINT Width, UINT Height, RECT* Aligned);
+UINT GetFoveationLevel(const FOVEATION_OPTIONS* Options);
+
+#endif
@@ -0,0 +1,148 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "FrameArena.h"
+
+#include <new>
+
+// Room in front of an overflow allocation for the list link, keeps the payload aligned
+#define OVERFLOW_HEADER_SIZE FRAMEARENA_ALIGNMENT
+
+static size_t AlignUp(size_t Value, size_t Alignment)
+{
+    return (Value + Alignment - 1) & ~(Alignment - 1);
+}
+
+FRAMEARENA::FRAMEARENA() : m_Block(nullptr),
+                           m_Capacity(0),
+                           m_Used(0),
+                           m_FrameBytes(0),
+                           m_HighWater(0),
+                           m_Overflow(nullptr)
+{
+}
+
+FRAMEARENA::~FRAMEARENA()
+{
+    Clean();
+}
+
+//
+// Optionally reserve space up front, otherwise the arena sizes itself over the first frames
+//
+bool FRAMEARENA::Initialize(size_t Capacity)
+{
+    Clean();
+
+    Capacity = AlignUp(Capacity, FRAMEARENA_GRANULARITY);
+    m_Block = new (std::nothrow) BYTE[Capacity];
+    if (!m_Block)
+    {
+        return false;
+    }
+    m_Capacity = Capacity;
+
+    return true;
+}
+
+//
+// Returns Size bytes valid until the next Reset(), or nullptr when out of memory.
+// Alignment must be a power of two.
+//
+void* FRAMEARENA::Alloc(size_t Size, size_t Alignment)
+{
+    // Account for the worst case padding so the high-water mark is enough to hold the same frame again
+    m_FrameBytes += Size + Alignment - 1;
+
+    size_t Offset = AlignUp(reinterpret_cast<size_t>(m_Block) + m_Used, Alignment) - reinterpret_cast<size_t>(m_Block);
+    if (m_Block && Offset + Size <= m_Capacity)
+    {
+        m_Used = Offset + Size;
+        return m_Block + Offset;
+    }
+
+    // Does not fit, serve it from the heap until the next Reset() makes room
+    BYTE* Block = new (std::nothrow) BYTE[OVERFLOW_HEADER_SIZE + Size + Alignment - 1];
+    if (!Block)
+    {
+        return nullptr;
+    }
+
+    OVERFLOW_BLOCK* Link = reinterpret_cast<OVERFLOW_BLOCK*>(Block);
+    Link->Next = m_Overflow;
+    m_Overflow = Link;
+
+    return reinterpret_cast<void*>(AlignUp(reinterpret_cast<size_t>(Block + OVERFLOW_HEADER_SIZE), Alignment));
+}
+
+//
+// Release everything allocated this frame, growing the arena if the frame did not fit
+//
+void FRAMEARENA::Reset()
+{
+    if (m_FrameBytes > m_HighWater)
+    {
+        m_HighWater = m_FrameBytes;
+    }
+
+    if (m_Overflow)
+    {
+        FreeOverflow();
+
+        // Grow with some headroom so a slowly rising high-water mark does not reallocate every frame
+        size_t NewCapacity = AlignUp(m_HighWater + m_HighWater / 2, FRAMEARENA_GRANULARITY);
+        BYTE* NewBlock = new (std::nothrow) BYTE[NewCapacity];
+        if (NewBlock)
+        {
+            delete [] m_Block;
+            m_Block = NewBlock;
+            m_Capacity = NewCapacity;
+        }
+    }
+
+    m_Used = 0;
+    m_FrameBytes = 0;
+}
+
+size_t FRAMEARENA::GetCapacity()
+{
+    return m_Capacity;
+}
+
+size_t FRAMEARENA::GetHighWater()
+{
+    return m_HighWater;
+}
+
+//
+// Free all memory
+//
+void FRAMEARENA::Clean()
+{
+    FreeOverflow();
+
+    if (m_Block)
+    {
+        delete [] m_Block;
+        m_Block = nullptr;
+    }
+
+    m_Capacity = 0;
+    m_Used = 0;
+    m_FrameBytes = 0;
+    m_HighWater = 0;
+}
+
+void FRAMEARENA::FreeOverflow()
+{
+    while (m_Overflow)
+    {
+        OVERFLOW_BLOCK* Next = m_Overflow->Next;
+        delete [] reinterpret_cast<BYTE*>(m_Overflow);
+        m_Overflow = Next;
+    }
+}
@@ -0,0 +1,61 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _FRAMEARENA_H_
+#define _FRAMEARENA_H_
+
+#include "Platform.h"
+
+#define FRAMEARENA_ALIGNMENT 16
+#define FRAMEARENA_GRANULARITY (64 * 1024)
+
+//
+// Bump allocator for CPU data that only lives for one frame (metadata, vertices, pointer pixels).
+// Everything handed out is released at once by Reset(). When a frame needs more than the arena holds
+// the extra requests are served from the heap, and the next Reset() grows the arena to the high-water
+// mark so that steady state frames never touch the heap. One arena is owned by one thread.
+//
+class FRAMEARENA
+{
+    public:
+        FRAMEARENA();
+        ~FRAMEARENA();
+        bool Initialize(size_t Capacity);
+        void* Alloc(size_t Size, size_t Alignment = FRAMEARENA_ALIGNMENT);
+        void Reset();
+        size_t GetCapacity();
+        size_t GetHighWater();
+        void Clean();
+
+        template <typename T>
+        T* AllocArray(size_t Count)
+        {
+            return static_cast<T*>(Alloc(sizeof(T) * Count, (alignof(T) > FRAMEARENA_ALIGNMENT) ? alignof(T) : FRAMEARENA_ALIGNMENT));
+        }
+
+    private:
+    // methods
+        void FreeOverflow();
+
+    // variables
+        BYTE* m_Block;
+        size_t m_Capacity;
+        size_t m_Used;
+
+        // Bytes requested this frame, including what did not fit
+        size_t m_FrameBytes;
+        size_t m_HighWater;
+
+        // Heap blocks for requests that did not fit, freed on Reset()
+        struct OVERFLOW_BLOCK
+        {
+            OVERFLOW_BLOCK* Next;
+        };
+        OVERFLOW_BLOCK* m_Overflow;
+};
+
+#endif
@@ -0,0 +1,169 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <string.h>
+
+#include "FrameGovernor.h"
+
+static const char* LevelNames[GOVERNOR_LEVEL_COUNT] = {"Full", "StaticCursor", "DeferOutputs", "CoarseDirty", "NoFilter"};
+
+const char* GetGovernorLevelName(GOVERNOR_LEVEL Level)
+{
+    return (Level < GOVERNOR_LEVEL_COUNT) ? LevelNames[Level] : "Unknown";
+}
+
+FRAMEGOVERNOR::FRAMEGOVERNOR() : m_Level(GOVERNOR_LEVEL_FULL),
+                                 m_PeriodNs(0),
+                                 m_BudgetNs(0),
+                                 m_Started(false),
+                                 m_SmoothedNs(0),
+                                 m_GpuNs(0),
+                                 m_OverFrames(0),
+                                 m_UnderFrames(0),
+                                 m_SettleFrames(0)
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+//
+// Start over at full quality for a headset refreshing every PeriodNs, whose frames must be done within BudgetNs
+// of the presenter waking. Without a budget nothing is ever shed.
+//
+void FRAMEGOVERNOR::Initialize(uint64_t PeriodNs, uint64_t BudgetNs)
+{
+    m_Level = GOVERNOR_LEVEL_FULL;
+    m_PeriodNs = PeriodNs;
+    m_BudgetNs = BudgetNs;
+    m_Started = false;
+    m_SmoothedNs = 0;
+    m_GpuNs = 0;
+    m_OverFrames = 0;
+    m_UnderFrames = 0;
+    m_SettleFrames = 0;
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+//
+// The headset switched to another refresh rate, the level and budget stay
+//
+void FRAMEGOVERNOR::SetPeriod(uint64_t PeriodNs)
+{
+    m_PeriodNs = PeriodNs;
+}
+
+//
+// Account for one presented frame and return the level the next one runs at
+//
+GOVERNOR_LEVEL FRAMEGOVERNOR::AddFrame(const GOVERNOR_SAMPLE* Sample)
+{
+    UINT Level = m_Level.load(std::memory_order_relaxed);
+    if (!m_BudgetNs)
+    {
+        return static_cast<GOVERNOR_LEVEL>(Level);
+    }
+
+    // The presenter is late when either its CPU or its GPU work is
+    if (Sample->HasGpu)
+    {
+        m_GpuNs = Sample->GpuNs;
+    }
+    uint64_t LoadNs = (Sample->CpuNs > m_GpuNs) ? Sample->CpuNs : m_GpuNs;
+    m_SmoothedNs = m_Started ? (m_SmoothedNs * 3 + LoadNs) / 4 : LoadNs;
+    m_Started = true;
+
+    bool Missed = LoadNs > m_BudgetNs;
+    ++m_Stats.Frames;
+    m_Stats.OverBudget += Missed ? 1 : 0;
+    ++m_Stats.FramesAtLevel[Level];
+
+    // The last change has not shown in the timings yet
+    if (m_SettleFrames)
+    {
+        --m_SettleFrames;
+        return static_cast<GOVERNOR_LEVEL>(Level);
+    }
+
+    if (Missed || m_SmoothedNs * 100 > m_BudgetNs * GOVERNOR_SHED_PERCENT)
+    {
+        ++m_OverFrames;
+        m_UnderFrames = 0;
+    }
+    else if (m_SmoothedNs * 100 < m_BudgetNs * GOVERNOR_RESTORE_PERCENT)
+    {
+        ++m_UnderFrames;
+        m_OverFrames = 0;
+    }
+    else
+    {
+        m_OverFrames = 0;
+        m_UnderFrames = 0;
+    }
+
+    if (m_OverFrames >= GOVERNOR_SHED_FRAMES && Level + 1 < GOVERNOR_LEVEL_COUNT)
+    {
+        ++Level;
+        ++m_Stats.Sheds;
+    }
+    else if (m_UnderFrames >= GOVERNOR_RESTORE_FRAMES && Level > GOVERNOR_LEVEL_FULL)
+    {
+        --Level;
+        ++m_Stats.Restores;
+    }
+    else
+    {
+        return static_cast<GOVERNOR_LEVEL>(Level);
+    }
+
+    m_Level.store(Level, std::memory_order_relaxed);
+    m_OverFrames = 0;
+    m_UnderFrames = 0;
+    m_SettleFrames = GOVERNOR_SETTLE_FRAMES;
+    return static_cast<GOVERNOR_LEVEL>(Level);
+}
+
+GOVERNOR_LEVEL FRAMEGOVERNOR::GetLevel() const
+{
+    return static_cast<GOVERNOR_LEVEL>(m_Level.load(std::memory_order_relaxed));
+}
+
+bool FRAMEGOVERNOR::RefreshesCursorShape() const
+{
+    return GetLevel() < GOVERNOR_LEVEL_STATIC_CURSOR;
+}
+
+bool FRAMEGOVERNOR::CopiesFullFrames() const
+{
+    return GetLevel() >= GOVERNOR_LEVEL_COARSE_DIRTY;
+}
+
+bool FRAMEGOVERNOR::FiltersFrames() const
+{
+    return GetLevel() < GOVERNOR_LEVEL_NO_FILTER;
+}
+
+//
+// Least time between two captures of an output, zero when it is captured whenever it changes
+//
+uint64_t FRAMEGOVERNOR::GetCaptureIntervalNs(bool PointerOnOutput) const
+{
+    GOVERNOR_LEVEL Level = GetLevel();
+    if (Level >= GOVERNOR_LEVEL_COARSE_DIRTY || (Level >= GOVERNOR_LEVEL_DEFER_OUTPUTS && !PointerOnOutput))
+    {
+        return m_PeriodNs.load(std::memory_order_relaxed) * GOVERNOR_RATE_DIVIDER;
+    }
+    return 0;
+}
+
+void FRAMEGOVERNOR::GetStats(GOVERNOR_STATS* Stats) const
+{
+    *Stats = m_Stats;
+}
+
+void FRAMEGOVERNOR::ResetStats()
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
@@ -0,0 +1,114 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _FRAMEGOVERNOR_H_
+#define _FRAMEGOVERNOR_H_
+
+#include <atomic>
+
+#include "Platform.h"
+
+//
+// How much work is shed, each level sheds what the ones before it do and more
+//
+typedef enum
+{
+    GOVERNOR_LEVEL_FULL             = 0,    // Everything at full rate and quality
+    GOVERNOR_LEVEL_STATIC_CURSOR    = 1,    // New pointer shapes are held back until the level drops
+    GOVERNOR_LEVEL_DEFER_OUTPUTS    = 2,    // Outputs the pointer is not on are captured at a reduced rate
+    GOVERNOR_LEVEL_COARSE_DIRTY     = 3,    // Every output is captured at a reduced rate, as one copy of the whole frame
+    GOVERNOR_LEVEL_NO_FILTER        = 4,    // No mip levels are rebuilt and the headset is sampled bilinearly
+    GOVERNOR_LEVEL_COUNT            = 5
+} GOVERNOR_LEVEL;
+
+// A frame sheds work when its smoothed load is above this much of the budget, or it missed the budget outright
+#define GOVERNOR_SHED_PERCENT 90
+
+// And can have it back when its smoothed load is below this much, in between nothing changes
+#define GOVERNOR_RESTORE_PERCENT 60
+
+// Frames in a row over or under before a level is shed or restored, shedding is quick and restoring slow
+#define GOVERNOR_SHED_FRAMES 3
+#define GOVERNOR_RESTORE_FRAMES 180
+
+// Frames after a change before the next is considered. GPU timings arrive PROFILE_LATENCY frames late, so this
+// is long enough for them to show the effect of the change.
+#define GOVERNOR_SETTLE_FRAMES 8
+
+// Outputs captured at a reduced rate are captured at the refresh rate divided by this
+#define GOVERNOR_RATE_DIVIDER 3
+
+//
+// Cost of one presented frame, in nanoseconds
+//
+typedef struct _GOVERNOR_SAMPLE
+{
+    // Presenter wake to submit
+    uint64_t CpuNs;
+
+    // Issue to completion of the presenter's GPU work, queueing behind other work on the GPU included. GPU
+    // timings come in late and not every frame, without one the last is assumed to still hold.
+    uint64_t GpuNs;
+    bool HasGpu;
+} GOVERNOR_SAMPLE;
+
+//
+// What the governor did since the stats were last reset
+//
+typedef struct _GOVERNOR_STATS
+{
+    UINT Frames;
+    UINT OverBudget;
+    UINT Sheds;
+    UINT Restores;
+    UINT FramesAtLevel[GOVERNOR_LEVEL_COUNT];
+} GOVERNOR_STATS;
+
+const char* GetGovernorLevelName(GOVERNOR_LEVEL Level);
+
+//
+// Watches the cost of each presented frame against the budget the presenter has before v-blank, and sheds work
+// one level at a time while frames run over it. Levels come back one at a time with hysteresis: the load has to
+// stay well under the budget for a good while. Decisions depend on the samples alone, in integer arithmetic, so
+// a replayed trace of samples always gives the same levels.
+//
+// Samples are added and stats read on the presenter thread, the level can be read from any thread.
+//
+class FRAMEGOVERNOR
+{
+    public:
+        FRAMEGOVERNOR();
+        void Initialize(uint64_t PeriodNs, uint64_t BudgetNs);
+        void SetPeriod(uint64_t PeriodNs);
+        GOVERNOR_LEVEL AddFrame(const GOVERNOR_SAMPLE* Sample);
+        GOVERNOR_LEVEL GetLevel() const;
+        bool RefreshesCursorShape() const;
+        bool CopiesFullFrames() const;
+        bool FiltersFrames() const;
+        uint64_t GetCaptureIntervalNs(bool PointerOnOutput) const;
+        void GetStats(GOVERNOR_STATS* Stats) const;
+        void ResetStats();
+
+    private:
+    // variables
+        std::atomic<UINT> m_Level;
+        std::atomic<uint64_t> m_PeriodNs;
+        uint64_t m_BudgetNs;
+
+        // Load smoothed over the last few frames, and the last GPU cost seen
+        bool m_Started;
+        uint64_t m_SmoothedNs;
+        uint64_t m_GpuNs;
+
+        UINT m_OverFrames;
+        UINT m_UnderFrames;
+        UINT m_SettleFrames;
+
+        GOVERNOR_STATS m_Stats;
+};
+
+#endif
@@ -0,0 +1,596 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <string.h>
+
+#include "FrameLog.h"
+
+// Records and the index start on 8 byte boundaries
+static uint64_t AlignRecord(uint64_t Offset)
+{
+    return (Offset + 7) & ~7ull;
+}
+
+//
+// Size of the tile at Column, Row, the last column and row are cut by the frame
+//
+static void GetTileSize(UINT FrameWidth, UINT FrameHeight, UINT Column, UINT Row, UINT* Width, UINT* Height)
+{
+    UINT Left = Column * TILE_SIZE;
+    UINT Top = Row * TILE_SIZE;
+    *Width = (Left + TILE_SIZE < FrameWidth) ? TILE_SIZE : FrameWidth - Left;
+    *Height = (Top + TILE_SIZE < FrameHeight) ? TILE_SIZE : FrameHeight - Top;
+}
+
+FRAMELOGWRITER::FRAMELOGWRITER() : m_End(0),
+                                   m_Record(0),
+                                   m_Keyframe(0),
+                                   m_Index(nullptr),
+                                   m_IndexCount(0),
+                                   m_IndexCapacity(0),
+                                   m_Pixels(nullptr)
+{
+    memset(&m_RecordHeader, 0, sizeof(m_RecordHeader));
+}
+
+FRAMELOGWRITER::~FRAMELOGWRITER()
+{
+    Clean();
+}
+
+//
+// Create the log, an existing file at Path is replaced
+//
+bool FRAMELOGWRITER::Create(const char* Path)
+{
+    Clean();
+
+    m_Pixels = new (std::nothrow) BYTE[TILE_SIZE * TILE_SIZE * 4];
+    if (!m_Pixels || !m_File.Create(Path, FRAMELOG_GROWTH))
+    {
+        Clean();
+        return false;
+    }
+
+    FRAMELOG_HEADER* Header = GetHeader();
+    memset(Header, 0, sizeof(FRAMELOG_HEADER));
+    Header->Magic = FRAMELOG_MAGIC;
+    Header->Version = FRAMELOG_VERSION;
+    Header->TileSize = TILE_SIZE;
+    m_End = AlignRecord(sizeof(FRAMELOG_HEADER));
+    Header->DataEnd = m_End;
+
+    return true;
+}
+
+void FRAMELOGWRITER::Clean()
+{
+    m_File.Clean();
+    if (m_Index)
+    {
+        delete [] m_Index;
+        m_Index = nullptr;
+    }
+    if (m_Pixels)
+    {
+        delete [] m_Pixels;
+        m_Pixels = nullptr;
+    }
+    m_IndexCount = 0;
+    m_IndexCapacity = 0;
+    m_End = 0;
+    m_Record = 0;
+    m_Keyframe = 0;
+}
+
+FRAMELOG_HEADER* FRAMELOGWRITER::GetHeader()
+{
+    return reinterpret_cast<FRAMELOG_HEADER*>(m_File.GetBits());
+}
+
+//
+// Make room for Size more bytes past the end, growing the mapping when needed
+//
+bool FRAMELOGWRITER::Reserve(uint64_t Size)
+{
+    if (m_End + Size <= m_File.GetSize())
+    {
+        return true;
+    }
+
+    uint64_t NewSize = m_File.GetSize() + FRAMELOG_GROWTH;
+    while (NewSize < m_End + Size)
+    {
+        NewSize += FRAMELOG_GROWTH;
+    }
+    return m_File.Resize(NewSize);
+}
+
+//
+// Start a record, its tiles follow with AddTile. A delta builds on the last keyframe written.
+//
+bool FRAMELOGWRITER::BeginRecord(FRAMELOG_RECORD_TYPE Type, UINT Width, UINT Height, uint64_t Timestamp, UINT Dropped)
+{
+    uint64_t Record = AlignRecord(m_End);
+    if (!m_File.GetBits() || !Reserve(Record - m_End + sizeof(FRAMELOG_RECORD)))
+    {
+        return false;
+    }
+
+    m_Record = Record;
+    if (Type == FRAMELOG_KEYFRAME)
+    {
+        m_Keyframe = Record;
+    }
+
+    memset(&m_RecordHeader, 0, sizeof(m_RecordHeader));
+    m_RecordHeader.Magic = FRAMELOG_RECORD_MAGIC;
+    m_RecordHeader.Type = static_cast<uint16_t>(Type);
+    m_RecordHeader.Width = Width;
+    m_RecordHeader.Height = Height;
+    m_RecordHeader.Dropped = Dropped;
+    m_RecordHeader.Timestamp = Timestamp;
+    m_RecordHeader.Keyframe = m_Keyframe;
+    m_End = Record + sizeof(FRAMELOG_RECORD);
+    return true;
+}
+
+//
+// Append the tile at Column, Row of Frame to the record
+//
+bool FRAMELOGWRITER::AddTile(const SOFTWARE_SURFACE* Frame, UINT Column, UINT Row)
+{
+    UINT Width;
+    UINT Height;
+    GetTileSize(Frame->Width, Frame->Height, Column, Row, &Width, &Height);
+    UINT RawSize = Width * Height * 4;
+    if (!Reserve(sizeof(FRAMELOG_TILE) + RawSize + m_Codec.GetMaxEncodedSize(Width, Height)))
+    {
+        return false;
+    }
+
+    for (UINT Y = 0; Y < Height; ++Y)
+    {
+        memcpy(m_Pixels + static_cast<size_t>(Y) * Width * 4, Frame->Bits + static_cast<size_t>(Row * TILE_SIZE + Y) * Frame->Pitch + Column * TILE_SIZE * 4, Width * 4);
+    }
+
+    FRAMELOG_TILE Tile;
+    memset(&Tile, 0, sizeof(Tile));
+    Tile.Column = static_cast<uint16_t>(Column);
+    Tile.Row = static_cast<uint16_t>(Row);
+    BYTE* Data = m_File.GetBits() + m_End + sizeof(FRAMELOG_TILE);
+    UINT Size = m_Codec.Encode(m_Pixels, Width, Height, Data, RawSize);
+    if (Size && Size < RawSize)
+    {
+        Tile.Codec = TILE_CODEC_LZ4;
+    }
+    else
+    {
+        Tile.Codec = TILE_CODEC_RAW;
+        memcpy(Data, m_Pixels, RawSize);
+        Size = RawSize;
+    }
+    Tile.Size = Size;
+    memcpy(m_File.GetBits() + m_End, &Tile, sizeof(Tile));
+
+    m_End += sizeof(FRAMELOG_TILE) + Size;
+    ++m_RecordHeader.TileCount;
+    return true;
+}
+
+//
+// Write the record header and move the end of the log past the record
+//
+bool FRAMELOGWRITER::EndRecord()
+{
+    m_RecordHeader.Size = m_End - m_Record - sizeof(FRAMELOG_RECORD);
+    memcpy(m_File.GetBits() + m_Record, &m_RecordHeader, sizeof(FRAMELOG_RECORD));
+    GetHeader()->DataEnd = m_End;
+
+    if (m_RecordHeader.Type != FRAMELOG_KEYFRAME)
+    {
+        return true;
+    }
+
+    if (m_IndexCount == m_IndexCapacity)
+    {
+        UINT Capacity = m_IndexCapacity ? m_IndexCapacity * 2 : 256;
+        FRAMELOG_INDEX_ENTRY* Index = new (std::nothrow) FRAMELOG_INDEX_ENTRY[Capacity];
+        if (!Index)
+        {
+            return false;
+        }
+        if (m_Index)
+        {
+            memcpy(Index, m_Index, m_IndexCount * sizeof(FRAMELOG_INDEX_ENTRY));
+            delete [] m_Index;
+        }
+        m_Index = Index;
+        m_IndexCapacity = Capacity;
+    }
+    m_Index[m_IndexCount].Timestamp = m_RecordHeader.Timestamp;
+    m_Index[m_IndexCount].Offset = m_Record;
+    ++m_IndexCount;
+    return true;
+}
+
+//
+// Write every tile of Frame as a keyframe
+//
+bool FRAMELOGWRITER::WriteKeyframe(const SOFTWARE_SURFACE* Frame, uint64_t Timestamp, UINT Dropped)
+{
+    if (!BeginRecord(FRAMELOG_KEYFRAME, Frame->Width, Frame->Height, Timestamp, Dropped))
+    {
+        return false;
+    }
+
+    UINT Columns = (Frame->Width + TILE_SIZE - 1) / TILE_SIZE;
+    UINT Rows = (Frame->Height + TILE_SIZE - 1) / TILE_SIZE;
+    for (UINT Row = 0; Row < Rows; ++Row)
+    {
+        for (UINT Column = 0; Column < Columns; ++Column)
+        {
+            if (!AddTile(Frame, Column, Row))
+            {
+                return false;
+            }
+        }
+    }
+
+    return EndRecord();
+}
+
+uint64_t FRAMELOGWRITER::GetSize()
+{
+    return m_End;
+}
+
+//
+// Append the keyframe index and cut the file to what was written
+//
+void FRAMELOGWRITER::Close()
+{
+    if (!m_File.GetBits())
+    {
+        return;
+    }
+
+    uint64_t IndexOffset = AlignRecord(GetHeader()->DataEnd);
+    uint64_t IndexSize = static_cast<uint64_t>(m_IndexCount) * sizeof(FRAMELOG_INDEX_ENTRY);
+    m_End = GetHeader()->DataEnd;
+    if (m_IndexCount && Reserve(IndexOffset - m_End + IndexSize))
+    {
+        memcpy(m_File.GetBits() + IndexOffset, m_Index, static_cast<size_t>(IndexSize));
+        FRAMELOG_HEADER* Header = GetHeader();
+        Header->IndexOffset = IndexOffset;
+        Header->IndexCount = m_IndexCount;
+        m_End = IndexOffset + IndexSize;
+    }
+
+    m_File.Close(m_End);
+    Clean();
+}
+
+FRAMELOGREADER::FRAMELOGREADER() : m_DataEnd(0),
+                                   m_Index(nullptr),
+                                   m_IndexCount(0),
+                                   m_IndexOwned(false),
+                                   m_LastTimestamp(0),
+                                   m_FrameTimestamp(0),
+                                   m_Keyframe(0),
+                                   m_Next(0),
+                                   m_Pixels(nullptr)
+{
+    memset(&m_Frame, 0, sizeof(m_Frame));
+}
+
+FRAMELOGREADER::~FRAMELOGREADER()
+{
+    Clean();
+}
+
+//
+// Map the log and find its keyframes. Logs still being written, or cut short, read up to their last
+// complete record.
+//
+bool FRAMELOGREADER::Open(const char* Path)
+{
+    Clean();
+
+    if (!m_File.Open(Path) || m_File.GetSize() < sizeof(FRAMELOG_HEADER))
+    {
+        Clean();
+        return false;
+    }
+
+    const FRAMELOG_HEADER* Header = reinterpret_cast<const FRAMELOG_HEADER*>(m_File.GetBits());
+    if (Header->Magic != FRAMELOG_MAGIC || Header->Version != FRAMELOG_VERSION || Header->TileSize != TILE_SIZE || Header->DataEnd > m_File.GetSize())
+    {
+        Clean();
+        return false;
+    }
+    m_DataEnd = Header->DataEnd;
+
+    m_Pixels = new (std::nothrow) BYTE[TILE_SIZE * TILE_SIZE * 4];
+    if (!m_Pixels)
+    {
+        Clean();
+        return false;
+    }
+
+    if (Header->IndexOffset && Header->IndexOffset + Header->IndexCount * sizeof(FRAMELOG_INDEX_ENTRY) <= m_File.GetSize())
+    {
+        m_Index = reinterpret_cast<FRAMELOG_INDEX_ENTRY*>(m_File.GetBits() + Header->IndexOffset);
+        m_IndexCount = static_cast<UINT>(Header->IndexCount);
+    }
+    else if (!BuildIndex())
+    {
+        Clean();
+        return false;
+    }
+    if (!m_IndexCount)
+    {
+        Clean();
+        return false;
+    }
+
+    // The last frame is at most one keyframe interval past the last keyframe
+    uint64_t Offset = m_Index[m_IndexCount - 1].Offset;
+    const FRAMELOG_RECORD* Record;
+    while ((Record = GetRecord(Offset)) != nullptr)
+    {
+        m_LastTimestamp = Record->Timestamp;
+        Offset = AlignRecord(Offset + sizeof(FRAMELOG_RECORD) + Record->Size);
+    }
+
+    return true;
+}
+
+void FRAMELOGREADER::Clean()
+{
+    if (m_Index && m_IndexOwned)
+    {
+        delete [] m_Index;
+    }
+    m_Index = nullptr;
+    m_IndexOwned = false;
+    m_IndexCount = 0;
+
+    if (m_Frame.Bits)
+    {
+        delete [] m_Frame.Bits;
+    }
+    memset(&m_Frame, 0, sizeof(m_Frame));
+
+    if (m_Pixels)
+    {
+        delete [] m_Pixels;
+        m_Pixels = nullptr;
+    }
+
+    m_File.Clean();
+    m_DataEnd = 0;
+    m_LastTimestamp = 0;
+    m_FrameTimestamp = 0;
+    m_Keyframe = 0;
+    m_Next = 0;
+}
+
+//
+// Record at Offset, nullptr past the last complete record or when it does not look like one
+//
+const FRAMELOG_RECORD* FRAMELOGREADER::GetRecord(uint64_t Offset)
+{
+    if (Offset + sizeof(FRAMELOG_RECORD) > m_DataEnd)
+    {
+        return nullptr;
+    }
+
+    const FRAMELOG_RECORD* Record = reinterpret_cast<const FRAMELOG_RECORD*>(m_File.GetBits() + Offset);
+    if (Record->Magic != FRAMELOG_RECORD_MAGIC || Record->Size > m_DataEnd - Offset - sizeof(FRAMELOG_RECORD))
+    {
+        return nullptr;
+    }
+    return Record;
+}
+
+//
+// Walk the records for the keyframes of a log that was not closed
+//
+bool FRAMELOGREADER::BuildIndex()
+{
+    UINT Count = 0;
+    uint64_t Offset = AlignRecord(sizeof(FRAMELOG_HEADER));
+    const FRAMELOG_RECORD* Record;
+    while ((Record = GetRecord(Offset)) != nullptr)
+    {
+        Count += (Record->Type == FRAMELOG_KEYFRAME) ? 1 : 0;
+        Offset = AlignRecord(Offset + sizeof(FRAMELOG_RECORD) + Record->Size);
+    }
+
+    m_Index = new (std::nothrow) FRAMELOG_INDEX_ENTRY[Count ? Count : 1];
+    if (!m_Index)
+    {
+        return false;
+    }
+    m_IndexOwned = true;
+
+    Offset = AlignRecord(sizeof(FRAMELOG_HEADER));
+    while ((Record = GetRecord(Offset)) != nullptr)
+    {
+        if (Record->Type == FRAMELOG_KEYFRAME)
+        {
+            m_Index[m_IndexCount].Timestamp = Record->Timestamp;
+            m_Index[m_IndexCount].Offset = Offset;
+            ++m_IndexCount;
+        }
+        Offset = AlignRecord(Offset + sizeof(FRAMELOG_RECORD) + Record->Size);
+    }
+
+    return true;
+}
+
+UINT FRAMELOGREADER::GetKeyframeCount()
+{
+    return m_IndexCount;
+}
+
+uint64_t FRAMELOGREADER::GetFirstTimestamp()
+{
+    return m_IndexCount ? m_Index[0].Timestamp : 0;
+}
+
+uint64_t FRAMELOGREADER::GetLastTimestamp()
+{
+    return m_LastTimestamp;
+}
+
+bool FRAMELOGREADER::Resize(UINT Width, UINT Height)
+{
+    if (m_Frame.Bits && m_Frame.Width == Width && m_Frame.Height == Height)
+    {
+        return true;
+    }
+
+    if (m_Frame.Bits)
+    {
+        delete [] m_Frame.Bits;
+    }
+    m_Frame.Bits = new (std::nothrow) BYTE[static_cast<size_t>(Width) * Height * 4];
+    if (!m_Frame.Bits)
+    {
+        memset(&m_Frame, 0, sizeof(m_Frame));
+        return false;
+    }
+    m_Frame.Width = Width;
+    m_Frame.Height = Height;
+    m_Frame.Pitch = Width * 4;
+    return true;
+}
+
+//
+// Decode the tiles of a record onto the frame
+//
+bool FRAMELOGREADER::ApplyRecord(const FRAMELOG_RECORD* Record)
+{
+    if (Record->Width != m_Frame.Width || Record->Height != m_Frame.Height)
+    {
+        return false;
+    }
+
+    UINT Columns = (m_Frame.Width + TILE_SIZE - 1) / TILE_SIZE;
+    UINT Rows = (m_Frame.Height + TILE_SIZE - 1) / TILE_SIZE;
+    const BYTE* Data = reinterpret_cast<const BYTE*>(Record + 1);
+    const BYTE* End = Data + Record->Size;
+    for (UINT i = 0; i < Record->TileCount; ++i)
+    {
+        FRAMELOG_TILE Tile;
+        if (static_cast<size_t>(End - Data) < sizeof(Tile))
+        {
+            return false;
+        }
+        memcpy(&Tile, Data, sizeof(Tile));
+        Data += sizeof(Tile);
+        if (Tile.Column >= Columns || Tile.Row >= Rows || Tile.Size > static_cast<size_t>(End - Data))
+        {
+            return false;
+        }
+
+        UINT Width;
+        UINT Height;
+        GetTileSize(m_Frame.Width, m_Frame.Height, Tile.Column, Tile.Row, &Width, &Height);
+        UINT RawSize = Width * Height * 4;
+        if (Tile.Codec == TILE_CODEC_RAW)
+        {
+            if (Tile.Size != RawSize)
+            {
+                return false;
+            }
+            memcpy(m_Pixels, Data, RawSize);
+        }
+        else if (Tile.Codec != TILE_CODEC_LZ4 || !m_Codec.Decode(Data, Tile.Size, Width, Height, m_Pixels))
+        {
+            return false;
+        }
+
+        for (UINT Y = 0; Y < Height; ++Y)
+        {
+            memcpy(m_Frame.Bits + static_cast<size_t>(Tile.Row * TILE_SIZE + Y) * m_Frame.Pitch + Tile.Column * TILE_SIZE * 4, m_Pixels + static_cast<size_t>(Y) * Width * 4, Width * 4);
+        }
+        Data += Tile.Size;
+    }
+
+    return true;
+}
+
+//
+// Rebuild the frame shown at Timestamp: the last record at or before it. Times before the first keyframe
+// give the first keyframe.
+//
+bool FRAMELOGREADER::Seek(uint64_t Timestamp)
+{
+    if (!m_IndexCount)
+    {
+        return false;
+    }
+
+    // Last keyframe at or before the time
+    UINT Low = 0;
+    UINT High = m_IndexCount;
+    while (High - Low > 1)
+    {
+        UINT Middle = (Low + High) / 2;
+        if (m_Index[Middle].Timestamp <= Timestamp)
+        {
+            Low = Middle;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+    uint64_t Keyframe = m_Index[Low].Offset;
+
+    // Seeking forward within the same keyframe carries on from the current frame
+    if (!m_Frame.Bits || Keyframe != m_Keyframe || Timestamp < m_FrameTimestamp)
+    {
+        const FRAMELOG_RECORD* Record = GetRecord(Keyframe);
+        if (!Record || Record->Type != FRAMELOG_KEYFRAME || !Resize(Record->Width, Record->Height) || !ApplyRecord(Record))
+        {
+            m_Keyframe = 0;
+            return false;
+        }
+        m_Keyframe = Keyframe;
+        m_FrameTimestamp = Record->Timestamp;
+        m_Next = AlignRecord(Keyframe + sizeof(FRAMELOG_RECORD) + Record->Size);
+    }
+
+    const FRAMELOG_RECORD* Record;
+    while ((Record = GetRecord(m_Next)) != nullptr && Record->Type == FRAMELOG_DELTA && Record->Timestamp <= Timestamp)
+    {
+        if (Record->Keyframe != m_Keyframe || !ApplyRecord(Record))
+        {
+            m_Keyframe = 0;
+            return false;
+        }
+        m_FrameTimestamp = Record->Timestamp;
+        m_Next = AlignRecord(m_Next + sizeof(FRAMELOG_RECORD) + Record->Size);
+    }
+
+    return true;
+}
+
+SOFTWARE_SURFACE* FRAMELOGREADER::GetFrame()
+{
+    return &m_Frame;
+}
+
+uint64_t FRAMELOGREADER::GetFrameTimestamp()
+{
+    return m_FrameTimestamp;
+}
@@ -0,0 +1,174 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _FRAMELOG_H_
+#define _FRAMELOG_H_
+
+#include "MappedFile.h"
+#include "SoftwareCompositor.h"
+#include "TileCodec.h"
+#include "TileDetector.h"
+
+// 'DDLG' at the start of the file, 'DDRC' at the start of every record
+#define FRAMELOG_MAGIC 0x474c4444
+#define FRAMELOG_RECORD_MAGIC 0x43524444
+#define FRAMELOG_VERSION 1
+
+// The file is mapped and grown in steps of this many bytes
+#define FRAMELOG_GROWTH (64 * 1024 * 1024)
+
+//
+// File format, little endian. The file header, then records back to back up to DataEnd, then the keyframe
+// index once the log is closed. A record is the record header followed by TileCount tiles, each a tile
+// header and Size bytes of data. Keyframes hold every tile of the frame, deltas the tiles that changed
+// since the record before.
+//
+typedef enum _FRAMELOG_RECORD_TYPE
+{
+    FRAMELOG_KEYFRAME = 0,
+    FRAMELOG_DELTA = 1,
+} FRAMELOG_RECORD_TYPE;
+
+typedef struct _FRAMELOG_HEADER
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t TileSize;
+    uint32_t Reserved;
+
+    // End of the last complete record, moved after every record so a log cut short by a crash still reads
+    uint64_t DataEnd;
+
+    // Keyframe index written on close, 0 while recording. Without it the reader scans the records.
+    uint64_t IndexOffset;
+    uint64_t IndexCount;
+} FRAMELOG_HEADER;
+
+typedef struct _FRAMELOG_RECORD
+{
+    uint32_t Magic;
+    uint16_t Type;
+    uint16_t Reserved;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t TileCount;
+
+    // Frames the recorder dropped since the record before, their changes are folded into this one
+    uint32_t Dropped;
+
+    // Capture time in nanoseconds
+    uint64_t Timestamp;
+
+    // Bytes of tiles after the record header
+    uint64_t Size;
+
+    // Offset of the keyframe this record builds on, its own offset for keyframes
+    uint64_t Keyframe;
+} FRAMELOG_RECORD;
+
+typedef struct _FRAMELOG_TILE
+{
+    uint16_t Column;
+    uint16_t Row;
+    uint8_t Codec;
+    uint8_t Reserved[3];
+    uint32_t Size;
+} FRAMELOG_TILE;
+
+typedef struct _FRAMELOG_INDEX_ENTRY
+{
+    uint64_t Timestamp;
+    uint64_t Offset;
+} FRAMELOG_INDEX_ENTRY;
+
+//
+// Appends records to a log through a memory mapping of the file. Tiles are LZ4 compressed, or kept raw
+// when that does not shrink them. Not thread safe, the recorder calls it from its writer thread only.
+//
+class FRAMELOGWRITER
+{
+    public:
+        FRAMELOGWRITER();
+        ~FRAMELOGWRITER();
+        bool Create(const char* Path);
+        bool BeginRecord(FRAMELOG_RECORD_TYPE Type, UINT Width, UINT Height, uint64_t Timestamp, UINT Dropped);
+        bool AddTile(const SOFTWARE_SURFACE* Frame, UINT Column, UINT Row);
+        bool EndRecord();
+        bool WriteKeyframe(const SOFTWARE_SURFACE* Frame, uint64_t Timestamp, UINT Dropped);
+        uint64_t GetSize();
+        void Close();
+        void Clean();
+
+    private:
+    // methods
+        bool Reserve(uint64_t Size);
+        FRAMELOG_HEADER* GetHeader();
+
+    // variables
+        MAPPEDFILE m_File;
+        LZ4TILECODEC m_Codec;
+        uint64_t m_End;
+
+        // Record being written
+        uint64_t m_Record;
+        FRAMELOG_RECORD m_RecordHeader;
+        uint64_t m_Keyframe;
+
+        // Keyframes written so far, appended to the file on close
+        FRAMELOG_INDEX_ENTRY* m_Index;
+        UINT m_IndexCount;
+        UINT m_IndexCapacity;
+
+        // Packed pixels of one tile
+        BYTE* m_Pixels;
+};
+
+//
+// Plays a log back from a read only mapping. Seeking goes to the last keyframe at or before the time and
+// applies the deltas after it, or carries on from the current frame when that is on the way.
+//
+class FRAMELOGREADER
+{
+    public:
+        FRAMELOGREADER();
+        ~FRAMELOGREADER();
+        bool Open(const char* Path);
+        UINT GetKeyframeCount();
+        uint64_t GetFirstTimestamp();
+        uint64_t GetLastTimestamp();
+        bool Seek(uint64_t Timestamp);
+        SOFTWARE_SURFACE* GetFrame();
+        uint64_t GetFrameTimestamp();
+        void Clean();
+
+    private:
+    // methods
+        bool BuildIndex();
+        const FRAMELOG_RECORD* GetRecord(uint64_t Offset);
+        bool ApplyRecord(const FRAMELOG_RECORD* Record);
+        bool Resize(UINT Width, UINT Height);
+
+    // variables
+        MAPPEDFILE m_File;
+        LZ4TILECODEC m_Codec;
+        uint64_t m_DataEnd;
+
+        FRAMELOG_INDEX_ENTRY* m_Index;
+        UINT m_IndexCount;
+        bool m_IndexOwned;
+        uint64_t m_LastTimestamp;
+
+        // Frame rebuilt so far, the keyframe it started from and the record after it
+        SOFTWARE_SURFACE m_Frame;
+        uint64_t m_FrameTimestamp;
+        uint64_t m_Keyframe;
+        uint64_t m_Next;
+
+        BYTE* m_Pixels;
+};
+
+#endif
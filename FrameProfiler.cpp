@@ -0,0 +1,371 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include "FrameProfiler.h"
+
+#define NS_PER_SECOND 1000000000ull
+
+static const char* PassNames[PROFILE_PASS_COUNT] = {"CopyMove", "CopyDirty", "ApplyRects", "DrawFrame", "DrawMouse", "Present", "Submit"};
+
+const char* GetProfilePassName(PROFILE_PASS Pass)
+{
+    return (Pass < PROFILE_PASS_COUNT) ? PassNames[Pass] : "Unknown";
+}
+
+PROFILETIMELINE::PROFILETIMELINE() : m_Events(nullptr),
+                                     m_Capacity(0),
+                                     m_Added(0)
+{
+    memset(m_Stats, 0, sizeof(m_Stats));
+    memset(m_Clocks, 0, sizeof(m_Clocks));
+    memset(m_LastFrames, 0, sizeof(m_LastFrames));
+}
+
+PROFILETIMELINE::~PROFILETIMELINE()
+{
+    Clean();
+}
+
+//
+// Keep the newest Capacity events for export
+//
+bool PROFILETIMELINE::Initialize(UINT Capacity)
+{
+    Clean();
+
+    m_Events = new (std::nothrow) PROFILE_EVENT[Capacity];
+    if (!m_Events)
+    {
+        return false;
+    }
+    m_Capacity = Capacity;
+    return true;
+}
+
+void PROFILETIMELINE::Clean()
+{
+    if (m_Events)
+    {
+        delete [] m_Events;
+        m_Events = nullptr;
+    }
+    m_Capacity = 0;
+    m_Added = 0;
+    memset(m_Stats, 0, sizeof(m_Stats));
+    memset(m_Clocks, 0, sizeof(m_Clocks));
+    memset(m_LastFrames, 0, sizeof(m_LastFrames));
+}
+
+//
+// Ticks of a clock running at Frequency to nanoseconds, without overflowing for large tick counts
+//
+uint64_t PROFILETIMELINE::TicksToNs(uint64_t Ticks, uint64_t Frequency)
+{
+    return (Ticks / Frequency) * NS_PER_SECOND + ((Ticks % Frequency) * NS_PER_SECOND) / Frequency;
+}
+
+void PROFILETIMELINE::AddCpuSpan(UINT Lane, uint64_t Frame, PROFILE_PASS Pass, uint64_t StartNs, uint64_t EndNs)
+{
+    PROFILE_EVENT Event = {Frame, StartNs, EndNs, Pass, PROFILE_TRACK_CPU, Lane};
+
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    AddEvent(&Event);
+}
+
+//
+// Put one frame of GPU passes on the CPU clock and the timeline
+//
+void PROFILETIMELINE::AddGpuFrame(const GPU_FRAME_TIMINGS* Timings)
+{
+    if (Timings->Lane >= PROFILE_MAX_LANES || !Timings->Frequency)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> Guard(m_Lock);
+
+    // The GPU started this frame at IssueNs or later. A frame that started right away gives the offset of the
+    // clocks, the others only an upper bound, so the offset follows the smallest one and relaxes slowly to let
+    // the clocks drift.
+    LANE_CLOCK* Clock = &m_Clocks[Timings->Lane];
+    int64_t Offset = static_cast<int64_t>(TicksToNs(Timings->FrameBegin, Timings->Frequency) - Timings->IssueNs);
+    if (Clock->Valid && Clock->Frequency == Timings->Frequency)
+    {
+        int64_t Relaxed = Clock->OffsetNs + static_cast<int64_t>(PROFILE_CLOCK_RELAX_NS);
+        Clock->OffsetNs = (Offset < Relaxed) ? Offset : Relaxed;
+    }
+    else
+    {
+        Clock->Valid = true;
+        Clock->Frequency = Timings->Frequency;
+        Clock->OffsetNs = Offset;
+    }
+
+    for (UINT i = 0; i < Timings->PassCount && i < PROFILE_MAX_FRAME_PASSES; ++i)
+    {
+        PROFILE_EVENT Event;
+        Event.Frame = Timings->Frame;
+        Event.StartNs = TicksToNs(Timings->Passes[i].Begin, Timings->Frequency) - static_cast<uint64_t>(Clock->OffsetNs);
+        Event.EndNs = TicksToNs(Timings->Passes[i].End, Timings->Frequency) - static_cast<uint64_t>(Clock->OffsetNs);
+        Event.Pass = Timings->Passes[i].Pass;
+        Event.Track = PROFILE_TRACK_GPU;
+        Event.Lane = Timings->Lane;
+        AddEvent(&Event);
+    }
+
+    if (Timings->PassCount)
+    {
+        UINT Last = ((Timings->PassCount < PROFILE_MAX_FRAME_PASSES) ? Timings->PassCount : PROFILE_MAX_FRAME_PASSES) - 1;
+        uint64_t EndNs = TicksToNs(Timings->Passes[Last].End, Timings->Frequency) - static_cast<uint64_t>(Clock->OffsetNs);
+        LANE_FRAME* LastFrame = &m_LastFrames[Timings->Lane];
+        LastFrame->Valid = true;
+        LastFrame->Frame = Timings->Frame;
+        LastFrame->LatencyNs = (EndNs > Timings->IssueNs) ? EndNs - Timings->IssueNs : 0;
+    }
+}
+
+//
+// Issue to completion of the newest GPU frame of a lane, false before the first one came in
+//
+bool PROFILETIMELINE::GetLastGpuFrame(UINT Lane, uint64_t* Frame, uint64_t* LatencyNs)
+{
+    if (Lane >= PROFILE_MAX_LANES)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    if (!m_LastFrames[Lane].Valid)
+    {
+        return false;
+    }
+    *Frame = m_LastFrames[Lane].Frame;
+    *LatencyNs = m_LastFrames[Lane].LatencyNs;
+    return true;
+}
+
+//
+// Store an event and fold its length into the pass statistics, with the lock held
+//
+void PROFILETIMELINE::AddEvent(const PROFILE_EVENT* Event)
+{
+    if (Event->Pass >= PROFILE_PASS_COUNT || Event->EndNs < Event->StartNs)
+    {
+        return;
+    }
+
+    if (m_Capacity)
+    {
+        m_Events[m_Added % m_Capacity] = *Event;
+    }
+    ++m_Added;
+
+    // Welford's running mean and variance, like the presenter's own statistics
+    PROFILE_STAT* Stat = &m_Stats[Event->Track][Event->Pass];
+    double Value = (Event->EndNs - Event->StartNs) / 1000000.0;
+    if (Stat->Count == 0)
+    {
+        Stat->Min = Value;
+        Stat->Max = Value;
+    }
+    else
+    {
+        Stat->Min = (Value < Stat->Min) ? Value : Stat->Min;
+        Stat->Max = (Value > Stat->Max) ? Value : Stat->Max;
+    }
+    Stat->Count++;
+    double Delta = Value - Stat->Mean;
+    Stat->Mean += Delta / Stat->Count;
+    Stat->M2 += Delta * (Value - Stat->Mean);
+}
+
+void PROFILETIMELINE::GetStat(PROFILE_TRACK Track, PROFILE_PASS Pass, PROFILE_STAT* Stat)
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    *Stat = m_Stats[Track][Pass];
+}
+
+void PROFILETIMELINE::ResetStats()
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    memset(m_Stats, 0, sizeof(m_Stats));
+}
+
+//
+// Copy up to Count of the newest events, oldest first. Returns how many were copied.
+//
+UINT PROFILETIMELINE::GetEvents(PROFILE_EVENT* Events, UINT Count)
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+
+    uint64_t Kept = (m_Added < m_Capacity) ? m_Added : m_Capacity;
+    if (Count > Kept)
+    {
+        Count = static_cast<UINT>(Kept);
+    }
+    for (UINT i = 0; i < Count; ++i)
+    {
+        Events[i] = m_Events[(m_Added - Count + i) % m_Capacity];
+    }
+    return Count;
+}
+
+//
+// Write the kept events as a Chrome trace (chrome://tracing, Perfetto), one row per lane and track
+//
+bool PROFILETIMELINE::Export(const char* Path)
+{
+    FILE* File = fopen(Path, "w");
+    if (!File)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> Guard(m_Lock);
+
+    uint64_t Kept = (m_Added < m_Capacity) ? m_Added : m_Capacity;
+    uint64_t First = m_Added - Kept;
+    uint64_t Origin = UINT64_MAX;
+    bool LaneUsed[PROFILE_TRACK_COUNT][PROFILE_MAX_LANES] = {};
+    for (uint64_t i = First; i < m_Added; ++i)
+    {
+        const PROFILE_EVENT* Event = &m_Events[i % m_Capacity];
+        Origin = (Event->StartNs < Origin) ? Event->StartNs : Origin;
+        if (Event->Lane < PROFILE_MAX_LANES)
+        {
+            LaneUsed[Event->Track][Event->Lane] = true;
+        }
+    }
+
+    fprintf(File, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool Separator = false;
+    for (UINT Track = 0; Track < PROFILE_TRACK_COUNT; ++Track)
+    {
+        for (UINT Lane = 0; Lane < PROFILE_MAX_LANES; ++Lane)
+        {
+            if (!LaneUsed[Track][Lane])
+            {
+                continue;
+            }
+
+            char Name[32];
+            if (Lane)
+            {
+                snprintf(Name, sizeof(Name), "%s output %u", Track ? "GPU" : "CPU", Lane - 1);
+            }
+            else
+            {
+                snprintf(Name, sizeof(Name), "%s presenter", Track ? "GPU" : "CPU");
+            }
+            fprintf(File, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", Separator ? ",\n" : "",
+                    Track * PROFILE_MAX_LANES + Lane, Name);
+            Separator = true;
+        }
+    }
+
+    for (uint64_t i = First; i < m_Added; ++i)
+    {
+        const PROFILE_EVENT* Event = &m_Events[i % m_Capacity];
+        fprintf(File, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                Separator ? ",\n" : "", GetProfilePassName(Event->Pass), Event->Track ? "gpu" : "cpu", Event->Track * PROFILE_MAX_LANES + Event->Lane,
+                (Event->StartNs - Origin) / 1000.0, (Event->EndNs - Event->StartNs) / 1000.0, static_cast<unsigned long long>(Event->Frame));
+        Separator = true;
+    }
+    fprintf(File, "\n]}\n");
+
+    bool Written = !ferror(File);
+    return (fclose(File) == 0) && Written;
+}
+
+MODELEDGPUTIMER::MODELEDGPUTIMER() : m_Timeline(nullptr),
+                                     m_Lane(0),
+                                     m_BusyUntilNs(0),
+                                     m_Issued(0),
+                                     m_Delivered(0)
+{
+    memset(&m_Model, 0, sizeof(m_Model));
+    memset(m_Frames, 0, sizeof(m_Frames));
+}
+
+void MODELEDGPUTIMER::Initialize(PROFILETIMELINE* Timeline, UINT Lane, const GPU_COST_MODEL* Model)
+{
+    m_Timeline = Timeline;
+    m_Lane = Lane;
+    m_Model = *Model;
+    m_BusyUntilNs = 0;
+    m_Issued = 0;
+    m_Delivered = 0;
+}
+
+//
+// Nanoseconds on the CPU clock to ticks of the modeled GPU clock
+//
+uint64_t MODELEDGPUTIMER::ToTicks(uint64_t CpuNs)
+{
+    uint64_t GpuNs = CpuNs + m_Model.ClockOffsetNs;
+    return (GpuNs / NS_PER_SECOND) * m_Model.Frequency + ((GpuNs % NS_PER_SECOND) * m_Model.Frequency) / NS_PER_SECOND;
+}
+
+//
+// Start a frame issued at NowNs. Hands the timeline the frames issued PROFILE_LATENCY frames ago.
+//
+void MODELEDGPUTIMER::BeginFrame(uint64_t Frame, uint64_t NowNs)
+{
+    while (m_Issued - m_Delivered >= PROFILE_LATENCY)
+    {
+        m_Timeline->AddGpuFrame(&m_Frames[m_Delivered % PROFILE_LATENCY]);
+        ++m_Delivered;
+    }
+
+    // The frame waits for the GPU to finish the ones before it
+    uint64_t StartNs = NowNs + m_Model.SubmitLatencyNs;
+    m_BusyUntilNs = (m_BusyUntilNs > StartNs) ? m_BusyUntilNs : StartNs;
+
+    GPU_FRAME_TIMINGS* Timings = &m_Frames[m_Issued % PROFILE_LATENCY];
+    Timings->Frame = Frame;
+    Timings->Lane = m_Lane;
+    Timings->IssueNs = NowNs;
+    Timings->Frequency = m_Model.Frequency;
+    Timings->FrameBegin = ToTicks(m_BusyUntilNs);
+    Timings->PassCount = 0;
+}
+
+void MODELEDGPUTIMER::AddPass(PROFILE_PASS Pass, uint64_t Pixels)
+{
+    GPU_FRAME_TIMINGS* Timings = &m_Frames[m_Issued % PROFILE_LATENCY];
+    if (Timings->PassCount >= PROFILE_MAX_FRAME_PASSES)
+    {
+        return;
+    }
+
+    Timings->Passes[Timings->PassCount].Pass = Pass;
+    Timings->Passes[Timings->PassCount].Begin = ToTicks(m_BusyUntilNs);
+    m_BusyUntilNs += m_Model.PassNs + static_cast<uint64_t>(Pixels * m_Model.NsPerPixel);
+    Timings->Passes[Timings->PassCount].End = ToTicks(m_BusyUntilNs);
+    ++Timings->PassCount;
+}
+
+void MODELEDGPUTIMER::EndFrame()
+{
+    ++m_Issued;
+}
+
+//
+// Hand over every frame still in flight, at the end of a run
+//
+void MODELEDGPUTIMER::Flush()
+{
+    while (m_Delivered < m_Issued)
+    {
+        m_Timeline->AddGpuFrame(&m_Frames[m_Delivered % PROFILE_LATENCY]);
+        ++m_Delivered;
+    }
+}
@@ -0,0 +1,203 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _FRAMEPROFILER_H_
+#define _FRAMEPROFILER_H_
+
+#include <mutex>
+
+#include "Platform.h"
+
+//
+// Timed parts of capture and present
+//
+typedef enum
+{
+    PROFILE_PASS_COPY_MOVE      = 0,    // DISPLAYMANAGER::CopyMove
+    PROFILE_PASS_COPY_DIRTY     = 1,    // DISPLAYMANAGER::CopyDirty
+    PROFILE_PASS_APPLY_RECTS    = 2,    // DISPLAYMANAGER::ApplyRects, instead of the two above
+    PROFILE_PASS_DRAW_FRAME     = 3,    // OUTPUTMANAGER::DrawFrame
+    PROFILE_PASS_DRAW_MOUSE     = 4,    // OUTPUTMANAGER::DrawMouse
+    PROFILE_PASS_PRESENT        = 5,    // The fence signal handing the frame to the display
+    PROFILE_PASS_SUBMIT         = 6,    // Presenter wake to submit, on the CPU
+    PROFILE_PASS_COUNT          = 7
+} PROFILE_PASS;
+
+typedef enum
+{
+    PROFILE_TRACK_CPU   = 0,
+    PROFILE_TRACK_GPU   = 1,
+    PROFILE_TRACK_COUNT = 2
+} PROFILE_TRACK;
+
+// Lane 0 is the presenter, lane n + 1 the duplication thread of output n
+#define PROFILE_MAX_LANES 16
+
+// Frames of GPU timestamps in flight. Results are read this many frames after they were issued, by then
+// the GPU has long finished them and reading never waits.
+#define PROFILE_LATENCY 4
+
+// Passes one frame of one lane can time
+#define PROFILE_MAX_FRAME_PASSES 8
+
+// How fast the GPU to CPU clock offset may grow back after a frame that ran with no queueing delay
+#define PROFILE_CLOCK_RELAX_NS 2000ull
+
+// Events kept for export, the last few minutes of a headset and two outputs
+#define PROFILE_EVENT_CAPACITY (256 * 1024)
+
+//
+// Raw timestamps of one frame's GPU passes, in ticks of the GPU clock
+//
+typedef struct _GPU_FRAME_TIMINGS
+{
+    uint64_t Frame;
+    UINT Lane;
+
+    // CPU nanoseconds when the frame's first timestamp was issued, the GPU reaches it no earlier
+    uint64_t IssueNs;
+    uint64_t Frequency;
+    uint64_t FrameBegin;
+
+    UINT PassCount;
+    struct
+    {
+        PROFILE_PASS Pass;
+        uint64_t Begin;
+        uint64_t End;
+    } Passes[PROFILE_MAX_FRAME_PASSES];
+} GPU_FRAME_TIMINGS;
+
+//
+// One span on the timeline, in CPU nanoseconds
+//
+typedef struct _PROFILE_EVENT
+{
+    uint64_t Frame;
+    uint64_t StartNs;
+    uint64_t EndNs;
+    PROFILE_PASS Pass;
+    PROFILE_TRACK Track;
+    UINT Lane;
+} PROFILE_EVENT;
+
+//
+// Running statistics of one pass, in milliseconds
+//
+typedef struct _PROFILE_STAT
+{
+    UINT Count;
+    double Mean;
+    double M2;
+    double Min;
+    double Max;
+} PROFILE_STAT;
+
+const char* GetProfilePassName(PROFILE_PASS Pass);
+
+//
+// CPU spans and GPU passes of every thread on one timeline. GPU timestamps are brought onto the CPU clock by
+// the smallest offset seen between when a frame was issued and when the GPU started it, which is the offset of
+// the clocks plus the shortest queueing delay. Keeps the newest events for export and running statistics for
+// reports. Safe to feed from any thread.
+//
+class PROFILETIMELINE
+{
+    public:
+        PROFILETIMELINE();
+        ~PROFILETIMELINE();
+        bool Initialize(UINT Capacity);
+        void AddCpuSpan(UINT Lane, uint64_t Frame, PROFILE_PASS Pass, uint64_t StartNs, uint64_t EndNs);
+        void AddGpuFrame(const GPU_FRAME_TIMINGS* Timings);
+        void GetStat(PROFILE_TRACK Track, PROFILE_PASS Pass, PROFILE_STAT* Stat);
+        bool GetLastGpuFrame(UINT Lane, uint64_t* Frame, uint64_t* LatencyNs);
+        void ResetStats();
+        UINT GetEvents(PROFILE_EVENT* Events, UINT Count);
+        bool Export(const char* Path);
+        void Clean();
+
+        static uint64_t TicksToNs(uint64_t Ticks, uint64_t Frequency);
+
+    private:
+    // methods
+        void AddEvent(const PROFILE_EVENT* Event);
+
+    // variables
+        std::mutex m_Lock;
+        PROFILE_EVENT* m_Events;
+        UINT m_Capacity;
+        uint64_t m_Added;
+
+        PROFILE_STAT m_Stats[PROFILE_TRACK_COUNT][PROFILE_PASS_COUNT];
+
+        // GPU clock minus CPU clock per lane, each lane may time a different device
+        struct LANE_CLOCK
+        {
+            bool Valid;
+            uint64_t Frequency;
+            int64_t OffsetNs;
+        };
+        LANE_CLOCK m_Clocks[PROFILE_MAX_LANES];
+
+        // Newest GPU frame of each lane: how long after it was issued its last pass ended, on the CPU clock
+        struct LANE_FRAME
+        {
+            bool Valid;
+            uint64_t Frame;
+            uint64_t LatencyNs;
+        };
+        LANE_FRAME m_LastFrames[PROFILE_MAX_LANES];
+};
+
+//
+// Cost of modeled GPU passes: a fixed part and a part per pixel written
+//
+typedef struct _GPU_COST_MODEL
+{
+    uint64_t PassNs;
+    double NsPerPixel;
+
+    // How long after being issued a frame starts on an idle GPU
+    uint64_t SubmitLatencyNs;
+
+    // The modeled GPU clock, and where its zero is relative to the CPU clock
+    uint64_t Frequency;
+    uint64_t ClockOffsetNs;
+} GPU_COST_MODEL;
+
+//
+// Stand-in for GPU timestamp queries where there is no GPU. Passes take modeled time on a modeled GPU clock,
+// queue behind earlier frames, and come out PROFILE_LATENCY frames later like query results do.
+//
+class MODELEDGPUTIMER
+{
+    public:
+        MODELEDGPUTIMER();
+        void Initialize(PROFILETIMELINE* Timeline, UINT Lane, const GPU_COST_MODEL* Model);
+        void BeginFrame(uint64_t Frame, uint64_t NowNs);
+        void AddPass(PROFILE_PASS Pass, uint64_t Pixels);
+        void EndFrame();
+        void Flush();
+
+    private:
+    // methods
+        uint64_t ToTicks(uint64_t CpuNs);
+
+    // variables
+        PROFILETIMELINE* m_Timeline;
+        UINT m_Lane;
+        GPU_COST_MODEL m_Model;
+
+        // When the modeled GPU is done with everything issued so far, in CPU nanoseconds
+        uint64_t m_BusyUntilNs;
+
+        GPU_FRAME_TIMINGS m_Frames[PROFILE_LATENCY];
+        uint64_t m_Issued;
+        uint64_t m_Delivered;
+};
+
+#endif
@@ -0,0 +1,419 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <string.h>
+
+#include "FrameRecorder.h"
+
+FRAMERECORDER::FRAMERECORDER() : m_Width(0),
+                                 m_Height(0),
+                                 m_Columns(0),
+                                 m_Rows(0),
+                                 m_Pending(nullptr),
+                                 m_PendingCount(0),
+                                 m_Dropped(0),
+                                 m_ForceKeyframe(false),
+                                 m_LastKeyframe(0),
+                                 m_HasKeyframe(false),
+                                 m_Queued(0),
+                                 m_Stop(false),
+                                 m_Failed(false),
+                                 m_FramesRecorded(0),
+                                 m_Keyframes(0),
+                                 m_BytesWritten(0),
+                                 m_FramesDropped(0)
+{
+    memset(m_Slots, 0, sizeof(m_Slots));
+    memset(&m_Shadow, 0, sizeof(m_Shadow));
+}
+
+FRAMERECORDER::~FRAMERECORDER()
+{
+    Clean();
+}
+
+//
+// Create the log at Path and start the writer thread
+//
+bool FRAMERECORDER::Initialize(const char* Path, UINT Width, UINT Height)
+{
+    Clean();
+
+    if (!m_Log.Create(Path) || !AllocateSlots(Width, Height))
+    {
+        Clean();
+        return false;
+    }
+
+    for (UINT i = 0; i < RECORDER_QUEUE_DEPTH; ++i)
+    {
+        m_Free.Push(i);
+    }
+
+    m_Stop = false;
+    m_Failed = false;
+    m_Writer = std::thread(&FRAMERECORDER::WriterThread, this);
+    return true;
+}
+
+//
+// Size the queue slots for frames of Width by Height, every tile starts out pending
+//
+bool FRAMERECORDER::AllocateSlots(UINT Width, UINT Height)
+{
+    m_Width = Width;
+    m_Height = Height;
+    m_Columns = (Width + TILE_SIZE - 1) / TILE_SIZE;
+    m_Rows = (Height + TILE_SIZE - 1) / TILE_SIZE;
+    UINT TileCount = m_Columns * m_Rows;
+
+    m_Pending = new (std::nothrow) bool[TileCount];
+    if (!m_Pending)
+    {
+        return false;
+    }
+    for (UINT i = 0; i < TileCount; ++i)
+    {
+        m_Pending[i] = true;
+    }
+    m_PendingCount = TileCount;
+
+    for (UINT i = 0; i < RECORDER_QUEUE_DEPTH; ++i)
+    {
+        m_Slots[i].Tiles = new (std::nothrow) uint32_t[TileCount];
+        m_Slots[i].Pixels = new (std::nothrow) BYTE[static_cast<size_t>(TileCount) * TILE_SIZE * TILE_SIZE * 4];
+        if (!m_Slots[i].Tiles || !m_Slots[i].Pixels)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FRAMERECORDER::FreeSlots()
+{
+    for (UINT i = 0; i < RECORDER_QUEUE_DEPTH; ++i)
+    {
+        if (m_Slots[i].Tiles)
+        {
+            delete [] m_Slots[i].Tiles;
+        }
+        if (m_Slots[i].Pixels)
+        {
+            delete [] m_Slots[i].Pixels;
+        }
+    }
+    memset(m_Slots, 0, sizeof(m_Slots));
+
+    if (m_Pending)
+    {
+        delete [] m_Pending;
+        m_Pending = nullptr;
+    }
+    m_PendingCount = 0;
+}
+
+//
+// Stop the writer thread once it has written everything queued, and finish the log
+//
+void FRAMERECORDER::Close()
+{
+    if (m_Writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Guard(m_WakeLock);
+            m_Stop = true;
+        }
+        m_Wake.notify_one();
+        m_Writer.join();
+    }
+    m_Log.Close();
+}
+
+void FRAMERECORDER::Clean()
+{
+    Close();
+    FreeSlots();
+
+    UINT Slot;
+    while (m_Filled.Pop(&Slot))
+    {
+    }
+    while (m_Free.Pop(&Slot))
+    {
+    }
+
+    if (m_Shadow.Bits)
+    {
+        delete [] m_Shadow.Bits;
+    }
+    memset(&m_Shadow, 0, sizeof(m_Shadow));
+
+    m_Width = 0;
+    m_Height = 0;
+    m_Columns = 0;
+    m_Rows = 0;
+    m_Dropped = 0;
+    m_ForceKeyframe = false;
+    m_LastKeyframe = 0;
+    m_HasKeyframe = false;
+    m_Queued = 0;
+    m_FramesRecorded = 0;
+    m_Keyframes = 0;
+    m_BytesWritten = 0;
+    m_FramesDropped = 0;
+}
+
+//
+// Wait for the writer thread to finish the frames queued
+//
+void FRAMERECORDER::Drain()
+{
+    std::unique_lock<std::mutex> Guard(m_WakeLock);
+    m_Idle.wait(Guard, [this] { return !m_Queued; });
+}
+
+//
+// Follow a change of the desktop size. Waits for the queue to empty, the next frame is a keyframe.
+//
+bool FRAMERECORDER::Resize(UINT Width, UINT Height)
+{
+    if (!m_Pending || (Width == m_Width && Height == m_Height))
+    {
+        return m_Pending != nullptr;
+    }
+
+    Drain();
+    FreeSlots();
+    if (!AllocateSlots(Width, Height))
+    {
+        FreeSlots();
+        return false;
+    }
+    m_ForceKeyframe = true;
+    return true;
+}
+
+//
+// Remember the tiles under a changed region
+//
+void FRAMERECORDER::MarkTiles(const RECT* Rect)
+{
+    LONG Left = (Rect->left > 0) ? Rect->left : 0;
+    LONG Top = (Rect->top > 0) ? Rect->top : 0;
+    LONG Right = (Rect->right < static_cast<LONG>(m_Width)) ? Rect->right : static_cast<LONG>(m_Width);
+    LONG Bottom = (Rect->bottom < static_cast<LONG>(m_Height)) ? Rect->bottom : static_cast<LONG>(m_Height);
+    if (Right <= Left || Bottom <= Top)
+    {
+        return;
+    }
+
+    for (UINT Row = Top / TILE_SIZE; Row <= static_cast<UINT>(Bottom - 1) / TILE_SIZE; ++Row)
+    {
+        for (UINT Column = Left / TILE_SIZE; Column <= static_cast<UINT>(Right - 1) / TILE_SIZE; ++Column)
+        {
+            bool* Pending = &m_Pending[Row * m_Columns + Column];
+            if (!*Pending)
+            {
+                *Pending = true;
+                ++m_PendingCount;
+            }
+        }
+    }
+}
+
+//
+// Queue the tiles under the damage of a frame, Frame is in desktop coordinates like the damage and only
+// the tiles under the damage need to be up to date. Never blocks: returns false when the frame was
+// dropped, its tiles then go with the next frame recorded.
+//
+bool FRAMERECORDER::RecordFrame(const SOFTWARE_SURFACE* Frame, const RECT* Damage, UINT DamageCount, uint64_t Timestamp)
+{
+    if (!m_Pending || m_Stop || m_Failed || Frame->Width != m_Width || Frame->Height != m_Height)
+    {
+        return false;
+    }
+
+    for (UINT i = 0; i < DamageCount; ++i)
+    {
+        MarkTiles(&Damage[i]);
+    }
+    if (!m_PendingCount)
+    {
+        return true;
+    }
+
+    UINT Slot;
+    if (!m_Free.Pop(&Slot))
+    {
+        ++m_Dropped;
+        ++m_FramesDropped;
+        return false;
+    }
+
+    RECORD_SLOT* Record = &m_Slots[Slot];
+    Record->Width = m_Width;
+    Record->Height = m_Height;
+    Record->Timestamp = Timestamp;
+    Record->Dropped = m_Dropped;
+    Record->Keyframe = m_ForceKeyframe;
+    Record->TileCount = 0;
+    for (UINT Row = 0; Row < m_Rows; ++Row)
+    {
+        for (UINT Column = 0; Column < m_Columns; ++Column)
+        {
+            bool* Pending = &m_Pending[Row * m_Columns + Column];
+            if (!*Pending)
+            {
+                continue;
+            }
+            *Pending = false;
+
+            UINT Left = Column * TILE_SIZE;
+            UINT Top = Row * TILE_SIZE;
+            UINT Width = (Left + TILE_SIZE < m_Width) ? TILE_SIZE : m_Width - Left;
+            UINT Height = (Top + TILE_SIZE < m_Height) ? TILE_SIZE : m_Height - Top;
+            BYTE* Pixels = Record->Pixels + static_cast<size_t>(Record->TileCount) * TILE_SIZE * TILE_SIZE * 4;
+            for (UINT Y = 0; Y < Height; ++Y)
+            {
+                memcpy(Pixels + static_cast<size_t>(Y) * Width * 4, Frame->Bits + static_cast<size_t>(Top + Y) * Frame->Pitch + Left * 4, Width * 4);
+            }
+            Record->Tiles[Record->TileCount++] = (Column << 16) | Row;
+        }
+    }
+    m_PendingCount = 0;
+    m_Dropped = 0;
+    m_ForceKeyframe = false;
+
+    m_Filled.Push(Slot);
+    {
+        std::lock_guard<std::mutex> Guard(m_WakeLock);
+        ++m_Queued;
+    }
+    m_Wake.notify_one();
+    return true;
+}
+
+//
+// Apply a queued frame to the writer's copy and append it to the log
+//
+bool FRAMERECORDER::WriteSlot(UINT Slot)
+{
+    RECORD_SLOT* Record = &m_Slots[Slot];
+
+    bool Keyframe = Record->Keyframe || !m_HasKeyframe || Record->Timestamp - m_LastKeyframe >= RECORDER_KEYFRAME_INTERVAL_NS;
+    if (m_Shadow.Width != Record->Width || m_Shadow.Height != Record->Height)
+    {
+        if (m_Shadow.Bits)
+        {
+            delete [] m_Shadow.Bits;
+        }
+        m_Shadow.Bits = new (std::nothrow) BYTE[static_cast<size_t>(Record->Width) * Record->Height * 4];
+        if (!m_Shadow.Bits)
+        {
+            memset(&m_Shadow, 0, sizeof(m_Shadow));
+            return false;
+        }
+        m_Shadow.Width = Record->Width;
+        m_Shadow.Height = Record->Height;
+        m_Shadow.Pitch = Record->Width * 4;
+        Keyframe = true;
+    }
+
+    for (UINT i = 0; i < Record->TileCount; ++i)
+    {
+        UINT Left = (Record->Tiles[i] >> 16) * TILE_SIZE;
+        UINT Top = (Record->Tiles[i] & 0xFFFF) * TILE_SIZE;
+        UINT Width = (Left + TILE_SIZE < m_Shadow.Width) ? TILE_SIZE : m_Shadow.Width - Left;
+        UINT Height = (Top + TILE_SIZE < m_Shadow.Height) ? TILE_SIZE : m_Shadow.Height - Top;
+        const BYTE* Pixels = Record->Pixels + static_cast<size_t>(i) * TILE_SIZE * TILE_SIZE * 4;
+        for (UINT Y = 0; Y < Height; ++Y)
+        {
+            memcpy(m_Shadow.Bits + static_cast<size_t>(Top + Y) * m_Shadow.Pitch + Left * 4, Pixels + static_cast<size_t>(Y) * Width * 4, Width * 4);
+        }
+    }
+
+    if (Keyframe)
+    {
+        if (!m_Log.WriteKeyframe(&m_Shadow, Record->Timestamp, Record->Dropped))
+        {
+            return false;
+        }
+        m_LastKeyframe = Record->Timestamp;
+        m_HasKeyframe = true;
+        ++m_Keyframes;
+    }
+    else
+    {
+        if (!m_Log.BeginRecord(FRAMELOG_DELTA, m_Shadow.Width, m_Shadow.Height, Record->Timestamp, Record->Dropped))
+        {
+            return false;
+        }
+        for (UINT i = 0; i < Record->TileCount; ++i)
+        {
+            if (!m_Log.AddTile(&m_Shadow, Record->Tiles[i] >> 16, Record->Tiles[i] & 0xFFFF))
+            {
+                return false;
+            }
+        }
+        if (!m_Log.EndRecord())
+        {
+            return false;
+        }
+    }
+
+    ++m_FramesRecorded;
+    m_BytesWritten = m_Log.GetSize();
+    return true;
+}
+
+//
+// Write queued frames until Close, everything queued before Close is still written. After a failed
+// write, usually a full disk, frames are taken off the queue and discarded.
+//
+void FRAMERECORDER::WriterThread()
+{
+    for (;;)
+    {
+        UINT Slot;
+        if (m_Filled.Pop(&Slot))
+        {
+            if (!m_Failed && !WriteSlot(Slot))
+            {
+                m_Failed = true;
+            }
+            m_Free.Push(Slot);
+
+            std::lock_guard<std::mutex> Guard(m_WakeLock);
+            --m_Queued;
+            m_Idle.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Guard(m_WakeLock);
+        if (m_Stop && !m_Queued)
+        {
+            break;
+        }
+        m_Wake.wait(Guard, [this] { return m_Stop || m_Queued; });
+    }
+}
+
+bool FRAMERECORDER::IsRecording()
+{
+    return m_Pending && !m_Stop && !m_Failed;
+}
+
+void FRAMERECORDER::GetStats(RECORDER_STATS* Stats)
+{
+    Stats->FramesRecorded = m_FramesRecorded;
+    Stats->FramesDropped = m_FramesDropped;
+    Stats->Keyframes = m_Keyframes;
+    Stats->BytesWritten = m_BytesWritten;
+}
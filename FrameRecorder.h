@@ -0,0 +1,112 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _FRAMERECORDER_H_
+#define _FRAMERECORDER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "CommandQueue.h"
+#include "FrameLog.h"
+
+// Frames queued for the writer thread before frames are dropped, a power of two
+#define RECORDER_QUEUE_DEPTH 4
+
+// Time between keyframes, the most a seek has to apply on top of a keyframe
+#define RECORDER_KEYFRAME_INTERVAL_NS 1000000000ull
+
+typedef struct _RECORDER_STATS
+{
+    uint64_t FramesRecorded;
+    uint64_t FramesDropped;
+    uint64_t Keyframes;
+    uint64_t BytesWritten;
+} RECORDER_STATS;
+
+//
+// Records the frames a pipeline shows into a frame log, for reproducing glitches after the fact.
+// The capture thread hands over the tiles under the damage of each frame and returns, a writer thread
+// compresses and appends them, and writes a keyframe every RECORDER_KEYFRAME_INTERVAL_NS from its own copy of
+// the frame. When the writer falls behind and the queue is full the frame is dropped and counted, and its
+// tiles go with the next frame recorded. Every queue slot holds a whole frame, so the only waits on the
+// capture thread are Resize and Close.
+//
+class FRAMERECORDER
+{
+    public:
+        FRAMERECORDER();
+        ~FRAMERECORDER();
+        bool Initialize(const char* Path, UINT Width, UINT Height);
+        bool Resize(UINT Width, UINT Height);
+        bool RecordFrame(const SOFTWARE_SURFACE* Frame, const RECT* Damage, UINT DamageCount, uint64_t Timestamp);
+        bool IsRecording();
+        void GetStats(RECORDER_STATS* Stats);
+        void Close();
+        void Clean();
+
+    private:
+    // methods
+        bool AllocateSlots(UINT Width, UINT Height);
+        void FreeSlots();
+        void MarkTiles(const RECT* Rect);
+        void Drain();
+        void WriterThread();
+        bool WriteSlot(UINT Slot);
+
+    // variables
+        // Tiles of one frame, packed TILE_SIZE * TILE_SIZE * 4 bytes apart
+        struct RECORD_SLOT
+        {
+            UINT Width;
+            UINT Height;
+            uint64_t Timestamp;
+            UINT Dropped;
+            bool Keyframe;
+            UINT TileCount;
+            uint32_t* Tiles;
+            BYTE* Pixels;
+        };
+
+        UINT m_Width;
+        UINT m_Height;
+        UINT m_Columns;
+        UINT m_Rows;
+
+        // Capture thread side: tiles changed since the last frame queued, and frames dropped since
+        bool* m_Pending;
+        UINT m_PendingCount;
+        UINT m_Dropped;
+        bool m_ForceKeyframe;
+
+        RECORD_SLOT m_Slots[RECORDER_QUEUE_DEPTH];
+        COMMANDQUEUE<UINT, RECORDER_QUEUE_DEPTH> m_Filled;
+        COMMANDQUEUE<UINT, RECORDER_QUEUE_DEPTH> m_Free;
+
+        // Writer thread side: its copy of the frame and the log
+        FRAMELOGWRITER m_Log;
+        SOFTWARE_SURFACE m_Shadow;
+        uint64_t m_LastKeyframe;
+        bool m_HasKeyframe;
+
+        std::thread m_Writer;
+        std::mutex m_WakeLock;
+        std::condition_variable m_Wake;
+        std::condition_variable m_Idle;
+        UINT m_Queued;
+        bool m_Stop;
+        std::atomic<bool> m_Failed;
+
+        std::atomic<uint64_t> m_FramesRecorded;
+        std::atomic<uint64_t> m_Keyframes;
+        std::atomic<uint64_t> m_BytesWritten;
+        uint64_t m_FramesDropped;
+};
+
+#endif
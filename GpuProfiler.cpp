@@ -0,0 +1,223 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "GpuProfiler.h"
+
+GPUPROFILER::GPUPROFILER() : m_DeviceContext(nullptr),
+                             m_Timeline(nullptr),
+                             m_Lane(0),
+                             m_Issued(0),
+                             m_Collected(0),
+                             m_Current(nullptr),
+                             m_PassOpen(false),
+                             m_Skipped(0),
+                             m_Disjoint(0)
+{
+    RtlZeroMemory(m_Slots, sizeof(m_Slots));
+}
+
+GPUPROFILER::~GPUPROFILER()
+{
+    Clean();
+}
+
+//
+// Make the queries. Profiling is a diagnostic, so when they cannot be made the passes simply go untimed.
+//
+void GPUPROFILER::Initialize(_In_ ID3D11Device* Device, _In_ ID3D11DeviceContext* Context, _In_opt_ PROFILETIMELINE* Timeline, UINT Lane)
+{
+    Clean();
+
+    if (!Timeline)
+    {
+        return;
+    }
+
+    D3D11_QUERY_DESC DisjointDesc = {D3D11_QUERY_TIMESTAMP_DISJOINT, 0};
+    D3D11_QUERY_DESC TimestampDesc = {D3D11_QUERY_TIMESTAMP, 0};
+    for (UINT i = 0; i < PROFILE_LATENCY; ++i)
+    {
+        HRESULT hr = Device->CreateQuery(&DisjointDesc, &m_Slots[i].Disjoint);
+        for (UINT j = 0; SUCCEEDED(hr) && j < ARRAYSIZE(m_Slots[i].Timestamps); ++j)
+        {
+            hr = Device->CreateQuery(&TimestampDesc, &m_Slots[i].Timestamps[j]);
+        }
+        if (FAILED(hr))
+        {
+            OutputDebugStringW(L"GPUPROFILER: failed to create timestamp queries, GPU passes are not timed\n");
+            Clean();
+            return;
+        }
+    }
+
+    m_DeviceContext = Context;
+    m_DeviceContext->AddRef();
+    m_Timeline = Timeline;
+    m_Lane = Lane;
+}
+
+void GPUPROFILER::Clean()
+{
+    if (m_Skipped || m_Disjoint)
+    {
+        wchar_t Msg[128];
+        swprintf_s(Msg, L"GPUPROFILER: lane %u left %u frames untimed while busy and dropped %u disjoint ones\n", m_Lane, m_Skipped, m_Disjoint);
+        OutputDebugStringW(Msg);
+    }
+
+    for (UINT i = 0; i < PROFILE_LATENCY; ++i)
+    {
+        if (m_Slots[i].Disjoint)
+        {
+            m_Slots[i].Disjoint->Release();
+            m_Slots[i].Disjoint = nullptr;
+        }
+        for (UINT j = 0; j < ARRAYSIZE(m_Slots[i].Timestamps); ++j)
+        {
+            if (m_Slots[i].Timestamps[j])
+            {
+                m_Slots[i].Timestamps[j]->Release();
+                m_Slots[i].Timestamps[j] = nullptr;
+            }
+        }
+    }
+
+    if (m_DeviceContext)
+    {
+        m_DeviceContext->Release();
+        m_DeviceContext = nullptr;
+    }
+
+    m_Timeline = nullptr;
+    m_Issued = 0;
+    m_Collected = 0;
+    m_Current = nullptr;
+    m_PassOpen = false;
+    m_Skipped = 0;
+    m_Disjoint = 0;
+}
+
+//
+// Hand the timeline every finished frame, oldest first, without waiting for the GPU
+//
+void GPUPROFILER::Collect()
+{
+    while (m_Collected < m_Issued)
+    {
+        PROFILE_SLOT* Slot = &m_Slots[m_Collected % PROFILE_LATENCY];
+
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT Disjoint;
+        HRESULT hr = m_DeviceContext->GetData(Slot->Disjoint, &Disjoint, sizeof(Disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+        if (hr == S_FALSE)
+        {
+            return;
+        }
+
+        // The disjoint query ends after the last timestamp, they are all in once it is
+        bool Valid = SUCCEEDED(hr) && !Disjoint.Disjoint && Disjoint.Frequency;
+        UINT64 Ticks[1 + 2 * PROFILE_MAX_FRAME_PASSES];
+        UINT Count = 1 + 2 * Slot->Timings.PassCount;
+        for (UINT i = 0; Valid && i < Count; ++i)
+        {
+            hr = m_DeviceContext->GetData(Slot->Timestamps[i], &Ticks[i], sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+            if (hr == S_FALSE)
+            {
+                return;
+            }
+            Valid = SUCCEEDED(hr);
+        }
+
+        if (Valid)
+        {
+            Slot->Timings.Frequency = Disjoint.Frequency;
+            Slot->Timings.FrameBegin = Ticks[0];
+            for (UINT i = 0; i < Slot->Timings.PassCount; ++i)
+            {
+                Slot->Timings.Passes[i].Begin = Ticks[2 * i + 1];
+                Slot->Timings.Passes[i].End = Ticks[2 * i + 2];
+            }
+            m_Timeline->AddGpuFrame(&Slot->Timings);
+        }
+        else
+        {
+            ++m_Disjoint;
+        }
+
+        ++m_Collected;
+    }
+}
+
+//
+// Start timing a frame, unless its slot is still in flight
+//
+void GPUPROFILER::BeginFrame(uint64_t Frame)
+{
+    m_Current = nullptr;
+    if (!m_Timeline)
+    {
+        return;
+    }
+
+    Collect();
+    if (m_Issued - m_Collected >= PROFILE_LATENCY)
+    {
+        ++m_Skipped;
+        return;
+    }
+
+    m_Current = &m_Slots[m_Issued % PROFILE_LATENCY];
+    m_Current->Timings.Frame = Frame;
+    m_Current->Timings.Lane = m_Lane;
+    m_Current->Timings.PassCount = 0;
+
+    // Taken before the first timestamp is issued, the GPU cannot get to it any earlier
+    LARGE_INTEGER IssueTime;
+    QueryPerformanceCounter(&IssueTime);
+    m_Current->Timings.IssueNs = QpcToNs(IssueTime.QuadPart);
+
+    m_DeviceContext->Begin(m_Current->Disjoint);
+    m_DeviceContext->End(m_Current->Timestamps[0]);
+}
+
+void GPUPROFILER::BeginPass(PROFILE_PASS Pass)
+{
+    if (!m_Current || m_PassOpen || m_Current->Timings.PassCount >= PROFILE_MAX_FRAME_PASSES)
+    {
+        return;
+    }
+
+    UINT Index = m_Current->Timings.PassCount;
+    m_Current->Timings.Passes[Index].Pass = Pass;
+    m_DeviceContext->End(m_Current->Timestamps[2 * Index + 1]);
+    m_PassOpen = true;
+}
+
+void GPUPROFILER::EndPass()
+{
+    if (!m_Current || !m_PassOpen)
+    {
+        return;
+    }
+
+    UINT Index = m_Current->Timings.PassCount++;
+    m_DeviceContext->End(m_Current->Timestamps[2 * Index + 2]);
+    m_PassOpen = false;
+}
+
+void GPUPROFILER::EndFrame()
+{
+    if (!m_Current)
+    {
+        return;
+    }
+
+    // A pass left open by an error path ends with the frame
+    EndPass();
+    m_DeviceContext->End(m_Current->Disjoint);
+    m_Current = nullptr;
+    ++m_Issued;
+}
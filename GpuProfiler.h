@@ -0,0 +1,61 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _GPUPROFILER_H_
+#define _GPUPROFILER_H_
+
+#include "CommonTypes.h"
+#include "FrameProfiler.h"
+
+//
+// Times the GPU passes of one thread's frames with timestamp queries inside a disjoint query. Results are read
+// PROFILE_LATENCY frames later without flushing, and a frame whose slot is still in flight is not timed rather
+// than waited for. Does nothing without a timeline.
+//
+class GPUPROFILER
+{
+    public:
+        GPUPROFILER();
+        ~GPUPROFILER();
+        void Initialize(_In_ ID3D11Device* Device, _In_ ID3D11DeviceContext* Context, _In_opt_ PROFILETIMELINE* Timeline, UINT Lane);
+        void BeginFrame(uint64_t Frame);
+        void BeginPass(PROFILE_PASS Pass);
+        void EndPass();
+        void EndFrame();
+        void Clean();
+
+    private:
+        // One frame's queries, the frame begins with timestamp 0 and pass n spans timestamps 2n + 1 and 2n + 2
+        typedef struct _PROFILE_SLOT
+        {
+            ID3D11Query* Disjoint;
+            ID3D11Query* Timestamps[1 + 2 * PROFILE_MAX_FRAME_PASSES];
+            GPU_FRAME_TIMINGS Timings;
+        } PROFILE_SLOT;
+
+    // methods
+        void Collect();
+
+    // variables
+        ID3D11DeviceContext* m_DeviceContext;
+        PROFILETIMELINE* m_Timeline;
+        UINT m_Lane;
+
+        PROFILE_SLOT m_Slots[PROFILE_LATENCY];
+        uint64_t m_Issued;
+        uint64_t m_Collected;
+
+        // Slot of the frame being recorded, nullptr when this frame is not timed
+        PROFILE_SLOT* m_Current;
+        bool m_PassOpen;
+
+        // Frames not timed because the GPU had not finished the one PROFILE_LATENCY frames earlier, or was disjoint
+        UINT m_Skipped;
+        UINT m_Disjoint;
+};
+
+#endif
@@ -0,0 +1,174 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <math.h>
+
+#include "HmdProfile.h"
+
+// Refresh rates closer than this are considered the same (e.g. 89.99 and 90)
+static constexpr double RefreshRateTolerance = 0.05;
+
+//
+// Headsets we know how to drive. Add new devices here.
+//
+static const HMD_PROFILE KnownProfiles[] = {
+    // Name         VID     PID     Width  Height Refresh Scanouts Pacing offset
+    {"SNY c207",    0xd94d, 0xc207, 0,     0,     90.0,   2,       5'000'000},
+};
+
+// Used for headsets selected on the command line that have no profile
+static const HMD_PROFILE DefaultProfile = {"Unknown", 0, 0, 0, 0, 90.0, 2, 5'000'000};
+
+//
+// Enumerate the known profiles, returns nullptr past the last one
+//
+const HMD_PROFILE* GetHmdProfile(size_t Index)
+{
+    if (Index >= sizeof(KnownProfiles) / sizeof(KnownProfiles[0]))
+    {
+        return nullptr;
+    }
+    return &KnownProfiles[Index];
+}
+
+const HMD_PROFILE* FindHmdProfile(uint16_t VendorId, uint16_t ProductId)
+{
+    for (const HMD_PROFILE& Profile : KnownProfiles)
+    {
+        if (Profile.VendorId == VendorId && Profile.ProductId == ProductId)
+        {
+            return &Profile;
+        }
+    }
+    return nullptr;
+}
+
+//
+// Whether the display with this EDID identity is the one we should drive
+//
+bool IsHmdTarget(const HMD_OPTIONS* Options, uint16_t VendorId, uint16_t ProductId)
+{
+    if (Options->OverrideTarget)
+    {
+        return Options->VendorId == VendorId && Options->ProductId == ProductId;
+    }
+    return FindHmdProfile(VendorId, ProductId) != nullptr;
+}
+
+//
+// Profile for the display, with the command line overrides applied
+//
+void ResolveHmdProfile(const HMD_OPTIONS* Options, uint16_t VendorId, uint16_t ProductId, HMD_PROFILE* Profile)
+{
+    const HMD_PROFILE* Known = FindHmdProfile(VendorId, ProductId);
+    *Profile = Known ? *Known : DefaultProfile;
+    Profile->VendorId = VendorId;
+    Profile->ProductId = ProductId;
+
+    if (Options->RefreshRate > 0)
+    {
+        Profile->RefreshRate = Options->RefreshRate;
+    }
+    if (Options->ScanoutCount)
+    {
+        Profile->ScanoutCount = Options->ScanoutCount;
+    }
+    if (Options->PacingOffsetNs)
+    {
+        Profile->PacingOffsetNs = Options->PacingOffsetNs;
+    }
+
+    if (Profile->ScanoutCount < HMD_MIN_SCANOUT_COUNT)
+    {
+        Profile->ScanoutCount = HMD_MIN_SCANOUT_COUNT;
+    }
+    else if (Profile->ScanoutCount > HMD_MAX_SCANOUT_COUNT)
+    {
+        Profile->ScanoutCount = HMD_MAX_SCANOUT_COUNT;
+    }
+}
+
+static bool IsBetterMode(const MODE_CANDIDATE* Mode, const MODE_CANDIDATE* Best, const HMD_PROFILE* Profile, MODE_POLICY Policy)
+{
+    switch (Policy)
+    {
+        case MODE_POLICY_HIGHEST_REFRESH:
+        {
+            return Mode->RefreshRate > Best->RefreshRate + RefreshRateTolerance;
+        }
+        case MODE_POLICY_LOWEST_LATENCY:
+        {
+            if (fabs(Mode->RefreshRate - Best->RefreshRate) > RefreshRateTolerance)
+            {
+                return Mode->RefreshRate > Best->RefreshRate;
+            }
+
+            // Fewer pixels to copy and scan out for the same rate
+            return static_cast<uint64_t>(Mode->Width) * Mode->Height < static_cast<uint64_t>(Best->Width) * Best->Height;
+        }
+        case MODE_POLICY_PROFILE:
+        default:
+        {
+            return fabs(Mode->RefreshRate - Profile->RefreshRate) < fabs(Best->RefreshRate - Profile->RefreshRate);
+        }
+    }
+}
+
+static int SelectModeAtResolution(const MODE_CANDIDATE* Modes, size_t Count, uint32_t Width, uint32_t Height, const HMD_PROFILE* Profile, MODE_POLICY Policy)
+{
+    int Best = -1;
+    for (size_t i = 0; i < Count; ++i)
+    {
+        if (Width && (Modes[i].Width != Width || Modes[i].Height != Height))
+        {
+            continue;
+        }
+
+        if (Best < 0 || IsBetterMode(&Modes[i], &Modes[Best], Profile, Policy))
+        {
+            Best = static_cast<int>(i);
+        }
+    }
+    return Best;
+}
+
+//
+// Pick a mode according to the policy, returns the index of the mode or -1 when there is none
+//
+int SelectMode(const MODE_CANDIDATE* Modes, size_t Count, const HMD_PROFILE* Profile, MODE_POLICY Policy)
+{
+    if (Policy == MODE_POLICY_LOWEST_LATENCY)
+    {
+        return SelectModeAtResolution(Modes, Count, 0, 0, Profile, Policy);
+    }
+
+    // Stay on the profile's resolution, or the one the display prefers
+    uint32_t Width = Profile->Width;
+    uint32_t Height = Profile->Height;
+    if (!Width || !Height)
+    {
+        Width = 0;
+        Height = 0;
+        for (size_t i = 0; i < Count; ++i)
+        {
+            if (Modes[i].Preferred)
+            {
+                Width = Modes[i].Width;
+                Height = Modes[i].Height;
+                break;
+            }
+        }
+    }
+
+    int Best = SelectModeAtResolution(Modes, Count, Width, Height, Profile, Policy);
+    if (Best < 0)
+    {
+        // The resolution we wanted is not offered, take the best rate at any resolution
+        Best = SelectModeAtResolution(Modes, Count, 0, 0, Profile, Policy);
+    }
+    return Best;
+}
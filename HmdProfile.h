@@ -0,0 +1,83 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _HMDPROFILE_H_
+#define _HMDPROFILE_H_
+
+// Like the EDID parser, this file does not depend on Windows headers
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// How to pick the display mode among the ones the headset offers
+//
+typedef enum
+{
+    MODE_POLICY_PROFILE         = 0,    // Profile (or preferred) resolution, refresh rate closest to the profile's
+    MODE_POLICY_HIGHEST_REFRESH = 1,    // Profile (or preferred) resolution, highest refresh rate
+    MODE_POLICY_LOWEST_LATENCY  = 2,    // Highest refresh rate at any resolution, smallest resolution on ties
+    MODE_POLICY_CONTENT         = 3     // Starts like MODE_POLICY_PROFILE, then the refresh rate follows what the desktop shows
+} MODE_POLICY;
+
+//
+// Known headset and how to drive it
+//
+typedef struct _HMD_PROFILE
+{
+    const char* Name;
+
+    // Keyed like EDID_INFO
+    uint16_t VendorId;
+    uint16_t ProductId;
+
+    // Desired resolution, zero for the display's preferred resolution
+    uint32_t Width;
+    uint32_t Height;
+    double RefreshRate;
+
+    // Number of scanout surfaces we cycle through
+    uint32_t ScanoutCount;
+
+    // How early before v-blank the presenter wakes up. This must be sufficient to run our copy shader.
+    uint64_t PacingOffsetNs;
+} HMD_PROFILE;
+
+#define HMD_MIN_SCANOUT_COUNT 2
+#define HMD_MAX_SCANOUT_COUNT 4
+
+//
+// Command line overrides applied on top of the profile, zero means keep the profile's value
+//
+typedef struct _HMD_OPTIONS
+{
+    bool OverrideTarget;
+    uint16_t VendorId;
+    uint16_t ProductId;
+    double RefreshRate;
+    uint32_t ScanoutCount;
+    uint64_t PacingOffsetNs;
+    MODE_POLICY Policy;
+} HMD_OPTIONS;
+
+//
+// One mode reported by the display
+//
+typedef struct _MODE_CANDIDATE
+{
+    uint32_t Width;
+    uint32_t Height;
+    double RefreshRate;
+    bool Preferred;
+} MODE_CANDIDATE;
+
+const HMD_PROFILE* GetHmdProfile(size_t Index);
+const HMD_PROFILE* FindHmdProfile(uint16_t VendorId, uint16_t ProductId);
+bool IsHmdTarget(const HMD_OPTIONS* Options, uint16_t VendorId, uint16_t ProductId);
+void ResolveHmdProfile(const HMD_OPTIONS* Options, uint16_t VendorId, uint16_t ProductId, HMD_PROFILE* Profile);
+int SelectMode(const MODE_CANDIDATE* Modes, size_t Count, const HMD_PROFILE* Profile, MODE_POLICY Policy);
+
+#endif
@@ -0,0 +1,223 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MAPPEDFILE::MAPPEDFILE() : m_Bits(nullptr),
+                           m_Size(0),
+                           m_Writable(false),
+#ifdef _WIN32
+                           m_File(INVALID_HANDLE_VALUE),
+                           m_Mapping(nullptr)
+#else
+                           m_File(-1)
+#endif
+{
+}
+
+MAPPEDFILE::~MAPPEDFILE()
+{
+    Clean();
+}
+
+//
+// Create the file, or empty it, and map Size bytes of it for writing
+//
+bool MAPPEDFILE::Create(const char* Path, uint64_t Size)
+{
+    Clean();
+
+#ifdef _WIN32
+    m_File = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+#else
+    m_File = open(Path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_File < 0)
+    {
+        return false;
+    }
+#endif
+
+    m_Writable = true;
+    if (!Resize(Size))
+    {
+        Clean();
+        return false;
+    }
+    return true;
+}
+
+//
+// Map an existing file for reading
+//
+bool MAPPEDFILE::Open(const char* Path)
+{
+    Clean();
+
+#ifdef _WIN32
+    m_File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER Size;
+    if (m_File == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_File, &Size))
+    {
+        Clean();
+        return false;
+    }
+    m_Size = static_cast<uint64_t>(Size.QuadPart);
+#else
+    m_File = open(Path, O_RDONLY);
+    struct stat Stat;
+    if (m_File < 0 || fstat(m_File, &Stat) != 0)
+    {
+        Clean();
+        return false;
+    }
+    m_Size = static_cast<uint64_t>(Stat.st_size);
+#endif
+
+    m_Writable = false;
+    if (!m_Size || !Map())
+    {
+        Clean();
+        return false;
+    }
+    return true;
+}
+
+bool MAPPEDFILE::Map()
+{
+#ifdef _WIN32
+    m_Mapping = CreateFileMappingA(m_File, nullptr, m_Writable ? PAGE_READWRITE : PAGE_READONLY, static_cast<DWORD>(m_Size >> 32), static_cast<DWORD>(m_Size), nullptr);
+    if (!m_Mapping)
+    {
+        return false;
+    }
+    m_Bits = static_cast<BYTE*>(MapViewOfFile(m_Mapping, m_Writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(m_Size)));
+    return m_Bits != nullptr;
+#else
+    void* Bits = mmap(nullptr, static_cast<size_t>(m_Size), m_Writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, m_File, 0);
+    if (Bits == MAP_FAILED)
+    {
+        return false;
+    }
+    m_Bits = static_cast<BYTE*>(Bits);
+    return true;
+#endif
+}
+
+void MAPPEDFILE::Unmap()
+{
+#ifdef _WIN32
+    if (m_Bits)
+    {
+        UnmapViewOfFile(m_Bits);
+        m_Bits = nullptr;
+    }
+    if (m_Mapping)
+    {
+        CloseHandle(m_Mapping);
+        m_Mapping = nullptr;
+    }
+#else
+    if (m_Bits)
+    {
+        munmap(m_Bits, static_cast<size_t>(m_Size));
+        m_Bits = nullptr;
+    }
+#endif
+}
+
+//
+// Grow or shrink a file opened for writing, pointers into the old mapping are no longer valid
+//
+bool MAPPEDFILE::Resize(uint64_t Size)
+{
+    if (!m_Writable)
+    {
+        return false;
+    }
+
+    Unmap();
+#ifdef _WIN32
+    // The mapping extends the file when it grows, shrinking needs the file cut first
+    LARGE_INTEGER End;
+    End.QuadPart = static_cast<LONGLONG>(Size);
+    if (!SetFilePointerEx(m_File, End, nullptr, FILE_BEGIN) || !SetEndOfFile(m_File))
+    {
+        return false;
+    }
+#else
+    if (ftruncate(m_File, static_cast<off_t>(Size)) != 0)
+    {
+        return false;
+    }
+#endif
+    m_Size = Size;
+    return Map();
+}
+
+BYTE* MAPPEDFILE::GetBits()
+{
+    return m_Bits;
+}
+
+uint64_t MAPPEDFILE::GetSize()
+{
+    return m_Size;
+}
+
+//
+// Unmap and cut a file opened for writing down to what was written
+//
+void MAPPEDFILE::Close(uint64_t FinalSize)
+{
+    if (m_Writable)
+    {
+        Unmap();
+#ifdef _WIN32
+        LARGE_INTEGER End;
+        End.QuadPart = static_cast<LONGLONG>(FinalSize);
+        SetFilePointerEx(m_File, End, nullptr, FILE_BEGIN);
+        SetEndOfFile(m_File);
+#else
+        if (ftruncate(m_File, static_cast<off_t>(FinalSize)) != 0)
+        {
+            // Keeps the zeros past the end, readers stop at the end recorded in the file
+        }
+#endif
+    }
+    Clean();
+}
+
+void MAPPEDFILE::Clean()
+{
+    Unmap();
+#ifdef _WIN32
+    if (m_File != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_File);
+        m_File = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_File >= 0)
+    {
+        close(m_File);
+        m_File = -1;
+    }
+#endif
+    m_Size = 0;
+    m_Writable = false;
+}
@@ -0,0 +1,46 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include "Platform.h"
+
+//
+// File mapped whole into memory, read only or growable for writing
+//
+class MAPPEDFILE
+{
+    public:
+        MAPPEDFILE();
+        ~MAPPEDFILE();
+        bool Create(const char* Path, uint64_t Size);
+        bool Open(const char* Path);
+        bool Resize(uint64_t Size);
+        BYTE* GetBits();
+        uint64_t GetSize();
+        void Close(uint64_t FinalSize);
+        void Clean();
+
+    private:
+    // methods
+        bool Map();
+        void Unmap();
+
+    // variables
+        BYTE* m_Bits;
+        uint64_t m_Size;
+        bool m_Writable;
+#ifdef _WIN32
+        HANDLE m_File;
+        HANDLE m_Mapping;
+#else
+        int m_File;
+#endif
+};
+
+#endif
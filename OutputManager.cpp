@@ -5,27 +5,180 @@
 //
 // Copyright (c) Microsoft Corporation. All rights reserved
 
+#include <chrono>
+#include <DirectXPackedVector.h>
+#include <math.h>
+
 #include "OutputManager.h"
 using namespace DirectX;
 using namespace winrt;
 
-// How early do we request wake up prior to VBlank. This must be sufficient to run our copy shader.
-static constexpr uint64_t OffsetFromVBlank = 5'000'000;
+//
+// Two triangles covering the given clip space rect with the given texture coordinates
+//
+static void SetQuad(_Out_writes_(NUMVERTICES) VERTEX* Vertices, FLOAT Left, FLOAT Top, FLOAT Right, FLOAT Bottom, FLOAT U0, FLOAT V0, FLOAT U1, FLOAT V1)
+{
+    Vertices[0] = {XMFLOAT3(Left, Bottom, 0), XMFLOAT2(U0, V1)};
+    Vertices[1] = {XMFLOAT3(Left, Top, 0), XMFLOAT2(U0, V0)};
+    Vertices[2] = {XMFLOAT3(Right, Bottom, 0), XMFLOAT2(U1, V1)};
+    Vertices[3] = Vertices[2];
+    Vertices[4] = Vertices[1];
+    Vertices[5] = {XMFLOAT3(Right, Top, 0), XMFLOAT2(U1, V0)};
+}
+
+//
+// Whether an output shows HDR content, and the brightness the user picked for SDR white on it
+//
+static bool IsHdrOutput(_In_ IDXGIOutput* Output, _Out_ FLOAT* SdrWhiteNits)
+{
+    *SdrWhiteNits = SCRGB_WHITE_NITS;
+
+    IDXGIOutput6* Output6 = nullptr;
+    HRESULT hr = Output->QueryInterface(__uuidof(Output6), reinterpret_cast<void**>(&Output6));
+    if (FAILED(hr))
+    {
+        return false;
+    }
+
+    DXGI_OUTPUT_DESC1 Desc;
+    hr = Output6->GetDesc1(&Desc);
+    Output6->Release();
+    Output6 = nullptr;
+    if (FAILED(hr) || Desc.ColorSpace != DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020)
+    {
+        return false;
+    }
+
+    // The SDR white level is a property of the display path, find the one driven by this output
+    UINT32 PathCount = 0;
+    UINT32 ModeCount = 0;
+    if (GetDisplayConfigBufferSizes(QDC_ONLY_ACTIVE_PATHS, &PathCount, &ModeCount) != ERROR_SUCCESS)
+    {
+        return true;
+    }
+
+    DISPLAYCONFIG_PATH_INFO* Paths = new (std::nothrow) DISPLAYCONFIG_PATH_INFO[PathCount];
+    DISPLAYCONFIG_MODE_INFO* Modes = new (std::nothrow) DISPLAYCONFIG_MODE_INFO[ModeCount];
+    if (Paths && Modes && QueryDisplayConfig(QDC_ONLY_ACTIVE_PATHS, &PathCount, Paths, &ModeCount, Modes, nullptr) == ERROR_SUCCESS)
+    {
+        for (UINT32 i = 0; i < PathCount; ++i)
+        {
+            DISPLAYCONFIG_SOURCE_DEVICE_NAME SourceName = {};
+            SourceName.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_SOURCE_NAME;
+            SourceName.header.size = sizeof(SourceName);
+            SourceName.header.adapterId = Paths[i].sourceInfo.adapterId;
+            SourceName.header.id = Paths[i].sourceInfo.id;
+            if (DisplayConfigGetDeviceInfo(&SourceName.header) != ERROR_SUCCESS || wcscmp(SourceName.viewGdiDeviceName, Desc.DeviceName) != 0)
+            {
+                continue;
+            }
+
+            DISPLAYCONFIG_SDR_WHITE_LEVEL WhiteLevel = {};
+            WhiteLevel.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_SDR_WHITE_LEVEL;
+            WhiteLevel.header.size = sizeof(WhiteLevel);
+            WhiteLevel.header.adapterId = Paths[i].targetInfo.adapterId;
+            WhiteLevel.header.id = Paths[i].targetInfo.id;
+            if (DisplayConfigGetDeviceInfo(&WhiteLevel.header) == ERROR_SUCCESS)
+            {
+                // In thousandths of the scRGB reference white
+                *SdrWhiteNits = WhiteLevel.SDRWhiteLevel * SCRGB_WHITE_NITS / 1000.0f;
+            }
+            break;
+        }
+    }
+
+    delete [] Paths;
+    delete [] Modes;
+
+    return true;
+}
+
+//
+// One FP16 desktop pixel as the presenter pass shows it (see ToneMap.hlsli), for the pointer code that
+// works on 8 bit desktop pixels. Stays linear, the render target does the sRGB encoding.
+//
+static UINT ToneMapHalfPixel(_In_reads_(4) const PackedVector::HALF* Pixel, FLOAT WhiteScale)
+{
+    FLOAT Color[3];
+    FLOAT Peak = 0.0f;
+    for (UINT i = 0; i < 3; ++i)
+    {
+        Color[i] = max(PackedVector::XMConvertHalfToFloat(Pixel[i]) * WhiteScale, 0.0f);
+        Peak = max(Peak, Color[i]);
+    }
+
+    FLOAT Scale = 1.0f;
+    if (Peak > TONEMAP_KNEE)
+    {
+        FLOAT Over = Peak - TONEMAP_KNEE;
+        Scale = (TONEMAP_KNEE + (1 - TONEMAP_KNEE) * Over / (Over + (1 - TONEMAP_KNEE))) / Peak;
+    }
+
+    UINT Bgra = 0xFF000000;
+    for (UINT i = 0; i < 3; ++i)
+    {
+        UINT Channel = static_cast<UINT>(min(Color[i] * Scale, 1.0f) * 255.0f + 0.5f);
+        Bgra |= Channel << (16 - i * 8);
+    }
+    return Bgra;
+}
 
 //
 // Constructor NULLs out all pointers & sets appropriate var vals
 //
 OUTPUTMANAGER::OUTPUTMANAGER() : m_Device(nullptr),
                                  m_DeviceContext(nullptr),
-                                 m_RTV(nullptr),
                                  m_SamplerLinear(nullptr),
                                  m_BlendState(nullptr),
+                                 m_ScissorRS(nullptr),
                                  m_VertexShader(nullptr),
                                  m_PixelShader(nullptr),
                                  m_InputLayout(nullptr),
                                  m_SharedSurf(nullptr),
-                                 m_KeyMutex(nullptr)
+                                 m_KeyMutex(nullptr),
+                                 m_LastFrame(nullptr),
+                                 m_LastFrameValid(false),
+                                 m_ForceFullCopy(true),
+                                 m_DesktopVersion(1),
+                                 m_MipCount(0),
+                                 m_ResamplePS(nullptr),
+                                 m_AllowHdr(false),
+                                 m_ComputeApply(false),
+                                 m_SharedFormat(DXGI_FORMAT_B8G8R8A8_UNORM),
+                                 m_WhiteScale(1.0f),
+                                 m_ToneMapPS(nullptr),
+                                 m_PresentConstants(nullptr),
+                                 m_PresentConstantsStale(true),
+                                 m_RecordPath(nullptr),
+                                 m_RecordStaging(nullptr),
+                                 m_RecordRectCount(0),
+                                 m_RecordTime(0),
+                                 m_StreamPort(0),
+                                 m_ReadbackValid(false),
+                                 m_Timeline(nullptr),
+                                 m_Governor(nullptr),
+                                 m_FilterShed(false),
+                                 m_AdaptRefresh(false),
+                                 m_ProfileFrame(0),
+                                 m_PointerSource(nullptr)
 {
+    RtlZeroMemory(m_MipRTV, sizeof(m_MipRTV));
+    RtlZeroMemory(m_MipSRV, sizeof(m_MipSRV));
+    RtlZeroMemory(&m_PtrInfo, sizeof(m_PtrInfo));
+    RtlZeroMemory(&m_PendingShape, sizeof(m_PendingShape));
+    RtlZeroMemory(&m_PtrHistory, sizeof(m_PtrHistory));
+    m_Prediction.Mode = PREDICTION_OFF;
+    m_Prediction.Source = POINTER_SOURCE_DXGI;
+    m_Prediction.TracePath = nullptr;
+    m_DesktopOrigin.x = 0;
+    m_DesktopOrigin.y = 0;
+    m_PolicyPointer.x = 0;
+    m_PolicyPointer.y = 0;
+    RtlZeroMemory(&m_HmdOptions, sizeof(m_HmdOptions));
+    RtlZeroMemory(&m_Foveation, sizeof(m_Foveation));
+    m_Scaling.MipLevels = 1;
+    m_Scaling.Filter = SCALING_FILTER_BILINEAR;
+    RtlZeroMemory(&m_Profile, sizeof(m_Profile));
 }
 
 //
@@ -33,8 +186,30 @@ OUTPUTMANAGER::OUTPUTMANAGER() : m_Device(nullptr),
 //
 OUTPUTMANAGER::~OUTPUTMANAGER()
 {
-    WaitNextVBlank();
+    if (m_VBlankFenceOnPresentationDevice)
+    {
+        WaitNextVBlank();
+    }
     CleanRefs();
+
+    if (m_PointerSource)
+    {
+        m_PointerSource->Stop();
+        delete m_PointerSource;
+        m_PointerSource = nullptr;
+    }
+
+    if (m_PtrInfo.PtrShapeBuffer)
+    {
+        delete [] m_PtrInfo.PtrShapeBuffer;
+        m_PtrInfo.PtrShapeBuffer = nullptr;
+    }
+
+    if (m_PendingShape.PtrShapeBuffer)
+    {
+        delete [] m_PendingShape.PtrShapeBuffer;
+        m_PendingShape.PtrShapeBuffer = nullptr;
+    }
 }
 
 //
@@ -45,10 +220,18 @@ DUPL_RETURN OUTPUTMANAGER::InitOutput(INT SingleOutput, _Out_ UINT* OutCount, _O
     HRESULT hr;
 
     // Open the output device and create the backbuffers;
-    OpenOutput(0xd94d, 0xc207, 90.f);
+    DUPL_RETURN Return = OpenOutput();
+    if (Return != DUPL_RETURN_SUCCESS)
+    {
+        return Return;
+    }
+
+    // The presenter's passes go on lane 0 of the timeline
+    m_Profiler.Initialize(m_Device, m_DeviceContext, m_Timeline, 0);
 
     // Create shared texture
-    DUPL_RETURN Return = CreateSharedSurf(SingleOutput, OutCount, DeskBounds);
+    bool SurfaceRecreated;
+    Return = CreateSharedSurf(SingleOutput, OutCount, DeskBounds, &SurfaceRecreated);
     if (Return != DUPL_RETURN_SUCCESS)
     {
         return Return;
@@ -98,6 +281,19 @@ DUPL_RETURN OUTPUTMANAGER::InitOutput(INT SingleOutput, _Out_ UINT* OutCount, _O
         return ProcessFailure(m_Device, L"Failed to create blend state in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
     }
 
+    // Same as the default rasterizer state but scissored, for putting the desktop back under the pointer
+    D3D11_RASTERIZER_DESC RasterizerDesc;
+    RtlZeroMemory(&RasterizerDesc, sizeof(RasterizerDesc));
+    RasterizerDesc.FillMode = D3D11_FILL_SOLID;
+    RasterizerDesc.CullMode = D3D11_CULL_BACK;
+    RasterizerDesc.DepthClipEnable = TRUE;
+    RasterizerDesc.ScissorEnable = TRUE;
+    hr = m_Device->CreateRasterizerState(&RasterizerDesc, &m_ScissorRS);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create rasterizer state in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
     // Initialize shaders
     Return = InitShaders();
     if (Return != DUPL_RETURN_SUCCESS)
@@ -108,10 +304,94 @@ DUPL_RETURN OUTPUTMANAGER::InitOutput(INT SingleOutput, _Out_ UINT* OutCount, _O
     return Return;
 }
 
+//
+// Select the headset and how to drive it, takes effect on the next InitOutput
+//
+void OUTPUTMANAGER::SetHmdOptions(_In_ const HMD_OPTIONS* Options)
+{
+    m_HmdOptions = *Options;
+}
+
+//
+// Takes effect when the shared surface is next created
+//
+void OUTPUTMANAGER::SetFoveationOptions(_In_ const FOVEATION_OPTIONS* Options)
+{
+    m_Foveation = *Options;
+}
+
+//
+// Whether HDR desktops are captured in FP16, whether the duplication threads may write the shared surface from
+// compute shaders, whether to record or stream and where to time passes to, takes effect on the next InitOutput or
+// ResetDesktop
+//
+void OUTPUTMANAGER::SetDuplicationOptions(_In_ const DUPLICATION_OPTIONS* Options)
+{
+    m_AllowHdr = Options->Hdr;
+    m_ComputeApply = Options->ComputeApply;
+    m_RecordPath = Options->RecordPath;
+    m_StreamPort = Options->StreamPort;
+    m_Timeline = Options->Timeline;
+    m_Governor = Options->Governor;
+}
+
+//
+// How to place the pointer, and whether to trace its updates. Takes effect on the next frame.
+//
+void OUTPUTMANAGER::SetPredictionOptions(_In_ const PREDICTION_OPTIONS* Options)
+{
+    m_Prediction = *Options;
+    if (m_Prediction.TracePath && !m_PointerTrace.Create(m_Prediction.TracePath))
+    {
+        // The trace is a tuning aid, carry on without it
+        m_Prediction.TracePath = nullptr;
+    }
+
+    if (m_Prediction.Source == POINTER_SOURCE_CURSOR && !m_PointerSource)
+    {
+        m_PointerSource = new (std::nothrow) CURSORPOINTERSOURCE;
+        if (m_PointerSource && !m_PointerSource->Start(&m_PointerStream))
+        {
+            delete m_PointerSource;
+            m_PointerSource = nullptr;
+        }
+        if (!m_PointerSource)
+        {
+            // DXGI pointer updates are always there to fall back to
+            m_Prediction.Source = POINTER_SOURCE_DXGI;
+        }
+    }
+}
+
+//
+// Select the mip levels and filter used to resample the desktop onto the headset, takes effect on the next InitOutput
+//
+void OUTPUTMANAGER::SetScalingOptions(_In_ const SCALING_OPTIONS* Options)
+{
+    m_Scaling = *Options;
+}
+
+//
+// Re-read the desktop layout after a capture side transition. The direct display output, scanout surfaces
+// and fences are kept; the shared texture is only recreated when the desktop size changed.
+//
+DUPL_RETURN OUTPUTMANAGER::ResetDesktop(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds, _Out_ bool* SurfaceRecreated)
+{
+    return CreateSharedSurf(SingleOutput, OutCount, DeskBounds, SurfaceRecreated);
+}
+
+//
+// Whether the HMD side must be rebuilt from scratch
+//
+bool OUTPUTMANAGER::IsOutputLost()
+{
+    return !m_Device || !m_SharedSurf || (m_Device->GetDeviceRemovedReason() != S_OK);
+}
+
 //
 // Open Direct Display Output.
 //
-DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, float refreshRate) {
+DUPL_RETURN OUTPUTMANAGER::OpenOutput() {
     // First, we disable Nvidia's protection of direct display mode devices. This is an undocumented API,
     // but the function ID is available online.
     {
@@ -131,7 +411,18 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
                 if (NvAPI_Initialize && NvAPI_DISP_DisableDirectMode)
                 {
                     DWORD retInitialize = NvAPI_Initialize();
-                    DWORD retDisableDirectMode = NvAPI_DISP_DisableDirectMode(vendorId, 0);
+                    if (m_HmdOptions.OverrideTarget)
+                    {
+                        NvAPI_DISP_DisableDirectMode(m_HmdOptions.VendorId, 0);
+                    }
+                    else
+                    {
+                        const HMD_PROFILE* profile;
+                        for (size_t i = 0; (profile = GetHmdProfile(i)) != nullptr; i++)
+                        {
+                            NvAPI_DISP_DisableDirectMode(profile->VendorId, 0);
+                        }
+                    }
                 }
             }
             FreeLibrary(nvapi);
@@ -150,11 +441,15 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
             continue;
         }
         winrt::com_array<uint8_t> edidBuffer = monitor.GetDescriptor(winrt::DisplayMonitorDescriptorKind::Edid);
-        const uint16_t deviceVendorId = *(uint16_t*)(edidBuffer.data() + 8);
-        const uint16_t deviceProductId = *(uint16_t*)(edidBuffer.data() + 10);
+        EDID_INFO edid;
+        if (!ParseEdid(edidBuffer.data(), edidBuffer.size(), &edid))
+        {
+            continue;
+        }
 
-        if (deviceVendorId == vendorId && deviceProductId == productId)
+        if (IsHmdTarget(&m_HmdOptions, edid.VendorId, edid.ProductId))
         {
+            ResolveHmdProfile(&m_HmdOptions, edid.VendorId, edid.ProductId, &m_Profile);
             myTargets.Append(target);
             break;
         }
@@ -184,26 +479,51 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
     // Output format cannot be sRGB, but our RTVs will be.
     path.SourcePixelFormat(winrt::DirectXPixelFormat::B8G8R8A8UIntNormalized);
 
-    // Pick the desired refresh rate.
-    winrt::IVectorView<winrt::DisplayModeInfo> modes = path.FindModes(winrt::DisplayModeQueryOptions::OnlyPreferredResolution);
-    winrt::DisplayModeInfo bestMode{ nullptr };
-    double bestModeDiff = INFINITY;
-    for (auto&& mode : modes)
+    // Pick the mode according to the profile and policy. The preferred resolution query tells us which modes are native.
+    winrt::SizeInt32 preferredResolution{};
+    winrt::IVectorView<winrt::DisplayModeInfo> preferredModes = path.FindModes(winrt::DisplayModeQueryOptions::OnlyPreferredResolution);
+    if (preferredModes.Size())
     {
-        auto vSync = mode.PresentationRate().VerticalSyncRate;
-        double vSyncDouble = (double)vSync.Numerator / vSync.Denominator;
+        preferredResolution = preferredModes.GetAt(0).TargetResolution();
+    }
 
-        double modeDiff = abs(vSyncDouble - refreshRate);
-        if (modeDiff < bestModeDiff)
+    winrt::IVectorView<winrt::DisplayModeInfo> modes = path.FindModes(winrt::DisplayModeQueryOptions::None);
+    std::vector<winrt::DisplayModeInfo> modeInfos;
+    std::vector<MODE_CANDIDATE> candidates;
+    for (auto&& mode : modes)
+    {
+        if (mode.IsInterlaced() || mode.IsStereo())
         {
-            bestMode = mode;
-            bestModeDiff = modeDiff;
+            continue;
         }
+
+        auto vSync = mode.PresentationRate().VerticalSyncRate;
+        auto resolution = mode.TargetResolution();
+
+        MODE_CANDIDATE candidate;
+        candidate.Width = resolution.Width;
+        candidate.Height = resolution.Height;
+        candidate.RefreshRate = (double)vSync.Numerator / vSync.Denominator;
+        candidate.Preferred = (resolution.Width == preferredResolution.Width && resolution.Height == preferredResolution.Height);
+        candidates.push_back(candidate);
+        modeInfos.push_back(mode);
     }
 
-    if (bestMode)
+    int bestMode = SelectMode(candidates.data(), candidates.size(), &m_Profile, m_HmdOptions.Policy);
+    if (bestMode >= 0)
     {
-        path.ApplyPropertiesFromMode(bestMode);
+        path.ApplyPropertiesFromMode(modeInfos[bestMode]);
+
+        wchar_t msg[160];
+        swprintf_s(msg, L"OUTPUTMANAGER: driving %S (%04x:%04x) at %ux%u %.2f Hz with %u scanouts\n", m_Profile.Name, m_Profile.VendorId, m_Profile.ProductId,
+                   candidates[bestMode].Width, candidates[bestMode].Height, candidates[bestMode].RefreshRate, m_Profile.ScanoutCount);
+        OutputDebugStringW(msg);
+
+        // Everything the presenter does has to be done in the time it wakes before v-blank
+        if (m_Governor)
+        {
+            m_Governor->Initialize(static_cast<uint64_t>(1000000000.0 / candidates[bestMode].RefreshRate), m_Profile.PacingOffsetNs);
+        }
     }
     else
     {
@@ -228,10 +548,21 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
 
     m_DisplayTarget = std::move(target);
     m_DisplayDevice = std::move(m_DisplayManager.CreateDisplayDevice(m_DisplayTarget.Adapter()));
+
+    // Keep what it takes to switch the rate later, when there is another rate at this resolution to switch to
+    m_AdaptRefresh = (m_HmdOptions.Policy == MODE_POLICY_CONTENT) && m_RefreshPolicy.Initialize(candidates.data(), candidates.size(), bestMode);
+    if (m_AdaptRefresh)
+    {
+        m_DisplayTargets = myTargets;
+        m_DisplayModes = std::move(modeInfos);
+        StopModeSwitchThread();
+        m_ModeSwitcher = std::thread(&OUTPUTMANAGER::ModeSwitchThread, this);
+    }
     m_DisplayTaskPool = m_DisplayDevice.CreateTaskPool();
 
     // Create the D3D device we will use for this output.
     auto adapterLuid = m_DisplayTarget.Adapter().Id();
+    m_AdapterLuid = { adapterLuid.LowPart, adapterLuid.HighPart };
 
     {
         com_ptr<IDXGIFactory6> dxgiFactory;
@@ -300,7 +631,7 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
             multisampleDesc
         };
 
-        for (uint32_t i = 0; i < 2; i++)
+        for (uint32_t i = 0; i < m_Profile.ScanoutCount; i++)
         {
             OutputSurface surface{};
 
@@ -371,7 +702,7 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
 
     // Create a fence to wake up the presentation thread to perform LSR just before scanout.
     {
-        m_VBlankFenceOnDisplayDevice = m_DisplayDevice.CreatePeriodicFence(m_DisplayTarget, std::chrono::milliseconds(OffsetFromVBlank / 1'000'000));
+        m_VBlankFenceOnDisplayDevice = m_DisplayDevice.CreatePeriodicFence(m_DisplayTarget, std::chrono::duration_cast<winrt::TimeSpan>(std::chrono::nanoseconds(m_Profile.PacingOffsetNs)));
 
         winrt::handle handle;
         hr = deviceInterop->CreateSharedHandle(m_VBlankFenceOnDisplayDevice.as<::IInspectable>().get(), nullptr, GENERIC_ALL,nullptr, handle.put());
@@ -395,10 +726,12 @@ DUPL_RETURN OUTPUTMANAGER::OpenOutput(uint16_t vendorId, uint16_t productId, flo
 //
 // Recreate shared texture
 //
-DUPL_RETURN OUTPUTMANAGER::CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds)
+DUPL_RETURN OUTPUTMANAGER::CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds, _Out_ bool* SurfaceRecreated)
 {
     HRESULT hr;
 
+    *SurfaceRecreated = false;
+
     // Get DXGI resources
     IDXGIDevice* DxgiDevice = nullptr;
     hr = m_Device->QueryInterface(__uuidof(IDXGIDevice), reinterpret_cast<void**>(&DxgiDevice));
@@ -424,6 +757,10 @@ DUPL_RETURN OUTPUTMANAGER::CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCou
 
     IDXGIOutput* DxgiOutput = nullptr;
 
+    // Whether any output shows HDR content, we then capture everything in FP16
+    bool Hdr = false;
+    FLOAT SdrWhiteNits = SCRGB_WHITE_NITS;
+
     // Figure out right dimensions for full size desktop texture and # of outputs to duplicate
     UINT OutputCount;
     if (SingleOutput < 0)
@@ -446,6 +783,13 @@ DUPL_RETURN OUTPUTMANAGER::CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCou
                 DeskBounds->top = min(DesktopDesc.DesktopCoordinates.top, DeskBounds->top);
                 DeskBounds->right = max(DesktopDesc.DesktopCoordinates.right, DeskBounds->right);
                 DeskBounds->bottom = max(DesktopDesc.DesktopCoordinates.bottom, DeskBounds->bottom);
+
+                FLOAT OutputWhiteNits;
+                if (m_AllowHdr && IsHdrOutput(DxgiOutput, &OutputWhiteNits))
+                {
+                    SdrWhiteNits = Hdr ? max(SdrWhiteNits, OutputWhiteNits) : OutputWhiteNits;
+                    Hdr = true;
+                }
             }
         }
 
@@ -464,6 +808,8 @@ DUPL_RETURN OUTPUTMANAGER::CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCou
         DxgiOutput->GetDesc(&DesktopDesc);
         *DeskBounds = DesktopDesc.DesktopCoordinates;
 
+        Hdr = m_AllowHdr && IsHdrOutput(DxgiOutput, &SdrWhiteNits);
+
         DxgiOutput->Release();
         DxgiOutput = nullptr;
 
@@ -473,107 +819,912 @@ DUPL_RETURN OUTPUTMANAGER::CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCou
     DxgiAdapter->Release();
     DxgiAdapter = nullptr;
 
-    // Set passed in output count variable
-    *OutCount = OutputCount;
+    // Set passed in output count variable
+    *OutCount = OutputCount;
+
+    if (OutputCount == 0)
+    {
+        // We could not find any outputs, the system must be in a transition so return expected error
+        // so we will attempt to recreate
+        return DUPL_RETURN_ERROR_EXPECTED;
+    }
+
+    // The presenter pass brings SDR white of the HDR desktop to the white of the headset
+    DXGI_FORMAT Format = Hdr ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_B8G8R8A8_UNORM;
+    m_WhiteScale = SCRGB_WHITE_NITS / SdrWhiteNits;
+    m_PresentConstantsStale = true;
+    ++m_DesktopVersion;
+    m_DesktopOrigin.x = DeskBounds->left;
+    m_DesktopOrigin.y = DeskBounds->top;
+
+    // Keep the current shared texture if the desktop still fits it exactly, and it was created whole
+    if (m_SharedSurf && m_KeyMutex && m_LastFrame)
+    {
+        D3D11_TEXTURE2D_DESC CurrentDesc;
+        m_SharedSurf->GetDesc(&CurrentDesc);
+        if ((CurrentDesc.Width == static_cast<UINT>(DeskBounds->right - DeskBounds->left)) &&
+            (CurrentDesc.Height == static_cast<UINT>(DeskBounds->bottom - DeskBounds->top)) &&
+            (CurrentDesc.Format == Format))
+        {
+            return DUPL_RETURN_SUCCESS;
+        }
+    }
+    CleanSharedSurf();
+    *SurfaceRecreated = true;
+
+    // Create shared texture for all duplication threads to draw into
+    D3D11_TEXTURE2D_DESC DeskTexD;
+    RtlZeroMemory(&DeskTexD, sizeof(D3D11_TEXTURE2D_DESC));
+    DeskTexD.Width = DeskBounds->right - DeskBounds->left;
+    DeskTexD.Height = DeskBounds->bottom - DeskBounds->top;
+    DeskTexD.MipLevels = 1;
+    DeskTexD.ArraySize = 1;
+    DeskTexD.Format = Format;
+    DeskTexD.SampleDesc.Count = 1;
+    DeskTexD.Usage = D3D11_USAGE_DEFAULT;
+    DeskTexD.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    DeskTexD.CPUAccessFlags = 0;
+    DeskTexD.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+    if (m_ComputeApply && SupportsComputeApply(m_Device, Format))
+    {
+        DeskTexD.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
+    }
+
+    hr = m_Device->CreateTexture2D(&DeskTexD, nullptr, &m_SharedSurf);
+    if (FAILED(hr))
+    {
+        if (OutputCount != 1)
+        {
+            // If we are duplicating the complete desktop we try to create a single texture to hold the
+            // complete desktop image and blit updates from the per output DDA interface.  The GPU can
+            // always support a texture size of the maximum resolution of any single output but there is no
+            // guarantee that it can support a texture size of the desktop.
+            // The sample only use this large texture to display the desktop image in a single window using DX
+            // we could revert back to using GDI to update the window in this failure case.
+            return ProcessFailure(m_Device, L"Failed to create DirectX shared texture - we are attempting to create a texture the size of the complete desktop and this may be larger than the maximum texture size of your GPU.  Please try again using the -output command line parameter to duplicate only 1 monitor or configure your computer to a single monitor configuration", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+        else
+        {
+            return ProcessFailure(m_Device, L"Failed to create shared texture", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    m_SharedFormat = Format;
+
+    // Get keyed mutex
+    hr = m_SharedSurf->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void**>(&m_KeyMutex));
+    if (FAILED(hr))
+    {
+        CleanSharedSurf();
+        return ProcessFailure(m_Device, L"Failed to query for keyed mutex in OUTPUTMANAGER", L"Error", hr);
+    }
+
+    // Create the presenter's copy of the desktop, with the mip levels we resample and foveate from
+    UINT WantedLevels = m_Scaling.MipLevels;
+    if (m_Foveation.Mode != FOVEATION_OFF)
+    {
+        WantedLevels = max(WantedLevels, GetFoveationLevel(&m_Foveation) + 1);
+    }
+    DeskTexD.MipLevels = GetMipCount(DeskTexD.Width, DeskTexD.Height, WantedLevels);
+    DeskTexD.BindFlags = D3D11_BIND_SHADER_RESOURCE | ((DeskTexD.MipLevels > 1) ? D3D11_BIND_RENDER_TARGET : 0);
+    DeskTexD.MiscFlags = 0;
+    hr = m_Device->CreateTexture2D(&DeskTexD, nullptr, &m_LastFrame);
+    if (FAILED(hr))
+    {
+        CleanSharedSurf();
+        return ProcessFailure(m_Device, L"Failed to create last frame texture in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    m_LastFrameValid = false;
+    m_ForceFullCopy = true;
+    m_MipCount = DeskTexD.MipLevels;
+
+    if (m_MipCount > 1)
+    {
+        DUPL_RETURN Ret = CreateMips(&DeskTexD);
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            CleanSharedSurf();
+            return Ret;
+        }
+    }
+
+    // The frame log and the stream carry 8 bit tiles, an FP16 desktop ends them rather than going missing unnoticed
+    if (m_RecordPath && m_SharedFormat != DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        DisplayMsg(L"Recording stopped, only 8 bit desktops can be recorded. Leave out /hdr to record an HDR desktop.", L"Error", S_OK);
+        m_RecordPath = nullptr;
+        m_Recorder.Close();
+    }
+    if (m_StreamPort && m_SharedFormat != DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        DisplayMsg(L"Streaming stopped, only 8 bit desktops can be streamed. Leave out /hdr to stream an HDR desktop.", L"Error", S_OK);
+        StopStream();
+    }
+    if (m_RecordPath || m_StreamPort)
+    {
+        DUPL_RETURN Ret = CreateRecordStaging(&DeskTexD);
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            CleanSharedSurf();
+            return Ret;
+        }
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Release the shared surface and everything made to go with it, so none of it is left half created
+//
+void OUTPUTMANAGER::CleanSharedSurf()
+{
+    if (m_SharedSurf)
+    {
+        m_SharedSurf->Release();
+        m_SharedSurf = nullptr;
+    }
+
+    if (m_KeyMutex)
+    {
+        m_KeyMutex->Release();
+        m_KeyMutex = nullptr;
+    }
+
+    if (m_LastFrame)
+    {
+        m_LastFrame->Release();
+        m_LastFrame = nullptr;
+    }
+    m_LastFrameValid = false;
+    m_ForceFullCopy = true;
+
+    CleanMips();
+
+    // Regions still in the staging texture go to the recorder before it is resized or closed
+    DrainRecording();
+    CleanRecordStaging();
+}
+
+//
+// Create the texture frames are read back through for the recorder and the stream, and start them or follow the new
+// desktop size
+//
+DUPL_RETURN OUTPUTMANAGER::CreateRecordStaging(_In_ D3D11_TEXTURE2D_DESC* DeskDesc)
+{
+    D3D11_TEXTURE2D_DESC StagingDesc = *DeskDesc;
+    StagingDesc.MipLevels = 1;
+    StagingDesc.Usage = D3D11_USAGE_STAGING;
+    StagingDesc.BindFlags = 0;
+    StagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    StagingDesc.MiscFlags = 0;
+    HRESULT hr = m_Device->CreateTexture2D(&StagingDesc, nullptr, &m_RecordStaging);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create recording staging texture in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    m_RecordRectCount = 0;
+    m_ReadbackValid = false;
+
+    if (m_RecordPath)
+    {
+        bool Recording = m_Recorder.IsRecording() ? m_Recorder.Resize(StagingDesc.Width, StagingDesc.Height) : m_Recorder.Initialize(m_RecordPath, StagingDesc.Width, StagingDesc.Height);
+        if (!Recording)
+        {
+            // Recording is a debugging aid, carry on without it
+            DisplayMsg(L"Recording stopped, the frame log could not be written.", L"Error", S_OK);
+            m_RecordPath = nullptr;
+        }
+    }
+    if (m_StreamPort)
+    {
+        StartStream(StagingDesc.Width, StagingDesc.Height);
+    }
+    if (!m_RecordPath && !m_StreamPort)
+    {
+        CleanRecordStaging();
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+void OUTPUTMANAGER::CleanRecordStaging()
+{
+    if (m_RecordStaging)
+    {
+        m_RecordStaging->Release();
+        m_RecordStaging = nullptr;
+    }
+    m_RecordRectCount = 0;
+    m_ReadbackValid = false;
+}
+
+//
+// Listen for the streaming client, or follow the new desktop size. A connected client keeps its connection while
+// the frames still fit the channel, and is sent every tile again.
+//
+void OUTPUTMANAGER::StartStream(UINT Width, UINT Height)
+{
+    STREAM_OPTIONS StreamOptions = {STREAM_DEFAULT_QUEUED_FRAMES, STREAM_DEFAULT_QUEUED_BYTES, false};
+    if (m_StreamChannel.IsOpen() && m_Sink.Initialize(Width, Height, &m_StreamCodec, nullptr, &m_StreamChannel, &StreamOptions))
+    {
+        return;
+    }
+
+    // Room for the frames the sink may queue and a whole frame sent at its worst on top
+    UINT Capacity = STREAM_DEFAULT_QUEUED_BYTES + 3 * Width * Height * BPP;
+    if (!m_StreamChannel.Listen(static_cast<uint16_t>(m_StreamPort), Capacity) ||
+        !m_Sink.Initialize(Width, Height, &m_StreamCodec, nullptr, &m_StreamChannel, &StreamOptions))
+    {
+        // Streaming is optional, carry on without it
+        DisplayMsg(L"Streaming stopped, could not listen for a client. Check that no other program uses the /stream port.", L"Error", S_OK);
+        StopStream();
+    }
+}
+
+void OUTPUTMANAGER::StopStream()
+{
+    m_Sink.Clean();
+    m_StreamChannel.Clean();
+    m_StreamPort = 0;
+}
+
+//
+// Hand the regions copied into the staging texture on the previous v-blank to the recorder and the stream. The GPU
+// had a whole refresh to finish the copy, so mapping does not wait. Never called with the keyed mutex held, the copy
+// of a full frame into the recorder's slot or its compression for the client would hold up the duplication threads.
+//
+DUPL_RETURN OUTPUTMANAGER::DrainRecording()
+{
+    if (!m_RecordStaging || !m_DeviceContext)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    // The client went away, the tiles it missed go to the next one with everything else
+    if (m_StreamPort && m_StreamChannel.HasFailed())
+    {
+        D3D11_TEXTURE2D_DESC StagingDesc;
+        m_RecordStaging->GetDesc(&StagingDesc);
+        StartStream(StagingDesc.Width, StagingDesc.Height);
+    }
+
+    // Held back tiles are retried without new damage, and no client is sent a frame not wholly read back yet
+    bool Stream = m_StreamPort && m_ReadbackValid && m_StreamChannel.IsConnected() && (m_RecordRectCount || m_Sink.HasPending());
+    bool Record = m_RecordPath && m_RecordRectCount;
+    if (!Stream && !Record)
+    {
+        m_RecordRectCount = 0;
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    D3D11_TEXTURE2D_DESC StagingDesc;
+    m_RecordStaging->GetDesc(&StagingDesc);
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    HRESULT hr = m_DeviceContext->Map(m_RecordStaging, 0, D3D11_MAP_READ, 0, &Mapped);
+    if (FAILED(hr))
+    {
+        m_RecordRectCount = 0;
+        return ProcessFailure(m_Device, L"Failed to map recording staging texture in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    SOFTWARE_SURFACE Frame = {static_cast<BYTE*>(Mapped.pData), StagingDesc.Width, StagingDesc.Height, Mapped.RowPitch};
+    if (Record)
+    {
+        m_Recorder.RecordFrame(&Frame, m_RecordRects, m_RecordRectCount, m_RecordTime);
+    }
+    if (Stream)
+    {
+        uint64_t Timestamp = m_RecordRectCount ? m_RecordTime : static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        m_Sink.SubmitFrame(&Frame, m_RecordRects, m_RecordRectCount, Timestamp);
+    }
+    m_DeviceContext->Unmap(m_RecordStaging, 0);
+    m_RecordRectCount = 0;
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Copy this frame's regions into the staging texture for DrainRecording to pick up on the next v-blank. Regions
+// are grown to whole tiles, the recorder and the sink take the tiles under them. Only GPU copies are queued here, so it is
+// cheap enough to run under the keyed mutex.
+//
+DUPL_RETURN OUTPUTMANAGER::RecordFrame(_In_reads_(RectCount) const RECT* Rects, UINT RectCount)
+{
+    if (!m_RecordStaging || !RectCount)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    // Regions from a v-blank that was not drained would be overwritten
+    if (m_RecordRectCount)
+    {
+        DUPL_RETURN Ret = DrainRecording();
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            return Ret;
+        }
+    }
+
+    D3D11_TEXTURE2D_DESC StagingDesc;
+    m_RecordStaging->GetDesc(&StagingDesc);
+
+    for (UINT i = 0; i < RectCount; ++i)
+    {
+        RECT Aligned;
+        Aligned.left = Rects[i].left / TILE_SIZE * TILE_SIZE;
+        Aligned.top = Rects[i].top / TILE_SIZE * TILE_SIZE;
+        Aligned.right = min(static_cast<LONG>((Rects[i].right + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE), static_cast<LONG>(StagingDesc.Width));
+        Aligned.bottom = min(static_cast<LONG>((Rects[i].bottom + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE), static_cast<LONG>(StagingDesc.Height));
+
+        D3D11_BOX Box;
+        Box.left = Aligned.left;
+        Box.top = Aligned.top;
+        Box.front = 0;
+        Box.right = Aligned.right;
+        Box.bottom = Aligned.bottom;
+        Box.back = 1;
+        m_DeviceContext->CopySubresourceRegion(m_RecordStaging, 0, Aligned.left, Aligned.top, 0, m_LastFrame, 0, &Box);
+        m_RecordRects[m_RecordRectCount++] = Aligned;
+    }
+
+    // The first copy after the staging texture was created is always of the whole frame
+    m_ReadbackValid = true;
+    m_RecordTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Create the views used to build each mip level of our desktop copy from the one above it
+//
+DUPL_RETURN OUTPUTMANAGER::CreateMips(_In_ D3D11_TEXTURE2D_DESC* DeskDesc)
+{
+    for (UINT Level = 0; Level < m_MipCount; ++Level)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC SrvDesc;
+        SrvDesc.Format = DeskDesc->Format;
+        SrvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        SrvDesc.Texture2D.MostDetailedMip = Level;
+        SrvDesc.Texture2D.MipLevels = 1;
+        HRESULT hr = m_Device->CreateShaderResourceView(m_LastFrame, &SrvDesc, &m_MipSRV[Level]);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create mip shader resource view in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+
+        // Level 0 is only ever copied into
+        if (!Level)
+        {
+            continue;
+        }
+
+        D3D11_RENDER_TARGET_VIEW_DESC RtvDesc;
+        RtvDesc.Format = DeskDesc->Format;
+        RtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+        RtvDesc.Texture2D.MipSlice = Level;
+        hr = m_Device->CreateRenderTargetView(m_LastFrame, &RtvDesc, &m_MipRTV[Level]);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create mip render target view in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+void OUTPUTMANAGER::CleanMips()
+{
+    for (UINT Level = 0; Level < MIP_MAX_LEVELS; ++Level)
+    {
+        if (m_MipSRV[Level])
+        {
+            m_MipSRV[Level]->Release();
+            m_MipSRV[Level] = nullptr;
+        }
+
+        if (m_MipRTV[Level])
+        {
+            m_MipRTV[Level]->Release();
+            m_MipRTV[Level] = nullptr;
+        }
+    }
+    m_MipCount = 0;
+}
+
+
+//
+// Present to the application window
+//
+DUPL_RETURN OUTPUTMANAGER::UpdateApplicationWindow(_In_ PTR_INFO* PointerInfo, _In_ PTR_POSITION* PtrPosition, _Inout_ DAMAGE_INFO* Damage)
+{
+    // In a typical desktop duplication application there would be an application running on one system collecting the desktop images
+    // and another application running on a different system that receives the desktop images via a network and display the image. This
+    // sample contains both these aspects into a single application.
+    // This routine is the part of the sample that displays the desktop image onto the display
+
+    // Everything allocated for the previous frame has been consumed
+    m_Arena.Reset();
+
+    // Record what the last v-blank copied out, before taking the keyed mutex and whether or not anything changed
+    // since, so the last change before the desktop goes idle is recorded too
+    DUPL_RETURN RecordRet = DrainRecording();
+    if (RecordRet != DUPL_RETURN_SUCCESS)
+    {
+        return RecordRet;
+    }
+
+    // Pick up whatever the duplication threads produced since the last v-blank. We never wait on the keyed mutex
+    // here: when duplication is busy, stalled or being restarted we keep scanning out the last good frame.
+    HRESULT hr = m_KeyMutex->AcquireSync(1, 0);
+    if (hr == static_cast<HRESULT>(WAIT_TIMEOUT))
+    {
+        // No new frame
+    }
+    else if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to acquire Keyed mutex in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    else
+    {
+        // We have keyed mutex so we can access the desktop and the mouse info
+        DUPL_RETURN Ret = UpdateLastFrame(Damage);
+        if (Ret == DUPL_RETURN_SUCCESS)
+        {
+            Ret = UpdatePointer(PointerInfo);
+        }
+
+        // Release keyed mutex
+        hr = m_KeyMutex->ReleaseSync(0);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to Release Keyed mutex in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            return Ret;
+        }
+    }
+    ApplyPendingShape();
+
+    // A pointer source has its own lock free stream, of hot spots sampled far more often than DXGI reports moves
+    bool FromSource = m_PointerSource && m_PointerStream.Read(&m_PtrHistory);
+
+    // Pointer moves come in without the keyed mutex, duplication threads only hold this lock for a few stores
+    AcquireSRWLockShared(&PtrPosition->Lock);
+    m_PtrInfo.Position = PtrPosition->Position;
+    m_PtrInfo.Visible = PtrPosition->Visible;
+    m_PtrInfo.WhoUpdatedPositionLast = PtrPosition->WhoUpdatedPositionLast;
+    m_PtrInfo.LastTimeStamp = PtrPosition->LastTimeStamp;
+    if (!FromSource)
+    {
+        m_PtrHistory = PtrPosition->History;
+    }
+    ReleaseSRWLockShared(&PtrPosition->Lock);
+
+    if (m_Prediction.TracePath)
+    {
+        m_PointerTrace.Write(&m_PtrHistory);
+    }
+
+    // Every v-blank and pointer move goes to the refresh policy, which may want another rate from here on
+    if (m_AdaptRefresh)
+    {
+        LARGE_INTEGER VBlankTime;
+        QueryPerformanceCounter(&VBlankTime);
+        uint64_t VBlankNs = QpcToNs(VBlankTime.QuadPart);
+        if (m_PtrInfo.Position.x != m_PolicyPointer.x || m_PtrInfo.Position.y != m_PolicyPointer.y)
+        {
+            m_RefreshPolicy.AddPointerMove(VBlankNs);
+            m_PolicyPointer = m_PtrInfo.Position;
+        }
+
+        // Only one switch is under way at a time, the policy keeps deciding from the rate still on the headset
+        int Mode = m_RefreshPolicy.AddVBlank(VBlankNs);
+        if (m_ModePending >= 0)
+        {
+            FinishModeSwitch(VBlankNs);
+        }
+        else if (Mode != m_RefreshPolicy.GetMode())
+        {
+            RequestModeSwitch(Mode);
+        }
+    }
+
+    // Nothing was ever duplicated, keep whatever is on the headset
+    if (!m_LastFrameValid)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+    m_Profiler.BeginFrame(m_ProfileFrame++);
+
+    // Filtering comes back once the governor allows it: the mip levels are rebuilt whole and every scanout
+    // surface is redrawn
+    if (m_Governor && !m_Governor->FiltersFrames())
+    {
+        m_FilterShed = true;
+    }
+    else if (m_FilterShed)
+    {
+        m_FilterShed = false;
+        ++m_DesktopVersion;
+        if (m_MipCount > 1)
+        {
+            D3D11_TEXTURE2D_DESC FullDesc;
+            m_LastFrame->GetDesc(&FullDesc);
+            RECT FullRect = {0, 0, static_cast<LONG>(FullDesc.Width), static_cast<LONG>(FullDesc.Height)};
+            DUPL_RETURN Ret = UpdateMips(&FullRect, 1);
+            if (Ret != DUPL_RETURN_SUCCESS)
+            {
+                m_Profiler.EndFrame();
+                return Ret;
+            }
+        }
+    }
+
+    // We woke PacingOffsetNs before the v-blank this frame is scanned out at, show the pointer where it will be by then
+    POINT Predicted;
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+    uint64_t NowNs = QpcToNs(Now.QuadPart);
+    if ((FromSource || m_Prediction.Mode != PREDICTION_OFF) && m_PtrInfo.Visible && PredictPointer(&m_PtrHistory, m_Prediction.Mode, NowNs, NowNs + m_Profile.PacingOffsetNs, &Predicted))
+    {
+        // The source samples the hot spot on the virtual screen, DXGI reports the top left of the shape on the desktop
+        if (FromSource)
+        {
+            const POINTER_SAMPLE* Newest = &m_PtrHistory.Samples[(m_PtrHistory.Count - 1) % POINTER_HISTORY_SIZE];
+            LONG OffsetX = m_DesktopOrigin.x + m_PtrInfo.ShapeInfo.HotSpot.x;
+            LONG OffsetY = m_DesktopOrigin.y + m_PtrInfo.ShapeInfo.HotSpot.y;
+            m_PtrInfo.Position.x = Newest->X - OffsetX;
+            m_PtrInfo.Position.y = Newest->Y - OffsetY;
+            Predicted.x -= OffsetX;
+            Predicted.y -= OffsetY;
+        }
+
+        // Not past the edges of the desktop, unless the shape already hangs over them
+        D3D11_TEXTURE2D_DESC FullDesc;
+        m_LastFrame->GetDesc(&FullDesc);
+        m_PtrInfo.Position.x = max(min(Predicted.x, max(m_PtrInfo.Position.x, static_cast<LONG>(FullDesc.Width) - 1)), min(m_PtrInfo.Position.x, 0L));
+        m_PtrInfo.Position.y = max(min(Predicted.y, max(m_PtrInfo.Position.y, static_cast<LONG>(FullDesc.Height) - 1)), min(m_PtrInfo.Position.y, 0L));
+    }
+
+    RECT PointerRect = {0, 0, 0, 0};
+    bool DrawPointer = m_PtrInfo.Visible && m_PtrInfo.PtrShapeBuffer;
+    if (DrawPointer)
+    {
+        GetPointerRect(&PointerRect);
+    }
+
+    // Scanout surfaces rotate, so each one is brought up to date from what it showed when last presented
+    OutputSurface& Surface = m_OutputSurfaces[m_OutputSurfaceIndex];
+    DUPL_RETURN Ret = DUPL_RETURN_SUCCESS;
+    if (Surface.DesktopVersion != m_DesktopVersion || m_Foveation.Mode == FOVEATION_POINTER)
+    {
+        // The desktop changed, or the fovea follows the pointer
+        m_Profiler.BeginPass(PROFILE_PASS_DRAW_FRAME);
+        Ret = DrawFrame(nullptr);
+        m_Profiler.EndPass();
+        Surface.DesktopVersion = m_DesktopVersion;
+    }
+    else if (!EqualRect(&Surface.PointerRect, &PointerRect) || Surface.ShapeSerial != m_PtrInfo.ShapeSerial)
+    {
+        // Only the pointer moved, put the desktop back where it was drawn last on this surface
+        if (!IsRectEmpty(&Surface.PointerRect))
+        {
+            m_Profiler.BeginPass(PROFILE_PASS_DRAW_FRAME);
+            Ret = DrawFrame(&Surface.PointerRect);
+            m_Profiler.EndPass();
+        }
+    }
+
+    if (Ret == DUPL_RETURN_SUCCESS && DrawPointer)
+    {
+        // Draw mouse into texture
+        m_Profiler.BeginPass(PROFILE_PASS_DRAW_MOUSE);
+        Ret = DrawMouse(&m_PtrInfo);
+        m_Profiler.EndPass();
+    }
+    Surface.PointerRect = PointerRect;
+    Surface.ShapeSerial = m_PtrInfo.ShapeSerial;
+
+    // Present to window if all worked
+    if (Ret == DUPL_RETURN_SUCCESS)
+    {
+        Ret = Present();
+    }
+    m_Profiler.EndFrame();
+
+    return Ret;
+}
+
+//
+// Desktop area the pointer is drawn over, clipped to the desktop
+//
+void OUTPUTMANAGER::GetPointerRect(_Out_ RECT* PointerRect)
+{
+    D3D11_TEXTURE2D_DESC FullDesc;
+    m_LastFrame->GetDesc(&FullDesc);
+
+    // Monochrome shapes hold the AND mask above the XOR mask
+    LONG Height = static_cast<LONG>(m_PtrInfo.ShapeInfo.Height);
+    if (m_PtrInfo.ShapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME)
+    {
+        Height /= 2;
+    }
+
+    RECT Shape = {m_PtrInfo.Position.x, m_PtrInfo.Position.y, m_PtrInfo.Position.x + static_cast<LONG>(m_PtrInfo.ShapeInfo.Width), m_PtrInfo.Position.y + Height};
+    RECT FullRect = {0, 0, static_cast<LONG>(FullDesc.Width), static_cast<LONG>(FullDesc.Height)};
+    if (!IntersectRect(PointerRect, &Shape, &FullRect))
+    {
+        SetRectEmpty(PointerRect);
+    }
+}
+
+//
+// Headset pixels a desktop rect can affect, grown by the reach of the resampling filter
+//
+void OUTPUTMANAGER::GetTargetRect(_In_ const RECT* DesktopRect, _Out_ RECT* TargetRect)
+{
+    D3D11_TEXTURE2D_DESC FullDesc;
+    m_LastFrame->GetDesc(&FullDesc);
+    FLOAT ScaleX = m_DisplayWidth / static_cast<FLOAT>(FullDesc.Width);
+    FLOAT ScaleY = m_DisplayHeight / static_cast<FLOAT>(FullDesc.Height);
+
+    // Lanczos reads two texels either side, of the mip level the periphery is taken from when foveated
+    FLOAT Reach = 2.0f;
+    if (m_Foveation.Mode != FOVEATION_OFF)
+    {
+        Reach *= static_cast<FLOAT>(1u << GetFoveationLevel(&m_Foveation));
+    }
+    LONG MarginX = static_cast<LONG>(ceilf(max(Reach * ScaleX, 2.0f))) + 1;
+    LONG MarginY = static_cast<LONG>(ceilf(max(Reach * ScaleY, 2.0f))) + 1;
+
+    TargetRect->left = max(static_cast<LONG>(floorf(DesktopRect->left * ScaleX)) - MarginX, 0L);
+    TargetRect->top = max(static_cast<LONG>(floorf(DesktopRect->top * ScaleY)) - MarginY, 0L);
+    TargetRect->right = min(static_cast<LONG>(ceilf(DesktopRect->right * ScaleX)) + MarginX, static_cast<LONG>(m_DisplayWidth));
+    TargetRect->bottom = min(static_cast<LONG>(ceilf(DesktopRect->bottom * ScaleY)) + MarginY, static_cast<LONG>(m_DisplayHeight));
+}
+
+//
+// Copy the regions of the shared surface that changed into our own copy of the desktop. Must hold the keyed mutex.
+//
+DUPL_RETURN OUTPUTMANAGER::UpdateLastFrame(_Inout_ DAMAGE_INFO* Damage)
+{
+    D3D11_TEXTURE2D_DESC FullDesc;
+    m_SharedSurf->GetDesc(&FullDesc);
+    RECT FullRect = {0, 0, static_cast<LONG>(FullDesc.Width), static_cast<LONG>(FullDesc.Height)};
+
+    // What changed, for the mip levels
+    RECT* Updated = m_Arena.AllocArray<RECT>(DAMAGE_RECT_COUNT);
+    UINT UpdatedCount = 0;
+    if (!Updated)
+    {
+        return ProcessFailure(nullptr, L"Failed to allocate memory for damage in OUTPUTMANAGER", L"Error", E_OUTOFMEMORY);
+    }
+
+    if (m_ForceFullCopy || Damage->FullDamage)
+    {
+        // Not CopyResource, our copy can have more mip levels than the shared surface
+        m_DeviceContext->CopySubresourceRegion(m_LastFrame, 0, 0, 0, 0, m_SharedSurf, 0, nullptr);
+        m_ForceFullCopy = false;
+        Updated[UpdatedCount++] = FullRect;
+    }
+    else
+    {
+        for (UINT i = 0; i < Damage->RectCount; ++i)
+        {
+            RECT Clipped;
+            if (!IntersectRect(&Clipped, &Damage->Rects[i], &FullRect))
+            {
+                continue;
+            }
+
+            D3D11_BOX Box;
+            Box.left = Clipped.left;
+            Box.top = Clipped.top;
+            Box.front = 0;
+            Box.right = Clipped.right;
+            Box.bottom = Clipped.bottom;
+            Box.back = 1;
+            m_DeviceContext->CopySubresourceRegion(m_LastFrame, 0, Clipped.left, Clipped.top, 0, m_SharedSurf, 0, &Box);
+            Updated[UpdatedCount++] = Clipped;
+        }
+    }
+
+    Damage->RectCount = 0;
+    Damage->FullDamage = false;
+    m_LastFrameValid = true;
+
+    if (m_AdaptRefresh)
+    {
+        for (UINT i = 0; i < Damage->UpdateCount; ++i)
+        {
+            m_RefreshPolicy.AddDesktopUpdate(Damage->UpdateNs[i]);
+        }
+    }
+    Damage->UpdateCount = 0;
+    if (UpdatedCount)
+    {
+        ++m_DesktopVersion;
+    }
+
+    // Mip levels are left behind while filtering is shed, and rebuilt whole when it comes back
+    if (m_Governor && !m_Governor->FiltersFrames())
+    {
+        m_FilterShed = true;
+    }
+
+    DUPL_RETURN Ret = RecordFrame(Updated, UpdatedCount);
+    if (Ret == DUPL_RETURN_SUCCESS && m_MipCount > 1 && UpdatedCount && !m_FilterShed)
+    {
+        Ret = UpdateMips(Updated, UpdatedCount);
+    }
+
+    return Ret;
+}
+
+//
+// Rebuild the mip levels of our desktop copy under the updated regions only, each level from the one above it
+//
+DUPL_RETURN OUTPUTMANAGER::UpdateMips(_In_reads_(RectCount) const RECT* Rects, UINT RectCount)
+{
+    D3D11_TEXTURE2D_DESC FullDesc;
+    m_LastFrame->GetDesc(&FullDesc);
+
+    // One quad per rect and level, grown to whole texels of that level
+    VERTEX* Vertices = m_Arena.AllocArray<VERTEX>(NUMVERTICES * RectCount * (m_MipCount - 1));
+    if (!Vertices)
+    {
+        return ProcessFailure(nullptr, L"Failed to allocate memory for mip vertices in OUTPUTMANAGER", L"Error", E_OUTOFMEMORY);
+    }
+
+    UINT QuadCounts[MIP_MAX_LEVELS] = {};
+    UINT TotalQuads = 0;
+    for (UINT Level = 1; Level < m_MipCount; ++Level)
+    {
+        UINT Scale = 1u << Level;
+        FLOAT SrcWidth = static_cast<FLOAT>(FullDesc.Width >> (Level - 1));
+        FLOAT SrcHeight = static_cast<FLOAT>(FullDesc.Height >> (Level - 1));
+        FLOAT DestWidth = static_cast<FLOAT>(FullDesc.Width >> Level);
+        FLOAT DestHeight = static_cast<FLOAT>(FullDesc.Height >> Level);
+
+        for (UINT i = 0; i < RectCount; ++i)
+        {
+            RECT Aligned;
+            if (!AlignToScale(&Rects[i], Scale, FullDesc.Width, FullDesc.Height, &Aligned))
+            {
+                continue;
+            }
+
+            // Each texel is drawn with a bilinear tap between the 2x2 texels it covers in the level above
+            SetQuad(&Vertices[TotalQuads * NUMVERTICES],
+                    (Aligned.left >> Level) / DestWidth * 2 - 1, 1 - (Aligned.top >> Level) / DestHeight * 2,
+                    (Aligned.right >> Level) / DestWidth * 2 - 1, 1 - (Aligned.bottom >> Level) / DestHeight * 2,
+                    (Aligned.left >> (Level - 1)) / SrcWidth, (Aligned.top >> (Level - 1)) / SrcHeight,
+                    (Aligned.right >> (Level - 1)) / SrcWidth, (Aligned.bottom >> (Level - 1)) / SrcHeight);
+            ++QuadCounts[Level];
+            ++TotalQuads;
+        }
+    }
+    if (!TotalQuads)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    D3D11_BUFFER_DESC BufferDesc;
+    RtlZeroMemory(&BufferDesc, sizeof(BufferDesc));
+    BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    BufferDesc.ByteWidth = sizeof(VERTEX) * NUMVERTICES * TotalQuads;
+    BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    D3D11_SUBRESOURCE_DATA InitData;
+    RtlZeroMemory(&InitData, sizeof(InitData));
+    InitData.pSysMem = Vertices;
 
-    if (OutputCount == 0)
+    ID3D11Buffer* VertexBuffer = nullptr;
+    HRESULT hr = m_Device->CreateBuffer(&BufferDesc, &InitData, &VertexBuffer);
+    if (FAILED(hr))
     {
-        // We could not find any outputs, the system must be in a transition so return expected error
-        // so we will attempt to recreate
-        return DUPL_RETURN_ERROR_EXPECTED;
+        return ProcessFailure(m_Device, L"Failed to create vertex buffer when updating mip levels", L"Error", hr, SystemTransitionsExpectedErrors);
     }
 
-    // Create shared texture for all duplication threads to draw into
-    D3D11_TEXTURE2D_DESC DeskTexD;
-    RtlZeroMemory(&DeskTexD, sizeof(D3D11_TEXTURE2D_DESC));
-    DeskTexD.Width = DeskBounds->right - DeskBounds->left;
-    DeskTexD.Height = DeskBounds->bottom - DeskBounds->top;
-    DeskTexD.MipLevels = 1;
-    DeskTexD.ArraySize = 1;
-    DeskTexD.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-    DeskTexD.SampleDesc.Count = 1;
-    DeskTexD.Usage = D3D11_USAGE_DEFAULT;
-    DeskTexD.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-    DeskTexD.CPUAccessFlags = 0;
-    DeskTexD.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+    UINT Stride = sizeof(VERTEX);
+    UINT Offset = 0;
+    FLOAT BlendFactor[4] = {0.f, 0.f, 0.f, 0.f};
+    ID3D11ShaderResourceView* NullSRV = nullptr;
+    m_DeviceContext->OMSetBlendState(nullptr, BlendFactor, 0xffffffff);
+    m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
+    m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
+    m_DeviceContext->PSSetSamplers(0, 1, &m_SamplerLinear);
+    m_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_DeviceContext->IASetVertexBuffers(0, 1, &VertexBuffer, &Stride, &Offset);
 
-    hr = m_Device->CreateTexture2D(&DeskTexD, nullptr, &m_SharedSurf);
-    if (FAILED(hr))
+    UINT FirstVertex = 0;
+    for (UINT Level = 1; Level < m_MipCount; ++Level)
     {
-        if (OutputCount != 1)
-        {
-            // If we are duplicating the complete desktop we try to create a single texture to hold the
-            // complete desktop image and blit updates from the per output DDA interface.  The GPU can
-            // always support a texture size of the maximum resolution of any single output but there is no
-            // guarantee that it can support a texture size of the desktop.
-            // The sample only use this large texture to display the desktop image in a single window using DX
-            // we could revert back to using GDI to update the window in this failure case.
-            return ProcessFailure(m_Device, L"Failed to create DirectX shared texture - we are attempting to create a texture the size of the complete desktop and this may be larger than the maximum texture size of your GPU.  Please try again using the -output command line parameter to duplicate only 1 monitor or configure your computer to a single monitor configuration", L"Error", hr, SystemTransitionsExpectedErrors);
-        }
-        else
+        if (!QuadCounts[Level])
         {
-            return ProcessFailure(m_Device, L"Failed to create shared texture", L"Error", hr, SystemTransitionsExpectedErrors);
+            continue;
         }
-    }
 
-    // Get keyed mutex
-    hr = m_SharedSurf->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void**>(&m_KeyMutex));
-    if (FAILED(hr))
-    {
-        return ProcessFailure(m_Device, L"Failed to query for keyed mutex in OUTPUTMANAGER", L"Error", hr);
+        // The level we read from was the render target of the previous pass
+        m_DeviceContext->PSSetShaderResources(0, 1, &NullSRV);
+        m_DeviceContext->OMSetRenderTargets(1, &m_MipRTV[Level], nullptr);
+        m_DeviceContext->PSSetShaderResources(0, 1, &m_MipSRV[Level - 1]);
+        SetViewPort(FullDesc.Width >> Level, FullDesc.Height >> Level);
+
+        m_DeviceContext->Draw(NUMVERTICES * QuadCounts[Level], FirstVertex);
+        FirstVertex += NUMVERTICES * QuadCounts[Level];
     }
 
+    // Back to drawing onto the headset
+    SetViewPort(m_DisplayWidth, m_DisplayHeight);
+    m_DeviceContext->PSSetShaderResources(0, 1, &NullSRV);
+    m_DeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+
+    VertexBuffer->Release();
+    VertexBuffer = nullptr;
+
     return DUPL_RETURN_SUCCESS;
 }
 
 //
-// Present to the application window
+// Take a copy of the pointer shape. Must hold the keyed mutex.
 //
-DUPL_RETURN OUTPUTMANAGER::UpdateApplicationWindow(_In_ PTR_INFO* PointerInfo)
+DUPL_RETURN OUTPUTMANAGER::UpdatePointer(_In_ PTR_INFO* PointerInfo)
 {
-    // In a typical desktop duplication application there would be an application running on one system collecting the desktop images
-    // and another application running on a different system that receives the desktop images via a network and display the image. This
-    // sample contains both these aspects into a single application.
-    // This routine is the part of the sample that displays the desktop image onto the display
-
-    // Try and acquire sync on common display buffer
-    HRESULT hr = m_KeyMutex->AcquireSync(1, 100);
-    if (hr == static_cast<HRESULT>(WAIT_TIMEOUT))
+    // Shape did not change
+    if (m_PendingShape.ShapeSerial == PointerInfo->ShapeSerial || !PointerInfo->PtrShapeBuffer)
     {
-        // Another thread has the keyed mutex so try again later
         return DUPL_RETURN_SUCCESS;
     }
-    else if (FAILED(hr))
-    {
-        return ProcessFailure(m_Device, L"Failed to acquire Keyed mutex in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
-    }
 
-    // Got mutex, so draw
-    DUPL_RETURN Ret = DrawFrame();
-    if (Ret == DUPL_RETURN_SUCCESS)
+    // Old buffer too small, grow it well past the request so new shapes rarely reallocate it
+    if (PointerInfo->BufferSize > m_PendingShape.BufferSize)
     {
-        // We have keyed mutex so we can access the mouse info
-        if (PointerInfo->Visible)
+        UINT NewSize = max(max(PointerInfo->BufferSize, m_PendingShape.BufferSize * 2), static_cast<UINT>(PTR_SHAPE_MIN_BUFFER_SIZE));
+        if (m_PendingShape.PtrShapeBuffer)
+        {
+            delete [] m_PendingShape.PtrShapeBuffer;
+            m_PendingShape.PtrShapeBuffer = nullptr;
+        }
+        m_PendingShape.PtrShapeBuffer = new (std::nothrow) BYTE[NewSize];
+        if (!m_PendingShape.PtrShapeBuffer)
         {
-            // Draw mouse into texture
-            Ret = DrawMouse(PointerInfo);
+            m_PendingShape.BufferSize = 0;
+            return ProcessFailure(nullptr, L"Failed to allocate memory for pointer shape in OUTPUTMANAGER", L"Error", E_OUTOFMEMORY);
         }
+
+        // Update buffer size
+        m_PendingShape.BufferSize = NewSize;
     }
 
-    // Release keyed mutex
-    hr = m_KeyMutex->ReleaseSync(0);
-    if (FAILED(hr))
+    memcpy_s(m_PendingShape.PtrShapeBuffer, m_PendingShape.BufferSize, PointerInfo->PtrShapeBuffer, PointerInfo->BufferSize);
+    m_PendingShape.ShapeInfo = PointerInfo->ShapeInfo;
+    m_PendingShape.ShapeSerial = PointerInfo->ShapeSerial;
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Show the newest shape taken, unless shedding work keeps the old one. Runs every v-blank, so a shape held back
+// while shedding is shown as soon as the governor allows it. Swaps buffers, nothing is copied.
+//
+void OUTPUTMANAGER::ApplyPendingShape()
+{
+    if (m_PendingShape.ShapeSerial == m_PtrInfo.ShapeSerial || !m_PendingShape.PtrShapeBuffer)
     {
-        return ProcessFailure(m_Device, L"Failed to Release Keyed mutex in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        return;
     }
-
-    // Present to window if all worked
-    if (Ret == DUPL_RETURN_SUCCESS)
+    if (m_Governor && !m_Governor->RefreshesCursorShape() && m_PtrInfo.PtrShapeBuffer)
     {
-        Ret = Present();
+        return;
     }
 
-    return Ret;
+    std::swap(m_PtrInfo.PtrShapeBuffer, m_PendingShape.PtrShapeBuffer);
+    std::swap(m_PtrInfo.BufferSize, m_PendingShape.BufferSize);
+    m_PtrInfo.ShapeInfo = m_PendingShape.ShapeInfo;
+    m_PtrInfo.ShapeSerial = m_PendingShape.ShapeSerial;
 }
 
 //
@@ -581,7 +1732,9 @@ DUPL_RETURN OUTPUTMANAGER::UpdateApplicationWindow(_In_ PTR_INFO* PointerInfo)
 //
 DUPL_RETURN OUTPUTMANAGER::Present() {
     ++m_DisplayFenceValue;
+    m_Profiler.BeginPass(PROFILE_PASS_PRESENT);
     HRESULT hr = m_DeviceContext->Signal(m_DisplayFenceOnPresentationDevice.get(), m_DisplayFenceValue);
+    m_Profiler.EndPass();
     if (FAILED(hr))
     {
         return ProcessFailure(m_Device, L"Failed to signal fence in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
@@ -596,7 +1749,7 @@ DUPL_RETURN OUTPUTMANAGER::Present() {
     m_DisplayTaskPool.ExecuteTask(task);
 
     // Switch backbuffer.
-    m_OutputSurfaceIndex ^= 1;
+    m_OutputSurfaceIndex = (m_OutputSurfaceIndex + 1) % m_OutputSurfaces.size();
 
     return DUPL_RETURN_SUCCESS;
 }
@@ -646,35 +1799,204 @@ HANDLE OUTPUTMANAGER::GetSharedHandle()
 }
 
 //
-// Draw frame into backbuffer
+// Returns the LUID of the adapter driving the HMD, which is also the one we duplicate outputs from
+//
+LUID OUTPUTMANAGER::GetAdapterLuid()
+{
+    return m_AdapterLuid;
+}
+
+//
+// Format the duplication threads should capture in, the one of the shared surface
 //
-DUPL_RETURN OUTPUTMANAGER::DrawFrame()
+DXGI_FORMAT OUTPUTMANAGER::GetSharedFormat()
+{
+    return m_SharedFormat;
+}
+
+//
+// Refresh policy of the headset, nullptr when its rate does not follow the desktop
+//
+REFRESHPOLICY* OUTPUTMANAGER::GetRefreshPolicy()
+{
+    return m_AdaptRefresh ? &m_RefreshPolicy : nullptr;
+}
+
+//
+// Hand a switch of the headset to another refresh rate to the mode switch thread, the presenter picks up the
+// outcome with FinishModeSwitch on a later v-blank
+//
+void OUTPUTMANAGER::RequestModeSwitch(int Mode)
+{
+    {
+        std::lock_guard<std::mutex> Guard(m_ModeSwitchLock);
+        m_ModeRequested = Mode;
+        m_ModeSwitchDone = false;
+    }
+    m_ModeSwitchWake.notify_one();
+    m_ModePending = Mode;
+}
+
+//
+// Once the mode switch thread is done, tell the refresh policy and the governor the rate the headset now runs
+// at. A failed switch leaves the headset as it was and is not retried for a while.
+//
+void OUTPUTMANAGER::FinishModeSwitch(uint64_t NowNs)
 {
     HRESULT hr;
+    {
+        std::lock_guard<std::mutex> Guard(m_ModeSwitchLock);
+        if (!m_ModeSwitchDone)
+        {
+            return;
+        }
+        hr = m_ModeSwitchResult;
+    }
+    int Current = m_RefreshPolicy.GetMode();
+    int Mode = m_ModePending;
+    m_ModePending = -1;
 
-    // Vertices for drawing whole texture
-    VERTEX Vertices[NUMVERTICES] =
+    wchar_t msg[160];
+    if (FAILED(hr))
     {
-        {XMFLOAT3(-1.0f, -1.0f, 0), XMFLOAT2(0.0f, 1.0f)},
-        {XMFLOAT3(-1.0f, 1.0f, 0), XMFLOAT2(0.0f, 0.0f)},
-        {XMFLOAT3(1.0f, -1.0f, 0), XMFLOAT2(1.0f, 1.0f)},
-        {XMFLOAT3(1.0f, -1.0f, 0), XMFLOAT2(1.0f, 1.0f)},
-        {XMFLOAT3(-1.0f, 1.0f, 0), XMFLOAT2(0.0f, 0.0f)},
-        {XMFLOAT3(1.0f, 1.0f, 0), XMFLOAT2(1.0f, 0.0f)},
-    };
+        swprintf_s(msg, L"OUTPUTMANAGER: failed to switch from %.2f to %.2f Hz for %S content, 0x%08x\n", m_RefreshPolicy.GetModeRate(Current),
+                   m_RefreshPolicy.GetModeRate(Mode), GetRefreshContentName(m_RefreshPolicy.GetContent()), static_cast<UINT>(hr));
+        OutputDebugStringW(msg);
+        m_RefreshPolicy.SetMode(Current, NowNs);
+        return;
+    }
+
+    m_RefreshPolicy.SetMode(Mode, NowNs);
+    swprintf_s(msg, L"OUTPUTMANAGER: switched from %.2f to %.2f Hz for %S content\n", m_RefreshPolicy.GetModeRate(Current),
+               m_RefreshPolicy.GetModeRate(Mode), GetRefreshContentName(m_RefreshPolicy.GetContent()));
+    OutputDebugStringW(msg);
+
+    if (m_Governor)
+    {
+        m_Governor->SetPeriod(static_cast<uint64_t>(1000000000.0 / m_RefreshPolicy.GetModeRate(Mode)));
+    }
+}
+
+//
+// Apply another mode of the same resolution to the targets we hold. Only the mode of the path changes, the
+// display device, primaries, scanouts and the v-blank fence stay. Blocks until the display manager is done.
+//
+HRESULT OUTPUTMANAGER::ApplyMode(int Mode)
+{
+    HRESULT hr;
+    try
+    {
+        auto stateResult = m_DisplayManager.TryAcquireTargetsAndReadCurrentState(m_DisplayTargets);
+        hr = stateResult.ExtendedErrorCode();
+        if (SUCCEEDED(hr))
+        {
+            auto state = stateResult.State();
+            state.GetPathForTarget(m_DisplayTarget).ApplyPropertiesFromMode(m_DisplayModes[Mode]);
+            hr = state.TryApply(winrt::DisplayStateApplyOptions::None).ExtendedErrorCode();
+        }
+    }
+    catch (winrt::hresult_error& Error)
+    {
+        hr = Error.code();
+    }
+    return hr;
+}
+
+//
+// Apply the modes the presenter requests until stopped
+//
+void OUTPUTMANAGER::ModeSwitchThread()
+{
+    std::unique_lock<std::mutex> Guard(m_ModeSwitchLock);
+    for (;;)
+    {
+        m_ModeSwitchWake.wait(Guard, [this] { return m_ModeSwitchStop || m_ModeRequested >= 0; });
+        if (m_ModeSwitchStop)
+        {
+            return;
+        }
+        int Mode = m_ModeRequested;
+        m_ModeRequested = -1;
+
+        Guard.unlock();
+        HRESULT hr = ApplyMode(Mode);
+        Guard.lock();
+
+        m_ModeSwitchResult = hr;
+        m_ModeSwitchDone = true;
+    }
+}
+
+//
+// Stop the mode switch thread once a switch it is applying is done, one still requested is dropped
+//
+void OUTPUTMANAGER::StopModeSwitchThread()
+{
+    if (m_ModeSwitcher.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Guard(m_ModeSwitchLock);
+            m_ModeSwitchStop = true;
+        }
+        m_ModeSwitchWake.notify_one();
+        m_ModeSwitcher.join();
+    }
+    m_ModeSwitchStop = false;
+    m_ModeRequested = -1;
+    m_ModeSwitchDone = false;
+    m_ModePending = -1;
+}
+
+//
+// Draw frame into backbuffer, or only the part of it over the desktop rect Restore
+//
+DUPL_RETURN OUTPUTMANAGER::DrawFrame(_In_opt_ const RECT* Restore)
+{
+    HRESULT hr;
+
+    // Vertices for drawing whole texture, followed by the fovea when foveated
+    VERTEX Vertices[NUMVERTICES * 2];
+    UINT VertexCount = NUMVERTICES;
 
     D3D11_TEXTURE2D_DESC FrameDesc;
-    m_SharedSurf->GetDesc(&FrameDesc);
+    m_LastFrame->GetDesc(&FrameDesc);
+
+    // The periphery is a mip level of our desktop copy. While filtering is shed the levels below the top are
+    // stale, so only the top one is sampled, bilinearly.
+    UINT MipCount = m_FilterShed ? 1 : m_MipCount;
+    UINT FoveationLevel = GetFoveationLevel(&m_Foveation);
+    ID3D11ShaderResourceView* PeripherySRV = (m_Foveation.Mode != FOVEATION_OFF && FoveationLevel < MipCount) ? m_MipSRV[FoveationLevel] : nullptr;
+
+    RECT Fovea = {0, 0, 0, 0};
+    if (PeripherySRV)
+    {
+        // The level stops at its last whole texel, stretch it to the edges
+        SetQuad(Vertices, -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f,
+                FrameDesc.Width / static_cast<FLOAT>((FrameDesc.Width >> FoveationLevel) << FoveationLevel),
+                FrameDesc.Height / static_cast<FLOAT>((FrameDesc.Height >> FoveationLevel) << FoveationLevel));
+
+        GetFoveaRect(&m_Foveation, FrameDesc.Width, FrameDesc.Height, m_PtrInfo.Position, &Fovea);
+        FLOAT U0 = Fovea.left / static_cast<FLOAT>(FrameDesc.Width);
+        FLOAT V0 = Fovea.top / static_cast<FLOAT>(FrameDesc.Height);
+        FLOAT U1 = Fovea.right / static_cast<FLOAT>(FrameDesc.Width);
+        FLOAT V1 = Fovea.bottom / static_cast<FLOAT>(FrameDesc.Height);
+        SetQuad(&Vertices[NUMVERTICES], U0 * 2 - 1, 1 - V0 * 2, U1 * 2 - 1, 1 - V1 * 2, U0, V0, U1, V1);
+        VertexCount += NUMVERTICES;
+    }
+    else
+    {
+        SetQuad(Vertices, -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+    }
 
     D3D11_SHADER_RESOURCE_VIEW_DESC ShaderDesc;
     ShaderDesc.Format = FrameDesc.Format;
     ShaderDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    ShaderDesc.Texture2D.MostDetailedMip = FrameDesc.MipLevels - 1;
-    ShaderDesc.Texture2D.MipLevels = FrameDesc.MipLevels;
+    ShaderDesc.Texture2D.MostDetailedMip = 0;
+    ShaderDesc.Texture2D.MipLevels = m_FilterShed ? 1 : FrameDesc.MipLevels;
 
     // Create new shader resource view
     ID3D11ShaderResourceView* ShaderResource = nullptr;
-    hr = m_Device->CreateShaderResourceView(m_SharedSurf, &ShaderDesc, &ShaderResource);
+    hr = m_Device->CreateShaderResourceView(m_LastFrame, &ShaderDesc, &ShaderResource);
     if (FAILED(hr))
     {
         return ProcessFailure(m_Device, L"Failed to create shader resource when drawing a frame", L"Error", hr, SystemTransitionsExpectedErrors);
@@ -684,18 +2006,36 @@ DUPL_RETURN OUTPUTMANAGER::DrawFrame()
     UINT Stride = sizeof(VERTEX);
     UINT Offset = 0;
     FLOAT blendFactor[4] = {0.f, 0.f, 0.f, 0.f};
+    ID3D11RenderTargetView* RTV = m_OutputSurfaces[m_OutputSurfaceIndex].rtv.get();
     m_DeviceContext->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
-    m_DeviceContext->OMSetRenderTargets(1, &m_RTV, nullptr);
+    m_DeviceContext->OMSetRenderTargets(1, &RTV, nullptr);
     m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
-    m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
-    m_DeviceContext->PSSetShaderResources(0, 1, &ShaderResource);
+
+    // Resampling and tone mapping are fused in the one pass onto the headset
+    bool Hdr = (FrameDesc.Format == DXGI_FORMAT_R16G16B16A16_FLOAT);
+    if (m_PresentConstantsStale)
+    {
+        PRESENT_CONSTANTS Constants = {static_cast<UINT>(m_Scaling.Filter), Hdr ? 1u : 0u, m_WhiteScale, 0.0f};
+        m_DeviceContext->UpdateSubresource(m_PresentConstants, 0, nullptr, &Constants, 0, 0);
+        m_PresentConstantsStale = false;
+    }
+    ID3D11PixelShader* ResamplePS = m_FilterShed ? nullptr : m_ResamplePS;
+    if (ResamplePS || Hdr)
+    {
+        m_DeviceContext->PSSetShader(ResamplePS ? ResamplePS : m_ToneMapPS, nullptr, 0);
+        m_DeviceContext->PSSetConstantBuffers(0, 1, &m_PresentConstants);
+    }
+    else
+    {
+        m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
+    }
     m_DeviceContext->PSSetSamplers(0, 1, &m_SamplerLinear);
     m_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     D3D11_BUFFER_DESC BufferDesc;
     RtlZeroMemory(&BufferDesc, sizeof(BufferDesc));
     BufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    BufferDesc.ByteWidth = sizeof(VERTEX) * NUMVERTICES;
+    BufferDesc.ByteWidth = sizeof(VERTEX) * VertexCount;
     BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     BufferDesc.CPUAccessFlags = 0;
     D3D11_SUBRESOURCE_DATA InitData;
@@ -714,8 +2054,33 @@ DUPL_RETURN OUTPUTMANAGER::DrawFrame()
     }
     m_DeviceContext->IASetVertexBuffers(0, 1, &VertexBuffer, &Stride, &Offset);
 
-    // Draw textured quad onto render target
-    m_DeviceContext->Draw(NUMVERTICES, 0);
+    if (Restore)
+    {
+        RECT Scissor;
+        GetTargetRect(Restore, &Scissor);
+        m_DeviceContext->RSSetState(m_ScissorRS);
+        m_DeviceContext->RSSetScissorRects(1, &Scissor);
+    }
+
+    if (PeripherySRV)
+    {
+        // Periphery from the downscaled level, then only the fovea from the whole chain
+        m_DeviceContext->PSSetShaderResources(0, 1, &PeripherySRV);
+        m_DeviceContext->Draw(NUMVERTICES, 0);
+        m_DeviceContext->PSSetShaderResources(0, 1, &ShaderResource);
+        m_DeviceContext->Draw(NUMVERTICES, NUMVERTICES);
+    }
+    else
+    {
+        // Draw textured quad onto render target
+        m_DeviceContext->PSSetShaderResources(0, 1, &ShaderResource);
+        m_DeviceContext->Draw(NUMVERTICES, 0);
+    }
+
+    if (Restore)
+    {
+        m_DeviceContext->RSSetState(nullptr);
+    }
 
     VertexBuffer->Release();
     VertexBuffer = nullptr;
@@ -734,7 +2099,7 @@ DUPL_RETURN OUTPUTMANAGER::ProcessMonoMask(bool IsMono, _Inout_ PTR_INFO* PtrInf
 {
     // Desktop dimensions
     D3D11_TEXTURE2D_DESC FullDesc;
-    m_SharedSurf->GetDesc(&FullDesc);
+    m_LastFrame->GetDesc(&FullDesc);
     INT DesktopWidth = FullDesc.Width;
     INT DesktopHeight = FullDesc.Height;
 
@@ -788,7 +2153,7 @@ DUPL_RETURN OUTPUTMANAGER::ProcessMonoMask(bool IsMono, _Inout_ PTR_INFO* PtrInf
     CopyBufferDesc.Height = *PtrHeight;
     CopyBufferDesc.MipLevels = 1;
     CopyBufferDesc.ArraySize = 1;
-    CopyBufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    CopyBufferDesc.Format = m_SharedFormat;
     CopyBufferDesc.SampleDesc.Count = 1;
     CopyBufferDesc.SampleDesc.Quality = 0;
     CopyBufferDesc.Usage = D3D11_USAGE_STAGING;
@@ -808,7 +2173,7 @@ DUPL_RETURN OUTPUTMANAGER::ProcessMonoMask(bool IsMono, _Inout_ PTR_INFO* PtrInf
     Box->top = *PtrTop;
     Box->right = *PtrLeft + *PtrWidth;
     Box->bottom = *PtrTop + *PtrHeight;
-    m_DeviceContext->CopySubresourceRegion(CopyBuffer, 0, 0, 0, 0, m_SharedSurf, 0, Box);
+    m_DeviceContext->CopySubresourceRegion(CopyBuffer, 0, 0, 0, 0, m_LastFrame, 0, Box);
 
     // QI for IDXGISurface
     IDXGISurface* CopySurface = nullptr;
@@ -830,10 +2195,13 @@ DUPL_RETURN OUTPUTMANAGER::ProcessMonoMask(bool IsMono, _Inout_ PTR_INFO* PtrInf
         return ProcessFailure(m_Device, L"Failed to map surface for pointer", L"Error", hr, SystemTransitionsExpectedErrors);
     }
 
-    // New mouseshape buffer
-    *InitBuffer = new (std::nothrow) BYTE[*PtrWidth * *PtrHeight * BPP];
+    // New mouseshape buffer, only needed until the pointer texture is created this frame
+    *InitBuffer = m_Arena.AllocArray<BYTE>(*PtrWidth * *PtrHeight * BPP);
     if (!(*InitBuffer))
     {
+        CopySurface->Unmap();
+        CopySurface->Release();
+        CopySurface = nullptr;
         return ProcessFailure(nullptr, L"Failed to allocate memory for new mouse shape buffer.", L"Error", E_OUTOFMEMORY);
     }
 
@@ -841,6 +2209,29 @@ DUPL_RETURN OUTPUTMANAGER::ProcessMonoMask(bool IsMono, _Inout_ PTR_INFO* PtrInf
     UINT* Desktop32 = reinterpret_cast<UINT*>(MappedSurface.pBits);
     UINT  DesktopPitchInPixels = MappedSurface.Pitch / sizeof(UINT);
 
+    // FP16 desktops are brought to 8 bits the way the presenter pass shows them
+    if (CopyBufferDesc.Format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+    {
+        Desktop32 = m_Arena.AllocArray<UINT>(*PtrWidth * *PtrHeight);
+        if (!Desktop32)
+        {
+            CopySurface->Unmap();
+            CopySurface->Release();
+            CopySurface = nullptr;
+            return ProcessFailure(nullptr, L"Failed to allocate memory for the desktop under the pointer.", L"Error", E_OUTOFMEMORY);
+        }
+
+        for (INT Row = 0; Row < *PtrHeight; ++Row)
+        {
+            const PackedVector::HALF* Source = reinterpret_cast<const PackedVector::HALF*>(MappedSurface.pBits + Row * MappedSurface.Pitch);
+            for (INT Col = 0; Col < *PtrWidth; ++Col)
+            {
+                Desktop32[Row * *PtrWidth + Col] = ToneMapHalfPixel(&Source[Col * 4], m_WhiteScale);
+            }
+        }
+        DesktopPitchInPixels = *PtrWidth;
+    }
+
     // What to skip (pixel offset)
     UINT SkipX = (GivenLeft < 0) ? (-1 * GivenLeft) : (0);
     UINT SkipY = (GivenTop < 0) ? (-1 * GivenTop) : (0);
@@ -937,7 +2328,7 @@ DUPL_RETURN OUTPUTMANAGER::DrawMouse(_In_ PTR_INFO* PtrInfo)
     };
 
     D3D11_TEXTURE2D_DESC FullDesc;
-    m_SharedSurf->GetDesc(&FullDesc);
+    m_LastFrame->GetDesc(&FullDesc);
     INT DesktopWidth = FullDesc.Width;
     INT DesktopHeight = FullDesc.Height;
 
@@ -1069,8 +2460,9 @@ DUPL_RETURN OUTPUTMANAGER::DrawMouse(_In_ PTR_INFO* PtrInfo)
     UINT Stride = sizeof(VERTEX);
     UINT Offset = 0;
     m_DeviceContext->IASetVertexBuffers(0, 1, &VertexBufferMouse, &Stride, &Offset);
+    ID3D11RenderTargetView* RTV = m_OutputSurfaces[m_OutputSurfaceIndex].rtv.get();
     m_DeviceContext->OMSetBlendState(m_BlendState, BlendFactor, 0xFFFFFFFF);
-    m_DeviceContext->OMSetRenderTargets(1, &m_RTV, nullptr);
+    m_DeviceContext->OMSetRenderTargets(1, &RTV, nullptr);
     m_DeviceContext->VSSetShader(m_VertexShader, nullptr, 0);
     m_DeviceContext->PSSetShader(m_PixelShader, nullptr, 0);
     m_DeviceContext->PSSetShaderResources(0, 1, &ShaderRes);
@@ -1095,12 +2487,6 @@ DUPL_RETURN OUTPUTMANAGER::DrawMouse(_In_ PTR_INFO* PtrInfo)
         MouseTex->Release();
         MouseTex = nullptr;
     }
-    if (InitBuffer)
-    {
-        delete [] InitBuffer;
-        InitBuffer = nullptr;
-    }
-
     return DUPL_RETURN_SUCCESS;
 }
 
@@ -1138,28 +2524,54 @@ DUPL_RETURN OUTPUTMANAGER::InitShaders()
         return ProcessFailure(m_Device, L"Failed to create pixel shader in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
     }
 
+    // Higher order filter onto the headset and tone mapping of FP16 desktops, the presentation device is always feature level 11
+    if (m_Scaling.Filter != SCALING_FILTER_BILINEAR)
+    {
+        Size = ARRAYSIZE(g_PS_Resample);
+        hr = m_Device->CreatePixelShader(g_PS_Resample, Size, nullptr, &m_ResamplePS);
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create resampling pixel shader in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
+    }
+
+    Size = ARRAYSIZE(g_PS_ToneMap);
+    hr = m_Device->CreatePixelShader(g_PS_ToneMap, Size, nullptr, &m_ToneMapPS);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create tone mapping pixel shader in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+
+    // Filled in before the next frame is drawn, the format of the desktop can change on any ResetDesktop
+    D3D11_BUFFER_DESC BufferDesc;
+    RtlZeroMemory(&BufferDesc, sizeof(BufferDesc));
+    BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    BufferDesc.ByteWidth = sizeof(PRESENT_CONSTANTS);
+    BufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    hr = m_Device->CreateBuffer(&BufferDesc, nullptr, &m_PresentConstants);
+    if (FAILED(hr))
+    {
+        return ProcessFailure(m_Device, L"Failed to create presenter constants in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+    }
+    m_PresentConstantsStale = true;
+
     return DUPL_RETURN_SUCCESS;
 }
 
 //
-// Reset render target view
+// Create a render target view for each scanout surface
 //
 DUPL_RETURN OUTPUTMANAGER::MakeRTV()
 {
-    // Get backbuffer
-    ID3D11Texture2D* BackBuffer = m_OutputSurfaces[m_OutputSurfaceIndex].surface.get();
-
-    // Create a render target view
-    HRESULT hr = m_Device->CreateRenderTargetView(BackBuffer, nullptr, &m_RTV);
-    BackBuffer->Release();
-    if (FAILED(hr))
+    for (auto& Surface : m_OutputSurfaces)
     {
-        return ProcessFailure(m_Device, L"Failed to create render target view in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        HRESULT hr = m_Device->CreateRenderTargetView(Surface.surface.get(), nullptr, Surface.rtv.put());
+        if (FAILED(hr))
+        {
+            return ProcessFailure(m_Device, L"Failed to create render target view in OUTPUTMANAGER", L"Error", hr, SystemTransitionsExpectedErrors);
+        }
     }
 
-    // Set new render target
-    m_DeviceContext->OMSetRenderTargets(1, &m_RTV, nullptr);
-
     return DUPL_RETURN_SUCCESS;
 }
 
@@ -1183,6 +2595,9 @@ void OUTPUTMANAGER::SetViewPort(UINT Width, UINT Height)
 //
 void OUTPUTMANAGER::CleanRefs()
 {
+    // The device context goes below, the last regions copied out are recorded while it is still there
+    DrainRecording();
+
     if (m_VertexShader)
     {
         m_VertexShader->Release();
@@ -1201,12 +2616,6 @@ void OUTPUTMANAGER::CleanRefs()
         m_InputLayout = nullptr;
     }
 
-    if (m_RTV)
-    {
-        m_RTV->Release();
-        m_RTV = nullptr;
-    }
-
     if (m_SamplerLinear)
     {
         m_SamplerLinear->Release();
@@ -1219,6 +2628,15 @@ void OUTPUTMANAGER::CleanRefs()
         m_BlendState = nullptr;
     }
 
+    if (m_ScissorRS)
+    {
+        m_ScissorRS->Release();
+        m_ScissorRS = nullptr;
+    }
+
+    // Its queries belong to the device
+    m_Profiler.Clean();
+
     if (m_DeviceContext)
     {
         m_DeviceContext->Release();
@@ -1231,15 +2649,43 @@ void OUTPUTMANAGER::CleanRefs()
         m_Device = nullptr;
     }
 
-    if (m_SharedSurf)
+    CleanSharedSurf();
+
+    if (m_ResamplePS)
     {
-        m_SharedSurf->Release();
-        m_SharedSurf = nullptr;
+        m_ResamplePS->Release();
+        m_ResamplePS = nullptr;
     }
 
-    if (m_KeyMutex)
+    if (m_ToneMapPS)
     {
-        m_KeyMutex->Release();
-        m_KeyMutex = nullptr;
+        m_ToneMapPS->Release();
+        m_ToneMapPS = nullptr;
     }
+
+    if (m_PresentConstants)
+    {
+        m_PresentConstants->Release();
+        m_PresentConstants = nullptr;
+    }
+
+    // Direct display objects, the mode switch thread uses the display manager and targets
+    StopModeSwitchThread();
+    m_VBlankFenceOnPresentationDevice = nullptr;
+    m_VBlankFenceOnDisplayDevice = nullptr;
+    m_VBlankEvent.close();
+    m_VBlankFenceValue = 0;
+    m_DisplayFenceOnPresentationDevice = nullptr;
+    m_DisplayFenceOnDisplayDevice = nullptr;
+    m_DisplayFenceValue = 0;
+    m_OutputSurfaces.clear();
+    m_OutputSurfaceIndex = 0;
+    m_AdaptRefresh = false;
+    m_DisplayModes.clear();
+    m_DisplayTargets = nullptr;
+    m_DisplayTaskPool = nullptr;
+    m_DisplaySource = nullptr;
+    m_DisplayDevice = nullptr;
+    m_DisplayTarget = nullptr;
+    m_DisplayManager = nullptr;
 }
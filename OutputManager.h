@@ -8,11 +8,41 @@
 #ifndef _OUTPUTMANAGER_H_
 #define _OUTPUTMANAGER_H_
 
+#include <condition_variable>
+#include <mutex>
 #include <stdio.h>
+#include <thread>
 
 #include "CommonTypes.h"
+#include "CursorPointerSource.h"
+#include "EdidParser.h"
+#include "Foveation.h"
+#include "FrameArena.h"
+#include "FrameRecorder.h"
+#include "GpuProfiler.h"
+#include "HmdProfile.h"
+#include "RefreshPolicy.h"
+#include "Scaling.h"
+#include "StreamSink.h"
 #include "warning.h"
 
+// Brightness of 1.0 in scRGB, the color space of FP16 desktops
+#define SCRGB_WHITE_NITS 80.0f
+
+// Where the tone curve starts rolling off highlights, must match ToneMap.hlsli
+#define TONEMAP_KNEE 0.8f
+
+//
+// Constants of the presenter pass shaders, must match PresentConstants in ToneMap.hlsli
+//
+typedef struct _PRESENT_CONSTANTS
+{
+    UINT Filter;
+    UINT ToneMap;
+    FLOAT WhiteScale;
+    FLOAT Padding;
+} PRESENT_CONSTANTS;
+
 //
 // Handles the task of drawing into a window.
 // Has the functionality to draw the mouse given a mouse shape buffer and position
@@ -22,23 +52,53 @@ class OUTPUTMANAGER
     public:
         OUTPUTMANAGER();
         ~OUTPUTMANAGER();
+        void SetHmdOptions(_In_ const HMD_OPTIONS* Options);
+        void SetFoveationOptions(_In_ const FOVEATION_OPTIONS* Options);
+        void SetScalingOptions(_In_ const SCALING_OPTIONS* Options);
+        void SetDuplicationOptions(_In_ const DUPLICATION_OPTIONS* Options);
+        void SetPredictionOptions(_In_ const PREDICTION_OPTIONS* Options);
         DUPL_RETURN InitOutput(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds);
-        DUPL_RETURN UpdateApplicationWindow(_In_ PTR_INFO* PointerInfo);
+        DUPL_RETURN ResetDesktop(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds, _Out_ bool* SurfaceRecreated);
+        bool IsOutputLost();
+        DUPL_RETURN UpdateApplicationWindow(_In_ PTR_INFO* PointerInfo, _In_ PTR_POSITION* PtrPosition, _Inout_ DAMAGE_INFO* Damage);
         DUPL_RETURN WaitNextVBlank();
         void CleanRefs();
         HANDLE GetSharedHandle();
+        LUID GetAdapterLuid();
+        DXGI_FORMAT GetSharedFormat();
+        REFRESHPOLICY* GetRefreshPolicy();
 
     private:
     // Methods
-        DUPL_RETURN OpenOutput(uint16_t vendorId, uint16_t productId, float refreshRate);
+        DUPL_RETURN OpenOutput();
+        void RequestModeSwitch(int Mode);
+        void FinishModeSwitch(uint64_t NowNs);
+        HRESULT ApplyMode(int Mode);
+        void ModeSwitchThread();
+        void StopModeSwitchThread();
         DUPL_RETURN ProcessMonoMask(bool IsMono, _Inout_ PTR_INFO* PtrInfo, _Out_ INT* PtrWidth, _Out_ INT* PtrHeight, _Out_ INT* PtrLeft, _Out_ INT* PtrTop, _Outptr_result_bytebuffer_(*PtrHeight * *PtrWidth * BPP) BYTE** InitBuffer, _Out_ D3D11_BOX* Box);
         DUPL_RETURN MakeRTV();
         void SetViewPort(UINT Width, UINT Height);
         DUPL_RETURN InitShaders();
         DUPL_RETURN InitGeometry();
-        DUPL_RETURN CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds);
-        DUPL_RETURN DrawFrame();
+        DUPL_RETURN CreateSharedSurf(INT SingleOutput, _Out_ UINT* OutCount, _Out_ RECT* DeskBounds, _Out_ bool* SurfaceRecreated);
+        void CleanSharedSurf();
+        DUPL_RETURN UpdateLastFrame(_Inout_ DAMAGE_INFO* Damage);
+        DUPL_RETURN CreateMips(_In_ D3D11_TEXTURE2D_DESC* DeskDesc);
+        DUPL_RETURN UpdateMips(_In_reads_(RectCount) const RECT* Rects, UINT RectCount);
+        void CleanMips();
+        DUPL_RETURN CreateRecordStaging(_In_ D3D11_TEXTURE2D_DESC* DeskDesc);
+        DUPL_RETURN RecordFrame(_In_reads_(RectCount) const RECT* Rects, UINT RectCount);
+        DUPL_RETURN DrainRecording();
+        void CleanRecordStaging();
+        void StartStream(UINT Width, UINT Height);
+        void StopStream();
+        DUPL_RETURN UpdatePointer(_In_ PTR_INFO* PointerInfo);
+        void ApplyPendingShape();
+        DUPL_RETURN DrawFrame(_In_opt_ const RECT* Restore);
         DUPL_RETURN DrawMouse(_In_ PTR_INFO* PtrInfo);
+        void GetPointerRect(_Out_ RECT* PointerRect);
+        void GetTargetRect(_In_ const RECT* DesktopRect, _Out_ RECT* TargetRect);
         DUPL_RETURN Present();
 
     // Vars
@@ -49,22 +109,127 @@ class OUTPUTMANAGER
         winrt::DisplayTaskPool m_DisplayTaskPool = nullptr;
         uint32_t m_DisplayWidth = 0;
         uint32_t m_DisplayHeight = 0;
+        LUID m_AdapterLuid = {};
+
+        // Headset selection from the command line, and the profile resolved for the headset we opened
+        HMD_OPTIONS m_HmdOptions;
+        HMD_PROFILE m_Profile;
 
         ID3D11Device5* m_Device;
         ID3D11DeviceContext4* m_DeviceContext;
-        ID3D11RenderTargetView* m_RTV;
         ID3D11SamplerState* m_SamplerLinear;
         ID3D11BlendState* m_BlendState;
+        ID3D11RasterizerState* m_ScissorRS;
         ID3D11VertexShader* m_VertexShader;
         ID3D11PixelShader* m_PixelShader;
         ID3D11InputLayout* m_InputLayout;
         ID3D11Texture2D* m_SharedSurf;
         IDXGIKeyedMutex* m_KeyMutex;
 
+        // Presenter's own copy of the desktop and pointer, so we can keep scanning out while duplication is busy or restarting
+        ID3D11Texture2D* m_LastFrame;
+        bool m_LastFrameValid;
+        bool m_ForceFullCopy;
+        PTR_INFO m_PtrInfo;
+
+        // Newest shape taken under the keyed mutex, swapped into m_PtrInfo once the governor lets new shapes
+        // through. Kept so a shape held back while shedding shows up when shedding ends, not on the next frame.
+        PTR_INFO m_PendingShape;
+
+        // Bumped whenever what the desktop pass draws changes. A scanout surface drawn at the current version only
+        // needs the desktop put back under the pointer it last drew when the pointer alone moved.
+        uint64_t m_DesktopVersion;
+
+        // The pointer is drawn where it is predicted to be at scanout, from the updates the duplication threads saw
+        // or, with a pointer source, from the positions it sampled. Those are of the hot spot in virtual screen
+        // coordinates, m_DesktopOrigin takes them to the desktop.
+        PREDICTION_OPTIONS m_Prediction;
+        POINTER_HISTORY m_PtrHistory;
+        POINTERTRACE m_PointerTrace;
+        POINTERSTREAM m_PointerStream;
+        POINTERSOURCE* m_PointerSource;
+        POINT m_DesktopOrigin;
+
+        // Per-frame CPU data of the presenter
+        FRAMEARENA m_Arena;
+
+        // Resampling onto the headset: mip levels of m_LastFrame kept up to date from the damage, and an optional
+        // higher order filter. Foveated presentation samples one of the levels everywhere but in the fovea.
+        SCALING_OPTIONS m_Scaling;
+        FOVEATION_OPTIONS m_Foveation;
+        UINT m_MipCount;
+        ID3D11RenderTargetView* m_MipRTV[MIP_MAX_LEVELS];
+        ID3D11ShaderResourceView* m_MipSRV[MIP_MAX_LEVELS];
+        ID3D11PixelShader* m_ResamplePS;
+
+        // HDR desktops are captured in FP16 end to end and tone mapped in the presenter pass
+        bool m_AllowHdr;
+        bool m_ComputeApply;
+        DXGI_FORMAT m_SharedFormat;
+        FLOAT m_WhiteScale;
+        ID3D11PixelShader* m_ToneMapPS;
+        ID3D11Buffer* m_PresentConstants;
+        bool m_PresentConstantsStale;
+
+        // Session recording: the tiles under each frame's damage are read back on the next v-blank, once the GPU
+        // is done copying them, outside the keyed mutex, and handed to the recorder's writer thread. 8 bit
+        // desktops only, an FP16 one stops the recording.
+        const char* m_RecordPath;
+        FRAMERECORDER m_Recorder;
+        ID3D11Texture2D* m_RecordStaging;
+        RECT m_RecordRects[DAMAGE_RECT_COUNT];
+        UINT m_RecordRectCount;
+        uint64_t m_RecordTime;
+
+        // Streaming reads back through the same staging texture, which holds a whole frame once the first full
+        // copy after it was created is in. The sink is fed every v-blank while it has tiles held back for a
+        // client that fell behind. One client at a time, the next one is listened for when it goes away.
+        UINT m_StreamPort;
+        SOCKETCHANNEL m_StreamChannel;
+        LZ4TILECODEC m_StreamCodec;
+        STREAMSINK m_Sink;
+        bool m_ReadbackValid;
+
+        // GPU time of the presenter's passes, on lane 0 of the timeline shared with the duplication threads
+        PROFILETIMELINE* m_Timeline;
+        GPUPROFILER m_Profiler;
+        uint64_t m_ProfileFrame;
+
+        // Sheds work when frames run over budget, nullptr when not governing. While filtering is shed the mip
+        // levels are not kept up to date and the headset is sampled bilinearly from the top level.
+        FRAMEGOVERNOR* m_Governor;
+        bool m_FilterShed;
+
+        // With MODE_POLICY_CONTENT the refresh rate follows what the desktop shows. Switches apply another mode
+        // of the same resolution to the targets we hold, the display device, primaries and scanouts all stay.
+        bool m_AdaptRefresh;
+        REFRESHPOLICY m_RefreshPolicy;
+        winrt::IVector<winrt::DisplayTarget> m_DisplayTargets = nullptr;
+        std::vector<winrt::DisplayModeInfo> m_DisplayModes;
+        POINT m_PolicyPointer;
+
+        // Applying a mode blocks for as long as the display manager takes, so it is done on a thread of its own
+        // and the presenter keeps presenting at the old rate until it is done. Requested mode, -1 for none, and
+        // the outcome are handed over under m_ModeSwitchLock.
+        std::thread m_ModeSwitcher;
+        std::mutex m_ModeSwitchLock;
+        std::condition_variable m_ModeSwitchWake;
+        bool m_ModeSwitchStop = false;
+        int m_ModeRequested = -1;
+        bool m_ModeSwitchDone = false;
+        HRESULT m_ModeSwitchResult = S_OK;
+
+        // Presenter side: the mode being switched to, -1 when no switch is under way
+        int m_ModePending = -1;
+
         struct OutputSurface {
             winrt::DisplaySurface primary = nullptr;
             winrt::DisplayScanout scanout = nullptr;
             winrt::com_ptr<ID3D11Texture2D> surface;
+            winrt::com_ptr<ID3D11RenderTargetView> rtv;
+            uint64_t DesktopVersion = 0;
+            RECT PointerRect = {};
+            UINT ShapeSerial = 0;
         };
         std::vector<OutputSurface> m_OutputSurfaces;
         uint32_t m_OutputSurfaceIndex = 0;
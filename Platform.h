@@ -0,0 +1,138 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+//
+// Types shared by the portable parts of the pipeline (software backend, capture, benchmark). On Windows they
+// come from the SDK, elsewhere we declare the few Win32 and DXGI types they need with the same layout.
+//
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <dxgi1_2.h>
+
+#else
+
+#include <shared_mutex>
+
+// Annotations of the declarations shared with the Windows code, only checked there
+#define _Return_type_success_(expr)
+#define _Field_size_bytes_(size)
+
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef int32_t LONG;
+typedef uint8_t BYTE;
+typedef int32_t BOOL;
+typedef int64_t LONGLONG;
+
+typedef union _LARGE_INTEGER
+{
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct tagRECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+} RECT;
+
+typedef struct tagPOINT
+{
+    LONG x;
+    LONG y;
+} POINT;
+
+typedef enum DXGI_MODE_ROTATION
+{
+    DXGI_MODE_ROTATION_UNSPECIFIED  = 0,
+    DXGI_MODE_ROTATION_IDENTITY     = 1,
+    DXGI_MODE_ROTATION_ROTATE90     = 2,
+    DXGI_MODE_ROTATION_ROTATE180    = 3,
+    DXGI_MODE_ROTATION_ROTATE270    = 4
+} DXGI_MODE_ROTATION;
+
+typedef struct DXGI_OUTDUPL_MOVE_RECT
+{
+    POINT SourcePoint;
+    RECT DestinationRect;
+} DXGI_OUTDUPL_MOVE_RECT;
+
+typedef enum DXGI_OUTDUPL_POINTER_SHAPE_TYPE
+{
+    DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME      = 0x1,
+    DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR           = 0x2,
+    DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR    = 0x4
+} DXGI_OUTDUPL_POINTER_SHAPE_TYPE;
+
+typedef struct DXGI_OUTDUPL_POINTER_SHAPE_INFO
+{
+    UINT Type;
+    UINT Width;
+    UINT Height;
+    UINT Pitch;
+    POINT HotSpot;
+} DXGI_OUTDUPL_POINTER_SHAPE_INFO;
+
+typedef struct DXGI_OUTDUPL_POINTER_POSITION
+{
+    POINT Position;
+    BOOL Visible;
+} DXGI_OUTDUPL_POINTER_POSITION;
+
+// Times are steady clock nanoseconds rather than performance counter ticks
+typedef struct DXGI_OUTDUPL_FRAME_INFO
+{
+    LARGE_INTEGER LastPresentTime;
+    LARGE_INTEGER LastMouseUpdateTime;
+    UINT AccumulatedFrames;
+    BOOL RectsCoalesced;
+    BOOL ProtectedContentMaskedOut;
+    DXGI_OUTDUPL_POINTER_POSITION PointerPosition;
+    UINT TotalMetadataBufferSize;
+    UINT PointerShapeBufferSize;
+} DXGI_OUTDUPL_FRAME_INFO;
+
+//
+// Slim reader/writer lock, constructed ready to use
+//
+typedef std::shared_mutex SRWLOCK;
+
+inline void InitializeSRWLock(SRWLOCK*)
+{
+}
+
+inline void AcquireSRWLockExclusive(SRWLOCK* Lock)
+{
+    Lock->lock();
+}
+
+inline void ReleaseSRWLockExclusive(SRWLOCK* Lock)
+{
+    Lock->unlock();
+}
+
+inline void AcquireSRWLockShared(SRWLOCK* Lock)
+{
+    Lock->lock_shared();
+}
+
+inline void ReleaseSRWLockShared(SRWLOCK* Lock)
+{
+    Lock->unlock_shared();
+}
+
+#endif
+
+#endif
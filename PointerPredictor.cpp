@@ -0,0 +1,359 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <math.h>
+#include <new>
+#include <string.h>
+
+#include "PointerPredictor.h"
+
+// Spectral density of the jerk the Kalman filter allows for, in px^2/s^5, and the variance of a reported
+// position, in px^2. Tuned on traces with the benchmark's --pointertrace.
+#define KALMAN_JERK_DENSITY 6.4e10
+#define KALMAN_POSITION_VARIANCE 1.0
+
+// Uncertainty of the velocity and acceleration at the start of a stroke, the pointer was at rest
+#define KALMAN_INITIAL_VELOCITY_VARIANCE (2000.0 * 2000.0)
+#define KALMAN_INITIAL_ACCELERATION_VARIANCE (50000.0 * 50000.0)
+
+//
+// Add a pointer update, updates older than the newest one are dropped
+//
+void AddPointerSample(POINTER_HISTORY* History, uint64_t Time, LONG X, LONG Y)
+{
+    if (History->Count && History->Samples[(History->Count - 1) % POINTER_HISTORY_SIZE].Time >= Time)
+    {
+        return;
+    }
+
+    POINTER_SAMPLE* Sample = &History->Samples[History->Count % POINTER_HISTORY_SIZE];
+    Sample->Time = Time;
+    Sample->X = X;
+    Sample->Y = Y;
+    ++History->Count;
+}
+
+//
+// Velocity of one axis, the least squares slope through the updates in the window
+//
+static double FitVelocity(const double* Times, const double* Positions, UINT Count)
+{
+    double MeanTime = 0.0;
+    double MeanPosition = 0.0;
+    for (UINT i = 0; i < Count; ++i)
+    {
+        MeanTime += Times[i];
+        MeanPosition += Positions[i];
+    }
+    MeanTime /= Count;
+    MeanPosition /= Count;
+
+    double Covariance = 0.0;
+    double Variance = 0.0;
+    for (UINT i = 0; i < Count; ++i)
+    {
+        Covariance += (Times[i] - MeanTime) * (Positions[i] - MeanPosition);
+        Variance += (Times[i] - MeanTime) * (Times[i] - MeanTime);
+    }
+    return (Variance > 0.0) ? Covariance / Variance : 0.0;
+}
+
+//
+// Run a constant acceleration Kalman filter over the updates of one axis, oldest first, and return the
+// velocity and acceleration at the last one
+//
+static void FilterAxis(const double* Times, const double* Positions, UINT Count, double* Velocity, double* Acceleration)
+{
+    // State: position, velocity, acceleration
+    double X[3] = {Positions[0], 0.0, 0.0};
+    double P[3][3] = {{KALMAN_POSITION_VARIANCE, 0.0, 0.0}, {0.0, KALMAN_INITIAL_VELOCITY_VARIANCE, 0.0}, {0.0, 0.0, KALMAN_INITIAL_ACCELERATION_VARIANCE}};
+
+    for (UINT i = 1; i < Count; ++i)
+    {
+        double Dt = Times[i] - Times[i - 1];
+        double Dt2 = Dt * Dt;
+        double Dt3 = Dt2 * Dt;
+
+        // Predict: x = F x, P = F P F' + Q with F the constant acceleration step and Q from white jerk
+        double F[3][3] = {{1.0, Dt, Dt2 / 2}, {0.0, 1.0, Dt}, {0.0, 0.0, 1.0}};
+        double Q[3][3] = {{Dt3 * Dt2 / 20, Dt2 * Dt2 / 8, Dt3 / 6}, {Dt2 * Dt2 / 8, Dt3 / 3, Dt2 / 2}, {Dt3 / 6, Dt2 / 2, Dt}};
+
+        double Predicted[3] = {X[0] + Dt * X[1] + Dt2 / 2 * X[2], X[1] + Dt * X[2], X[2]};
+        double FP[3][3];
+        for (UINT r = 0; r < 3; ++r)
+        {
+            for (UINT c = 0; c < 3; ++c)
+            {
+                FP[r][c] = F[r][0] * P[0][c] + F[r][1] * P[1][c] + F[r][2] * P[2][c];
+            }
+        }
+        for (UINT r = 0; r < 3; ++r)
+        {
+            for (UINT c = 0; c < 3; ++c)
+            {
+                P[r][c] = FP[r][0] * F[c][0] + FP[r][1] * F[c][1] + FP[r][2] * F[c][2] + KALMAN_JERK_DENSITY * Q[r][c];
+            }
+        }
+
+        // Update with the reported position
+        double S = P[0][0] + KALMAN_POSITION_VARIANCE;
+        double K[3] = {P[0][0] / S, P[1][0] / S, P[2][0] / S};
+        double Residual = Positions[i] - Predicted[0];
+        double Row[3] = {P[0][0], P[0][1], P[0][2]};
+        for (UINT r = 0; r < 3; ++r)
+        {
+            X[r] = Predicted[r] + K[r] * Residual;
+            for (UINT c = 0; c < 3; ++c)
+            {
+                P[r][c] -= K[r] * Row[c];
+            }
+        }
+    }
+
+    *Velocity = X[1];
+    *Acceleration = X[2];
+}
+
+//
+// How far one axis moves in Lead seconds, clamped so the prediction does not overshoot where the pointer turns
+//
+static double Extrapolate(double Velocity, double Acceleration, double LastStep, double Lead)
+{
+    double Offset = Velocity * Lead;
+    if (Acceleration * Velocity < 0.0)
+    {
+        // Slowing down, stop where the velocity would reach zero instead of coming back
+        double StopTime = -Velocity / Acceleration;
+        double Time = (Lead < StopTime) ? Lead : StopTime;
+        Offset = Velocity * Time + Acceleration * Time * Time / 2;
+    }
+    else
+    {
+        // Speeding up, at most twice as far as the velocity alone would go
+        double Extra = Acceleration * Lead * Lead / 2;
+        Offset += (fabs(Extra) < fabs(Offset)) ? Extra : Offset;
+    }
+
+    // Only carry on the way the pointer last went, a reversal shows up here before it does in the fit
+    if (Offset * LastStep <= 0.0)
+    {
+        return 0.0;
+    }
+    return Offset;
+}
+
+//
+// Where the pointer will be at Target, from the updates seen until Now. Returns false if there are none.
+//
+bool PredictPointer(const POINTER_HISTORY* History, PREDICTION_MODE Mode, uint64_t Now, uint64_t Target, POINT* Predicted)
+{
+    if (!History->Count)
+    {
+        return false;
+    }
+
+    const POINTER_SAMPLE* Newest = &History->Samples[(History->Count - 1) % POINTER_HISTORY_SIZE];
+    Predicted->x = Newest->X;
+    Predicted->y = Newest->Y;
+    if (Mode == PREDICTION_OFF || History->Count < 2 || Now > Newest->Time + PREDICTION_IDLE_NS || Target <= Newest->Time)
+    {
+        return true;
+    }
+
+    // The current stroke, oldest first, in seconds before the newest update
+    double Times[POINTER_HISTORY_SIZE];
+    double Xs[POINTER_HISTORY_SIZE];
+    double Ys[POINTER_HISTORY_SIZE];
+    UINT Available = (History->Count < POINTER_HISTORY_SIZE) ? History->Count : POINTER_HISTORY_SIZE;
+    UINT Count = 1;
+    while (Count < Available)
+    {
+        const POINTER_SAMPLE* Older = &History->Samples[(History->Count - 1 - Count) % POINTER_HISTORY_SIZE];
+        const POINTER_SAMPLE* Newer = &History->Samples[(History->Count - Count) % POINTER_HISTORY_SIZE];
+        if (Newer->Time - Older->Time > PREDICTION_IDLE_NS)
+        {
+            break;
+        }
+        ++Count;
+    }
+    if (Count < 2)
+    {
+        return true;
+    }
+
+    for (UINT i = 0; i < Count; ++i)
+    {
+        const POINTER_SAMPLE* Sample = &History->Samples[(History->Count - Count + i) % POINTER_HISTORY_SIZE];
+        Times[i] = -static_cast<double>(Newest->Time - Sample->Time) / 1e9;
+        Xs[i] = Sample->X;
+        Ys[i] = Sample->Y;
+    }
+
+    double VelocityX;
+    double VelocityY;
+    double AccelerationX = 0.0;
+    double AccelerationY = 0.0;
+    if (Mode == PREDICTION_KALMAN)
+    {
+        FilterAxis(Times, Xs, Count, &VelocityX, &AccelerationX);
+        FilterAxis(Times, Ys, Count, &VelocityY, &AccelerationY);
+    }
+    else
+    {
+        // The newest two updates always, older ones while they are in the window
+        UINT First = Count - 2;
+        while (First > 0 && -Times[First - 1] * 1e9 <= PREDICTION_WINDOW_NS)
+        {
+            --First;
+        }
+        VelocityX = FitVelocity(&Times[First], &Xs[First], Count - First);
+        VelocityY = FitVelocity(&Times[First], &Ys[First], Count - First);
+    }
+
+    uint64_t LeadNs = Target - Newest->Time;
+    double Lead = ((LeadNs < PREDICTION_MAX_LEAD_NS) ? LeadNs : PREDICTION_MAX_LEAD_NS) / 1e9;
+    Predicted->x = Newest->X + static_cast<LONG>(lround(Extrapolate(VelocityX, AccelerationX, Xs[Count - 1] - Xs[Count - 2], Lead)));
+    Predicted->y = Newest->Y + static_cast<LONG>(lround(Extrapolate(VelocityY, AccelerationY, Ys[Count - 1] - Ys[Count - 2], Lead)));
+
+    return true;
+}
+
+POINTERTRACE::POINTERTRACE() : m_File(nullptr),
+                               m_Written(0)
+{
+}
+
+POINTERTRACE::~POINTERTRACE()
+{
+    Close();
+}
+
+bool POINTERTRACE::Create(const char* Path)
+{
+    Close();
+
+#ifdef _WIN32
+    if (fopen_s(&m_File, Path, "w") != 0)
+    {
+        m_File = nullptr;
+    }
+#else
+    m_File = fopen(Path, "w");
+#endif
+    if (!m_File)
+    {
+        return false;
+    }
+
+    m_Written = 0;
+    return fprintf(m_File, "# time_ns x y\n") > 0;
+}
+
+//
+// Append the updates added to the history since the last call. Updates that already left the history are lost.
+//
+bool POINTERTRACE::Write(const POINTER_HISTORY* History)
+{
+    if (!m_File)
+    {
+        return false;
+    }
+
+    UINT First = (History->Count - m_Written > POINTER_HISTORY_SIZE) ? History->Count - POINTER_HISTORY_SIZE : m_Written;
+    for (UINT i = First; i < History->Count; ++i)
+    {
+        const POINTER_SAMPLE* Sample = &History->Samples[i % POINTER_HISTORY_SIZE];
+        if (fprintf(m_File, "%llu %ld %ld\n", static_cast<unsigned long long>(Sample->Time), static_cast<long>(Sample->X), static_cast<long>(Sample->Y)) < 0)
+        {
+            return false;
+        }
+    }
+    m_Written = History->Count;
+    return true;
+}
+
+void POINTERTRACE::Close()
+{
+    if (m_File)
+    {
+        fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+//
+// Read a trace written by Write, Samples is allocated with new[] and owned by the caller
+//
+bool POINTERTRACE::Load(const char* Path, POINTER_SAMPLE** Samples, UINT* Count)
+{
+    *Samples = nullptr;
+    *Count = 0;
+
+    FILE* File = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&File, Path, "r") != 0)
+    {
+        File = nullptr;
+    }
+#else
+    File = fopen(Path, "r");
+#endif
+    if (!File)
+    {
+        return false;
+    }
+
+    UINT Capacity = 0;
+    char Line[128];
+    bool Result = true;
+    while (fgets(Line, sizeof(Line), File))
+    {
+        unsigned long long Time;
+        long X;
+        long Y;
+        if (Line[0] == '#' || sscanf(Line, "%llu %ld %ld", &Time, &X, &Y) != 3)
+        {
+            continue;
+        }
+        if (*Count && (*Samples)[*Count - 1].Time >= Time)
+        {
+            continue;
+        }
+
+        if (*Count == Capacity)
+        {
+            UINT NewCapacity = Capacity ? Capacity * 2 : 1024;
+            POINTER_SAMPLE* Grown = new (std::nothrow) POINTER_SAMPLE[NewCapacity];
+            if (!Grown)
+            {
+                Result = false;
+                break;
+            }
+            if (*Samples)
+            {
+                memcpy(Grown, *Samples, *Count * sizeof(POINTER_SAMPLE));
+                delete [] *Samples;
+            }
+            *Samples = Grown;
+            Capacity = NewCapacity;
+        }
+
+        POINTER_SAMPLE* Sample = &(*Samples)[(*Count)++];
+        Sample->Time = Time;
+        Sample->X = static_cast<LONG>(X);
+        Sample->Y = static_cast<LONG>(Y);
+    }
+    fclose(File);
+
+    if (!Result)
+    {
+        delete [] *Samples;
+        *Samples = nullptr;
+        *Count = 0;
+    }
+    return Result;
+}
@@ -0,0 +1,95 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _POINTERPREDICTOR_H_
+#define _POINTERPREDICTOR_H_
+
+#include <stdio.h>
+
+#include "Platform.h"
+
+//
+// How the presenter places the pointer
+//
+typedef enum
+{
+    PREDICTION_OFF      = 0,    // Where the last pointer update put it
+    PREDICTION_VELOCITY = 1,    // Extrapolated with the velocity fitted to the last few updates
+    PREDICTION_KALMAN   = 2     // Extrapolated with the velocity and acceleration of a constant acceleration Kalman filter
+} PREDICTION_MODE;
+
+//
+// Where the presenter takes pointer positions from. DXGI always decides the shape and whether it shows.
+//
+typedef enum
+{
+    POINTER_SOURCE_DXGI     = 0,    // Pointer updates of the duplicated frames, at most one per desktop refresh
+    POINTER_SOURCE_CURSOR   = 1     // The cursor position sampled on a thread of its own at 1 kHz
+} POINTER_SOURCE_TYPE;
+
+typedef struct _PREDICTION_OPTIONS
+{
+    PREDICTION_MODE Mode;
+    POINTER_SOURCE_TYPE Source;
+
+    // Write every pointer update the presenter sees to a trace at this path, nullptr for none
+    const char* TracePath;
+} PREDICTION_OPTIONS;
+
+// Pointer updates kept, a power of two. DXGI reports at most one per desktop refresh, an input source
+// up to one a millisecond.
+#define POINTER_HISTORY_SIZE 64
+
+// Updates this recent are fitted by the velocity predictor, a longer window lags behind turns
+#define PREDICTION_WINDOW_NS 25000000ull
+
+// No update for this long means the pointer stopped, DXGI only reports moves. Such a gap also ends a stroke.
+#define PREDICTION_IDLE_NS 50000000ull
+
+// Never extrapolate further than this past the last update
+#define PREDICTION_MAX_LEAD_NS 50000000ull
+
+typedef struct _POINTER_SAMPLE
+{
+    // Nanoseconds, on the clock of the code feeding the history
+    uint64_t Time;
+    LONG X;
+    LONG Y;
+} POINTER_SAMPLE;
+
+//
+// The last POINTER_HISTORY_SIZE pointer updates, Count is the number ever added
+//
+typedef struct _POINTER_HISTORY
+{
+    POINTER_SAMPLE Samples[POINTER_HISTORY_SIZE];
+    UINT Count;
+} POINTER_HISTORY;
+
+void AddPointerSample(POINTER_HISTORY* History, uint64_t Time, LONG X, LONG Y);
+bool PredictPointer(const POINTER_HISTORY* History, PREDICTION_MODE Mode, uint64_t Now, uint64_t Target, POINT* Predicted);
+
+//
+// Text trace of pointer updates, one "time x y" line each, for tuning the predictors offline
+//
+class POINTERTRACE
+{
+    public:
+        POINTERTRACE();
+        ~POINTERTRACE();
+        bool Create(const char* Path);
+        bool Write(const POINTER_HISTORY* History);
+        void Close();
+
+        static bool Load(const char* Path, POINTER_SAMPLE** Samples, UINT* Count);
+
+    private:
+        FILE* m_File;
+        UINT m_Written;
+};
+
+#endif
@@ -0,0 +1,176 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <chrono>
+
+#include "PointerSource.h"
+
+POINTERSTREAM::POINTERSTREAM() : m_Count(0),
+                                 m_Retries(0)
+{
+    for (STREAM_SLOT& Slot : m_Slots)
+    {
+        Slot.Time.store(0, std::memory_order_relaxed);
+        Slot.Position.store(0, std::memory_order_relaxed);
+    }
+}
+
+//
+// Add the newest position, from the one writer only
+//
+void POINTERSTREAM::Push(uint64_t Time, LONG X, LONG Y)
+{
+    UINT Count = m_Count.load(std::memory_order_relaxed);
+    STREAM_SLOT* Slot = &m_Slots[Count % POINTER_STREAM_SIZE];
+
+    // A reader that sees any part of the slot rewritten also sees the count from before, and so knows the
+    // slot is no longer the position it was copying
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot->Time.store(Time, std::memory_order_relaxed);
+    Slot->Position.store(static_cast<uint32_t>(X) | (static_cast<uint64_t>(static_cast<uint32_t>(Y)) << 32), std::memory_order_relaxed);
+    m_Count.store(Count + 1, std::memory_order_release);
+}
+
+//
+// Copy the newest positions into a history, numbered like the stream so callers can tell what is new.
+// Returns false if nothing was pushed yet.
+//
+bool POINTERSTREAM::Read(POINTER_HISTORY* History)
+{
+    for (;;)
+    {
+        UINT Count = m_Count.load(std::memory_order_acquire);
+        if (!Count)
+        {
+            return false;
+        }
+
+        UINT Copied = (Count < POINTER_HISTORY_SIZE) ? Count : POINTER_HISTORY_SIZE;
+        for (UINT i = Count - Copied; i < Count; ++i)
+        {
+            const STREAM_SLOT* Slot = &m_Slots[i % POINTER_STREAM_SIZE];
+            POINTER_SAMPLE* Sample = &History->Samples[i % POINTER_HISTORY_SIZE];
+            uint64_t Position = Slot->Position.load(std::memory_order_relaxed);
+            Sample->Time = Slot->Time.load(std::memory_order_relaxed);
+            Sample->X = static_cast<LONG>(static_cast<uint32_t>(Position));
+            Sample->Y = static_cast<LONG>(static_cast<uint32_t>(Position >> 32));
+        }
+        History->Count = Count;
+
+        // While the count reads Now the writer may be rewriting the slot of position Now - POINTER_STREAM_SIZE,
+        // what we copied is whole if it is all newer than that
+        std::atomic_thread_fence(std::memory_order_acquire);
+        UINT Now = m_Count.load(std::memory_order_relaxed);
+        if (Now - (Count - Copied) < POINTER_STREAM_SIZE)
+        {
+            return true;
+        }
+        m_Retries.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+//
+// Copies that had to be taken again because the writer overtook them
+//
+UINT POINTERSTREAM::GetRetries()
+{
+    return m_Retries.load(std::memory_order_relaxed);
+}
+
+SCRIPTEDPOINTERSOURCE::SCRIPTEDPOINTERSOURCE() : m_Samples(nullptr),
+                                                 m_Count(0),
+                                                 m_Stream(nullptr),
+                                                 m_StartTime(0),
+                                                 m_Stop(false),
+                                                 m_Finished(false)
+{
+}
+
+SCRIPTEDPOINTERSOURCE::~SCRIPTEDPOINTERSOURCE()
+{
+    Stop();
+}
+
+//
+// Positions to play, the caller keeps them alive until the source is stopped. Times are only used relative
+// to the first one.
+//
+bool SCRIPTEDPOINTERSOURCE::Initialize(const POINTER_SAMPLE* Samples, UINT Count)
+{
+    if (!Count || m_Player.joinable())
+    {
+        return false;
+    }
+
+    m_Samples = Samples;
+    m_Count = Count;
+    return true;
+}
+
+bool SCRIPTEDPOINTERSOURCE::Start(POINTERSTREAM* Stream)
+{
+    if (!m_Samples || m_Player.joinable())
+    {
+        return false;
+    }
+
+    m_Stream = Stream;
+    m_Stop = false;
+    m_Finished.store(false);
+    m_StartTime = Now();
+    m_Player = std::thread(&SCRIPTEDPOINTERSOURCE::PlayThread, this);
+    return true;
+}
+
+void SCRIPTEDPOINTERSOURCE::Stop()
+{
+    if (!m_Player.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard(m_Lock);
+        m_Stop = true;
+    }
+    m_Wake.notify_all();
+    m_Player.join();
+}
+
+uint64_t SCRIPTEDPOINTERSOURCE::GetStartTime()
+{
+    return m_StartTime;
+}
+
+bool SCRIPTEDPOINTERSOURCE::IsFinished()
+{
+    return m_Finished.load();
+}
+
+//
+// Nanoseconds on the steady clock, the clock the scripted positions are pushed with
+//
+uint64_t SCRIPTEDPOINTERSOURCE::Now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void SCRIPTEDPOINTERSOURCE::PlayThread()
+{
+    std::unique_lock<std::mutex> Guard(m_Lock);
+    for (UINT i = 0; i < m_Count && !m_Stop; ++i)
+    {
+        uint64_t Time = m_StartTime + (m_Samples[i].Time - m_Samples[0].Time);
+        auto Due = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(Time)));
+        if (m_Wake.wait_until(Guard, Due, [this] { return m_Stop; }))
+        {
+            break;
+        }
+        m_Stream->Push(Time, m_Samples[i].X, m_Samples[i].Y);
+    }
+    m_Finished.store(true);
+}
@@ -0,0 +1,90 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _POINTERSOURCE_H_
+#define _POINTERSOURCE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "PointerPredictor.h"
+
+// Positions the stream holds, twice what a reader copies so a copy is only retried when the writer laps it
+#define POINTER_STREAM_SIZE (POINTER_HISTORY_SIZE * 2)
+
+//
+// Pointer positions from one writer to any number of readers without locks. The writer never waits, a
+// reader copies the newest POINTER_HISTORY_SIZE positions and copies again if the writer overwrote any of
+// them meanwhile.
+//
+class POINTERSTREAM
+{
+    public:
+        POINTERSTREAM();
+        void Push(uint64_t Time, LONG X, LONG Y);
+        bool Read(POINTER_HISTORY* History);
+        UINT GetRetries();
+
+    private:
+        struct STREAM_SLOT
+        {
+            std::atomic<uint64_t> Time;
+            std::atomic<uint64_t> Position;
+        };
+
+        STREAM_SLOT m_Slots[POINTER_STREAM_SIZE];
+        std::atomic<UINT> m_Count;
+        std::atomic<UINT> m_Retries;
+};
+
+//
+// Something that reports where the pointer is, at a higher rate than the desktop updates. Positions are of
+// the hot spot, on the clock PredictPointer is given, pushed only when the pointer moved.
+//
+class POINTERSOURCE
+{
+    public:
+        virtual ~POINTERSOURCE() {}
+        virtual bool Start(POINTERSTREAM* Stream) = 0;
+        virtual void Stop() = 0;
+};
+
+//
+// Stand-in for an input device: plays recorded or generated positions into the stream at their own pace,
+// on the steady clock, starting at the time returned by GetStartTime
+//
+class SCRIPTEDPOINTERSOURCE : public POINTERSOURCE
+{
+    public:
+        SCRIPTEDPOINTERSOURCE();
+        ~SCRIPTEDPOINTERSOURCE();
+        bool Initialize(const POINTER_SAMPLE* Samples, UINT Count);
+        bool Start(POINTERSTREAM* Stream) override;
+        void Stop() override;
+        uint64_t GetStartTime();
+        bool IsFinished();
+
+        static uint64_t Now();
+
+    private:
+        void PlayThread();
+
+        const POINTER_SAMPLE* m_Samples;
+        UINT m_Count;
+        POINTERSTREAM* m_Stream;
+        uint64_t m_StartTime;
+
+        std::thread m_Player;
+        std::mutex m_Lock;
+        std::condition_variable m_Wake;
+        bool m_Stop;
+        std::atomic<bool> m_Finished;
+};
+
+#endif
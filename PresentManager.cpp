@@ -0,0 +1,417 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <avrt.h>
+#include <math.h>
+
+#include "PresentManager.h"
+
+// Number of frames between two reports of the presentation timings (10 seconds at 90 Hz)
+static constexpr UINT StatsReportInterval = 900;
+
+PRESENTMANAGER::PRESENTMANAGER() : m_OutMgr(nullptr),
+                                   m_ThreadMgr(nullptr),
+                                   m_UnexpectedErrorEvent(nullptr),
+                                   m_ExpectedErrorEvent(nullptr),
+                                   m_Thread(nullptr),
+                                   m_CommandEvent(nullptr),
+                                   m_AckEvent(nullptr),
+                                   m_Paused(true),
+                                   m_Failed(FALSE),
+                                   m_FrameCount(0),
+                                   m_GovernedGpuFrame(UINT64_MAX),
+                                   m_AllocCounter(L"PRESENTMANAGER")
+{
+    RtlZeroMemory(&m_Options, sizeof(m_Options));
+    QueryPerformanceFrequency(&m_QPCFrequency);
+    m_LastWakeTime.QuadPart = 0;
+    RtlZeroMemory(&m_WakeToSubmit, sizeof(m_WakeToSubmit));
+    RtlZeroMemory(&m_VBlankInterval, sizeof(m_VBlankInterval));
+}
+
+PRESENTMANAGER::~PRESENTMANAGER()
+{
+    Terminate();
+
+    if (m_CommandEvent)
+    {
+        CloseHandle(m_CommandEvent);
+        m_CommandEvent = nullptr;
+    }
+
+    if (m_AckEvent)
+    {
+        CloseHandle(m_AckEvent);
+        m_AckEvent = nullptr;
+    }
+}
+
+//
+// Set up the presenter, it starts paused
+//
+DUPL_RETURN PRESENTMANAGER::Initialize(_In_ OUTPUTMANAGER* OutMgr, _In_ THREADMANAGER* ThreadMgr, _In_ PRESENT_OPTIONS* Options, HANDLE UnexpectedErrorEvent, HANDLE ExpectedErrorEvent)
+{
+    m_OutMgr = OutMgr;
+    m_ThreadMgr = ThreadMgr;
+    m_Options = *Options;
+    m_UnexpectedErrorEvent = UnexpectedErrorEvent;
+    m_ExpectedErrorEvent = ExpectedErrorEvent;
+
+    if (!m_Options.PresentThread)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    m_CommandEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    m_AckEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (!m_CommandEvent || !m_AckEvent)
+    {
+        return ProcessFailure(nullptr, L"Failed to create presentation thread events", L"Error", E_UNEXPECTED);
+    }
+
+    DWORD ThreadId;
+    m_Thread = CreateThread(nullptr, 0, PresentProc, this, 0, &ThreadId);
+    if (!m_Thread)
+    {
+        return ProcessFailure(nullptr, L"Failed to create presentation thread", L"Error", E_FAIL);
+    }
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Stop presenting. Returns once the presenter no longer touches the output.
+//
+void PRESENTMANAGER::Pause()
+{
+    SendCommand(PRESENT_CMD_PAUSE, true);
+}
+
+//
+// Start presenting again
+//
+void PRESENTMANAGER::Resume()
+{
+    SendCommand(PRESENT_CMD_RESUME, false);
+}
+
+//
+// Stop the presentation thread
+//
+void PRESENTMANAGER::Terminate()
+{
+    if (!m_Thread)
+    {
+        return;
+    }
+
+    SendCommand(PRESENT_CMD_EXIT, false);
+    WaitForSingleObjectEx(m_Thread, INFINITE, FALSE);
+    CloseHandle(m_Thread);
+    m_Thread = nullptr;
+}
+
+bool PRESENTMANAGER::IsThreaded()
+{
+    return m_Options.PresentThread;
+}
+
+//
+// Returns whether the last failure came from the presenter, and clears it
+//
+bool PRESENTMANAGER::CheckFailed()
+{
+    return InterlockedExchange(&m_Failed, FALSE) != FALSE;
+}
+
+void PRESENTMANAGER::SendCommand(PRESENT_COMMAND Command, bool WaitForAck)
+{
+    if (!m_Thread)
+    {
+        // Presenting from the message loop, nothing runs concurrently
+        m_Paused = (Command != PRESENT_CMD_RESUME);
+        if (!m_Paused)
+        {
+            m_AllocCounter.Restart();
+        }
+        return;
+    }
+
+    while (!m_Commands.Push(Command))
+    {
+        // The presenter drains the queue every frame so this does not happen in practice
+        Sleep(0);
+    }
+    SetEvent(m_CommandEvent);
+
+    if (WaitForAck)
+    {
+        WaitForSingleObjectEx(m_AckEvent, INFINITE, FALSE);
+    }
+}
+
+//
+// Executes pending commands on the presentation thread, returns false when asked to exit
+//
+bool PRESENTMANAGER::ProcessCommands()
+{
+    PRESENT_COMMAND Command;
+    while (m_Commands.Pop(&Command))
+    {
+        switch (Command)
+        {
+            case PRESENT_CMD_PAUSE:
+            {
+                m_Paused = true;
+                SetEvent(m_AckEvent);
+                break;
+            }
+            case PRESENT_CMD_RESUME:
+            {
+                m_Paused = false;
+                m_AllocCounter.Restart();
+                break;
+            }
+            case PRESENT_CMD_EXIT:
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// Entry point for the presentation thread
+//
+DWORD WINAPI PRESENTMANAGER::PresentProc(_In_ void* Param)
+{
+    reinterpret_cast<PRESENTMANAGER*>(Param)->Run();
+    return 0;
+}
+
+void PRESENTMANAGER::Run()
+{
+    // Let the multimedia scheduler know we have a hard deadline every v-blank
+    HANDLE MmcssHandle = nullptr;
+    if (m_Options.MmcssTask)
+    {
+        DWORD TaskIndex = 0;
+        MmcssHandle = AvSetMmThreadCharacteristicsW(m_Options.MmcssTask, &TaskIndex);
+        if (!MmcssHandle)
+        {
+            OutputDebugStringW(L"PRESENTMANAGER: MMCSS registration failed\n");
+        }
+    }
+
+    if (m_Options.RealTime)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+        if (MmcssHandle)
+        {
+            AvSetMmThreadPriority(MmcssHandle, AVRT_PRIORITY_CRITICAL);
+        }
+    }
+
+    while (ProcessCommands())
+    {
+        if (m_Paused)
+        {
+            WaitForSingleObjectEx(m_CommandEvent, INFINITE, FALSE);
+            continue;
+        }
+
+        DUPL_RETURN Ret = PresentOnce();
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            // Leave the output alone until the main loop has rebuilt it
+            m_Paused = true;
+            SetEvent((Ret == DUPL_RETURN_ERROR_EXPECTED) ? m_ExpectedErrorEvent : m_UnexpectedErrorEvent);
+        }
+    }
+
+    if (MmcssHandle)
+    {
+        AvRevertMmThreadCharacteristics(MmcssHandle);
+    }
+}
+
+//
+// Wait for the next v-blank and present, recording how long it took
+//
+DUPL_RETURN PRESENTMANAGER::PresentOnce()
+{
+    if (m_Paused)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    m_OutMgr->WaitNextVBlank();
+    m_AllocCounter.BeginFrame();
+
+    LARGE_INTEGER WakeTime;
+    QueryPerformanceCounter(&WakeTime);
+    if (m_LastWakeTime.QuadPart)
+    {
+        AddSample(&m_VBlankInterval, (WakeTime.QuadPart - m_LastWakeTime.QuadPart) * 1000.0 / m_QPCFrequency.QuadPart);
+    }
+    m_LastWakeTime = WakeTime;
+
+    DUPL_RETURN Ret = m_OutMgr->UpdateApplicationWindow(m_ThreadMgr->GetPointerInfo(), m_ThreadMgr->GetPointerPosition(), m_ThreadMgr->GetDamageInfo());
+    if (Ret != DUPL_RETURN_SUCCESS)
+    {
+        InterlockedExchange(&m_Failed, TRUE);
+        m_LastWakeTime.QuadPart = 0;
+        return Ret;
+    }
+
+    LARGE_INTEGER SubmitTime;
+    QueryPerformanceCounter(&SubmitTime);
+    AddSample(&m_WakeToSubmit, (SubmitTime.QuadPart - WakeTime.QuadPart) * 1000.0 / m_QPCFrequency.QuadPart);
+    if (m_Options.Timeline)
+    {
+        m_Options.Timeline->AddCpuSpan(0, m_FrameCount, PROFILE_PASS_SUBMIT, QpcToNs(WakeTime.QuadPart), QpcToNs(SubmitTime.QuadPart));
+    }
+    ++m_FrameCount;
+
+    // The governor weighs this frame's CPU time and the newest GPU frame the timeline has, once each
+    if (m_Options.Governor)
+    {
+        GOVERNOR_SAMPLE Sample;
+        Sample.CpuNs = QpcToNs(SubmitTime.QuadPart) - QpcToNs(WakeTime.QuadPart);
+        Sample.GpuNs = 0;
+        Sample.HasGpu = false;
+        uint64_t GpuFrame;
+        if (m_Options.Timeline && m_Options.Timeline->GetLastGpuFrame(0, &GpuFrame, &Sample.GpuNs) && GpuFrame != m_GovernedGpuFrame)
+        {
+            Sample.HasGpu = true;
+            m_GovernedGpuFrame = GpuFrame;
+        }
+
+        GOVERNOR_LEVEL Before = m_Options.Governor->GetLevel();
+        GOVERNOR_LEVEL After = m_Options.Governor->AddFrame(&Sample);
+        if (After != Before)
+        {
+            wchar_t Msg[128];
+            swprintf_s(Msg, L"Present: governor %s to %S\n", (After > Before) ? L"shed work" : L"restored work", GetGovernorLevelName(After));
+            OutputDebugStringW(Msg);
+        }
+    }
+
+    if (m_WakeToSubmit.Count >= StatsReportInterval)
+    {
+        ReportStats();
+    }
+
+    m_AllocCounter.EndFrame();
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Welford's running mean and variance
+//
+void PRESENTMANAGER::AddSample(_Inout_ PRESENT_STAT* Stat, double Value)
+{
+    if (Stat->Count == 0)
+    {
+        Stat->Min = Value;
+        Stat->Max = Value;
+    }
+    else
+    {
+        Stat->Min = min(Stat->Min, Value);
+        Stat->Max = max(Stat->Max, Value);
+    }
+
+    Stat->Count++;
+    double Delta = Value - Stat->Mean;
+    Stat->Mean += Delta / Stat->Count;
+    Stat->M2 += Delta * (Value - Stat->Mean);
+}
+
+//
+// Print the timings gathered since the last report and start over
+//
+void PRESENTMANAGER::ReportStats()
+{
+    double WakeStdDev = (m_WakeToSubmit.Count > 1) ? sqrt(m_WakeToSubmit.M2 / (m_WakeToSubmit.Count - 1)) : 0.0;
+    double VBlankStdDev = (m_VBlankInterval.Count > 1) ? sqrt(m_VBlankInterval.M2 / (m_VBlankInterval.Count - 1)) : 0.0;
+
+    wchar_t Msg[256];
+    swprintf_s(Msg, L"Present (%s): wake to submit %.3f ms (stddev %.3f, min %.3f, max %.3f), v-blank interval %.3f ms (stddev %.3f, max %.3f)\n",
+               m_Thread ? L"thread" : L"message loop",
+               m_WakeToSubmit.Mean, WakeStdDev, m_WakeToSubmit.Min, m_WakeToSubmit.Max,
+               m_VBlankInterval.Mean, VBlankStdDev, m_VBlankInterval.Max);
+    OutputDebugStringW(Msg);
+
+    // Time of every pass of capture and present over the same frames, CPU and GPU alike
+    double GpuMs = 0.0;
+    if (m_Options.Timeline)
+    {
+        for (UINT Track = 0; Track < PROFILE_TRACK_COUNT; ++Track)
+        {
+            for (UINT Pass = 0; Pass < PROFILE_PASS_COUNT; ++Pass)
+            {
+                PROFILE_STAT Stat;
+                m_Options.Timeline->GetStat(static_cast<PROFILE_TRACK>(Track), static_cast<PROFILE_PASS>(Pass), &Stat);
+                if (!Stat.Count)
+                {
+                    continue;
+                }
+
+                if (Track == PROFILE_TRACK_GPU)
+                {
+                    GpuMs += Stat.Mean * Stat.Count;
+                }
+
+                double StdDev = (Stat.Count > 1) ? sqrt(Stat.M2 / (Stat.Count - 1)) : 0.0;
+                swprintf_s(Msg, L"  %s %S: %.3f ms (stddev %.3f, min %.3f, max %.3f) over %u passes\n",
+                           Track ? L"GPU" : L"CPU", GetProfilePassName(static_cast<PROFILE_PASS>(Pass)),
+                           Stat.Mean, StdDev, Stat.Min, Stat.Max, Stat.Count);
+                OutputDebugStringW(Msg);
+            }
+        }
+        m_Options.Timeline->ResetStats();
+    }
+
+    if (m_Options.Governor)
+    {
+        GOVERNOR_STATS Stats;
+        m_Options.Governor->GetStats(&Stats);
+        swprintf_s(Msg, L"  Governor: %u of %u frames over budget, shed %u and restored %u times, frames per level %u %u %u %u %u\n",
+                   Stats.OverBudget, Stats.Frames, Stats.Sheds, Stats.Restores, Stats.FramesAtLevel[GOVERNOR_LEVEL_FULL],
+                   Stats.FramesAtLevel[GOVERNOR_LEVEL_STATIC_CURSOR], Stats.FramesAtLevel[GOVERNOR_LEVEL_DEFER_OUTPUTS],
+                   Stats.FramesAtLevel[GOVERNOR_LEVEL_COARSE_DIRTY], Stats.FramesAtLevel[GOVERNOR_LEVEL_NO_FILTER]);
+        OutputDebugStringW(Msg);
+        m_Options.Governor->ResetStats();
+    }
+
+    // What the refresh rates the headset ran at cost, scaled to an hour: v-blanks stand for the display's power
+    // and the GPU time of every pass for the GPU's
+    REFRESHPOLICY* RefreshPolicy = m_OutMgr->GetRefreshPolicy();
+    if (RefreshPolicy)
+    {
+        REFRESH_STATS Stats;
+        RefreshPolicy->GetStats(&Stats);
+        if (Stats.ElapsedNs)
+        {
+            double PerHour = 3600e9 / Stats.ElapsedNs;
+            swprintf_s(Msg, L"  Refresh: %.2f Hz on average, %u switches, %.0f v-blanks and %.0f ms of GPU per hour, idle %.0f%% active %.0f%% video %.0f%% pointer %.0f%%\n",
+                       Stats.VBlanks * 1e9 / Stats.ElapsedNs, Stats.Switches, Stats.VBlanks * PerHour, GpuMs * PerHour,
+                       100.0 * Stats.NsAtContent[REFRESH_CONTENT_IDLE] / Stats.ElapsedNs, 100.0 * Stats.NsAtContent[REFRESH_CONTENT_ACTIVE] / Stats.ElapsedNs,
+                       100.0 * Stats.NsAtContent[REFRESH_CONTENT_VIDEO] / Stats.ElapsedNs, 100.0 * Stats.NsAtContent[REFRESH_CONTENT_POINTER] / Stats.ElapsedNs);
+            OutputDebugStringW(Msg);
+        }
+        RefreshPolicy->ResetStats();
+    }
+
+    RtlZeroMemory(&m_WakeToSubmit, sizeof(m_WakeToSubmit));
+    RtlZeroMemory(&m_VBlankInterval, sizeof(m_VBlankInterval));
+}
@@ -0,0 +1,106 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _PRESENTMANAGER_H_
+#define _PRESENTMANAGER_H_
+
+#include "AllocationCounter.h"
+#include "CommonTypes.h"
+#include "CommandQueue.h"
+#include "OutputManager.h"
+#include "ThreadManager.h"
+
+//
+// How the presenter runs
+//
+typedef struct _PRESENT_OPTIONS
+{
+    // Present from a dedicated thread rather than from the message loop
+    bool PresentThread;
+
+    // MMCSS task to register the presentation thread with, nullptr for none
+    LPCWSTR MmcssTask;
+
+    // Run the presentation thread at time critical priority
+    bool RealTime;
+
+    // Timeline wake to submit is recorded onto, nullptr when not profiling
+    PROFILETIMELINE* Timeline;
+
+    // Governor every frame's cost is reported to, nullptr when not governing. Needs the timeline for GPU costs.
+    FRAMEGOVERNOR* Governor;
+} PRESENT_OPTIONS;
+
+typedef enum
+{
+    PRESENT_CMD_PAUSE       = 0,
+    PRESENT_CMD_RESUME      = 1,
+    PRESENT_CMD_EXIT        = 2
+} PRESENT_COMMAND;
+
+//
+// Running statistics for one presentation timing
+//
+typedef struct _PRESENT_STAT
+{
+    UINT Count;
+    double Mean;
+    double M2;
+    double Min;
+    double Max;
+} PRESENT_STAT;
+
+//
+// Drives the HMD presentation loop, either on its own thread or from the message loop
+//
+class PRESENTMANAGER
+{
+    public:
+        PRESENTMANAGER();
+        ~PRESENTMANAGER();
+        DUPL_RETURN Initialize(_In_ OUTPUTMANAGER* OutMgr, _In_ THREADMANAGER* ThreadMgr, _In_ PRESENT_OPTIONS* Options, HANDLE UnexpectedErrorEvent, HANDLE ExpectedErrorEvent);
+        void Pause();
+        void Resume();
+        void Terminate();
+        DUPL_RETURN PresentOnce();
+        bool IsThreaded();
+        bool CheckFailed();
+
+    private:
+    // methods
+        static DWORD WINAPI PresentProc(_In_ void* Param);
+        void Run();
+        void SendCommand(PRESENT_COMMAND Command, bool WaitForAck);
+        bool ProcessCommands();
+        void AddSample(_Inout_ PRESENT_STAT* Stat, double Value);
+        void ReportStats();
+
+    // variables
+        OUTPUTMANAGER* m_OutMgr;
+        THREADMANAGER* m_ThreadMgr;
+        PRESENT_OPTIONS m_Options;
+        HANDLE m_UnexpectedErrorEvent;
+        HANDLE m_ExpectedErrorEvent;
+
+        HANDLE m_Thread;
+        HANDLE m_CommandEvent;
+        HANDLE m_AckEvent;
+        COMMANDQUEUE<PRESENT_COMMAND, 16> m_Commands;
+        bool m_Paused;
+        volatile LONG m_Failed;
+
+        LARGE_INTEGER m_QPCFrequency;
+        LARGE_INTEGER m_LastWakeTime;
+        PRESENT_STAT m_WakeToSubmit;
+        PRESENT_STAT m_VBlankInterval;
+        uint64_t m_FrameCount;
+        uint64_t m_GovernedGpuFrame;
+
+        ALLOCATIONCOUNTER m_AllocCounter;
+};
+
+#endif
@@ -0,0 +1,259 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <string.h>
+
+#include "RectApply.h"
+
+static inline LONG MaxLong(LONG A, LONG B)
+{
+    return (A > B) ? A : B;
+}
+
+static inline LONG MinLong(LONG A, LONG B)
+{
+    return (A < B) ? A : B;
+}
+
+static inline bool ClipRect(RECT* Rect, LONG Width, LONG Height)
+{
+    Rect->left = MaxLong(Rect->left, 0);
+    Rect->top = MaxLong(Rect->top, 0);
+    Rect->right = MinLong(Rect->right, Width);
+    Rect->bottom = MinLong(Rect->bottom, Height);
+    return (Rect->right > Rect->left) && (Rect->bottom > Rect->top);
+}
+
+static inline bool Overlaps(const RECT* A, const RECT* B)
+{
+    return (A->left < B->right) && (B->left < A->right) && (A->top < B->bottom) && (B->top < A->bottom);
+}
+
+static inline void SetMapping(APPLY_RECT* Rect, INT AxisXX, INT AxisXY, INT AxisYX, INT AxisYY, INT OffsetX, INT OffsetY)
+{
+    Rect->AxisX[0] = AxisXX;
+    Rect->AxisX[1] = AxisXY;
+    Rect->AxisY[0] = AxisYX;
+    Rect->AxisY[1] = AxisYY;
+    Rect->Offset[0] = OffsetX;
+    Rect->Offset[1] = OffsetY;
+}
+
+//
+// Shared surface pixels of the output back to frame pixels, the inverse of RotateFrameRect
+//
+static void SetFrameMapping(const RECT_TRANSFORM* Transform, APPLY_RECT* Rect)
+{
+    INT Width = Transform->Width;
+    INT Height = Transform->Height;
+    INT OriginX = Transform->OriginX;
+    INT OriginY = Transform->OriginY;
+    switch (Transform->Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+            SetMapping(Rect, 0, -1, 1, 0, -OriginY, Width - 1 + OriginX);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE180:
+            SetMapping(Rect, -1, 0, 0, -1, Width - 1 + OriginX, Height - 1 + OriginY);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE270:
+            SetMapping(Rect, 0, 1, -1, 0, Height - 1 + OriginY, -OriginX);
+            break;
+        default:
+            SetMapping(Rect, 1, 0, 0, 1, -OriginX, -OriginY);
+            break;
+    }
+}
+
+//
+// Turn a frame's moves and dirty rects into rects on the shared surface and bin them by tile. Rects are
+// clipped to the output, and to the frame for dirty rects. Returns false when out of memory or when a move
+// reads what an earlier move of the same frame wrote, which one copy of the move sources cannot reproduce;
+// the caller then applies the frame rect by rect instead.
+//
+bool BuildApplyList(const RECT_TRANSFORM* Transform, UINT TexWidth, UINT TexHeight, const DXGI_OUTDUPL_MOVE_RECT* MoveRects, UINT MoveCount,
+                    const RECT* DirtyRects, UINT DirtyCount, FRAMEARENA* Arena, APPLY_LIST* List)
+{
+    memset(List, 0, sizeof(APPLY_LIST));
+
+    UINT Count = MoveCount + DirtyCount;
+    if (!Count)
+    {
+        return true;
+    }
+
+    LONG Width = Transform->Width;
+    LONG Height = Transform->Height;
+    List->Rects = Arena->AllocArray<APPLY_RECT>(Count);
+    if (!List->Rects)
+    {
+        return false;
+    }
+
+    if (MoveCount)
+    {
+        RECT* SrcRects = Arena->AllocArray<RECT>(MoveCount * 2);
+        if (!SrcRects)
+        {
+            return false;
+        }
+        RECT* DestRects = SrcRects + MoveCount;
+        TransformMoveRects(Transform, MoveRects, MoveCount, SrcRects, DestRects);
+
+        for (UINT i = 0; i < MoveCount; ++i)
+        {
+            // Clip the destination so that its source stays on the output too
+            LONG DeltaX = SrcRects[i].left - DestRects[i].left;
+            LONG DeltaY = SrcRects[i].top - DestRects[i].top;
+            RECT Dest = DestRects[i];
+            if (!ClipRect(&Dest, MinLong(Width, Width - DeltaX), MinLong(Height, Height - DeltaY)))
+            {
+                continue;
+            }
+            Dest.left = MaxLong(Dest.left, -DeltaX);
+            Dest.top = MaxLong(Dest.top, -DeltaY);
+            if (Dest.right <= Dest.left || Dest.bottom <= Dest.top)
+            {
+                continue;
+            }
+            RECT Src = {Dest.left + DeltaX, Dest.top + DeltaY, Dest.right + DeltaX, Dest.bottom + DeltaY};
+
+            // Kept moves' destinations, relative to the output, are gathered at the front of DestRects
+            for (UINT j = 0; j < List->MoveCount; ++j)
+            {
+                if (Overlaps(&Src, &DestRects[j]))
+                {
+                    return false;
+                }
+            }
+            DestRects[List->MoveCount] = Dest;
+
+            if (!List->MoveCount)
+            {
+                List->MoveSource = Src;
+            }
+            else
+            {
+                List->MoveSource.left = MinLong(List->MoveSource.left, Src.left);
+                List->MoveSource.top = MinLong(List->MoveSource.top, Src.top);
+                List->MoveSource.right = MaxLong(List->MoveSource.right, Src.right);
+                List->MoveSource.bottom = MaxLong(List->MoveSource.bottom, Src.bottom);
+            }
+
+            // The moved copy sits at the output's own coordinates
+            APPLY_RECT* Rect = &List->Rects[List->RectCount++];
+            Rect->Dest = {Dest.left + Transform->OriginX, Dest.top + Transform->OriginY, Dest.right + Transform->OriginX, Dest.bottom + Transform->OriginY};
+            SetMapping(Rect, 1, 0, 0, 1, DeltaX - Transform->OriginX, DeltaY - Transform->OriginY);
+            Rect->Source = APPLY_SOURCE_MOVED;
+            Rect->Padding = 0;
+            ++List->MoveCount;
+        }
+    }
+
+    for (UINT i = 0; i < DirtyCount; ++i)
+    {
+        RECT Dirty = DirtyRects[i];
+        RECT Dest;
+        if (!ClipRect(&Dirty, TexWidth, TexHeight))
+        {
+            continue;
+        }
+        RotateFrameRect(Transform, &Dirty, &Dest);
+        if (!ClipRect(&Dest, Width, Height))
+        {
+            continue;
+        }
+
+        APPLY_RECT* Rect = &List->Rects[List->RectCount++];
+        Rect->Dest = {Dest.left + Transform->OriginX, Dest.top + Transform->OriginY, Dest.right + Transform->OriginX, Dest.bottom + Transform->OriginY};
+        SetFrameMapping(Transform, Rect);
+        Rect->Source = APPLY_SOURCE_FRAME;
+        Rect->Padding = 0;
+    }
+
+    if (!List->RectCount)
+    {
+        return true;
+    }
+
+    // Count the rects of every tile of the output, then give each touched tile its slice of TileRects
+    UINT Columns = (Width + APPLY_TILE_SIZE - 1) / APPLY_TILE_SIZE;
+    UINT Rows = (Height + APPLY_TILE_SIZE - 1) / APPLY_TILE_SIZE;
+    UINT* Slots = Arena->AllocArray<UINT>(static_cast<size_t>(Columns) * Rows);
+    if (!Slots)
+    {
+        return false;
+    }
+    memset(Slots, 0, static_cast<size_t>(Columns) * Rows * sizeof(UINT));
+
+    for (UINT i = 0; i < List->RectCount; ++i)
+    {
+        const RECT* Dest = &List->Rects[i].Dest;
+        UINT FirstColumn = (Dest->left - Transform->OriginX) / APPLY_TILE_SIZE;
+        UINT LastColumn = (Dest->right - Transform->OriginX - 1) / APPLY_TILE_SIZE;
+        UINT FirstRow = (Dest->top - Transform->OriginY) / APPLY_TILE_SIZE;
+        UINT LastRow = (Dest->bottom - Transform->OriginY - 1) / APPLY_TILE_SIZE;
+        for (UINT Row = FirstRow; Row <= LastRow; ++Row)
+        {
+            for (UINT Column = FirstColumn; Column <= LastColumn; ++Column)
+            {
+                if (!Slots[Row * Columns + Column]++)
+                {
+                    ++List->TileCount;
+                }
+                ++List->TileRectCount;
+            }
+        }
+    }
+
+    List->Tiles = Arena->AllocArray<APPLY_TILE>(List->TileCount);
+    List->TileRects = Arena->AllocArray<UINT>(List->TileRectCount);
+    if (!List->Tiles || !List->TileRects)
+    {
+        return false;
+    }
+
+    // From here on a slot holds one past the index of its tile
+    UINT Tile = 0;
+    UINT First = 0;
+    for (UINT Row = 0; Row < Rows; ++Row)
+    {
+        for (UINT Column = 0; Column < Columns; ++Column)
+        {
+            UINT* Slot = &Slots[Row * Columns + Column];
+            if (*Slot)
+            {
+                List->Tiles[Tile].Left = Transform->OriginX + Column * APPLY_TILE_SIZE;
+                List->Tiles[Tile].Top = Transform->OriginY + Row * APPLY_TILE_SIZE;
+                List->Tiles[Tile].First = First;
+                List->Tiles[Tile].Count = 0;
+                First += *Slot;
+                *Slot = ++Tile;
+            }
+        }
+    }
+
+    // Rects go into their tiles in list order, which is the order they are applied in
+    for (UINT i = 0; i < List->RectCount; ++i)
+    {
+        const RECT* Dest = &List->Rects[i].Dest;
+        UINT FirstColumn = (Dest->left - Transform->OriginX) / APPLY_TILE_SIZE;
+        UINT LastColumn = (Dest->right - Transform->OriginX - 1) / APPLY_TILE_SIZE;
+        UINT FirstRow = (Dest->top - Transform->OriginY) / APPLY_TILE_SIZE;
+        UINT LastRow = (Dest->bottom - Transform->OriginY - 1) / APPLY_TILE_SIZE;
+        for (UINT Row = FirstRow; Row <= LastRow; ++Row)
+        {
+            for (UINT Column = FirstColumn; Column <= LastColumn; ++Column)
+            {
+                APPLY_TILE* Entry = &List->Tiles[Slots[Row * Columns + Column] - 1];
+                List->TileRects[Entry->First + Entry->Count++] = i;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,77 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _RECTAPPLY_H_
+#define _RECTAPPLY_H_
+
+#include "FrameArena.h"
+#include "RectTransform.h"
+
+// Must match APPLY_TILE_SIZE in ApplyRects.hlsl, one thread group per tile
+#define APPLY_TILE_SIZE 32
+
+//
+// Where the pixels of a rect come from
+//
+typedef enum
+{
+    APPLY_SOURCE_MOVED  = 0,    // The shared surface as it was before the frame, copied aside
+    APPLY_SOURCE_FRAME  = 1     // The duplicated frame
+} APPLY_SOURCE;
+
+//
+// One move or dirty rect as the apply dispatch sees it. Dest is on the shared surface, and its pixel X, Y
+// comes from pixel AxisX * X + AxisY * Y + Offset of Source, which covers rotation and placement alike.
+// Same layout as the structured buffer in ApplyRects.hlsl.
+//
+typedef struct _APPLY_RECT
+{
+    RECT Dest;
+    INT AxisX[2];
+    INT AxisY[2];
+    INT Offset[2];
+    UINT Source;
+    UINT Padding;
+} APPLY_RECT;
+
+//
+// A tile of the shared surface some rect touches and the range of TileRects holding those rects, in frame order
+//
+typedef struct _APPLY_TILE
+{
+    UINT Left;
+    UINT Top;
+    UINT First;
+    UINT Count;
+} APPLY_TILE;
+
+//
+// Everything one dispatch needs to apply a frame's moves and dirty rects, moves first. The last rect of a
+// tile covering a pixel decides it, which is the order the draw and copy path writes them in. Arrays come
+// from the frame arena.
+//
+typedef struct _APPLY_LIST
+{
+    APPLY_RECT* Rects;
+    UINT RectCount;
+    UINT MoveCount;
+
+    APPLY_TILE* Tiles;
+    UINT TileCount;
+
+    UINT* TileRects;
+    UINT TileRectCount;
+
+    // Part of the output the moves read, relative to the output. It is copied aside before the dispatch so
+    // moves never see each other's writes. Empty without moves.
+    RECT MoveSource;
+} APPLY_LIST;
+
+bool BuildApplyList(const RECT_TRANSFORM* Transform, UINT TexWidth, UINT TexHeight, const DXGI_OUTDUPL_MOVE_RECT* MoveRects, UINT MoveCount,
+                    const RECT* DirtyRects, UINT DirtyCount, FRAMEARENA* Arena, APPLY_LIST* List);
+
+#endif
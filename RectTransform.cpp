@@ -0,0 +1,456 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <string.h>
+
+#include "RectTransform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RECT_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+//
+// Set up the transform of an output Width x Height in desktop orientation, placed at OriginX, OriginY on a
+// TargetWidth x TargetHeight surface, whose frames are TexWidth x TexHeight
+//
+void InitRectTransform(RECT_TRANSFORM* Transform, DXGI_MODE_ROTATION Rotation, INT Width, INT Height, INT OriginX, INT OriginY,
+                       UINT TexWidth, UINT TexHeight, UINT TargetWidth, UINT TargetHeight)
+{
+    Transform->Rotation = Rotation;
+    Transform->Width = Width;
+    Transform->Height = Height;
+    Transform->OriginX = OriginX;
+    Transform->OriginY = OriginY;
+
+    // Clip space is centered on the surface, rounded down to a whole pixel like the viewport math always was
+    float CenterX = static_cast<float>(TargetWidth / 2);
+    float CenterY = static_cast<float>(TargetHeight / 2);
+    Transform->PosScaleX = 1.0f / CenterX;
+    Transform->PosOffsetX = -1.0f;
+    Transform->PosScaleY = -1.0f / CenterY;
+    Transform->PosOffsetY = 1.0f;
+
+    Transform->TexScaleX = 1.0f / TexWidth;
+    Transform->TexScaleY = 1.0f / TexHeight;
+}
+
+#ifdef RECT_TRANSFORM_SSE2
+
+//
+// Four rects' worth of one edge, so the rotation below reads the same for one rect or four
+//
+struct LANES
+{
+    __m128i Value;
+};
+
+static inline LANES operator+(LANES A, LANES B)
+{
+    return {_mm_add_epi32(A.Value, B.Value)};
+}
+
+static inline LANES operator-(LANES A, LANES B)
+{
+    return {_mm_sub_epi32(A.Value, B.Value)};
+}
+
+//
+// Four rects to their four edges and back, a 4x4 transpose
+//
+static inline void Transpose(__m128i* A, __m128i* B, __m128i* C, __m128i* D)
+{
+    __m128i Low01 = _mm_unpacklo_epi32(*A, *B);
+    __m128i Low23 = _mm_unpacklo_epi32(*C, *D);
+    __m128i High01 = _mm_unpackhi_epi32(*A, *B);
+    __m128i High23 = _mm_unpackhi_epi32(*C, *D);
+    *A = _mm_unpacklo_epi64(Low01, Low23);
+    *B = _mm_unpackhi_epi64(Low01, Low23);
+    *C = _mm_unpacklo_epi64(High01, High23);
+    *D = _mm_unpackhi_epi64(High01, High23);
+}
+
+#endif
+
+//
+// Rect of the frame in desktop orientation. The frame is the desktop turned by Rotation, Width and Height are
+// of the desktop.
+//
+template <DXGI_MODE_ROTATION Rotation, typename EDGE>
+static inline void RotateRect(EDGE Left, EDGE Top, EDGE Right, EDGE Bottom, EDGE Width, EDGE Height, EDGE* OutLeft, EDGE* OutTop, EDGE* OutRight, EDGE* OutBottom)
+{
+    switch (Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+        {
+            *OutLeft = Width - Bottom;
+            *OutTop = Left;
+            *OutRight = Width - Top;
+            *OutBottom = Right;
+            break;
+        }
+        case DXGI_MODE_ROTATION_ROTATE180:
+        {
+            *OutLeft = Width - Right;
+            *OutTop = Height - Bottom;
+            *OutRight = Width - Left;
+            *OutBottom = Height - Top;
+            break;
+        }
+        case DXGI_MODE_ROTATION_ROTATE270:
+        {
+            *OutLeft = Top;
+            *OutTop = Height - Right;
+            *OutRight = Bottom;
+            *OutBottom = Height - Left;
+            break;
+        }
+        default:
+        {
+            *OutLeft = Left;
+            *OutTop = Top;
+            *OutRight = Right;
+            *OutBottom = Bottom;
+            break;
+        }
+    }
+}
+
+//
+// Corners of the frame rect sampled at the positions of vertices 0, 1, 2 and 5: the bottom left, top left,
+// bottom right and top right of the destination. Bit 0 picks the right edge of the frame rect, bit 1 its bottom.
+//
+template <DXGI_MODE_ROTATION Rotation>
+struct TEX_CORNERS
+{
+    static constexpr UINT Corners[4] = {2, 0, 3, 1};
+};
+
+template <>
+struct TEX_CORNERS<DXGI_MODE_ROTATION_ROTATE90>
+{
+    static constexpr UINT Corners[4] = {3, 2, 1, 0};
+};
+
+template <>
+struct TEX_CORNERS<DXGI_MODE_ROTATION_ROTATE180>
+{
+    static constexpr UINT Corners[4] = {1, 3, 0, 2};
+};
+
+template <>
+struct TEX_CORNERS<DXGI_MODE_ROTATION_ROTATE270>
+{
+    static constexpr UINT Corners[4] = {0, 1, 2, 3};
+};
+
+//
+// The two triangles of one rect, from its destination in clip space and its source in texture coordinates
+//
+template <DXGI_MODE_ROTATION Rotation>
+static inline void EmitRect(RECT_VERTEX* Vertices, float PosLeft, float PosTop, float PosRight, float PosBottom,
+                            float TexLeft, float TexTop, float TexRight, float TexBottom)
+{
+    static const UINT Slots[4] = {0, 1, 2, 5};
+    const float PosX[4] = {PosLeft, PosLeft, PosRight, PosRight};
+    const float PosY[4] = {PosBottom, PosTop, PosBottom, PosTop};
+    for (UINT i = 0; i < 4; ++i)
+    {
+        UINT Corner = TEX_CORNERS<Rotation>::Corners[i];
+        RECT_VERTEX* Vertex = &Vertices[Slots[i]];
+        Vertex->Pos[0] = PosX[i];
+        Vertex->Pos[1] = PosY[i];
+        Vertex->Pos[2] = 0.0f;
+        Vertex->TexCoord[0] = (Corner & 1) ? TexRight : TexLeft;
+        Vertex->TexCoord[1] = (Corner & 2) ? TexBottom : TexTop;
+    }
+    Vertices[3] = Vertices[2];
+    Vertices[4] = Vertices[1];
+}
+
+//
+// Without Emit only the destination rects are worked out, for the instanced draw that expands rects on the GPU
+//
+template <DXGI_MODE_ROTATION Rotation, bool Emit>
+static void DirtyKernel(const RECT_TRANSFORM* Transform, const RECT* DirtyRects, UINT Count, RECT_VERTEX* Vertices, RECT* DestRects)
+{
+    UINT i = 0;
+
+#ifdef RECT_TRANSFORM_SSE2
+    // Four rects at a time, transposed so each register holds one edge of all four
+    const LANES Width = {_mm_set1_epi32(Transform->Width)};
+    const LANES Height = {_mm_set1_epi32(Transform->Height)};
+    const LANES OriginX = {_mm_set1_epi32(Transform->OriginX)};
+    const LANES OriginY = {_mm_set1_epi32(Transform->OriginY)};
+    const __m128 PosScaleX = _mm_set1_ps(Transform->PosScaleX);
+    const __m128 PosOffsetX = _mm_set1_ps(Transform->PosOffsetX);
+    const __m128 PosScaleY = _mm_set1_ps(Transform->PosScaleY);
+    const __m128 PosOffsetY = _mm_set1_ps(Transform->PosOffsetY);
+    const __m128 TexScaleX = _mm_set1_ps(Transform->TexScaleX);
+    const __m128 TexScaleY = _mm_set1_ps(Transform->TexScaleY);
+
+    for (; i + 4 <= Count; i += 4)
+    {
+        LANES Left = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(&DirtyRects[i]))};
+        LANES Top = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(&DirtyRects[i + 1]))};
+        LANES Right = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(&DirtyRects[i + 2]))};
+        LANES Bottom = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(&DirtyRects[i + 3]))};
+        Transpose(&Left.Value, &Top.Value, &Right.Value, &Bottom.Value);
+
+        LANES DestLeft;
+        LANES DestTop;
+        LANES DestRight;
+        LANES DestBottom;
+        RotateRect<Rotation>(Left, Top, Right, Bottom, Width, Height, &DestLeft, &DestTop, &DestRight, &DestBottom);
+        DestLeft = DestLeft + OriginX;
+        DestTop = DestTop + OriginY;
+        DestRight = DestRight + OriginX;
+        DestBottom = DestBottom + OriginY;
+
+        if (!Emit)
+        {
+            Transpose(&DestLeft.Value, &DestTop.Value, &DestRight.Value, &DestBottom.Value);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i]), DestLeft.Value);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i + 1]), DestTop.Value);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i + 2]), DestRight.Value);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i + 3]), DestBottom.Value);
+            continue;
+        }
+
+        alignas(16) float Edges[8][4];
+        _mm_store_ps(Edges[0], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(DestLeft.Value), PosScaleX), PosOffsetX));
+        _mm_store_ps(Edges[1], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(DestTop.Value), PosScaleY), PosOffsetY));
+        _mm_store_ps(Edges[2], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(DestRight.Value), PosScaleX), PosOffsetX));
+        _mm_store_ps(Edges[3], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(DestBottom.Value), PosScaleY), PosOffsetY));
+        _mm_store_ps(Edges[4], _mm_mul_ps(_mm_cvtepi32_ps(Left.Value), TexScaleX));
+        _mm_store_ps(Edges[5], _mm_mul_ps(_mm_cvtepi32_ps(Top.Value), TexScaleY));
+        _mm_store_ps(Edges[6], _mm_mul_ps(_mm_cvtepi32_ps(Right.Value), TexScaleX));
+        _mm_store_ps(Edges[7], _mm_mul_ps(_mm_cvtepi32_ps(Bottom.Value), TexScaleY));
+
+        Transpose(&DestLeft.Value, &DestTop.Value, &DestRight.Value, &DestBottom.Value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i]), DestLeft.Value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i + 1]), DestTop.Value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i + 2]), DestRight.Value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&DestRects[i + 3]), DestBottom.Value);
+
+        for (UINT Lane = 0; Lane < 4; ++Lane)
+        {
+            EmitRect<Rotation>(&Vertices[(i + Lane) * RECT_VERTICES], Edges[0][Lane], Edges[1][Lane], Edges[2][Lane], Edges[3][Lane],
+                               Edges[4][Lane], Edges[5][Lane], Edges[6][Lane], Edges[7][Lane]);
+        }
+    }
+#endif
+
+    for (; i < Count; ++i)
+    {
+        const RECT* Dirty = &DirtyRects[i];
+        RECT* Dest = &DestRects[i];
+        RotateRect<Rotation>(Dirty->left, Dirty->top, Dirty->right, Dirty->bottom, static_cast<LONG>(Transform->Width), static_cast<LONG>(Transform->Height),
+                             &Dest->left, &Dest->top, &Dest->right, &Dest->bottom);
+        Dest->left += Transform->OriginX;
+        Dest->top += Transform->OriginY;
+        Dest->right += Transform->OriginX;
+        Dest->bottom += Transform->OriginY;
+        if (!Emit)
+        {
+            continue;
+        }
+
+        EmitRect<Rotation>(&Vertices[i * RECT_VERTICES],
+                           Dest->left * Transform->PosScaleX + Transform->PosOffsetX, Dest->top * Transform->PosScaleY + Transform->PosOffsetY,
+                           Dest->right * Transform->PosScaleX + Transform->PosOffsetX, Dest->bottom * Transform->PosScaleY + Transform->PosOffsetY,
+                           Dirty->left * Transform->TexScaleX, Dirty->top * Transform->TexScaleY,
+                           Dirty->right * Transform->TexScaleX, Dirty->bottom * Transform->TexScaleY);
+    }
+}
+
+//
+// Vertices drawing each dirty rect of the frame onto the shared surface, RECT_VERTICES per rect, and the
+// shared surface rect each one covers
+//
+void TransformDirtyRects(const RECT_TRANSFORM* Transform, const RECT* DirtyRects, UINT Count, RECT_VERTEX* Vertices, RECT* DestRects)
+{
+    switch (Transform->Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+            DirtyKernel<DXGI_MODE_ROTATION_ROTATE90, true>(Transform, DirtyRects, Count, Vertices, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE180:
+            DirtyKernel<DXGI_MODE_ROTATION_ROTATE180, true>(Transform, DirtyRects, Count, Vertices, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE270:
+            DirtyKernel<DXGI_MODE_ROTATION_ROTATE270, true>(Transform, DirtyRects, Count, Vertices, DestRects);
+            break;
+        default:
+            DirtyKernel<DXGI_MODE_ROTATION_IDENTITY, true>(Transform, DirtyRects, Count, Vertices, DestRects);
+            break;
+    }
+}
+
+//
+// Only the shared surface rect each dirty rect covers, the vertices are left to the GPU
+//
+void TransformDirtyDestRects(const RECT_TRANSFORM* Transform, const RECT* DirtyRects, UINT Count, RECT* DestRects)
+{
+    switch (Transform->Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+            DirtyKernel<DXGI_MODE_ROTATION_ROTATE90, false>(Transform, DirtyRects, Count, nullptr, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE180:
+            DirtyKernel<DXGI_MODE_ROTATION_ROTATE180, false>(Transform, DirtyRects, Count, nullptr, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE270:
+            DirtyKernel<DXGI_MODE_ROTATION_ROTATE270, false>(Transform, DirtyRects, Count, nullptr, DestRects);
+            break;
+        default:
+            DirtyKernel<DXGI_MODE_ROTATION_IDENTITY, false>(Transform, DirtyRects, Count, nullptr, DestRects);
+            break;
+    }
+}
+
+template <DXGI_MODE_ROTATION Rotation>
+static constexpr UINT PackCorners()
+{
+    return TEX_CORNERS<Rotation>::Corners[0] | (TEX_CORNERS<Rotation>::Corners[1] << 2) |
+           (TEX_CORNERS<Rotation>::Corners[2] << 4) | (TEX_CORNERS<Rotation>::Corners[3] << 6);
+}
+
+//
+// Constants the instanced draw of an output's dirty rects needs, once per frame
+//
+void InitRectConstants(const RECT_TRANSFORM* Transform, RECT_CONSTANTS* Constants)
+{
+    Constants->Width = Transform->Width;
+    Constants->Height = Transform->Height;
+    Constants->OriginX = Transform->OriginX;
+    Constants->OriginY = Transform->OriginY;
+    Constants->PosScaleX = Transform->PosScaleX;
+    Constants->PosOffsetX = Transform->PosOffsetX;
+    Constants->PosScaleY = Transform->PosScaleY;
+    Constants->PosOffsetY = Transform->PosOffsetY;
+    Constants->TexScaleX = Transform->TexScaleX;
+    Constants->TexScaleY = Transform->TexScaleY;
+    switch (Transform->Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+            Constants->Rotation = DXGI_MODE_ROTATION_ROTATE90;
+            Constants->Corners = PackCorners<DXGI_MODE_ROTATION_ROTATE90>();
+            break;
+        case DXGI_MODE_ROTATION_ROTATE180:
+            Constants->Rotation = DXGI_MODE_ROTATION_ROTATE180;
+            Constants->Corners = PackCorners<DXGI_MODE_ROTATION_ROTATE180>();
+            break;
+        case DXGI_MODE_ROTATION_ROTATE270:
+            Constants->Rotation = DXGI_MODE_ROTATION_ROTATE270;
+            Constants->Corners = PackCorners<DXGI_MODE_ROTATION_ROTATE270>();
+            break;
+        default:
+            Constants->Rotation = DXGI_MODE_ROTATION_IDENTITY;
+            Constants->Corners = PackCorners<DXGI_MODE_ROTATION_IDENTITY>();
+            break;
+    }
+}
+
+//
+// What VS_DirtyRects in DirtyRects.hlsl makes of strip vertex VertexId of a rect, to check the shader against
+// TransformDirtyRects where there is no GPU
+//
+void ExpandRectInstance(const RECT_CONSTANTS* Constants, const RECT* Rect, UINT VertexId, RECT_VERTEX* Vertex)
+{
+    RECT_TRANSFORM Transform = {};
+    Transform.Rotation = static_cast<DXGI_MODE_ROTATION>(Constants->Rotation);
+    Transform.Width = Constants->Width;
+    Transform.Height = Constants->Height;
+
+    RECT Dest;
+    RotateFrameRect(&Transform, Rect, &Dest);
+    Dest.left += Constants->OriginX;
+    Dest.top += Constants->OriginY;
+    Dest.right += Constants->OriginX;
+    Dest.bottom += Constants->OriginY;
+
+    UINT Corner = (Constants->Corners >> (2 * VertexId)) & 3;
+    Vertex->Pos[0] = ((VertexId & 2) ? Dest.right : Dest.left) * Constants->PosScaleX + Constants->PosOffsetX;
+    Vertex->Pos[1] = ((VertexId & 1) ? Dest.top : Dest.bottom) * Constants->PosScaleY + Constants->PosOffsetY;
+    Vertex->Pos[2] = 0.0f;
+    Vertex->TexCoord[0] = ((Corner & 1) ? Rect->right : Rect->left) * Constants->TexScaleX;
+    Vertex->TexCoord[1] = ((Corner & 2) ? Rect->bottom : Rect->top) * Constants->TexScaleY;
+}
+
+template <DXGI_MODE_ROTATION Rotation>
+static void MoveKernel(const RECT_TRANSFORM* Transform, const DXGI_OUTDUPL_MOVE_RECT* MoveRects, UINT Count, RECT* SrcRects, RECT* DestRects)
+{
+    LONG Width = Transform->Width;
+    LONG Height = Transform->Height;
+    for (UINT i = 0; i < Count; ++i)
+    {
+        const DXGI_OUTDUPL_MOVE_RECT* Move = &MoveRects[i];
+        const RECT* Dest = &Move->DestinationRect;
+        LONG SrcRight = Move->SourcePoint.x + (Dest->right - Dest->left);
+        LONG SrcBottom = Move->SourcePoint.y + (Dest->bottom - Dest->top);
+        RotateRect<Rotation>(Move->SourcePoint.x, Move->SourcePoint.y, SrcRight, SrcBottom, Width, Height,
+                             &SrcRects[i].left, &SrcRects[i].top, &SrcRects[i].right, &SrcRects[i].bottom);
+        RotateRect<Rotation>(Dest->left, Dest->top, Dest->right, Dest->bottom, Width, Height,
+                             &DestRects[i].left, &DestRects[i].top, &DestRects[i].right, &DestRects[i].bottom);
+    }
+}
+
+//
+// Source and destination of each move rect in desktop orientation, relative to the output. Moves are few per
+// frame and each costs two copies on the GPU, so they are not worth vectorizing.
+//
+void TransformMoveRects(const RECT_TRANSFORM* Transform, const DXGI_OUTDUPL_MOVE_RECT* MoveRects, UINT Count, RECT* SrcRects, RECT* DestRects)
+{
+    switch (Transform->Rotation)
+    {
+        case DXGI_MODE_ROTATION_UNSPECIFIED:
+        case DXGI_MODE_ROTATION_IDENTITY:
+            MoveKernel<DXGI_MODE_ROTATION_IDENTITY>(Transform, MoveRects, Count, SrcRects, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE90:
+            MoveKernel<DXGI_MODE_ROTATION_ROTATE90>(Transform, MoveRects, Count, SrcRects, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE180:
+            MoveKernel<DXGI_MODE_ROTATION_ROTATE180>(Transform, MoveRects, Count, SrcRects, DestRects);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE270:
+            MoveKernel<DXGI_MODE_ROTATION_ROTATE270>(Transform, MoveRects, Count, SrcRects, DestRects);
+            break;
+        default:
+            memset(SrcRects, 0, Count * sizeof(RECT));
+            memset(DestRects, 0, Count * sizeof(RECT));
+            break;
+    }
+}
+
+//
+// One rect of the frame in desktop orientation, relative to the output
+//
+void RotateFrameRect(const RECT_TRANSFORM* Transform, const RECT* FrameRect, RECT* DestRect)
+{
+    LONG Width = Transform->Width;
+    LONG Height = Transform->Height;
+    switch (Transform->Rotation)
+    {
+        case DXGI_MODE_ROTATION_ROTATE90:
+            RotateRect<DXGI_MODE_ROTATION_ROTATE90>(FrameRect->left, FrameRect->top, FrameRect->right, FrameRect->bottom, Width, Height,
+                                                    &DestRect->left, &DestRect->top, &DestRect->right, &DestRect->bottom);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE180:
+            RotateRect<DXGI_MODE_ROTATION_ROTATE180>(FrameRect->left, FrameRect->top, FrameRect->right, FrameRect->bottom, Width, Height,
+                                                     &DestRect->left, &DestRect->top, &DestRect->right, &DestRect->bottom);
+            break;
+        case DXGI_MODE_ROTATION_ROTATE270:
+            RotateRect<DXGI_MODE_ROTATION_ROTATE270>(FrameRect->left, FrameRect->top, FrameRect->right, FrameRect->bottom, Width, Height,
+                                                     &DestRect->left, &DestRect->top, &DestRect->right, &DestRect->bottom);
+            break;
+        default:
+            *DestRect = *FrameRect;
+            break;
+    }
+}
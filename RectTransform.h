@@ -0,0 +1,86 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _RECTTRANSFORM_H_
+#define _RECTTRANSFORM_H_
+
+#include "Platform.h"
+
+// Two triangles per rect, like NUMVERTICES
+#define RECT_VERTICES 6
+
+//
+// Same layout as VERTEX, without needing DirectXMath
+//
+typedef struct _RECT_VERTEX
+{
+    float Pos[3];
+    float TexCoord[2];
+} RECT_VERTEX;
+
+//
+// Everything that takes the rects of one output's frames to its place on the shared surface, worked out once
+// per frame instead of for every rect
+//
+typedef struct _RECT_TRANSFORM
+{
+    DXGI_MODE_ROTATION Rotation;
+
+    // Size of the output in desktop orientation, the duplicated frame is this size rotated
+    INT Width;
+    INT Height;
+
+    // Where the output sits on the shared surface
+    INT OriginX;
+    INT OriginY;
+
+    // Shared surface pixels to clip space, X * PosScaleX + PosOffsetX
+    float PosScaleX;
+    float PosOffsetX;
+    float PosScaleY;
+    float PosOffsetY;
+
+    // Frame pixels to texture coordinates
+    float TexScaleX;
+    float TexScaleY;
+} RECT_TRANSFORM;
+
+//
+// Per output constants of the instanced dirty rect draw, which expands each frame rect into a quad on the GPU.
+// Same layout as RectConstants in DirtyRects.hlsl.
+//
+typedef struct _RECT_CONSTANTS
+{
+    INT Width;
+    INT Height;
+    INT OriginX;
+    INT OriginY;
+    float PosScaleX;
+    float PosOffsetX;
+    float PosScaleY;
+    float PosOffsetY;
+    float TexScaleX;
+    float TexScaleY;
+    UINT Rotation;
+
+    // Corner of the frame rect each of the four strip vertices samples, two bits per vertex
+    UINT Corners;
+} RECT_CONSTANTS;
+
+// Strip vertices of one instanced rect: bottom left, top left, bottom right and top right
+#define RECT_INSTANCE_VERTICES 4
+
+void InitRectTransform(RECT_TRANSFORM* Transform, DXGI_MODE_ROTATION Rotation, INT Width, INT Height, INT OriginX, INT OriginY,
+                       UINT TexWidth, UINT TexHeight, UINT TargetWidth, UINT TargetHeight);
+void TransformDirtyRects(const RECT_TRANSFORM* Transform, const RECT* DirtyRects, UINT Count, RECT_VERTEX* Vertices, RECT* DestRects);
+void TransformMoveRects(const RECT_TRANSFORM* Transform, const DXGI_OUTDUPL_MOVE_RECT* MoveRects, UINT Count, RECT* SrcRects, RECT* DestRects);
+void RotateFrameRect(const RECT_TRANSFORM* Transform, const RECT* FrameRect, RECT* DestRect);
+void TransformDirtyDestRects(const RECT_TRANSFORM* Transform, const RECT* DirtyRects, UINT Count, RECT* DestRects);
+void InitRectConstants(const RECT_TRANSFORM* Transform, RECT_CONSTANTS* Constants);
+void ExpandRectInstance(const RECT_CONSTANTS* Constants, const RECT* Rect, UINT VertexId, RECT_VERTEX* Vertex);
+
+#endif
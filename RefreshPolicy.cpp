@@ -0,0 +1,316 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <math.h>
+#include <string.h>
+
+#include "RefreshPolicy.h"
+
+static const char* ContentNames[REFRESH_CONTENT_COUNT] = {"Idle", "Active", "Video", "Pointer"};
+
+// Frame rates video plays at, in mHz
+static const uint32_t VideoRates[] = {23976, 24000, 25000, 29970, 30000, 48000, 50000, 59940, 60000};
+
+const char* GetRefreshContentName(REFRESH_CONTENT Content)
+{
+    return (Content < REFRESH_CONTENT_COUNT) ? ContentNames[Content] : "Unknown";
+}
+
+REFRESHPOLICY::REFRESHPOLICY() : m_ModeCount(0),
+                                 m_Default(-1),
+                                 m_Current(-1),
+                                 m_UpdateCount(0),
+                                 m_PointerNs(0),
+                                 m_Content(REFRESH_CONTENT_ACTIVE),
+                                 m_VideoRate(0),
+                                 m_Target(-1),
+                                 m_TargetNs(0),
+                                 m_SwitchNs(0),
+                                 m_StartNs(0),
+                                 m_LastNs(0)
+{
+    ResetStats();
+}
+
+//
+// Start over on the modes the display offers, the one at index Current having been applied. Returns false when
+// there is nothing to choose from.
+//
+bool REFRESHPOLICY::Initialize(const MODE_CANDIDATE* Modes, size_t Count, int Current)
+{
+    m_ModeCount = 0;
+    m_Default = Current;
+    m_Current = Current;
+    m_UpdateCount = 0;
+    m_PointerNs = 0;
+    m_Content = REFRESH_CONTENT_ACTIVE;
+    m_VideoRate = 0;
+    m_Target = Current;
+    m_TargetNs = 0;
+    m_SwitchNs = 0;
+    m_StartNs = 0;
+    m_LastNs = 0;
+    ResetStats();
+
+    if (Current < 0 || static_cast<size_t>(Current) >= Count)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < Count && m_ModeCount < REFRESH_MAX_MODES; ++i)
+    {
+        if (Modes[i].Width == Modes[Current].Width && Modes[i].Height == Modes[Current].Height)
+        {
+            m_Modes[m_ModeCount] = static_cast<int>(i);
+            m_Rates[m_ModeCount] = Modes[i].RefreshRate;
+            ++m_ModeCount;
+        }
+    }
+    return m_ModeCount > 1;
+}
+
+//
+// The desktop image changed at TimeNs, updates must come in order
+//
+void REFRESHPOLICY::AddDesktopUpdate(uint64_t TimeNs)
+{
+    if (m_UpdateCount && TimeNs <= m_Updates[(m_UpdateCount - 1) % (REFRESH_UPDATE_HISTORY + 1)])
+    {
+        return;
+    }
+    m_Updates[m_UpdateCount % (REFRESH_UPDATE_HISTORY + 1)] = TimeNs;
+    ++m_UpdateCount;
+}
+
+void REFRESHPOLICY::AddPointerMove(uint64_t TimeNs)
+{
+    if (TimeNs > m_PointerNs)
+    {
+        m_PointerNs = TimeNs;
+    }
+}
+
+//
+// Account for one v-blank and return the mode the headset should be in, the current one unless a switch is due
+//
+int REFRESHPOLICY::AddVBlank(uint64_t NowNs)
+{
+    if (!m_ModeCount)
+    {
+        return m_Current;
+    }
+
+    if (!m_LastNs)
+    {
+        m_StartNs = NowNs;
+        m_TargetNs = NowNs;
+        m_SwitchNs = NowNs;
+    }
+    else if (NowNs > m_LastNs)
+    {
+        m_Stats.ElapsedNs += NowNs - m_LastNs;
+        m_Stats.NsAtContent[m_Content] += NowNs - m_LastNs;
+    }
+    m_LastNs = NowNs;
+    ++m_Stats.VBlanks;
+
+    m_Content = Classify(NowNs);
+    int Target = SelectFor(m_Content);
+    if (Target != m_Target)
+    {
+        m_Target = Target;
+        m_TargetNs = NowNs;
+    }
+    if (Target == m_Current)
+    {
+        return m_Current;
+    }
+
+    // The pointer wants the rate right away, anything else has to hold first
+    if (m_Content == REFRESH_CONTENT_POINTER && GetModeRate(Target) > GetModeRate(m_Current))
+    {
+        return Target;
+    }
+    if (NowNs - m_TargetNs >= REFRESH_HOLD_NS && NowNs - m_SwitchNs >= REFRESH_HOLD_NS)
+    {
+        return Target;
+    }
+    return m_Current;
+}
+
+//
+// The headset is in Mode as of NowNs. Called after a switch AddVBlank asked for, or with the current mode when
+// the switch failed so it is not retried before REFRESH_HOLD_NS.
+//
+void REFRESHPOLICY::SetMode(int Mode, uint64_t NowNs)
+{
+    if (Mode != m_Current)
+    {
+        ++m_Stats.Switches;
+    }
+    m_Current = Mode;
+    m_SwitchNs = NowNs;
+}
+
+int REFRESHPOLICY::GetMode() const
+{
+    return m_Current;
+}
+
+double REFRESHPOLICY::GetModeRate(int Mode) const
+{
+    for (UINT i = 0; i < m_ModeCount; ++i)
+    {
+        if (m_Modes[i] == Mode)
+        {
+            return m_Rates[i];
+        }
+    }
+    return 0.0;
+}
+
+REFRESH_CONTENT REFRESHPOLICY::GetContent() const
+{
+    return m_Content;
+}
+
+//
+// Frame rate of the video playing in mHz, zero when none is
+//
+uint32_t REFRESHPOLICY::GetVideoRate() const
+{
+    return (m_Content == REFRESH_CONTENT_VIDEO) ? m_VideoRate : 0;
+}
+
+void REFRESHPOLICY::GetStats(REFRESH_STATS* Stats) const
+{
+    *Stats = m_Stats;
+}
+
+void REFRESHPOLICY::ResetStats()
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+REFRESH_CONTENT REFRESHPOLICY::Classify(uint64_t NowNs)
+{
+    if (m_PointerNs && (NowNs <= m_PointerNs || NowNs - m_PointerNs < REFRESH_POINTER_NS))
+    {
+        return REFRESH_CONTENT_POINTER;
+    }
+
+    uint64_t ActivityNs = m_StartNs;
+    if (m_PointerNs > ActivityNs)
+    {
+        ActivityNs = m_PointerNs;
+    }
+    if (m_UpdateCount && m_Updates[(m_UpdateCount - 1) % (REFRESH_UPDATE_HISTORY + 1)] > ActivityNs)
+    {
+        ActivityNs = m_Updates[(m_UpdateCount - 1) % (REFRESH_UPDATE_HISTORY + 1)];
+    }
+    if (NowNs > ActivityNs && NowNs - ActivityNs >= REFRESH_IDLE_NS)
+    {
+        return REFRESH_CONTENT_IDLE;
+    }
+
+    if (FindVideoRate(NowNs, &m_VideoRate))
+    {
+        return REFRESH_CONTENT_VIDEO;
+    }
+    return REFRESH_CONTENT_ACTIVE;
+}
+
+//
+// Whether the desktop has been updating at a steady video frame rate up to now. Desktop updates land on the
+// desktop's own v-blanks, which spreads them: 24 fps on a 60 Hz desktop comes as 33 and 50 ms apart in turn.
+//
+bool REFRESHPOLICY::FindVideoRate(uint64_t NowNs, uint32_t* RateMilliHz) const
+{
+    *RateMilliHz = 0;
+    if (m_UpdateCount < REFRESH_UPDATE_HISTORY + 1)
+    {
+        return false;
+    }
+
+    uint64_t NewestNs = m_Updates[(m_UpdateCount - 1) % (REFRESH_UPDATE_HISTORY + 1)];
+    uint64_t OldestNs = m_Updates[m_UpdateCount % (REFRESH_UPDATE_HISTORY + 1)];
+    uint64_t MeanNs = (NewestNs - OldestNs) / REFRESH_UPDATE_HISTORY;
+    if (!MeanNs || (NowNs > NewestNs && NowNs - NewestNs > 2 * MeanNs))
+    {
+        return false;
+    }
+
+    for (UINT i = 0; i < REFRESH_UPDATE_HISTORY; ++i)
+    {
+        uint64_t Start = m_Updates[(m_UpdateCount + i) % (REFRESH_UPDATE_HISTORY + 1)];
+        uint64_t End = m_Updates[(m_UpdateCount + i + 1) % (REFRESH_UPDATE_HISTORY + 1)];
+        uint64_t IntervalNs = End - Start;
+        uint64_t DeviationNs = (IntervalNs > MeanNs) ? IntervalNs - MeanNs : MeanNs - IntervalNs;
+        if (DeviationNs > MeanNs / 4)
+        {
+            return false;
+        }
+    }
+
+    // Closest video rate within 1.5%
+    uint64_t Rate = 1000000000000ull / MeanNs;
+    uint64_t BestError = UINT64_MAX;
+    for (uint32_t VideoRate : VideoRates)
+    {
+        uint64_t Error = (Rate > VideoRate) ? Rate - VideoRate : VideoRate - Rate;
+        if (Error * 1000 <= static_cast<uint64_t>(VideoRate) * 15 && Error < BestError)
+        {
+            BestError = Error;
+            *RateMilliHz = VideoRate;
+        }
+    }
+    return *RateMilliHz != 0;
+}
+
+int REFRESHPOLICY::SelectFor(REFRESH_CONTENT Content) const
+{
+    int Best = m_Default;
+    double BestRate = 0.0;
+    for (UINT i = 0; i < m_ModeCount; ++i)
+    {
+        double Rate = m_Rates[i];
+        bool Better = false;
+        switch (Content)
+        {
+            case REFRESH_CONTENT_IDLE:
+            {
+                Better = !BestRate || Rate < BestRate;
+                break;
+            }
+            case REFRESH_CONTENT_POINTER:
+            {
+                Better = Rate > BestRate;
+                break;
+            }
+            case REFRESH_CONTENT_VIDEO:
+            {
+                // Each video frame shown for a whole number of refreshes, at the lowest such rate
+                double VideoRate = m_VideoRate / 1000.0;
+                double Multiple = floor(Rate / VideoRate + 0.5);
+                Better = Multiple >= 1.0 && fabs(Rate - Multiple * VideoRate) <= Rate * 0.01 && (!BestRate || Rate < BestRate);
+                break;
+            }
+            case REFRESH_CONTENT_ACTIVE:
+            default:
+            {
+                return m_Default;
+            }
+        }
+
+        if (Better)
+        {
+            Best = m_Modes[i];
+            BestRate = Rate;
+        }
+    }
+    return Best;
+}
@@ -0,0 +1,112 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _REFRESHPOLICY_H_
+#define _REFRESHPOLICY_H_
+
+#include "HmdProfile.h"
+#include "Platform.h"
+
+//
+// What the desktop shows, as far as the refresh rate is concerned
+//
+typedef enum
+{
+    REFRESH_CONTENT_IDLE    = 0,    // Nothing changed for a while, lowest rate
+    REFRESH_CONTENT_ACTIVE  = 1,    // Irregular updates, the mode the mode policy picked
+    REFRESH_CONTENT_VIDEO   = 2,    // Updates at a steady video frame rate, the lowest multiple of it
+    REFRESH_CONTENT_POINTER = 3,    // The pointer is moving, highest rate
+    REFRESH_CONTENT_COUNT   = 4
+} REFRESH_CONTENT;
+
+// Modes considered, at the resolution of the mode picked first
+#define REFRESH_MAX_MODES 16
+
+// Desktop update intervals a video frame rate is told from
+#define REFRESH_UPDATE_HISTORY 32
+
+// Without desktop updates or pointer moves for this long the desktop is idle
+#define REFRESH_IDLE_NS 2000000000ull
+
+// The pointer counts as moving for this long after it last moved
+#define REFRESH_POINTER_NS 500000000ull
+
+// What the desktop shows has to hold this long before the rate follows it, and no two switches are closer. Going
+// up for the pointer is the exception, that happens right away.
+#define REFRESH_HOLD_NS 1000000000ull
+
+//
+// How the headset refreshed since the stats were last reset
+//
+typedef struct _REFRESH_STATS
+{
+    uint64_t ElapsedNs;
+    uint64_t VBlanks;
+    UINT Switches;
+    uint64_t NsAtContent[REFRESH_CONTENT_COUNT];
+} REFRESH_STATS;
+
+const char* GetRefreshContentName(REFRESH_CONTENT Content);
+
+//
+// Picks the refresh rate of the headset from what the desktop shows: the lowest rate when idle, the lowest
+// multiple of the frame rate of a video playing, the highest while the pointer moves and the mode the mode
+// policy picked otherwise. Only modes at the resolution of that mode are considered, so a switch keeps the
+// primaries and scanouts. Decisions depend on the times given alone.
+//
+// Not thread safe, the presenter owns it.
+//
+class REFRESHPOLICY
+{
+    public:
+        REFRESHPOLICY();
+        bool Initialize(const MODE_CANDIDATE* Modes, size_t Count, int Current);
+        void AddDesktopUpdate(uint64_t TimeNs);
+        void AddPointerMove(uint64_t TimeNs);
+        int AddVBlank(uint64_t NowNs);
+        void SetMode(int Mode, uint64_t NowNs);
+        int GetMode() const;
+        double GetModeRate(int Mode) const;
+        REFRESH_CONTENT GetContent() const;
+        uint32_t GetVideoRate() const;
+        void GetStats(REFRESH_STATS* Stats) const;
+        void ResetStats();
+
+    private:
+    // methods
+        REFRESH_CONTENT Classify(uint64_t NowNs);
+        bool FindVideoRate(uint64_t NowNs, uint32_t* RateMilliHz) const;
+        int SelectFor(REFRESH_CONTENT Content) const;
+
+    // variables
+        // Candidate index and rate of each mode considered
+        int m_Modes[REFRESH_MAX_MODES];
+        double m_Rates[REFRESH_MAX_MODES];
+        UINT m_ModeCount;
+        int m_Default;
+        int m_Current;
+
+        // Newest desktop updates, and the last pointer move
+        uint64_t m_Updates[REFRESH_UPDATE_HISTORY + 1];
+        UINT m_UpdateCount;
+        uint64_t m_PointerNs;
+
+        // What the desktop shows, the mode for it and since when it was wanted
+        REFRESH_CONTENT m_Content;
+        uint32_t m_VideoRate;
+        int m_Target;
+        uint64_t m_TargetNs;
+        uint64_t m_SwitchNs;
+
+        // First and last v-blank seen
+        uint64_t m_StartNs;
+        uint64_t m_LastNs;
+
+        REFRESH_STATS m_Stats;
+};
+
+#endif
@@ -0,0 +1,83 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+//----------------------------------------------------------------------
+
+// Must match SCALING_FILTER in Scaling.h
+#define SCALING_FILTER_LANCZOS 2
+
+#define PI 3.14159265f
+
+#include "ToneMap.hlsli"
+
+Texture2D tx : register( t0 );
+SamplerState samLinear : register( s0 );
+
+struct PS_INPUT
+{
+    float4 Pos : SV_POSITION;
+    float2 Tex : TEXCOORD;
+};
+
+//--------------------------------------------------------------------------------------
+// Weights of the 4 taps around a sample, at -1, 0, +1 and +2 texels from the one on its left
+//--------------------------------------------------------------------------------------
+float4 Weights(float t)
+{
+    if (Filter == SCALING_FILTER_LANCZOS)
+    {
+        float4 x = PI * float4(1 + t, t, 1 - t, 2 - t);
+        float4 w = (x < 1e-5f) ? 1 : 2 * sin(x) * sin(x / 2) / (x * x);
+        return w / dot(w, 1);
+    }
+
+    // Catmull-Rom
+    float4 w;
+    w.x = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+    w.y = (1.5f * t - 2.5f) * t * t + 1.0f;
+    w.z = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+    w.w = (0.5f * t - 0.5f) * t * t;
+    return w;
+}
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader: picks the mip level closest to the minification, then filters within it with
+// separable 4x4 weights. FP16 desktops are tone mapped in the same pass.
+//--------------------------------------------------------------------------------------
+float4 PS_Resample(PS_INPUT input) : SV_Target
+{
+    float Width, Height, Levels;
+    tx.GetDimensions(0, Width, Height, Levels);
+    uint Level = (uint)clamp(floor(tx.CalculateLevelOfDetail(samLinear, input.Tex)), 0, Levels - 1);
+    tx.GetDimensions(Level, Width, Height, Levels);
+
+    float2 Pos = input.Tex * float2(Width, Height) - 0.5f;
+    float2 Base = floor(Pos);
+    float4 wx = Weights(Pos.x - Base.x);
+    float4 wy = Weights(Pos.y - Base.y);
+    int2 MaxCoord = int2(Width, Height) - 1;
+
+    float4 Color = 0;
+    [unroll]
+    for (int y = 0; y < 4; ++y)
+    {
+        float4 Row = 0;
+        [unroll]
+        for (int x = 0; x < 4; ++x)
+        {
+            int2 Coord = clamp(int2(Base) + int2(x - 1, y - 1), 0, MaxCoord);
+            Row += wx[x] * tx.Load(int3(Coord, Level));
+        }
+        Color += wy[y] * Row;
+    }
+
+    // Both filters ring a little past the source range, the tone map clips FP16 desktops itself
+    if (ToneMap)
+    {
+        return ToneMapColor(Color);
+    }
+    return saturate(Color);
+}
@@ -0,0 +1,26 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "Scaling.h"
+
+//
+// Number of mip levels to create for a desktop, stopping before either side goes below one texel
+//
+UINT GetMipCount(UINT Width, UINT Height, UINT MaxLevels)
+{
+    if (MaxLevels > MIP_MAX_LEVELS)
+    {
+        MaxLevels = MIP_MAX_LEVELS;
+    }
+
+    UINT Levels = 1;
+    while (Levels < MaxLevels && (Width >> Levels) && (Height >> Levels))
+    {
+        ++Levels;
+    }
+    return Levels;
+}
@@ -0,0 +1,35 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _SCALING_H_
+#define _SCALING_H_
+
+#include "Platform.h"
+
+//
+// How the desktop is resampled onto the headset panel
+//
+typedef enum
+{
+    SCALING_FILTER_BILINEAR = 0,    // Hardware trilinear filtering
+    SCALING_FILTER_BICUBIC  = 1,    // Catmull-Rom, 4x4 taps
+    SCALING_FILTER_LANCZOS  = 2     // Lanczos with 2 lobes, 4x4 taps
+} SCALING_FILTER;
+
+// Smallest level is 1/32 of the desktop, enough for a 4K desktop on any headset panel
+#define MIP_MAX_LEVELS 6
+
+typedef struct _SCALING_OPTIONS
+{
+    // Levels of the presenter's copy of the desktop, 1 for no mip maps
+    UINT MipLevels;
+    SCALING_FILTER Filter;
+} SCALING_OPTIONS;
+
+UINT GetMipCount(UINT Width, UINT Height, UINT MaxLevels);
+
+#endif
@@ -0,0 +1,554 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <string.h>
+
+#include "Foveation.h"
+#include "SoftwareCompositor.h"
+
+static bool AllocSurface(SOFTWARE_SURFACE* Surface, UINT Width, UINT Height)
+{
+    Surface->Width = Width;
+    Surface->Height = Height;
+    Surface->Pitch = Width * SOFTWARE_BPP;
+    Surface->Bits = new (std::nothrow) BYTE[static_cast<size_t>(Surface->Pitch) * Height];
+    if (!Surface->Bits)
+    {
+        return false;
+    }
+    memset(Surface->Bits, 0, static_cast<size_t>(Surface->Pitch) * Height);
+    return true;
+}
+
+static void FreeSurface(SOFTWARE_SURFACE* Surface)
+{
+    if (Surface->Bits)
+    {
+        delete [] Surface->Bits;
+        Surface->Bits = nullptr;
+    }
+    Surface->Width = 0;
+    Surface->Height = 0;
+    Surface->Pitch = 0;
+}
+
+static inline UINT* PixelAt(const SOFTWARE_SURFACE* Surface, INT X, INT Y)
+{
+    return reinterpret_cast<UINT*>(Surface->Bits + static_cast<size_t>(Y) * Surface->Pitch) + X;
+}
+
+SOFTWARECOMPOSITOR::SOFTWARECOMPOSITOR() : m_BytesTouched(0)
+{
+    memset(&m_Desktop, 0, sizeof(m_Desktop));
+    memset(&m_MoveSurf, 0, sizeof(m_MoveSurf));
+}
+
+SOFTWARECOMPOSITOR::~SOFTWARECOMPOSITOR()
+{
+    Clean();
+}
+
+//
+// Allocate the desktop image and scratch surface
+//
+bool SOFTWARECOMPOSITOR::Initialize(UINT Width, UINT Height)
+{
+    Clean();
+
+    if (!AllocSurface(&m_Desktop, Width, Height) || !AllocSurface(&m_MoveSurf, Width, Height))
+    {
+        Clean();
+        return false;
+    }
+
+    return true;
+}
+
+void SOFTWARECOMPOSITOR::Clean()
+{
+    FreeSurface(&m_Desktop);
+    FreeSurface(&m_MoveSurf);
+}
+
+SOFTWARE_SURFACE* SOFTWARECOMPOSITOR::GetDesktop()
+{
+    return &m_Desktop;
+}
+
+uint64_t SOFTWARECOMPOSITOR::GetBytesTouched()
+{
+    return m_BytesTouched;
+}
+
+void SOFTWARECOMPOSITOR::ResetCounters()
+{
+    m_BytesTouched = 0;
+}
+
+bool SOFTWARECOMPOSITOR::ClipToDesktop(RECT* Rect)
+{
+    if (Rect->left < 0)
+    {
+        Rect->left = 0;
+    }
+    if (Rect->top < 0)
+    {
+        Rect->top = 0;
+    }
+    if (Rect->right > static_cast<LONG>(m_Desktop.Width))
+    {
+        Rect->right = m_Desktop.Width;
+    }
+    if (Rect->bottom > static_cast<LONG>(m_Desktop.Height))
+    {
+        Rect->bottom = m_Desktop.Height;
+    }
+    return (Rect->right > Rect->left) && (Rect->bottom > Rect->top);
+}
+
+//
+// Apply move rects. Like the GPU path, each rect goes through the scratch surface so overlapping
+// source and destination are handled.
+//
+void SOFTWARECOMPOSITOR::CopyMove(const DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, DXGI_MODE_ROTATION Rotation, INT TexWidth, INT TexHeight, RECT* DestRects)
+{
+    // Same rotation as DISPLAYMANAGER, the frame is the desktop turned
+    bool Rotated = (Rotation == DXGI_MODE_ROTATION_ROTATE90 || Rotation == DXGI_MODE_ROTATION_ROTATE270);
+    RECT_TRANSFORM Transform;
+    InitRectTransform(&Transform, Rotation, Rotated ? TexHeight : TexWidth, Rotated ? TexWidth : TexHeight, 0, 0, TexWidth, TexHeight, m_Desktop.Width, m_Desktop.Height);
+
+    for (UINT i = 0; i < MoveCount; ++i)
+    {
+        if (DestRects)
+        {
+            memset(&DestRects[i], 0, sizeof(RECT));
+        }
+
+        RECT SrcRect;
+        RECT DestRect;
+        TransformMoveRects(&Transform, &MoveBuffer[i], 1, &SrcRect, &DestRect);
+
+        // Keep source and destination the same size when clipping
+        RECT ClippedSrc = SrcRect;
+        if (!ClipToDesktop(&ClippedSrc))
+        {
+            continue;
+        }
+        RECT ClippedDest = {DestRect.left + (ClippedSrc.left - SrcRect.left), DestRect.top + (ClippedSrc.top - SrcRect.top),
+                            DestRect.right - (SrcRect.right - ClippedSrc.right), DestRect.bottom - (SrcRect.bottom - ClippedSrc.bottom)};
+        RECT Dest = ClippedDest;
+        if (!ClipToDesktop(&Dest))
+        {
+            continue;
+        }
+        INT SrcX = ClippedSrc.left + (Dest.left - ClippedDest.left);
+        INT SrcY = ClippedSrc.top + (Dest.top - ClippedDest.top);
+
+        size_t RowBytes = static_cast<size_t>(Dest.right - Dest.left) * SOFTWARE_BPP;
+        INT Rows = Dest.bottom - Dest.top;
+
+        for (INT Row = 0; Row < Rows; ++Row)
+        {
+            memcpy(PixelAt(&m_MoveSurf, SrcX, SrcY + Row), PixelAt(&m_Desktop, SrcX, SrcY + Row), RowBytes);
+        }
+        for (INT Row = 0; Row < Rows; ++Row)
+        {
+            memcpy(PixelAt(&m_Desktop, Dest.left, Dest.top + Row), PixelAt(&m_MoveSurf, SrcX, SrcY + Row), RowBytes);
+        }
+
+        // Read and write both ways through the scratch surface
+        m_BytesTouched += RowBytes * Rows * 4;
+
+        if (DestRects)
+        {
+            DestRects[i] = Dest;
+        }
+    }
+}
+
+//
+// Apply dirty rects from the duplicated frame, rotating into desktop orientation like DISPLAYMANAGER::SetDirtyVert
+//
+void SOFTWARECOMPOSITOR::CopyDirty(const SOFTWARE_SURFACE* SrcSurface, const RECT* DirtyBuffer, UINT DirtyCount, DXGI_MODE_ROTATION Rotation, RECT* DestRects)
+{
+    INT Width = m_Desktop.Width;
+    INT Height = m_Desktop.Height;
+
+    for (UINT i = 0; i < DirtyCount; ++i)
+    {
+        if (DestRects)
+        {
+            memset(&DestRects[i], 0, sizeof(RECT));
+        }
+
+        // Clip in source space first
+        RECT Dirty = DirtyBuffer[i];
+        if (Dirty.left < 0)
+        {
+            Dirty.left = 0;
+        }
+        if (Dirty.top < 0)
+        {
+            Dirty.top = 0;
+        }
+        if (Dirty.right > static_cast<LONG>(SrcSurface->Width))
+        {
+            Dirty.right = SrcSurface->Width;
+        }
+        if (Dirty.bottom > static_cast<LONG>(SrcSurface->Height))
+        {
+            Dirty.bottom = SrcSurface->Height;
+        }
+        if (Dirty.right <= Dirty.left || Dirty.bottom <= Dirty.top)
+        {
+            continue;
+        }
+
+        RECT Dest = Dirty;
+        switch (Rotation)
+        {
+            case DXGI_MODE_ROTATION_ROTATE90:
+            {
+                Dest.left = Width - Dirty.bottom;
+                Dest.top = Dirty.left;
+                Dest.right = Width - Dirty.top;
+                Dest.bottom = Dirty.right;
+                break;
+            }
+            case DXGI_MODE_ROTATION_ROTATE180:
+            {
+                Dest.left = Width - Dirty.right;
+                Dest.top = Height - Dirty.bottom;
+                Dest.right = Width - Dirty.left;
+                Dest.bottom = Height - Dirty.top;
+                break;
+            }
+            case DXGI_MODE_ROTATION_ROTATE270:
+            {
+                Dest.left = Dirty.top;
+                Dest.top = Height - Dirty.right;
+                Dest.right = Dirty.bottom;
+                Dest.bottom = Height - Dirty.left;
+                break;
+            }
+            default:
+                break;
+        }
+        if (Dest.left < 0 || Dest.top < 0 || Dest.right > Width || Dest.bottom > Height)
+        {
+            continue;
+        }
+
+        INT DestWidth = Dest.right - Dest.left;
+        INT DestHeight = Dest.bottom - Dest.top;
+
+        switch (Rotation)
+        {
+            case DXGI_MODE_ROTATION_ROTATE90:
+            {
+                // Desktop (x, y) comes from source (y, Width - 1 - x)
+                for (INT Y = 0; Y < DestHeight; ++Y)
+                {
+                    UINT* Dst = PixelAt(&m_Desktop, Dest.left, Dest.top + Y);
+                    for (INT X = 0; X < DestWidth; ++X)
+                    {
+                        Dst[X] = *PixelAt(SrcSurface, Dest.top + Y, Width - 1 - (Dest.left + X));
+                    }
+                }
+                break;
+            }
+            case DXGI_MODE_ROTATION_ROTATE180:
+            {
+                for (INT Y = 0; Y < DestHeight; ++Y)
+                {
+                    UINT* Dst = PixelAt(&m_Desktop, Dest.left, Dest.top + Y);
+                    const UINT* Src = PixelAt(SrcSurface, Width - 1 - Dest.left, Height - 1 - (Dest.top + Y));
+                    for (INT X = 0; X < DestWidth; ++X)
+                    {
+                        Dst[X] = *(Src - X);
+                    }
+                }
+                break;
+            }
+            case DXGI_MODE_ROTATION_ROTATE270:
+            {
+                // Desktop (x, y) comes from source (Height - 1 - y, x)
+                for (INT Y = 0; Y < DestHeight; ++Y)
+                {
+                    UINT* Dst = PixelAt(&m_Desktop, Dest.left, Dest.top + Y);
+                    for (INT X = 0; X < DestWidth; ++X)
+                    {
+                        Dst[X] = *PixelAt(SrcSurface, Height - 1 - (Dest.top + Y), Dest.left + X);
+                    }
+                }
+                break;
+            }
+            default:
+            {
+                size_t RowBytes = static_cast<size_t>(DestWidth) * SOFTWARE_BPP;
+                for (INT Y = 0; Y < DestHeight; ++Y)
+                {
+                    memcpy(PixelAt(&m_Desktop, Dest.left, Dest.top + Y), PixelAt(SrcSurface, Dirty.left, Dirty.top + Y), RowBytes);
+                }
+                break;
+            }
+        }
+
+        m_BytesTouched += static_cast<uint64_t>(DestWidth) * DestHeight * SOFTWARE_BPP * 2;
+
+        if (DestRects)
+        {
+            DestRects[i] = Dest;
+        }
+    }
+}
+
+//
+// Reference for the compute apply engine: the same tile walk as ApplyRects.hlsl, one pixel at a time. The
+// list must have been built for an output at the origin of the desktop image.
+//
+void SOFTWARECOMPOSITOR::ApplyRects(const SOFTWARE_SURFACE* SrcSurface, const APPLY_LIST* List)
+{
+    // Moves read the desktop as it was before the frame
+    const RECT* Moved = &List->MoveSource;
+    if (List->MoveCount)
+    {
+        size_t RowBytes = static_cast<size_t>(Moved->right - Moved->left) * SOFTWARE_BPP;
+        for (INT Row = Moved->top; Row < Moved->bottom; ++Row)
+        {
+            memcpy(PixelAt(&m_MoveSurf, Moved->left, Row), PixelAt(&m_Desktop, Moved->left, Row), RowBytes);
+        }
+        m_BytesTouched += RowBytes * (Moved->bottom - Moved->top) * 2;
+    }
+
+    for (UINT t = 0; t < List->TileCount; ++t)
+    {
+        const APPLY_TILE* Tile = &List->Tiles[t];
+        UINT Right = (Tile->Left + APPLY_TILE_SIZE < m_Desktop.Width) ? Tile->Left + APPLY_TILE_SIZE : m_Desktop.Width;
+        UINT Bottom = (Tile->Top + APPLY_TILE_SIZE < m_Desktop.Height) ? Tile->Top + APPLY_TILE_SIZE : m_Desktop.Height;
+        for (INT Y = Tile->Top; Y < static_cast<INT>(Bottom); ++Y)
+        {
+            for (INT X = Tile->Left; X < static_cast<INT>(Right); ++X)
+            {
+                // The last rect covering the pixel wins
+                for (UINT i = Tile->Count; i > 0; --i)
+                {
+                    const APPLY_RECT* Rect = &List->Rects[List->TileRects[Tile->First + i - 1]];
+                    if (X >= Rect->Dest.left && X < Rect->Dest.right && Y >= Rect->Dest.top && Y < Rect->Dest.bottom)
+                    {
+                        INT SrcX = Rect->AxisX[0] * X + Rect->AxisY[0] * Y + Rect->Offset[0];
+                        INT SrcY = Rect->AxisX[1] * X + Rect->AxisY[1] * Y + Rect->Offset[1];
+                        const SOFTWARE_SURFACE* Source = (Rect->Source == APPLY_SOURCE_FRAME) ? SrcSurface : &m_MoveSurf;
+                        *PixelAt(&m_Desktop, X, Y) = *PixelAt(Source, SrcX, SrcY);
+                        m_BytesTouched += SOFTWARE_BPP * 2;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+//
+// Copy a region between two surfaces of the same size, as the presenter does for damaged regions
+//
+void SOFTWARECOMPOSITOR::CopyRect(const SOFTWARE_SURFACE* SrcSurface, const RECT* Rect, SOFTWARE_SURFACE* Target)
+{
+    RECT Clipped = *Rect;
+    if (!ClipToDesktop(&Clipped))
+    {
+        return;
+    }
+
+    size_t RowBytes = static_cast<size_t>(Clipped.right - Clipped.left) * SOFTWARE_BPP;
+    for (INT Row = Clipped.top; Row < Clipped.bottom; ++Row)
+    {
+        memcpy(PixelAt(Target, Clipped.left, Row), PixelAt(SrcSurface, Clipped.left, Row), RowBytes);
+    }
+
+    m_BytesTouched += RowBytes * (Clipped.bottom - Clipped.top) * 2;
+}
+
+//
+// Box filter a region of a surface into one Scale times smaller on each axis, following
+// OUTPUTMANAGER::UpdateMips where each mip level is built from the one above it
+//
+void SOFTWARECOMPOSITOR::DownsampleRect(const SOFTWARE_SURFACE* SrcSurface, const RECT* Rect, UINT Scale, SOFTWARE_SURFACE* Target)
+{
+    RECT Aligned;
+    if (!AlignToScale(Rect, Scale, SrcSurface->Width, SrcSurface->Height, &Aligned))
+    {
+        return;
+    }
+
+    UINT Taps = Scale * Scale;
+    for (INT Row = Aligned.top; Row < Aligned.bottom; Row += Scale)
+    {
+        UINT* Dest = PixelAt(Target, Aligned.left / Scale, Row / Scale);
+        for (INT Col = Aligned.left; Col < Aligned.right; Col += Scale)
+        {
+            UINT Sum[4] = {0, 0, 0, 0};
+            for (UINT Y = 0; Y < Scale; ++Y)
+            {
+                const BYTE* Src = reinterpret_cast<const BYTE*>(PixelAt(SrcSurface, Col, Row + Y));
+                for (UINT X = 0; X < Scale * SOFTWARE_BPP; X += SOFTWARE_BPP)
+                {
+                    Sum[0] += Src[X];
+                    Sum[1] += Src[X + 1];
+                    Sum[2] += Src[X + 2];
+                    Sum[3] += Src[X + 3];
+                }
+            }
+            *Dest++ = (Sum[0] / Taps) | ((Sum[1] / Taps) << 8) | ((Sum[2] / Taps) << 16) | ((Sum[3] / Taps) << 24);
+        }
+    }
+
+    uint64_t Pixels = static_cast<uint64_t>(Aligned.right - Aligned.left) * (Aligned.bottom - Aligned.top);
+    m_BytesTouched += Pixels * SOFTWARE_BPP + Pixels / Taps * SOFTWARE_BPP;
+}
+
+//
+// Build the whole view like OUTPUTMANAGER::DrawFrame does with foveation: the fovea comes from the desktop
+// image, everything else is point sampled from a mip level Scale times smaller.
+//
+void SOFTWARECOMPOSITOR::ComposeFoveated(const SOFTWARE_SURFACE* Periphery, UINT Scale, const RECT* Fovea, SOFTWARE_SURFACE* Target)
+{
+    RECT Sharp = *Fovea;
+    if (!ClipToDesktop(&Sharp))
+    {
+        Sharp = {0, 0, 0, 0};
+    }
+
+    // The level stops at its last whole texel, repeat it up to the edges
+    INT LastCol = static_cast<INT>(Periphery->Width) - 1;
+    INT LastRow = static_cast<INT>(Periphery->Height) - 1;
+    INT S = static_cast<INT>(Scale);
+    INT Width = static_cast<INT>(m_Desktop.Width);
+    size_t RowBytes = static_cast<size_t>(Width) * SOFTWARE_BPP;
+    for (INT Row = 0; Row < static_cast<INT>(m_Desktop.Height); ++Row)
+    {
+        UINT* Dest = PixelAt(Target, 0, Row);
+        if (Row % S)
+        {
+            // Same peripheral row as the one above, the fovea only starts and stops on whole texels
+            memcpy(Dest, PixelAt(Target, 0, Row - 1), RowBytes);
+        }
+        else
+        {
+            INT SrcRow = Row / S;
+            const UINT* Src = PixelAt(Periphery, 0, (SrcRow > LastRow) ? LastRow : SrcRow);
+            for (INT Col = 0; Col < Width; Col += S)
+            {
+                INT SrcCol = Col / S;
+                UINT Texel = Src[(SrcCol > LastCol) ? LastCol : SrcCol];
+                INT End = (Col + S < Width) ? Col + S : Width;
+                for (INT X = Col; X < End; ++X)
+                {
+                    Dest[X] = Texel;
+                }
+            }
+        }
+
+        if (Row >= Sharp.top && Row < Sharp.bottom)
+        {
+            memcpy(Dest + Sharp.left, PixelAt(&m_Desktop, Sharp.left, Row), static_cast<size_t>(Sharp.right - Sharp.left) * SOFTWARE_BPP);
+        }
+    }
+
+    // Every output pixel is written, only the fovea is read at full resolution
+    uint64_t Total = static_cast<uint64_t>(m_Desktop.Width) * m_Desktop.Height;
+    uint64_t SharpPixels = static_cast<uint64_t>(Sharp.right - Sharp.left) * (Sharp.bottom - Sharp.top);
+    m_BytesTouched += (Total + SharpPixels + (Total - SharpPixels) / (Scale * Scale)) * SOFTWARE_BPP;
+}
+
+//
+// Compose the pointer onto the target, following OUTPUTMANAGER::DrawMouse and ProcessMonoMask:
+// color pointers are alpha blended, monochrome and masked color pointers are combined with the desktop.
+//
+void SOFTWARECOMPOSITOR::DrawPointer(const BYTE* ShapeBuffer, const DXGI_OUTDUPL_POINTER_SHAPE_INFO* ShapeInfo, POINT Position, SOFTWARE_SURFACE* Target)
+{
+    bool IsMono = (ShapeInfo->Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME);
+    INT ShapeWidth = ShapeInfo->Width;
+    INT ShapeHeight = IsMono ? ShapeInfo->Height / 2 : ShapeInfo->Height;
+
+    // Clip against the target
+    INT SkipX = (Position.x < 0) ? -Position.x : 0;
+    INT SkipY = (Position.y < 0) ? -Position.y : 0;
+    INT Left = Position.x + SkipX;
+    INT Top = Position.y + SkipY;
+    INT Right = Position.x + ShapeWidth;
+    INT Bottom = Position.y + ShapeHeight;
+    if (Right > static_cast<INT>(Target->Width))
+    {
+        Right = Target->Width;
+    }
+    if (Bottom > static_cast<INT>(Target->Height))
+    {
+        Bottom = Target->Height;
+    }
+    if (Right <= Left || Bottom <= Top)
+    {
+        return;
+    }
+
+    for (INT Row = 0; Row < Bottom - Top; ++Row)
+    {
+        UINT* Desktop32 = PixelAt(Target, Left, Top + Row);
+        for (INT Col = 0; Col < Right - Left; ++Col)
+        {
+            INT ShapeX = Col + SkipX;
+            INT ShapeY = Row + SkipY;
+
+            switch (ShapeInfo->Type)
+            {
+                case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
+                {
+                    BYTE Mask = 0x80 >> (ShapeX % 8);
+                    BYTE AndMask = ShapeBuffer[(ShapeX / 8) + (ShapeY * ShapeInfo->Pitch)] & Mask;
+                    BYTE XorMask = ShapeBuffer[(ShapeX / 8) + ((ShapeY + ShapeHeight) * ShapeInfo->Pitch)] & Mask;
+                    UINT AndMask32 = (AndMask) ? 0xFFFFFFFF : 0xFF000000;
+                    UINT XorMask32 = (XorMask) ? 0x00FFFFFF : 0x00000000;
+                    Desktop32[Col] = (Desktop32[Col] & AndMask32) ^ XorMask32;
+                    break;
+                }
+                case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
+                {
+                    UINT Shape = reinterpret_cast<const UINT*>(ShapeBuffer + ShapeY * ShapeInfo->Pitch)[ShapeX];
+                    if (Shape & 0xFF000000)
+                    {
+                        Desktop32[Col] = (Desktop32[Col] ^ Shape) | 0xFF000000;
+                    }
+                    else
+                    {
+                        Desktop32[Col] = Shape | 0xFF000000;
+                    }
+                    break;
+                }
+                case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
+                default:
+                {
+                    UINT Shape = reinterpret_cast<const UINT*>(ShapeBuffer + ShapeY * ShapeInfo->Pitch)[ShapeX];
+                    UINT Alpha = Shape >> 24;
+                    UINT Dst = Desktop32[Col];
+                    UINT Out = 0xFF000000;
+                    for (UINT Shift = 0; Shift < 24; Shift += 8)
+                    {
+                        UINT S = (Shape >> Shift) & 0xFF;
+                        UINT D = (Dst >> Shift) & 0xFF;
+                        Out |= (((S * Alpha) + (D * (255 - Alpha)) + 127) / 255) << Shift;
+                    }
+                    Desktop32[Col] = Out;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Shape read, target read and written
+    m_BytesTouched += static_cast<uint64_t>(Right - Left) * (Bottom - Top) * SOFTWARE_BPP * 3;
+}
@@ -0,0 +1,65 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _SOFTWARECOMPOSITOR_H_
+#define _SOFTWARECOMPOSITOR_H_
+
+#include "Platform.h"
+#include "RectApply.h"
+#include "RectTransform.h"
+
+#define SOFTWARE_BPP 4
+
+//
+// 32 bit BGRA image in system memory
+//
+typedef struct _SOFTWARE_SURFACE
+{
+    BYTE* Bits;
+    UINT Width;
+    UINT Height;
+    UINT Pitch;
+} SOFTWARE_SURFACE;
+
+//
+// CPU implementation of the frame pipeline: applies move and dirty rects from a duplicated frame onto
+// the desktop image and composes the pointer, following what DISPLAYMANAGER and OUTPUTMANAGER do on the GPU.
+// Only one output placed at the origin of the desktop image is handled. The apply stages optionally
+// return the desktop region each rect wrote to (empty when the rect was dropped), as the damage list.
+//
+class SOFTWARECOMPOSITOR
+{
+    public:
+        SOFTWARECOMPOSITOR();
+        ~SOFTWARECOMPOSITOR();
+        bool Initialize(UINT Width, UINT Height);
+        void CopyMove(const DXGI_OUTDUPL_MOVE_RECT* MoveBuffer, UINT MoveCount, DXGI_MODE_ROTATION Rotation, INT TexWidth, INT TexHeight, RECT* DestRects);
+        void CopyDirty(const SOFTWARE_SURFACE* SrcSurface, const RECT* DirtyBuffer, UINT DirtyCount, DXGI_MODE_ROTATION Rotation, RECT* DestRects);
+        void ApplyRects(const SOFTWARE_SURFACE* SrcSurface, const APPLY_LIST* List);
+        void CopyRect(const SOFTWARE_SURFACE* SrcSurface, const RECT* Rect, SOFTWARE_SURFACE* Target);
+        void DownsampleRect(const SOFTWARE_SURFACE* SrcSurface, const RECT* Rect, UINT Scale, SOFTWARE_SURFACE* Target);
+        void ComposeFoveated(const SOFTWARE_SURFACE* Periphery, UINT Scale, const RECT* Fovea, SOFTWARE_SURFACE* Target);
+        void DrawPointer(const BYTE* ShapeBuffer, const DXGI_OUTDUPL_POINTER_SHAPE_INFO* ShapeInfo, POINT Position, SOFTWARE_SURFACE* Target);
+        SOFTWARE_SURFACE* GetDesktop();
+        uint64_t GetBytesTouched();
+        void ResetCounters();
+        void Clean();
+
+    private:
+    // methods
+        bool ClipToDesktop(RECT* Rect);
+
+    // variables
+        SOFTWARE_SURFACE m_Desktop;
+
+        // Scratch copy used for move rects, like the move surface on the GPU path
+        SOFTWARE_SURFACE m_MoveSurf;
+
+        uint64_t m_BytesTouched;
+};
+
+#endif
@@ -0,0 +1,531 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+// The socket headers must come before windows.h, which Platform.h brings in
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include "StreamChannel.h"
+
+#ifdef _WIN32
+#define CloseSocket closesocket
+#define SOCKET_SEND_FLAGS 0
+#define SOCKET_SHUT_SEND SD_SEND
+#define SOCKET_SHUT_BOTH SD_BOTH
+#else
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define CloseSocket close
+// A client going away must fail the send, not raise SIGPIPE
+#define SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#define SOCKET_SHUT_SEND SHUT_WR
+#define SOCKET_SHUT_BOTH SHUT_RDWR
+#endif
+
+LOOPBACKCHANNEL::LOOPBACKCHANNEL() : m_Ring(nullptr),
+                                     m_Capacity(0),
+                                     m_Head(0),
+                                     m_Used(0),
+                                     m_Messages(0),
+                                     m_Closed(false)
+{
+}
+
+LOOPBACKCHANNEL::~LOOPBACKCHANNEL()
+{
+    Clean();
+}
+
+//
+// Allocate the ring, Capacity bytes of messages and their length prefixes
+//
+bool LOOPBACKCHANNEL::Initialize(UINT Capacity)
+{
+    Clean();
+
+    m_Ring = new (std::nothrow) BYTE[Capacity];
+    if (!m_Ring)
+    {
+        return false;
+    }
+    m_Capacity = Capacity;
+    return true;
+}
+
+void LOOPBACKCHANNEL::Clean()
+{
+    if (m_Ring)
+    {
+        delete [] m_Ring;
+        m_Ring = nullptr;
+    }
+    m_Capacity = 0;
+    m_Head = 0;
+    m_Used = 0;
+    m_Messages = 0;
+    m_Closed = false;
+}
+
+//
+// Copy in and out of the ring, wrapping around its end
+//
+void LOOPBACKCHANNEL::Write(const BYTE* Data, UINT Size)
+{
+    UINT Tail = (m_Head + m_Used) % m_Capacity;
+    UINT First = (Size < m_Capacity - Tail) ? Size : m_Capacity - Tail;
+    memcpy(m_Ring + Tail, Data, First);
+    memcpy(m_Ring, Data + First, Size - First);
+    m_Used += Size;
+}
+
+void LOOPBACKCHANNEL::Read(BYTE* Data, UINT Size)
+{
+    UINT First = (Size < m_Capacity - m_Head) ? Size : m_Capacity - m_Head;
+    memcpy(Data, m_Ring + m_Head, First);
+    memcpy(Data + First, m_Ring, Size - First);
+    Skip(Size);
+}
+
+void LOOPBACKCHANNEL::Skip(UINT Size)
+{
+    m_Head = (m_Head + Size) % m_Capacity;
+    m_Used -= Size;
+}
+
+bool LOOPBACKCHANNEL::Send(const BYTE* Message, UINT Size)
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    if (m_Closed || static_cast<uint64_t>(m_Used) + sizeof(uint32_t) + Size > m_Capacity)
+    {
+        return false;
+    }
+
+    uint32_t Length = Size;
+    Write(reinterpret_cast<const BYTE*>(&Length), sizeof(Length));
+    Write(Message, Size);
+    ++m_Messages;
+    m_MessageReady.notify_one();
+    return true;
+}
+
+//
+// Wait up to TimeoutMs for the next message. Messages already sent are still delivered after Close.
+//
+STREAM_RECEIVE LOOPBACKCHANNEL::Receive(BYTE* Buffer, UINT Capacity, UINT* Size, UINT TimeoutMs)
+{
+    std::unique_lock<std::mutex> Guard(m_Lock);
+    if (!m_MessageReady.wait_for(Guard, std::chrono::milliseconds(TimeoutMs), [this] { return m_Used || m_Closed; }))
+    {
+        return STREAM_RECEIVE_TIMEOUT;
+    }
+    if (!m_Used)
+    {
+        return STREAM_RECEIVE_CLOSED;
+    }
+
+    uint32_t Length;
+    Read(reinterpret_cast<BYTE*>(&Length), sizeof(Length));
+    --m_Messages;
+    if (Length > Capacity)
+    {
+        Skip(Length);
+        return STREAM_RECEIVE_ERROR;
+    }
+
+    Read(Buffer, Length);
+    *Size = Length;
+    return STREAM_RECEIVE_MESSAGE;
+}
+
+UINT LOOPBACKCHANNEL::GetQueuedMessages()
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    return m_Messages;
+}
+
+UINT LOOPBACKCHANNEL::GetQueuedBytes()
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    return m_Used;
+}
+
+UINT LOOPBACKCHANNEL::GetMaxMessageSize()
+{
+    return m_Capacity - sizeof(uint32_t);
+}
+
+void LOOPBACKCHANNEL::Close()
+{
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    m_Closed = true;
+    m_MessageReady.notify_all();
+}
+
+SOCKETCHANNEL::SOCKETCHANNEL() : m_Listener(-1),
+                                 m_Socket(-1),
+                                 m_SocketsStarted(false),
+                                 m_Message(nullptr),
+                                 m_Connected(false),
+                                 m_Stopping(false),
+                                 m_Failed(false),
+                                 m_SendingBytes(0)
+{
+}
+
+SOCKETCHANNEL::~SOCKETCHANNEL()
+{
+    Clean();
+}
+
+//
+// Wait for a client on Port, Capacity bytes of messages and their length prefixes may be queued for it. The
+// client is accepted by the sender thread, so this returns right away.
+//
+bool SOCKETCHANNEL::Listen(uint16_t Port, UINT Capacity)
+{
+    Clean();
+
+#ifdef _WIN32
+    WSADATA WsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+    {
+        return false;
+    }
+    m_SocketsStarted = true;
+#endif
+
+    m_Message = new (std::nothrow) BYTE[Capacity];
+    if (!m_Message || !m_Queue.Initialize(Capacity))
+    {
+        Clean();
+        return false;
+    }
+
+    SOCKET Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Listener == INVALID_SOCKET)
+    {
+        Clean();
+        return false;
+    }
+    m_Listener = static_cast<intptr_t>(Listener);
+
+    int Reuse = 1;
+    setsockopt(Listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&Reuse), sizeof(Reuse));
+    sockaddr_in Address;
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    Address.sin_port = htons(Port);
+    if (bind(Listener, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0 || listen(Listener, 1) != 0)
+    {
+        Clean();
+        return false;
+    }
+
+    m_Sender = std::thread(&SOCKETCHANNEL::SenderThread, this);
+    return true;
+}
+
+//
+// Connect to a channel listening on Host, for the client side. Only Receive is used on it.
+//
+bool SOCKETCHANNEL::Connect(const char* Host, uint16_t Port)
+{
+    Clean();
+
+#ifdef _WIN32
+    WSADATA WsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+    {
+        return false;
+    }
+    m_SocketsStarted = true;
+#endif
+
+    char Service[8];
+    snprintf(Service, sizeof(Service), "%u", Port);
+    addrinfo Hints;
+    memset(&Hints, 0, sizeof(Hints));
+    Hints.ai_family = AF_UNSPEC;
+    Hints.ai_socktype = SOCK_STREAM;
+    addrinfo* Addresses = nullptr;
+    if (getaddrinfo(Host, Service, &Hints, &Addresses) != 0)
+    {
+        Clean();
+        return false;
+    }
+
+    for (addrinfo* Address = Addresses; Address && m_Socket == -1; Address = Address->ai_next)
+    {
+        SOCKET Socket = socket(Address->ai_family, Address->ai_socktype, Address->ai_protocol);
+        if (Socket == INVALID_SOCKET)
+        {
+            continue;
+        }
+        if (connect(Socket, Address->ai_addr, static_cast<int>(Address->ai_addrlen)) != 0)
+        {
+            CloseSocket(Socket);
+            continue;
+        }
+        m_Socket = static_cast<intptr_t>(Socket);
+    }
+    freeaddrinfo(Addresses);
+
+    m_Connected = (m_Socket != -1);
+    if (!m_Connected)
+    {
+        Clean();
+        return false;
+    }
+    return true;
+}
+
+//
+// Whether Listen or Connect succeeded, and the channel has not failed or been cleaned since
+//
+bool SOCKETCHANNEL::IsOpen()
+{
+    return (m_Sender.joinable() || m_Socket != -1) && !m_Failed;
+}
+
+bool SOCKETCHANNEL::IsConnected()
+{
+    return m_Connected;
+}
+
+//
+// Whether the client went away or the socket failed, the channel then takes no more messages
+//
+bool SOCKETCHANNEL::HasFailed()
+{
+    return m_Failed;
+}
+
+//
+// Accept the client, then write the queued messages to it until the channel is closed and the queue drained
+//
+void SOCKETCHANNEL::SenderThread()
+{
+    SOCKET Listener = static_cast<SOCKET>(m_Listener);
+    while (m_Socket == -1 && !m_Stopping)
+    {
+        fd_set Readable;
+        FD_ZERO(&Readable);
+        FD_SET(Listener, &Readable);
+        timeval Timeout = {0, SOCKET_CHANNEL_POLL_MS * 1000};
+        if (select(static_cast<int>(Listener + 1), &Readable, nullptr, nullptr, &Timeout) <= 0)
+        {
+            continue;
+        }
+
+        SOCKET Socket = accept(Listener, nullptr, nullptr);
+        if (Socket != INVALID_SOCKET)
+        {
+            // Frames are whole messages, sending them as they come keeps the latency down
+            int NoDelay = 1;
+            setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&NoDelay), sizeof(NoDelay));
+            m_Socket = static_cast<intptr_t>(Socket);
+            m_Connected = true;
+        }
+    }
+    if (m_Socket == -1)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        UINT Size;
+        STREAM_RECEIVE Ret = m_Queue.Receive(m_Message, m_Queue.GetMaxMessageSize(), &Size, SOCKET_CHANNEL_POLL_MS);
+        if (Ret == STREAM_RECEIVE_TIMEOUT)
+        {
+            continue;
+        }
+        if (Ret != STREAM_RECEIVE_MESSAGE)
+        {
+            // Closed and everything queued is written, let the client see the end
+            shutdown(static_cast<SOCKET>(m_Socket), SOCKET_SHUT_SEND);
+            break;
+        }
+
+        m_SendingBytes = Size + sizeof(uint32_t);
+        uint32_t Length = Size;
+        bool Sent = SendAll(reinterpret_cast<const BYTE*>(&Length), sizeof(Length)) && SendAll(m_Message, Size);
+        m_SendingBytes = 0;
+        if (!Sent)
+        {
+            m_Failed = true;
+            m_Connected = false;
+            m_Queue.Close();
+            break;
+        }
+    }
+}
+
+bool SOCKETCHANNEL::SendAll(const BYTE* Data, UINT Size)
+{
+    while (Size)
+    {
+        int Sent = send(static_cast<SOCKET>(m_Socket), reinterpret_cast<const char*>(Data), static_cast<int>(Size), SOCKET_SEND_FLAGS);
+        if (Sent <= 0)
+        {
+            return false;
+        }
+        Data += Sent;
+        Size -= Sent;
+    }
+    return true;
+}
+
+STREAM_RECEIVE SOCKETCHANNEL::ReceiveAll(BYTE* Data, UINT Size)
+{
+    while (Size)
+    {
+        int Received = recv(static_cast<SOCKET>(m_Socket), reinterpret_cast<char*>(Data), static_cast<int>(Size), 0);
+        if (Received == 0)
+        {
+            return STREAM_RECEIVE_CLOSED;
+        }
+        if (Received < 0)
+        {
+            return STREAM_RECEIVE_ERROR;
+        }
+        Data += Received;
+        Size -= Received;
+    }
+    return STREAM_RECEIVE_MESSAGE;
+}
+
+bool SOCKETCHANNEL::Send(const BYTE* Message, UINT Size)
+{
+    return m_Connected && m_Queue.Send(Message, Size);
+}
+
+//
+// Wait up to TimeoutMs for the next message to start coming in, then read all of it
+//
+STREAM_RECEIVE SOCKETCHANNEL::Receive(BYTE* Buffer, UINT Capacity, UINT* Size, UINT TimeoutMs)
+{
+    if (m_Socket == -1 || m_Stopping)
+    {
+        return STREAM_RECEIVE_CLOSED;
+    }
+
+    SOCKET Socket = static_cast<SOCKET>(m_Socket);
+    fd_set Readable;
+    FD_ZERO(&Readable);
+    FD_SET(Socket, &Readable);
+    timeval Timeout = {static_cast<long>(TimeoutMs / 1000), static_cast<long>((TimeoutMs % 1000) * 1000)};
+    int Ready = select(static_cast<int>(Socket + 1), &Readable, nullptr, nullptr, &Timeout);
+    if (Ready == 0)
+    {
+        return STREAM_RECEIVE_TIMEOUT;
+    }
+    if (Ready < 0)
+    {
+        return STREAM_RECEIVE_ERROR;
+    }
+
+    uint32_t Length;
+    STREAM_RECEIVE Ret = ReceiveAll(reinterpret_cast<BYTE*>(&Length), sizeof(Length));
+    if (Ret != STREAM_RECEIVE_MESSAGE)
+    {
+        return Ret;
+    }
+
+    // The rest of the stream cannot be told apart from a message too large, give up on it
+    if (Length > Capacity)
+    {
+        return STREAM_RECEIVE_ERROR;
+    }
+    Ret = ReceiveAll(Buffer, Length);
+    if (Ret != STREAM_RECEIVE_MESSAGE)
+    {
+        return (Ret == STREAM_RECEIVE_CLOSED) ? STREAM_RECEIVE_ERROR : Ret;
+    }
+    *Size = Length;
+    return STREAM_RECEIVE_MESSAGE;
+}
+
+//
+// Messages in the ring, and the one being written, are what the client has not taken yet
+//
+UINT SOCKETCHANNEL::GetQueuedMessages()
+{
+    return m_Queue.GetQueuedMessages() + (m_SendingBytes ? 1 : 0);
+}
+
+UINT SOCKETCHANNEL::GetQueuedBytes()
+{
+    return m_Queue.GetQueuedBytes() + m_SendingBytes;
+}
+
+UINT SOCKETCHANNEL::GetMaxMessageSize()
+{
+    return m_Queue.GetMaxMessageSize();
+}
+
+//
+// Take no more messages. The ones queued are still written, and the client sees the end of the stream after them.
+//
+void SOCKETCHANNEL::Close()
+{
+    m_Stopping = true;
+    m_Queue.Close();
+}
+
+void SOCKETCHANNEL::Clean()
+{
+    Close();
+    if (m_Sender.joinable())
+    {
+        m_Sender.join();
+    }
+
+    if (m_Socket != -1)
+    {
+        CloseSocket(static_cast<SOCKET>(m_Socket));
+        m_Socket = -1;
+    }
+    if (m_Listener != -1)
+    {
+        CloseSocket(static_cast<SOCKET>(m_Listener));
+        m_Listener = -1;
+    }
+    if (m_Message)
+    {
+        delete [] m_Message;
+        m_Message = nullptr;
+    }
+    m_Queue.Clean();
+
+#ifdef _WIN32
+    if (m_SocketsStarted)
+    {
+        WSACleanup();
+    }
+#endif
+    m_SocketsStarted = false;
+    m_Connected = false;
+    m_Stopping = false;
+    m_Failed = false;
+    m_SendingBytes = 0;
+}
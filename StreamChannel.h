@@ -0,0 +1,130 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _STREAMCHANNEL_H_
+#define _STREAMCHANNEL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Platform.h"
+
+//
+// Result of waiting for a message
+//
+typedef enum _STREAM_RECEIVE
+{
+    STREAM_RECEIVE_MESSAGE = 0,
+    STREAM_RECEIVE_TIMEOUT = 1,
+    STREAM_RECEIVE_CLOSED = 2,
+    STREAM_RECEIVE_ERROR = 3,
+} STREAM_RECEIVE;
+
+//
+// Ordered, reliable message transport between the streaming sink and a headset client.
+// Send never blocks: it fails when the message does not fit what the transport still buffers, and the
+// messages and bytes it holds tell the sink how far behind the client is.
+//
+class STREAMCHANNEL
+{
+    public:
+        virtual ~STREAMCHANNEL() {}
+        virtual bool Send(const BYTE* Message, UINT Size) = 0;
+        virtual STREAM_RECEIVE Receive(BYTE* Buffer, UINT Capacity, UINT* Size, UINT TimeoutMs) = 0;
+        virtual UINT GetQueuedMessages() = 0;
+        virtual UINT GetQueuedBytes() = 0;
+        virtual UINT GetMaxMessageSize() = 0;
+        virtual void Close() = 0;
+};
+
+//
+// Stand-in for the network inside one process: a fixed size ring of length prefixed messages
+//
+class LOOPBACKCHANNEL : public STREAMCHANNEL
+{
+    public:
+        LOOPBACKCHANNEL();
+        ~LOOPBACKCHANNEL();
+        bool Initialize(UINT Capacity);
+        bool Send(const BYTE* Message, UINT Size) override;
+        STREAM_RECEIVE Receive(BYTE* Buffer, UINT Capacity, UINT* Size, UINT TimeoutMs) override;
+        UINT GetQueuedMessages() override;
+        UINT GetQueuedBytes() override;
+        UINT GetMaxMessageSize() override;
+        void Close() override;
+        void Clean();
+
+    private:
+    // methods
+        void Write(const BYTE* Data, UINT Size);
+        void Read(BYTE* Data, UINT Size);
+        void Skip(UINT Size);
+
+    // variables
+        std::mutex m_Lock;
+        std::condition_variable m_MessageReady;
+
+        BYTE* m_Ring;
+        UINT m_Capacity;
+        UINT m_Head;
+        UINT m_Used;
+        UINT m_Messages;
+        bool m_Closed;
+};
+
+// How long the threads of a socket channel wait on the socket before looking at whether they were stopped
+#define SOCKET_CHANNEL_POLL_MS 100
+
+//
+// TCP transport to one client. Sent messages are queued in a ring like the loopback one, and a thread of the
+// channel writes them to the socket, so Send never blocks and the ring tells the sink how far behind the client
+// is. Until a client connects Send fails, which makes the sink hold its frames back. On the wire each message
+// has a 4 byte little endian length in front, as in the ring.
+//
+class SOCKETCHANNEL : public STREAMCHANNEL
+{
+    public:
+        SOCKETCHANNEL();
+        ~SOCKETCHANNEL();
+        bool Listen(uint16_t Port, UINT Capacity);
+        bool Connect(const char* Host, uint16_t Port);
+        bool IsOpen();
+        bool IsConnected();
+        bool HasFailed();
+        bool Send(const BYTE* Message, UINT Size) override;
+        STREAM_RECEIVE Receive(BYTE* Buffer, UINT Capacity, UINT* Size, UINT TimeoutMs) override;
+        UINT GetQueuedMessages() override;
+        UINT GetQueuedBytes() override;
+        UINT GetMaxMessageSize() override;
+        void Close() override;
+        void Clean();
+
+    private:
+    // methods
+        void SenderThread();
+        bool SendAll(const BYTE* Data, UINT Size);
+        STREAM_RECEIVE ReceiveAll(BYTE* Data, UINT Size);
+
+    // variables
+        // Sockets are kept as intptr_t so this header needs no socket headers, -1 when not open
+        intptr_t m_Listener;
+        intptr_t m_Socket;
+        bool m_SocketsStarted;
+
+        // Sending side: the queue, the message being written and the thread writing it
+        LOOPBACKCHANNEL m_Queue;
+        BYTE* m_Message;
+        std::thread m_Sender;
+        std::atomic<bool> m_Connected;
+        std::atomic<bool> m_Stopping;
+        std::atomic<bool> m_Failed;
+        std::atomic<UINT> m_SendingBytes;
+};
+
+#endif
@@ -0,0 +1,212 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <chrono>
+#include <new>
+#include <string.h>
+
+#include "StreamClient.h"
+
+STREAMCLIENT::STREAMCLIENT() : m_Codec(nullptr),
+                               m_Channel(nullptr),
+                               m_Message(nullptr),
+                               m_MessageCapacity(0),
+                               m_Pixels(nullptr),
+                               m_Frame(nullptr),
+                               m_NextFrameNumber(0)
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+STREAMCLIENT::~STREAMCLIENT()
+{
+    Clean();
+}
+
+//
+// The codec must be the one the sink uses, raw tiles are always understood
+//
+bool STREAMCLIENT::Initialize(TILECODEC* Codec, STREAMCHANNEL* Channel)
+{
+    Clean();
+
+    m_Codec = Codec;
+    m_Channel = Channel;
+    m_MessageCapacity = Channel->GetMaxMessageSize();
+    m_Message = new (std::nothrow) BYTE[m_MessageCapacity];
+    if (!m_Message)
+    {
+        Clean();
+        return false;
+    }
+
+    return true;
+}
+
+void STREAMCLIENT::Clean()
+{
+    if (m_Message)
+    {
+        delete [] m_Message;
+        m_Message = nullptr;
+    }
+    if (m_Pixels)
+    {
+        delete [] m_Pixels;
+        m_Pixels = nullptr;
+    }
+    m_FrameHolder.Clean();
+    m_Frame = nullptr;
+    m_MessageCapacity = 0;
+    m_NextFrameNumber = 0;
+    m_Codec = nullptr;
+    m_Channel = nullptr;
+}
+
+//
+// Reallocate the frame when the sink's size changes, the next frame it sends is a full one
+//
+bool STREAMCLIENT::Resize(UINT Width, UINT Height)
+{
+    if (m_Frame && m_Frame->Width == Width && m_Frame->Height == Height)
+    {
+        return true;
+    }
+
+    if (m_Pixels)
+    {
+        delete [] m_Pixels;
+        m_Pixels = nullptr;
+    }
+    m_Frame = nullptr;
+
+    // Full frame codecs decode the whole frame at once
+    m_Pixels = new (std::nothrow) BYTE[static_cast<size_t>(Width) * Height * 4];
+    if (!m_Pixels || !m_FrameHolder.Initialize(Width, Height))
+    {
+        return false;
+    }
+    m_Frame = m_FrameHolder.GetDesktop();
+    return true;
+}
+
+//
+// Apply the regions of one frame message
+//
+bool STREAMCLIENT::DecodeFrame(UINT Size)
+{
+    if (Size < sizeof(STREAM_FRAME_HEADER))
+    {
+        return false;
+    }
+
+    STREAM_FRAME_HEADER Header;
+    memcpy(&Header, m_Message, sizeof(Header));
+    if (Header.Magic != STREAM_FRAME_MAGIC || !Resize(Header.Width, Header.Height))
+    {
+        return false;
+    }
+
+    const BYTE* In = m_Message + sizeof(STREAM_FRAME_HEADER);
+    const BYTE* InEnd = m_Message + Size;
+    for (UINT i = 0; i < Header.TileCount; ++i)
+    {
+        STREAM_TILE_HEADER Tile;
+        if (static_cast<size_t>(InEnd - In) < sizeof(Tile))
+        {
+            return false;
+        }
+        memcpy(&Tile, In, sizeof(Tile));
+        In += sizeof(Tile);
+        if (static_cast<size_t>(InEnd - In) < Tile.Size)
+        {
+            return false;
+        }
+
+        bool FullFrame = (Tile.Codec != TILE_CODEC_RAW) && m_Codec && m_Codec->IsFullFrame();
+        UINT Left = FullFrame ? 0 : Tile.Column * TILE_SIZE;
+        UINT Top = FullFrame ? 0 : Tile.Row * TILE_SIZE;
+        if (Left >= Header.Width || Top >= Header.Height)
+        {
+            return false;
+        }
+        UINT Width = FullFrame ? Header.Width : ((Left + TILE_SIZE < Header.Width) ? TILE_SIZE : Header.Width - Left);
+        UINT Height = FullFrame ? Header.Height : ((Top + TILE_SIZE < Header.Height) ? TILE_SIZE : Header.Height - Top);
+
+        const BYTE* Pixels = In;
+        if (Tile.Codec == TILE_CODEC_RAW)
+        {
+            if (Tile.Size != Width * Height * 4)
+            {
+                return false;
+            }
+        }
+        else if (!m_Codec || Tile.Codec != m_Codec->GetId() || !m_Codec->Decode(In, Tile.Size, Width, Height, m_Pixels))
+        {
+            return false;
+        }
+        else
+        {
+            Pixels = m_Pixels;
+        }
+
+        for (UINT Y = 0; Y < Height; ++Y)
+        {
+            memcpy(m_Frame->Bits + static_cast<size_t>(Top + Y) * m_Frame->Pitch + Left * 4, Pixels + static_cast<size_t>(Y) * Width * 4, Width * 4);
+        }
+        In += Tile.Size;
+    }
+
+    // Frames held back by the sink never make it here, their tiles come with the next one
+    m_Stats.FramesSkipped += Header.FrameNumber - m_NextFrameNumber;
+    m_NextFrameNumber = Header.FrameNumber + 1;
+    ++m_Stats.FramesReceived;
+
+    if (Header.Checksum && STREAMSINK::HashFrame(m_Frame) != Header.Checksum)
+    {
+        ++m_Stats.FramesCorrupt;
+    }
+
+    uint64_t Now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    uint64_t Latency = (Now > Header.Timestamp) ? Now - Header.Timestamp : 0;
+    m_Stats.LatencyTotalNs += Latency;
+    if (Latency > m_Stats.LatencyMaxNs)
+    {
+        m_Stats.LatencyMaxNs = Latency;
+    }
+    return true;
+}
+
+//
+// Wait for the next frame and apply it to the client's copy
+//
+STREAM_RECEIVE STREAMCLIENT::ReceiveFrame(UINT TimeoutMs)
+{
+    UINT Size;
+    STREAM_RECEIVE Ret = m_Channel->Receive(m_Message, m_MessageCapacity, &Size, TimeoutMs);
+    if (Ret != STREAM_RECEIVE_MESSAGE)
+    {
+        return Ret;
+    }
+
+    return DecodeFrame(Size) ? STREAM_RECEIVE_MESSAGE : STREAM_RECEIVE_ERROR;
+}
+
+SOFTWARE_SURFACE* STREAMCLIENT::GetFrame()
+{
+    return m_Frame;
+}
+
+void STREAMCLIENT::GetStats(STREAM_CLIENT_STATS* Stats)
+{
+    *Stats = m_Stats;
+}
+
+void STREAMCLIENT::ResetStats()
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
@@ -0,0 +1,58 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _STREAMCLIENT_H_
+#define _STREAMCLIENT_H_
+
+#include "StreamSink.h"
+
+typedef struct _STREAM_CLIENT_STATS
+{
+    uint64_t FramesReceived;
+    uint64_t FramesSkipped;
+    uint64_t FramesCorrupt;
+    uint64_t LatencyTotalNs;
+    uint64_t LatencyMaxNs;
+} STREAM_CLIENT_STATS;
+
+//
+// Receiving end of the stream, what runs on the headset side: rebuilds the frame from the tiles and
+// checks it against the hash the sink sent. Latency is measured against the sink's clock, so it only
+// means something when both ends run on the same machine.
+//
+class STREAMCLIENT
+{
+    public:
+        STREAMCLIENT();
+        ~STREAMCLIENT();
+        bool Initialize(TILECODEC* Codec, STREAMCHANNEL* Channel);
+        STREAM_RECEIVE ReceiveFrame(UINT TimeoutMs);
+        SOFTWARE_SURFACE* GetFrame();
+        void GetStats(STREAM_CLIENT_STATS* Stats);
+        void ResetStats();
+        void Clean();
+
+    private:
+    // methods
+        bool DecodeFrame(UINT Size);
+        bool Resize(UINT Width, UINT Height);
+
+    // variables
+        TILECODEC* m_Codec;
+        STREAMCHANNEL* m_Channel;
+
+        BYTE* m_Message;
+        UINT m_MessageCapacity;
+        BYTE* m_Pixels;
+        SOFTWARECOMPOSITOR m_FrameHolder;
+        SOFTWARE_SURFACE* m_Frame;
+
+        uint32_t m_NextFrameNumber;
+        STREAM_CLIENT_STATS m_Stats;
+};
+
+#endif
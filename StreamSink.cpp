@@ -0,0 +1,433 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <string.h>
+
+#include "StreamSink.h"
+
+STREAMSINK::STREAMSINK() : m_Width(0),
+                           m_Height(0),
+                           m_Columns(0),
+                           m_Rows(0),
+                           m_Codec(nullptr),
+                           m_Channel(nullptr),
+                           m_Pool(nullptr),
+                           m_InFlight(-1),
+                           m_Pending(nullptr),
+                           m_PendingCount(0),
+                           m_Message(nullptr),
+                           m_MessageCapacity(0),
+                           m_Pixels(nullptr),
+                           m_FrameNumber(0)
+{
+    memset(&m_Options, 0, sizeof(m_Options));
+    memset(&m_InFlightHeader, 0, sizeof(m_InFlightHeader));
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+STREAMSINK::~STREAMSINK()
+{
+    Clean();
+}
+
+//
+// Allocate everything a frame needs up front. Without a codec tiles are sent raw. A pool, when given, does
+// the compression of tile codecs instead, with its own codecs. Fails when the largest possible frame
+// message does not fit the channel.
+//
+bool STREAMSINK::Initialize(UINT Width, UINT Height, TILECODEC* Codec, COMPRESSIONPOOL* Pool, STREAMCHANNEL* Channel, const STREAM_OPTIONS* Options)
+{
+    Clean();
+
+    m_Width = Width;
+    m_Height = Height;
+    m_Columns = (Width + TILE_SIZE - 1) / TILE_SIZE;
+    m_Rows = (Height + TILE_SIZE - 1) / TILE_SIZE;
+    m_Codec = Codec;
+    m_Channel = Channel;
+    m_Pool = (Codec && Codec->IsFullFrame()) ? nullptr : Pool;
+    m_Options = *Options;
+
+    UINT RegionWidth = TILE_SIZE;
+    UINT RegionHeight = TILE_SIZE;
+    UINT RegionCount = m_Columns * m_Rows;
+    if (Codec && Codec->IsFullFrame())
+    {
+        RegionWidth = Width;
+        RegionHeight = Height;
+        RegionCount = 1;
+    }
+
+    // Regions that do not shrink are sent raw
+    uint64_t RegionSize = static_cast<uint64_t>(RegionWidth) * RegionHeight * 4;
+    if (Codec && Codec->GetMaxEncodedSize(RegionWidth, RegionHeight) > RegionSize)
+    {
+        RegionSize = Codec->GetMaxEncodedSize(RegionWidth, RegionHeight);
+    }
+    if (m_Pool && m_Pool->GetMaxTileSize() > RegionSize)
+    {
+        RegionSize = m_Pool->GetMaxTileSize();
+    }
+    uint64_t MessageSize = sizeof(STREAM_FRAME_HEADER) + RegionCount * (sizeof(STREAM_TILE_HEADER) + RegionSize);
+    if (MessageSize > Channel->GetMaxMessageSize())
+    {
+        Clean();
+        return false;
+    }
+    m_MessageCapacity = static_cast<UINT>(MessageSize);
+
+    m_Pending = new (std::nothrow) bool[m_Columns * m_Rows];
+    m_Message = new (std::nothrow) BYTE[m_MessageCapacity];
+    m_Pixels = new (std::nothrow) BYTE[static_cast<size_t>(RegionWidth) * RegionHeight * 4];
+    if (!m_Pending || !m_Message || !m_Pixels)
+    {
+        Clean();
+        return false;
+    }
+
+    // The client starts from nothing
+    for (UINT i = 0; i < m_Columns * m_Rows; ++i)
+    {
+        m_Pending[i] = true;
+    }
+    m_PendingCount = m_Columns * m_Rows;
+
+    return true;
+}
+
+void STREAMSINK::Clean()
+{
+    if (m_InFlight >= 0)
+    {
+        m_Pool->WaitFrame(m_InFlight);
+        m_Pool->EndFrame(m_InFlight);
+        m_InFlight = -1;
+    }
+    m_Pool = nullptr;
+
+    if (m_Pending)
+    {
+        delete [] m_Pending;
+        m_Pending = nullptr;
+    }
+    if (m_Message)
+    {
+        delete [] m_Message;
+        m_Message = nullptr;
+    }
+    if (m_Pixels)
+    {
+        delete [] m_Pixels;
+        m_Pixels = nullptr;
+    }
+    m_PendingCount = 0;
+    m_MessageCapacity = 0;
+    m_FrameNumber = 0;
+    m_Codec = nullptr;
+    m_Channel = nullptr;
+}
+
+//
+// Remember the tiles under a changed region
+//
+void STREAMSINK::MarkTiles(const RECT* Rect)
+{
+    LONG Left = (Rect->left > 0) ? Rect->left : 0;
+    LONG Top = (Rect->top > 0) ? Rect->top : 0;
+    LONG Right = (Rect->right < static_cast<LONG>(m_Width)) ? Rect->right : static_cast<LONG>(m_Width);
+    LONG Bottom = (Rect->bottom < static_cast<LONG>(m_Height)) ? Rect->bottom : static_cast<LONG>(m_Height);
+    if (Right <= Left || Bottom <= Top)
+    {
+        return;
+    }
+
+    for (UINT Row = Top / TILE_SIZE; Row <= static_cast<UINT>(Bottom - 1) / TILE_SIZE; ++Row)
+    {
+        for (UINT Column = Left / TILE_SIZE; Column <= static_cast<UINT>(Right - 1) / TILE_SIZE; ++Column)
+        {
+            bool* Pending = &m_Pending[Row * m_Columns + Column];
+            if (!*Pending)
+            {
+                *Pending = true;
+                ++m_PendingCount;
+            }
+        }
+    }
+}
+
+//
+// Append one region to the message: the tile at Column, Row or the whole frame for full frame codecs
+//
+bool STREAMSINK::EncodeRegion(const SOFTWARE_SURFACE* Frame, UINT Column, UINT Row, BYTE** Out)
+{
+    bool FullFrame = m_Codec && m_Codec->IsFullFrame();
+    UINT Left = FullFrame ? 0 : Column * TILE_SIZE;
+    UINT Top = FullFrame ? 0 : Row * TILE_SIZE;
+    UINT Width = FullFrame ? m_Width : ((Left + TILE_SIZE < m_Width) ? TILE_SIZE : m_Width - Left);
+    UINT Height = FullFrame ? m_Height : ((Top + TILE_SIZE < m_Height) ? TILE_SIZE : m_Height - Top);
+    UINT RawSize = Width * Height * 4;
+
+    STREAM_TILE_HEADER* Header = reinterpret_cast<STREAM_TILE_HEADER*>(*Out);
+    memset(Header, 0, sizeof(STREAM_TILE_HEADER));
+    Header->Column = static_cast<uint16_t>(Column);
+    Header->Row = static_cast<uint16_t>(Row);
+    BYTE* Data = *Out + sizeof(STREAM_TILE_HEADER);
+    UINT Available = static_cast<UINT>(m_Message + m_MessageCapacity - Data);
+
+    // Codecs take packed pixels
+    for (UINT Y = 0; Y < Height; ++Y)
+    {
+        memcpy(m_Pixels + static_cast<size_t>(Y) * Width * 4, Frame->Bits + static_cast<size_t>(Top + Y) * Frame->Pitch + Left * 4, Width * 4);
+    }
+
+    UINT Size = m_Codec ? m_Codec->Encode(m_Pixels, Width, Height, Data, Available) : 0;
+    if (Size && (Size < RawSize || FullFrame))
+    {
+        Header->Codec = static_cast<uint8_t>(m_Codec->GetId());
+    }
+    else if (!FullFrame && RawSize <= Available)
+    {
+        Header->Codec = TILE_CODEC_RAW;
+        memcpy(Data, m_Pixels, RawSize);
+        Size = RawSize;
+    }
+    else
+    {
+        return false;
+    }
+    Header->Size = Size;
+
+    *Out = Data + Size;
+    m_Stats.RawBytes += RawSize;
+    ++m_Stats.TilesSent;
+    return true;
+}
+
+//
+// Copy the changed tiles into a frame slot of the pool and let the workers at them
+//
+void STREAMSINK::StartPooledFrame(const SOFTWARE_SURFACE* Frame, const STREAM_FRAME_HEADER* Header)
+{
+    for (UINT Row = 0; Row < m_Rows; ++Row)
+    {
+        for (UINT Column = 0; Column < m_Columns; ++Column)
+        {
+            bool* Pending = &m_Pending[Row * m_Columns + Column];
+            if (*Pending)
+            {
+                m_Pool->AddTile(m_InFlight, Frame, Column, Row);
+                *Pending = false;
+            }
+        }
+    }
+    m_PendingCount = 0;
+
+    m_InFlightHeader = *Header;
+    m_InFlightHeader.TileCount = m_Pool->GetTileCount(m_InFlight);
+    m_Pool->SubmitFrame(m_InFlight);
+}
+
+//
+// Wait for the frame in flight and send it, in the order its tiles were added. When the channel does not
+// take it, its tiles are pending again.
+//
+bool STREAMSINK::SendPooledFrame()
+{
+    m_Pool->WaitFrame(m_InFlight);
+    UINT TileCount = m_Pool->GetTileCount(m_InFlight);
+    const COMPRESSED_TILE* Tiles = m_Pool->GetTiles(m_InFlight);
+
+    memcpy(m_Message, &m_InFlightHeader, sizeof(STREAM_FRAME_HEADER));
+    BYTE* Out = m_Message + sizeof(STREAM_FRAME_HEADER);
+    uint64_t RawBytes = 0;
+    for (UINT i = 0; i < TileCount; ++i)
+    {
+        STREAM_TILE_HEADER Header;
+        memset(&Header, 0, sizeof(Header));
+        Header.Column = static_cast<uint16_t>(Tiles[i].Column);
+        Header.Row = static_cast<uint16_t>(Tiles[i].Row);
+        Header.Codec = static_cast<uint8_t>(Tiles[i].Codec);
+        Header.Size = Tiles[i].Size;
+        memcpy(Out, &Header, sizeof(Header));
+        memcpy(Out + sizeof(Header), Tiles[i].Data, Tiles[i].Size);
+        Out += sizeof(Header) + Tiles[i].Size;
+        RawBytes += Tiles[i].Width * Tiles[i].Height * 4;
+    }
+
+    UINT Size = static_cast<UINT>(Out - m_Message);
+    bool Sent = m_Channel->Send(m_Message, Size);
+    if (Sent)
+    {
+        ++m_Stats.FramesSent;
+        m_Stats.TilesSent += TileCount;
+        m_Stats.RawBytes += RawBytes;
+        m_Stats.WireBytes += Size;
+    }
+    else
+    {
+        for (UINT i = 0; i < TileCount; ++i)
+        {
+            RECT Rect = {static_cast<LONG>(Tiles[i].Column * TILE_SIZE), static_cast<LONG>(Tiles[i].Row * TILE_SIZE),
+                         static_cast<LONG>(Tiles[i].Column * TILE_SIZE + Tiles[i].Width), static_cast<LONG>(Tiles[i].Row * TILE_SIZE + Tiles[i].Height)};
+            MarkTiles(&Rect);
+        }
+        ++m_Stats.FramesHeld;
+    }
+
+    m_Pool->EndFrame(m_InFlight);
+    m_InFlight = -1;
+    return Sent;
+}
+
+//
+// Send the changed tiles of a composed frame, Frame is in desktop coordinates like the damage.
+// Returns false when a frame was held back, its tiles then go out with the next frame sent.
+//
+bool STREAMSINK::SubmitFrame(const SOFTWARE_SURFACE* Frame, const RECT* Damage, UINT DamageCount, uint64_t Timestamp)
+{
+    for (UINT i = 0; i < DamageCount; ++i)
+    {
+        MarkTiles(&Damage[i]);
+    }
+
+    // The previous frame compressed while the caller built this one
+    bool Sent = true;
+    if (m_InFlight >= 0)
+    {
+        Sent = SendPooledFrame();
+    }
+    if (!m_PendingCount)
+    {
+        return Sent;
+    }
+
+    // Held frames use up a number too, the client sees them as skipped
+    uint32_t FrameNumber = m_FrameNumber++;
+
+    // Pacing: the client has not taken what we already sent, let it catch up instead of queueing more
+    if (m_Channel->GetQueuedMessages() >= m_Options.MaxQueuedFrames || m_Channel->GetQueuedBytes() > m_Options.MaxQueuedBytes)
+    {
+        ++m_Stats.FramesHeld;
+        return false;
+    }
+
+    STREAM_FRAME_HEADER* Header = reinterpret_cast<STREAM_FRAME_HEADER*>(m_Message);
+    memset(Header, 0, sizeof(STREAM_FRAME_HEADER));
+    Header->Magic = STREAM_FRAME_MAGIC;
+    Header->FrameNumber = FrameNumber;
+    Header->Width = m_Width;
+    Header->Height = m_Height;
+    Header->Timestamp = Timestamp;
+    Header->Checksum = m_Options.Verify ? HashFrame(Frame) : 0;
+
+    if (m_Pool)
+    {
+        m_InFlight = m_Pool->BeginFrame();
+        if (m_InFlight >= 0)
+        {
+            StartPooledFrame(Frame, Header);
+            return Sent;
+        }
+    }
+
+    BYTE* Out = m_Message + sizeof(STREAM_FRAME_HEADER);
+    uint64_t RawBytes = m_Stats.RawBytes;
+    uint64_t TilesSent = m_Stats.TilesSent;
+    bool Encoded = true;
+    if (m_Codec && m_Codec->IsFullFrame())
+    {
+        Encoded = EncodeRegion(Frame, 0, 0, &Out);
+        Header->TileCount = 1;
+    }
+    else
+    {
+        for (UINT Row = 0; Row < m_Rows && Encoded; ++Row)
+        {
+            for (UINT Column = 0; Column < m_Columns && Encoded; ++Column)
+            {
+                if (m_Pending[Row * m_Columns + Column])
+                {
+                    Encoded = EncodeRegion(Frame, Column, Row, &Out);
+                    ++Header->TileCount;
+                }
+            }
+        }
+    }
+
+    UINT Size = static_cast<UINT>(Out - m_Message);
+    if (!Encoded || !m_Channel->Send(m_Message, Size))
+    {
+        m_Stats.RawBytes = RawBytes;
+        m_Stats.TilesSent = TilesSent;
+        ++m_Stats.FramesHeld;
+        return false;
+    }
+
+    for (UINT i = 0; i < m_Columns * m_Rows; ++i)
+    {
+        m_Pending[i] = false;
+    }
+    m_PendingCount = 0;
+    ++m_Stats.FramesSent;
+    m_Stats.WireBytes += Size;
+    return Sent;
+}
+
+//
+// Push out everything still pending or compressing, true once the client has been sent all of it
+//
+bool STREAMSINK::Flush(const SOFTWARE_SURFACE* Frame, uint64_t Timestamp)
+{
+    bool Sent = SubmitFrame(Frame, nullptr, 0, Timestamp);
+    return Sent && !m_PendingCount && m_InFlight < 0;
+}
+
+//
+// Whether tiles are waiting to be sent or compressed, callers with no damage can skip SubmitFrame otherwise
+//
+bool STREAMSINK::HasPending()
+{
+    return m_PendingCount || m_InFlight >= 0;
+}
+
+void STREAMSINK::GetStats(STREAM_STATS* Stats)
+{
+    *Stats = m_Stats;
+}
+
+void STREAMSINK::ResetStats()
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+//
+// FNV style hash of the whole frame, 8 bytes at a time
+//
+uint64_t STREAMSINK::HashFrame(const SOFTWARE_SURFACE* Frame)
+{
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    UINT RowSize = Frame->Width * 4;
+    for (UINT Y = 0; Y < Frame->Height; ++Y)
+    {
+        const BYTE* Row = Frame->Bits + static_cast<size_t>(Y) * Frame->Pitch;
+        UINT X = 0;
+        for (; X + 8 <= RowSize; X += 8)
+        {
+            uint64_t Word;
+            memcpy(&Word, Row + X, sizeof(Word));
+            Hash = (Hash ^ Word) * 0x100000001b3ull;
+        }
+        for (; X < RowSize; ++X)
+        {
+            Hash = (Hash ^ Row[X]) * 0x100000001b3ull;
+        }
+    }
+
+    // 0 means not verified on the wire
+    return Hash ? Hash : 1;
+}
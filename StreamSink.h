@@ -0,0 +1,130 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _STREAMSINK_H_
+#define _STREAMSINK_H_
+
+#include "CompressionPool.h"
+#include "SoftwareCompositor.h"
+#include "StreamChannel.h"
+#include "TileCodec.h"
+#include "TileDetector.h"
+
+// 'DDFR' at the start of every frame message
+#define STREAM_FRAME_MAGIC 0x52464444
+
+// Default frames and bytes the channel may hold before frames are held back
+#define STREAM_DEFAULT_QUEUED_FRAMES 2
+#define STREAM_DEFAULT_QUEUED_BYTES (4 * 1024 * 1024)
+
+//
+// Wire format, little endian. A frame message is the frame header followed by TileCount regions, each
+// a tile header and Size bytes of data. Regions are TILE_SIZE tiles, or the whole frame for full frame codecs.
+//
+typedef struct _STREAM_FRAME_HEADER
+{
+    uint32_t Magic;
+    uint32_t FrameNumber;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t TileCount;
+    uint32_t Reserved;
+
+    // Steady clock of the sender when the frame was composed, in nanoseconds
+    uint64_t Timestamp;
+
+    // Hash of the whole frame after the update, 0 when the sender does not verify
+    uint64_t Checksum;
+} STREAM_FRAME_HEADER;
+
+typedef struct _STREAM_TILE_HEADER
+{
+    uint16_t Column;
+    uint16_t Row;
+    uint8_t Codec;
+    uint8_t Reserved[3];
+    uint32_t Size;
+} STREAM_TILE_HEADER;
+
+typedef struct _STREAM_OPTIONS
+{
+    // Frames are held back while the channel holds this many frames or more than this many bytes,
+    // their tiles go out with the next frame sent
+    UINT MaxQueuedFrames;
+    UINT MaxQueuedBytes;
+
+    // Send the hash of every frame so the client can check what it rebuilt
+    bool Verify;
+} STREAM_OPTIONS;
+
+typedef struct _STREAM_STATS
+{
+    uint64_t FramesSent;
+    uint64_t FramesHeld;
+    uint64_t TilesSent;
+    uint64_t RawBytes;
+    uint64_t WireBytes;
+} STREAM_STATS;
+
+//
+// Output stage for a headset on another machine. Takes the composed frame with the regions that changed,
+// and sends the tiles under them through the codec. When the client falls behind, the changed tiles are
+// remembered and sent with a later frame, so the client skips frames instead of queueing them up.
+// With a compression pool the tiles of a frame are compressed while the caller builds the next one,
+// and go out on the next call, so SubmitFrame should be called every refresh even without damage.
+//
+class STREAMSINK
+{
+    public:
+        STREAMSINK();
+        ~STREAMSINK();
+        bool Initialize(UINT Width, UINT Height, TILECODEC* Codec, COMPRESSIONPOOL* Pool, STREAMCHANNEL* Channel, const STREAM_OPTIONS* Options);
+        bool SubmitFrame(const SOFTWARE_SURFACE* Frame, const RECT* Damage, UINT DamageCount, uint64_t Timestamp);
+        bool Flush(const SOFTWARE_SURFACE* Frame, uint64_t Timestamp);
+        bool HasPending();
+        void GetStats(STREAM_STATS* Stats);
+        void ResetStats();
+        void Clean();
+
+        static uint64_t HashFrame(const SOFTWARE_SURFACE* Frame);
+
+    private:
+    // methods
+        void MarkTiles(const RECT* Rect);
+        bool EncodeRegion(const SOFTWARE_SURFACE* Frame, UINT Column, UINT Row, BYTE** Out);
+        void StartPooledFrame(const SOFTWARE_SURFACE* Frame, const STREAM_FRAME_HEADER* Header);
+        bool SendPooledFrame();
+
+    // variables
+        UINT m_Width;
+        UINT m_Height;
+        UINT m_Columns;
+        UINT m_Rows;
+        TILECODEC* m_Codec;
+        STREAMCHANNEL* m_Channel;
+
+        // Frame slot of the pool still compressing, with the header it goes out with
+        COMPRESSIONPOOL* m_Pool;
+        INT m_InFlight;
+        STREAM_FRAME_HEADER m_InFlightHeader;
+
+        STREAM_OPTIONS m_Options;
+
+        // Tiles changed since the client last got them
+        bool* m_Pending;
+        UINT m_PendingCount;
+
+        // Message being built, sized for every region at its worst, and the packed pixels of one region
+        BYTE* m_Message;
+        UINT m_MessageCapacity;
+        BYTE* m_Pixels;
+
+        uint32_t m_FrameNumber;
+        STREAM_STATS m_Stats;
+};
+
+#endif
@@ -14,24 +14,33 @@ THREADMANAGER::THREADMANAGER() : m_ThreadCount(0),
                                  m_ThreadData(nullptr)
 {
     RtlZeroMemory(&m_PtrInfo, sizeof(m_PtrInfo));
+    RtlZeroMemory(&m_PtrPosition, sizeof(m_PtrPosition));
+    InitializeSRWLock(&m_PtrPosition.Lock);
+    RtlZeroMemory(&m_DamageInfo, sizeof(m_DamageInfo));
+    RtlZeroMemory(&m_Options, sizeof(m_Options));
+    m_DamageInfo.FullDamage = true;
 }
 
 THREADMANAGER::~THREADMANAGER()
 {
     Clean();
-}
 
-//
-// Clean up resources
-//
-void THREADMANAGER::Clean()
-{
     if (m_PtrInfo.PtrShapeBuffer)
     {
         delete [] m_PtrInfo.PtrShapeBuffer;
         m_PtrInfo.PtrShapeBuffer = nullptr;
     }
-    RtlZeroMemory(&m_PtrInfo, sizeof(m_PtrInfo));
+}
+
+//
+// Clean up resources. The pointer info and position are kept so the presenter can keep drawing the cursor
+// where it last was while duplication is restarted.
+//
+void THREADMANAGER::Clean()
+{
+    // We can't tell what the threads were doing when they stopped so have the presenter pick up everything
+    m_DamageInfo.RectCount = 0;
+    m_DamageInfo.FullDamage = true;
 
     if (m_ThreadHandles)
     {
@@ -60,51 +69,17 @@ void THREADMANAGER::Clean()
 }
 
 //
-// Clean up DX_RESOURCES
+// Options handed to the duplication threads started by the next Initialize
 //
-void THREADMANAGER::CleanDx(_Inout_ DX_RESOURCES* Data)
+void THREADMANAGER::SetOptions(_In_ const DUPLICATION_OPTIONS* Options)
 {
-    if (Data->Device)
-    {
-        Data->Device->Release();
-        Data->Device = nullptr;
-    }
-
-    if (Data->Context)
-    {
-        Data->Context->Release();
-        Data->Context = nullptr;
-    }
-
-    if (Data->VertexShader)
-    {
-        Data->VertexShader->Release();
-        Data->VertexShader = nullptr;
-    }
-
-    if (Data->PixelShader)
-    {
-        Data->PixelShader->Release();
-        Data->PixelShader = nullptr;
-    }
-
-    if (Data->InputLayout)
-    {
-        Data->InputLayout->Release();
-        Data->InputLayout = nullptr;
-    }
-
-    if (Data->SamplerLinear)
-    {
-        Data->SamplerLinear->Release();
-        Data->SamplerLinear = nullptr;
-    }
+    m_Options = *Options;
 }
 
 //
 // Start up threads for DDA
 //
-DUPL_RETURN THREADMANAGER::Initialize(INT SingleOutput, UINT OutputCount, HANDLE UnexpectedErrorEvent, HANDLE ExpectedErrorEvent, HANDLE TerminateThreadsEvent, HANDLE SharedHandle, _In_ RECT* DesktopDim)
+DUPL_RETURN THREADMANAGER::Initialize(INT SingleOutput, UINT OutputCount, HANDLE UnexpectedErrorEvent, HANDLE ExpectedErrorEvent, HANDLE TerminateThreadsEvent, HANDLE SharedHandle, DXGI_FORMAT CaptureFormat, LUID AdapterLuid, _In_ RECT* DesktopDim)
 {
     m_ThreadCount = OutputCount;
     m_ThreadHandles = new (std::nothrow) HANDLE[m_ThreadCount];
@@ -113,6 +88,8 @@ DUPL_RETURN THREADMANAGER::Initialize(INT SingleOutput, UINT OutputCount, HANDLE
     {
         return ProcessFailure(nullptr, L"Failed to allocate array for threads", L"Error", E_OUTOFMEMORY);
     }
+    RtlZeroMemory(m_ThreadHandles, m_ThreadCount * sizeof(HANDLE));
+    RtlZeroMemory(m_ThreadData, m_ThreadCount * sizeof(THREAD_DATA));
 
     // Create appropriate # of threads for duplication
     DUPL_RETURN Ret = DUPL_RETURN_SUCCESS;
@@ -123,12 +100,16 @@ DUPL_RETURN THREADMANAGER::Initialize(INT SingleOutput, UINT OutputCount, HANDLE
         m_ThreadData[i].TerminateThreadsEvent = TerminateThreadsEvent;
         m_ThreadData[i].Output = (SingleOutput < 0) ? i : SingleOutput;
         m_ThreadData[i].TexSharedHandle = SharedHandle;
+        m_ThreadData[i].CaptureFormat = CaptureFormat;
         m_ThreadData[i].OffsetX = DesktopDim->left;
         m_ThreadData[i].OffsetY = DesktopDim->top;
         m_ThreadData[i].PtrInfo = &m_PtrInfo;
+        m_ThreadData[i].PtrPosition = &m_PtrPosition;
+        m_ThreadData[i].Damage = &m_DamageInfo;
+        m_ThreadData[i].Options = m_Options;
 
-        RtlZeroMemory(&m_ThreadData[i].DxRes, sizeof(DX_RESOURCES));
-        Ret = InitializeDx(&m_ThreadData[i].DxRes);
+        // All outputs of the adapter share one device and its shaders
+        Ret = m_DevicePool.GetResources(AdapterLuid, &m_ThreadData[i].DxRes);
         if (Ret != DUPL_RETURN_SUCCESS)
         {
             return Ret;
@@ -146,104 +127,27 @@ DUPL_RETURN THREADMANAGER::Initialize(INT SingleOutput, UINT OutputCount, HANDLE
 }
 
 //
-// Get DX_RESOURCES
+// Getter for the PTR_INFO structure
 //
-DUPL_RETURN THREADMANAGER::InitializeDx(_Out_ DX_RESOURCES* Data)
+PTR_INFO* THREADMANAGER::GetPointerInfo()
 {
-    HRESULT hr = S_OK;
-
-    // Driver types supported
-    D3D_DRIVER_TYPE DriverTypes[] =
-    {
-        D3D_DRIVER_TYPE_HARDWARE,
-        D3D_DRIVER_TYPE_WARP,
-        D3D_DRIVER_TYPE_REFERENCE,
-    };
-    UINT NumDriverTypes = ARRAYSIZE(DriverTypes);
-
-    // Feature levels supported
-    D3D_FEATURE_LEVEL FeatureLevels[] =
-    {
-        D3D_FEATURE_LEVEL_11_0,
-        D3D_FEATURE_LEVEL_10_1,
-        D3D_FEATURE_LEVEL_10_0,
-        D3D_FEATURE_LEVEL_9_1
-    };
-    UINT NumFeatureLevels = ARRAYSIZE(FeatureLevels);
-
-    D3D_FEATURE_LEVEL FeatureLevel;
-
-    // Create device
-    for (UINT DriverTypeIndex = 0; DriverTypeIndex < NumDriverTypes; ++DriverTypeIndex)
-    {
-        hr = D3D11CreateDevice(nullptr, DriverTypes[DriverTypeIndex], nullptr, 0, FeatureLevels, NumFeatureLevels,
-                                D3D11_SDK_VERSION, &Data->Device, &FeatureLevel, &Data->Context);
-        if (SUCCEEDED(hr))
-        {
-            // Device creation success, no need to loop anymore
-            break;
-        }
-    }
-    if (FAILED(hr))
-    {
-        return ProcessFailure(nullptr, L"Failed to create device in InitializeDx", L"Error", hr);
-    }
-
-    // VERTEX shader
-    UINT Size = ARRAYSIZE(g_VS);
-    hr = Data->Device->CreateVertexShader(g_VS, Size, nullptr, &Data->VertexShader);
-    if (FAILED(hr))
-    {
-        return ProcessFailure(Data->Device, L"Failed to create vertex shader in InitializeDx", L"Error", hr, SystemTransitionsExpectedErrors);
-    }
-
-    // Input layout
-    D3D11_INPUT_ELEMENT_DESC Layout[] =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
-    };
-    UINT NumElements = ARRAYSIZE(Layout);
-    hr = Data->Device->CreateInputLayout(Layout, NumElements, g_VS, Size, &Data->InputLayout);
-    if (FAILED(hr))
-    {
-        return ProcessFailure(Data->Device, L"Failed to create input layout in InitializeDx", L"Error", hr, SystemTransitionsExpectedErrors);
-    }
-    Data->Context->IASetInputLayout(Data->InputLayout);
-
-    // Pixel shader
-    Size = ARRAYSIZE(g_PS);
-    hr = Data->Device->CreatePixelShader(g_PS, Size, nullptr, &Data->PixelShader);
-    if (FAILED(hr))
-    {
-        return ProcessFailure(Data->Device, L"Failed to create pixel shader in InitializeDx", L"Error", hr, SystemTransitionsExpectedErrors);
-    }
-
-    // Set up sampler
-    D3D11_SAMPLER_DESC SampDesc;
-    RtlZeroMemory(&SampDesc, sizeof(SampDesc));
-    SampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-    SampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-    SampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-    SampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-    SampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-    SampDesc.MinLOD = 0;
-    SampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-    hr = Data->Device->CreateSamplerState(&SampDesc, &Data->SamplerLinear);
-    if (FAILED(hr))
-    {
-        return ProcessFailure(Data->Device, L"Failed to create sampler state in InitializeDx", L"Error", hr, SystemTransitionsExpectedErrors);
-    }
+    return &m_PtrInfo;
+}
 
-    return DUPL_RETURN_SUCCESS;
+//
+// Getter for the PTR_POSITION structure
+//
+PTR_POSITION* THREADMANAGER::GetPointerPosition()
+{
+    return &m_PtrPosition;
 }
 
 //
-// Getter for the PTR_INFO structure
+// Getter for the DAMAGE_INFO structure
 //
-PTR_INFO* THREADMANAGER::GetPointerInfo()
+DAMAGE_INFO* THREADMANAGER::GetDamageInfo()
 {
-    return &m_PtrInfo;
+    return &m_DamageInfo;
 }
 
 //
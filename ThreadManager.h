@@ -9,6 +9,7 @@
 #define _THREADMANAGER_H_
 
 #include "CommonTypes.h"
+#include "DevicePool.h"
 
 class THREADMANAGER
 {
@@ -16,15 +17,19 @@ class THREADMANAGER
         THREADMANAGER();
         ~THREADMANAGER();
         void Clean();
-        DUPL_RETURN Initialize(INT SingleOutput, UINT OutputCount, HANDLE UnexpectedErrorEvent, HANDLE ExpectedErrorEvent, HANDLE TerminateThreadsEvent, HANDLE SharedHandle, _In_ RECT* DesktopDim);
+        void SetOptions(_In_ const DUPLICATION_OPTIONS* Options);
+        DUPL_RETURN Initialize(INT SingleOutput, UINT OutputCount, HANDLE UnexpectedErrorEvent, HANDLE ExpectedErrorEvent, HANDLE TerminateThreadsEvent, HANDLE SharedHandle, DXGI_FORMAT CaptureFormat, LUID AdapterLuid, _In_ RECT* DesktopDim);
         PTR_INFO* GetPointerInfo();
+        PTR_POSITION* GetPointerPosition();
+        DAMAGE_INFO* GetDamageInfo();
         void WaitForThreadTermination();
 
     private:
-        DUPL_RETURN InitializeDx(_Out_ DX_RESOURCES* Data);
-        void CleanDx(_Inout_ DX_RESOURCES* Data);
-
+        DEVICEPOOL m_DevicePool;
         PTR_INFO m_PtrInfo;
+        PTR_POSITION m_PtrPosition;
+        DAMAGE_INFO m_DamageInfo;
+        DUPLICATION_OPTIONS m_Options;
         UINT m_ThreadCount;
         _Field_size_(m_ThreadCount) HANDLE* m_ThreadHandles;
         _Field_size_(m_ThreadCount) THREAD_DATA* m_ThreadData;
@@ -0,0 +1,253 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <string.h>
+
+#include "TileCodec.h"
+
+// Limits of the LZ4 block format
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+
+// Misses before the match finder starts skipping ahead, incompressible data is then got through quickly
+#define LZ4_SKIP_TRIGGER 6
+
+static inline uint32_t Read32(const BYTE* Ptr)
+{
+    uint32_t Value;
+    memcpy(&Value, Ptr, sizeof(Value));
+    return Value;
+}
+
+static inline UINT HashSequence(uint32_t Sequence)
+{
+    return (Sequence * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+//
+// Extra bytes of a literal or match length past what fits in the token
+//
+static bool WriteLength(BYTE** Out, const BYTE* OutEnd, UINT Length)
+{
+    while (Length >= 255)
+    {
+        if (*Out >= OutEnd)
+        {
+            return false;
+        }
+        *(*Out)++ = 255;
+        Length -= 255;
+    }
+    if (*Out >= OutEnd)
+    {
+        return false;
+    }
+    *(*Out)++ = static_cast<BYTE>(Length);
+    return true;
+}
+
+static bool ReadLength(const BYTE** In, const BYTE* InEnd, UINT* Length)
+{
+    BYTE Byte;
+    do
+    {
+        if (*In >= InEnd)
+        {
+            return false;
+        }
+        Byte = *(*In)++;
+        *Length += Byte;
+    } while (Byte == 255);
+    return true;
+}
+
+//
+// One sequence: literals, then a match unless MatchLength is 0 (the last sequence of a block)
+//
+static bool WriteSequence(BYTE** Out, const BYTE* OutEnd, const BYTE* Literals, UINT LiteralLength, UINT Offset, UINT MatchLength)
+{
+    if (*Out >= OutEnd)
+    {
+        return false;
+    }
+    BYTE* Token = (*Out)++;
+
+    *Token = static_cast<BYTE>(((LiteralLength < 15) ? LiteralLength : 15) << 4);
+    if (LiteralLength >= 15 && !WriteLength(Out, OutEnd, LiteralLength - 15))
+    {
+        return false;
+    }
+    if (static_cast<size_t>(OutEnd - *Out) < LiteralLength)
+    {
+        return false;
+    }
+    memcpy(*Out, Literals, LiteralLength);
+    *Out += LiteralLength;
+
+    if (!MatchLength)
+    {
+        return true;
+    }
+
+    if (OutEnd - *Out < 2)
+    {
+        return false;
+    }
+    *(*Out)++ = static_cast<BYTE>(Offset & 0xFF);
+    *(*Out)++ = static_cast<BYTE>(Offset >> 8);
+
+    UINT Length = MatchLength - LZ4_MIN_MATCH;
+    *Token |= static_cast<BYTE>((Length < 15) ? Length : 15);
+    return (Length < 15) || WriteLength(Out, OutEnd, Length - 15);
+}
+
+LZ4TILECODEC::LZ4TILECODEC()
+{
+    memset(m_Table, 0, sizeof(m_Table));
+}
+
+TILE_CODEC LZ4TILECODEC::GetId()
+{
+    return TILE_CODEC_LZ4;
+}
+
+//
+// Incompressible input grows by one byte every 255 literals plus the token
+//
+UINT LZ4TILECODEC::GetMaxEncodedSize(UINT Width, UINT Height)
+{
+    UINT Size = Width * Height * 4;
+    return Size + Size / 255 + 16;
+}
+
+UINT LZ4TILECODEC::Encode(const BYTE* Pixels, UINT Width, UINT Height, BYTE* Dst, UINT DstCapacity)
+{
+    UINT Size = Width * Height * 4;
+    if (Size > LZ4_MAX_INPUT_SIZE)
+    {
+        return 0;
+    }
+
+    BYTE* Out = Dst;
+    const BYTE* OutEnd = Dst + DstCapacity;
+    UINT Anchor = 0;
+
+    // Positions from the previous region only cost a failed compare, the table is not cleared
+    if (Size > LZ4_MATCH_LIMIT)
+    {
+        UINT Limit = Size - LZ4_MATCH_LIMIT;
+        UINT MatchEnd = Size - LZ4_LAST_LITERALS;
+        UINT Position = 0;
+        UINT Misses = 0;
+        while (Position < Limit)
+        {
+            uint32_t Sequence = Read32(Pixels + Position);
+            UINT Hash = HashSequence(Sequence);
+            UINT Reference = m_Table[Hash];
+            m_Table[Hash] = static_cast<uint16_t>(Position);
+
+            if (Reference >= Position || Position - Reference > LZ4_MAX_OFFSET || Read32(Pixels + Reference) != Sequence)
+            {
+                Position += 1 + (Misses++ >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+
+            UINT Length = LZ4_MIN_MATCH;
+            while (Position + Length < MatchEnd && Pixels[Reference + Length] == Pixels[Position + Length])
+            {
+                ++Length;
+            }
+
+            if (!WriteSequence(&Out, OutEnd, Pixels + Anchor, Position - Anchor, Position - Reference, Length))
+            {
+                return 0;
+            }
+            Position += Length;
+            Anchor = Position;
+            Misses = 0;
+        }
+    }
+
+    if (!WriteSequence(&Out, OutEnd, Pixels + Anchor, Size - Anchor, 0, 0))
+    {
+        return 0;
+    }
+    return static_cast<UINT>(Out - Dst);
+}
+
+bool LZ4TILECODEC::Decode(const BYTE* Src, UINT Size, UINT Width, UINT Height, BYTE* Pixels)
+{
+    const BYTE* In = Src;
+    const BYTE* InEnd = Src + Size;
+    BYTE* Out = Pixels;
+    BYTE* OutEnd = Pixels + static_cast<size_t>(Width) * Height * 4;
+
+    while (In < InEnd)
+    {
+        BYTE Token = *In++;
+
+        UINT LiteralLength = Token >> 4;
+        if (LiteralLength == 15 && !ReadLength(&In, InEnd, &LiteralLength))
+        {
+            return false;
+        }
+        if (static_cast<size_t>(InEnd - In) < LiteralLength || static_cast<size_t>(OutEnd - Out) < LiteralLength)
+        {
+            return false;
+        }
+        memcpy(Out, In, LiteralLength);
+        In += LiteralLength;
+        Out += LiteralLength;
+
+        // The last sequence has no match
+        if (In == InEnd)
+        {
+            break;
+        }
+
+        if (InEnd - In < 2)
+        {
+            return false;
+        }
+        UINT Offset = In[0] | (In[1] << 8);
+        In += 2;
+        if (!Offset || Offset > static_cast<size_t>(Out - Pixels))
+        {
+            return false;
+        }
+
+        UINT MatchLength = Token & 15;
+        if (MatchLength == 15 && !ReadLength(&In, InEnd, &MatchLength))
+        {
+            return false;
+        }
+        MatchLength += LZ4_MIN_MATCH;
+        if (static_cast<size_t>(OutEnd - Out) < MatchLength)
+        {
+            return false;
+        }
+
+        // Matches can overlap what they write, runs of one pixel come out with an offset of 4
+        const BYTE* Match = Out - Offset;
+        if (Offset >= MatchLength)
+        {
+            memcpy(Out, Match, MatchLength);
+        }
+        else
+        {
+            for (UINT i = 0; i < MatchLength; ++i)
+            {
+                Out[i] = Match[i];
+            }
+        }
+        Out += MatchLength;
+    }
+
+    return Out == OutEnd;
+}
@@ -0,0 +1,64 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _TILECODEC_H_
+#define _TILECODEC_H_
+
+#include "Platform.h"
+
+//
+// Codec of a region in the stream, as sent on the wire
+//
+typedef enum _TILE_CODEC
+{
+    TILE_CODEC_RAW = 0,
+    TILE_CODEC_LZ4 = 1,
+    TILE_CODEC_VIDEO = 2,
+} TILE_CODEC;
+
+// Largest region the LZ4 codec takes, match positions are kept in 16 bits
+#define LZ4_MAX_INPUT_SIZE 65536
+
+// Entries in the LZ4 match finder's hash table
+#define LZ4_HASH_LOG 12
+
+//
+// Compresses the 32 bit BGRA pixels of a region of the frame for the stream.
+// Tile codecs get each changed tile on its own. Full frame codecs (a video encoder plugs in here)
+// get the whole frame every time something changed and can keep state from one frame to the next.
+//
+class TILECODEC
+{
+    public:
+        virtual ~TILECODEC() {}
+        virtual TILE_CODEC GetId() = 0;
+        virtual bool IsFullFrame() { return false; }
+        virtual UINT GetMaxEncodedSize(UINT Width, UINT Height) = 0;
+
+        // Pixels are packed, Width * 4 bytes per row. Encode returns the size written to Dst, 0 when the
+        // region could not be coded in DstCapacity. Decode fails on anything but exactly one region.
+        virtual UINT Encode(const BYTE* Pixels, UINT Width, UINT Height, BYTE* Dst, UINT DstCapacity) = 0;
+        virtual bool Decode(const BYTE* Src, UINT Size, UINT Width, UINT Height, BYTE* Pixels) = 0;
+};
+
+//
+// LZ4 block format, greedy single probe match finder. The blocks decode with any LZ4 implementation.
+//
+class LZ4TILECODEC : public TILECODEC
+{
+    public:
+        LZ4TILECODEC();
+        TILE_CODEC GetId() override;
+        UINT GetMaxEncodedSize(UINT Width, UINT Height) override;
+        UINT Encode(const BYTE* Pixels, UINT Width, UINT Height, BYTE* Dst, UINT DstCapacity) override;
+        bool Decode(const BYTE* Src, UINT Size, UINT Width, UINT Height, BYTE* Pixels) override;
+
+    private:
+        uint16_t m_Table[1 << LZ4_HASH_LOG];
+};
+
+#endif
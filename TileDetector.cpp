@@ -0,0 +1,368 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include <new>
+#include <string.h>
+
+#include "TileDetector.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TILE_HASH_SSE2
+#include <emmintrin.h>
+#endif
+
+//
+// Fold the running sums of a tile into one value
+//
+static uint64_t FinishHash(const uint64_t* Sums, UINT Count)
+{
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    for (UINT i = 0; i < Count; ++i)
+    {
+        Hash = (Hash ^ Sums[i]) * 0x100000001b3ull;
+    }
+    return Hash;
+}
+
+//
+// Key added to each pixel of a tile row before pixels are multiplied in pairs. Sums of raw pixels are linear, so
+// changes that cancel out (+d, -d, -d, +d along a row, as anti-aliased text and dithering do) would leave them as
+// they were, products of keyed pairs do not. A factor is only ever zero for a pixel whose alpha is neither 0 nor
+// 255, the top byte of every key word is kept away from both.
+//
+class TILEHASHKEY
+{
+    public:
+        TILEHASHKEY()
+        {
+            uint64_t State = 0x9e3779b97f4a7c15ull;
+            for (UINT i = 0; i < TILE_SIZE; ++i)
+            {
+                State += 0x9e3779b97f4a7c15ull;
+                uint64_t Z = State;
+                Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                Z = (Z ^ (Z >> 27)) * 0x94d049bb133111ebull;
+                Z ^= Z >> 31;
+                Words[i] = (static_cast<UINT>(Z) & 0x00FFFFFFu) | ((2 + static_cast<UINT>(Z >> 32) % 0xFC) << 24);
+            }
+        }
+
+        UINT Words[TILE_SIZE];
+};
+
+static const TILEHASHKEY HashKey;
+
+//
+// NH style hash over the tile: each row sums the products of its keyed pixels taken in pairs, 4 pixels at a time
+// so one SSE2 multiply does two pairs. Then A adds up the rows and B adds up A, so the row of a change matters too.
+// One multiply per two pixels keeps hashing a frame close to the cost of reading it, which it has to beat to be
+// worth doing on the CPU. Rows narrower than a multiple of 4 pixels are padded with zeros.
+//
+static uint64_t HashTile(const BYTE* Bits, UINT Pitch, UINT Width, UINT Height)
+{
+    uint64_t Sums[4];
+    UINT Whole = Width & ~3u;
+    UINT Tail = Width - Whole;
+
+#ifdef TILE_HASH_SSE2
+    __m128i A = _mm_setzero_si128();
+    __m128i B = _mm_setzero_si128();
+    for (UINT Y = 0; Y < Height; ++Y)
+    {
+        const BYTE* Row = Bits + static_cast<size_t>(Y) * Pitch;
+        __m128i RowSum = _mm_setzero_si128();
+        for (UINT X = 0; X < Whole; X += 4)
+        {
+            __m128i Keyed = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Row + X * 4)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(HashKey.Words + X)));
+            RowSum = _mm_add_epi64(RowSum, _mm_mul_epu32(Keyed, _mm_srli_epi64(Keyed, 32)));
+        }
+        if (Tail)
+        {
+            UINT Padded[4] = {0, 0, 0, 0};
+            memcpy(Padded, Row + Whole * 4, Tail * 4);
+            __m128i Keyed = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Padded)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(HashKey.Words + Whole)));
+            RowSum = _mm_add_epi64(RowSum, _mm_mul_epu32(Keyed, _mm_srli_epi64(Keyed, 32)));
+        }
+        A = _mm_add_epi64(A, RowSum);
+        B = _mm_add_epi64(B, A);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(Sums), A);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(Sums + 2), B);
+#else
+    uint64_t* A = Sums;
+    uint64_t* B = Sums + 2;
+    memset(Sums, 0, sizeof(Sums));
+    for (UINT Y = 0; Y < Height; ++Y)
+    {
+        const BYTE* Row = Bits + static_cast<size_t>(Y) * Pitch;
+        uint64_t RowSum[2] = {0, 0};
+        for (UINT X = 0; X < Whole + (Tail ? 4 : 0); X += 4)
+        {
+            UINT Pixels[4] = {0, 0, 0, 0};
+            memcpy(Pixels, Row + X * 4, ((X < Whole) ? 4 : Tail) * 4);
+            for (UINT Pair = 0; Pair < 2; ++Pair)
+            {
+                UINT First = Pixels[Pair * 2] + HashKey.Words[X + Pair * 2];
+                UINT Second = Pixels[Pair * 2 + 1] + HashKey.Words[X + Pair * 2 + 1];
+                RowSum[Pair] += static_cast<uint64_t>(First) * Second;
+            }
+        }
+        for (UINT Pair = 0; Pair < 2; ++Pair)
+        {
+            A[Pair] += RowSum[Pair];
+            B[Pair] += A[Pair];
+        }
+    }
+#endif
+
+    return FinishHash(Sums, 4);
+}
+
+TILEDETECTOR::TILEDETECTOR() : m_Width(0),
+                               m_Height(0),
+                               m_Columns(0),
+                               m_Rows(0),
+                               m_Current(0),
+                               m_PreviousValid(false),
+                               m_BusyFrames(0),
+                               m_Cooldown(0)
+{
+    m_Hashes[0] = nullptr;
+    m_Hashes[1] = nullptr;
+}
+
+TILEDETECTOR::~TILEDETECTOR()
+{
+    Clean();
+}
+
+//
+// Size the hash tables for a frame of the given dimensions
+//
+bool TILEDETECTOR::Initialize(UINT Width, UINT Height)
+{
+    Clean();
+
+    m_Width = Width;
+    m_Height = Height;
+    m_Columns = (Width + TILE_SIZE - 1) / TILE_SIZE;
+    m_Rows = (Height + TILE_SIZE - 1) / TILE_SIZE;
+
+    size_t TileCount = static_cast<size_t>(m_Columns) * m_Rows;
+    m_Hashes[0] = new (std::nothrow) uint64_t[TileCount];
+    m_Hashes[1] = new (std::nothrow) uint64_t[TileCount];
+    if (!m_Hashes[0] || !m_Hashes[1])
+    {
+        Clean();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Whether the next frame should be hashed, counts down while detection is switched off
+//
+bool TILEDETECTOR::ShouldDetect()
+{
+    if (m_Cooldown)
+    {
+        m_Cooldown--;
+        return false;
+    }
+
+    return m_Hashes[0] != nullptr;
+}
+
+//
+// The frame changed without being hashed (e.g. regular dirty rects), the previous hashes are stale
+//
+void TILEDETECTOR::Invalidate()
+{
+    m_PreviousValid = false;
+}
+
+//
+// Table the hashes of the current frame go in, one per tile in row major order
+//
+uint64_t* TILEDETECTOR::GetHashes()
+{
+    return m_Hashes[m_Current];
+}
+
+//
+// Hash every tile of a 32 bit frame in system memory
+//
+void TILEDETECTOR::HashTiles(const BYTE* Bits, UINT Pitch)
+{
+    uint64_t* Hashes = m_Hashes[m_Current];
+    for (UINT Row = 0; Row < m_Rows; ++Row)
+    {
+        UINT Top = Row * TILE_SIZE;
+        UINT Height = ((m_Height - Top) < TILE_SIZE) ? (m_Height - Top) : TILE_SIZE;
+        for (UINT Column = 0; Column < m_Columns; ++Column)
+        {
+            UINT Left = Column * TILE_SIZE;
+            UINT Width = ((m_Width - Left) < TILE_SIZE) ? (m_Width - Left) : TILE_SIZE;
+            Hashes[Row * m_Columns + Column] = HashTile(Bits + static_cast<size_t>(Top) * Pitch + Left * 4, Pitch, Width, Height);
+        }
+    }
+}
+
+//
+// Compare the current hashes with the previous frame and write the changed regions to Rects.
+// Returns false when the caller should keep the full frame update: nothing to compare against yet,
+// most of the frame changed, or the changes are too scattered to fit in MaxRects.
+//
+bool TILEDETECTOR::BuildDirtyRects(RECT* Rects, UINT MaxRects, UINT* RectCount)
+{
+    *RectCount = 0;
+
+    if (!m_PreviousValid)
+    {
+        m_PreviousValid = true;
+        SwapHashes();
+        return false;
+    }
+
+    const uint64_t* Current = m_Hashes[m_Current];
+    const uint64_t* Previous = m_Hashes[m_Current ^ 1];
+    UINT TileCount = m_Columns * m_Rows;
+
+    UINT Changed = 0;
+    for (UINT i = 0; i < TileCount; ++i)
+    {
+        Changed += (Current[i] != Previous[i]) ? 1 : 0;
+    }
+
+    // Most of the frame changed, the full update is what we need anyway
+    if (Changed * 4 >= TileCount * 3)
+    {
+        if (++m_BusyFrames >= TILE_BUSY_FRAMES)
+        {
+            m_BusyFrames = 0;
+            m_Cooldown = TILE_COOLDOWN_FRAMES;
+            m_PreviousValid = false;
+        }
+        SwapHashes();
+        return false;
+    }
+    m_BusyFrames = 0;
+
+    // Merge runs of changed tiles on a row, then runs spanning the same columns on consecutive rows
+    UINT Count = 0;
+    for (UINT Row = 0; Row < m_Rows; ++Row)
+    {
+        LONG Top = static_cast<LONG>(Row * TILE_SIZE);
+        LONG Bottom = static_cast<LONG>(((Row + 1) * TILE_SIZE < m_Height) ? (Row + 1) * TILE_SIZE : m_Height);
+
+        UINT Column = 0;
+        while (Column < m_Columns)
+        {
+            if (Current[Row * m_Columns + Column] == Previous[Row * m_Columns + Column])
+            {
+                ++Column;
+                continue;
+            }
+
+            UINT Start = Column;
+            while (Column < m_Columns && Current[Row * m_Columns + Column] != Previous[Row * m_Columns + Column])
+            {
+                ++Column;
+            }
+
+            LONG Left = static_cast<LONG>(Start * TILE_SIZE);
+            LONG Right = static_cast<LONG>((Column * TILE_SIZE < m_Width) ? Column * TILE_SIZE : m_Width);
+
+            bool Merged = false;
+            for (UINT i = 0; i < Count; ++i)
+            {
+                if (Rects[i].bottom == Top && Rects[i].left == Left && Rects[i].right == Right)
+                {
+                    Rects[i].bottom = Bottom;
+                    Merged = true;
+                    break;
+                }
+            }
+
+            if (!Merged)
+            {
+                if (Count == MaxRects)
+                {
+                    SwapHashes();
+                    return false;
+                }
+                Rects[Count].left = Left;
+                Rects[Count].top = Top;
+                Rects[Count].right = Right;
+                Rects[Count].bottom = Bottom;
+                ++Count;
+            }
+        }
+    }
+
+    *RectCount = Count;
+    SwapHashes();
+    return true;
+}
+
+UINT TILEDETECTOR::GetWidth()
+{
+    return m_Width;
+}
+
+UINT TILEDETECTOR::GetHeight()
+{
+    return m_Height;
+}
+
+UINT TILEDETECTOR::GetColumns()
+{
+    return m_Columns;
+}
+
+UINT TILEDETECTOR::GetRows()
+{
+    return m_Rows;
+}
+
+//
+// False while detection switched itself off
+//
+bool TILEDETECTOR::IsEnabled()
+{
+    return m_Cooldown == 0;
+}
+
+void TILEDETECTOR::Clean()
+{
+    for (UINT i = 0; i < 2; ++i)
+    {
+        if (m_Hashes[i])
+        {
+            delete [] m_Hashes[i];
+            m_Hashes[i] = nullptr;
+        }
+    }
+
+    m_Width = 0;
+    m_Height = 0;
+    m_Columns = 0;
+    m_Rows = 0;
+    m_Current = 0;
+    m_PreviousValid = false;
+    m_BusyFrames = 0;
+    m_Cooldown = 0;
+}
+
+//
+// The current hashes become the previous ones
+//
+void TILEDETECTOR::SwapHashes()
+{
+    m_Current ^= 1;
+}
@@ -0,0 +1,68 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _TILEDETECTOR_H_
+#define _TILEDETECTOR_H_
+
+#include "Platform.h"
+
+// Edge of the square tiles the frame is hashed in, must match TileHash.hlsl
+#define TILE_SIZE 64
+
+// Most dirty rects we emit, past this the change is not worth splitting up
+#define TILE_MAX_RECTS 64
+
+// Consecutive frames with most tiles changed before detection switches itself off
+#define TILE_BUSY_FRAMES 8
+
+// Frames detection stays off before probing again
+#define TILE_COOLDOWN_FRAMES 240
+
+//
+// Recovers the regions that really changed when DXGI reports the whole output as dirty.
+// The frame is split in TILE_SIZE tiles, each tile is hashed (on the GPU by TileHash.hlsl, or on the CPU by
+// HashTiles) and compared with its hash in the previous frame. Changed tiles are merged into rects.
+// When most tiles change every frame the hashing is wasted work, so detection turns itself off for a while.
+//
+class TILEDETECTOR
+{
+    public:
+        TILEDETECTOR();
+        ~TILEDETECTOR();
+        bool Initialize(UINT Width, UINT Height);
+        bool ShouldDetect();
+        void Invalidate();
+        uint64_t* GetHashes();
+        void HashTiles(const BYTE* Bits, UINT Pitch);
+        bool BuildDirtyRects(RECT* Rects, UINT MaxRects, UINT* RectCount);
+        UINT GetWidth();
+        UINT GetHeight();
+        UINT GetColumns();
+        UINT GetRows();
+        bool IsEnabled();
+        void Clean();
+
+    private:
+    // methods
+        void SwapHashes();
+
+    // variables
+        UINT m_Width;
+        UINT m_Height;
+        UINT m_Columns;
+        UINT m_Rows;
+
+        // Hashes of the frame being processed and of the previous one
+        uint64_t* m_Hashes[2];
+        UINT m_Current;
+        bool m_PreviousValid;
+
+        UINT m_BusyFrames;
+        UINT m_Cooldown;
+};
+
+#endif
@@ -0,0 +1,76 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+//----------------------------------------------------------------------
+
+// Must match TILE_SIZE in TileDetector.h
+#define TILE_SIZE 64
+
+Texture2D<float4> Frame : register( t0 );
+RWStructuredBuffer<uint2> TileHashes : register( u0 );
+
+groupshared uint2 RowSums[TILE_SIZE];
+
+//--------------------------------------------------------------------------------------
+// Scramble each word before it is summed, so that changes cancelling out in both sums still
+// change the hash. The CPU multiplies keyed pairs of pixels instead (HashTile in TileDetector.cpp),
+// a multiply per pixel is cheap here but not there. GPU and CPU hashes are never compared.
+//--------------------------------------------------------------------------------------
+uint MixTexel(uint X)
+{
+    X ^= X >> 16;
+    X *= 0x7feb352d;
+    X ^= X >> 15;
+    X *= 0x846ca68b;
+    X ^= X >> 16;
+    return X;
+}
+
+//--------------------------------------------------------------------------------------
+// Compute Shader: one group per tile, one thread per row of the tile. Each row gets Fletcher
+// style sums of its mixed pixels, then the rows are folded in order into the tile hash.
+//--------------------------------------------------------------------------------------
+[numthreads(TILE_SIZE, 1, 1)]
+void CS(uint3 GroupId : SV_GroupID, uint3 ThreadId : SV_GroupThreadID)
+{
+    uint Width, Height;
+    Frame.GetDimensions(Width, Height);
+
+    uint Left = GroupId.x * TILE_SIZE;
+    uint Y = GroupId.y * TILE_SIZE + ThreadId.x;
+
+    uint A = 0;
+    uint B = 0;
+    if (Y < Height)
+    {
+        uint Right = min(Left + TILE_SIZE, Width);
+        for (uint X = Left; X < Right; ++X)
+        {
+            // Half float bits tell apart every 8 bit value and keep FP16 highlights above 1.0
+            uint4 Bits = f32tof16(Frame.Load(int3(X, Y, 0)));
+            A += MixTexel(Bits.r | (Bits.g << 16));
+            B += A;
+            A += MixTexel(Bits.b | (Bits.a << 16));
+            B += A;
+        }
+    }
+    RowSums[ThreadId.x] = uint2(A, B);
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (ThreadId.x == 0)
+    {
+        uint2 Hash = uint2(0x811c9dc5, 0x01000193);
+        for (uint Row = 0; Row < TILE_SIZE; ++Row)
+        {
+            Hash.x = (Hash.x ^ RowSums[Row].x) * 0x01000193;
+            Hash.y = (Hash.y ^ RowSums[Row].y) * 0x01000193 + Hash.x;
+        }
+
+        uint Columns = (Width + TILE_SIZE - 1) / TILE_SIZE;
+        TileHashes[GroupId.y * Columns + GroupId.x] = Hash;
+    }
+}
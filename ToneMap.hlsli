@@ -0,0 +1,36 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+//----------------------------------------------------------------------
+
+// Where the shoulder of the tone curve starts, below it SDR content is left alone
+#define TONEMAP_KNEE 0.8f
+
+// Must match PRESENT_CONSTANTS in OutputManager.h
+cbuffer PresentConstants : register( b0 )
+{
+    uint Filter;
+    uint ToneMap;
+    float WhiteScale;
+};
+
+//--------------------------------------------------------------------------------------
+// Bring linear scRGB (1.0 is 80 nits) to the SDR range of the headset: SDR white goes to 1.0, colors
+// outside of the sRGB gamut are clipped and highlights roll off towards 1.0 keeping their hue.
+// The render target is sRGB so the result stays linear.
+//--------------------------------------------------------------------------------------
+float4 ToneMapColor(float4 Color)
+{
+    float3 Linear = max(Color.rgb * WhiteScale, 0);
+    float Peak = max(Linear.r, max(Linear.g, Linear.b));
+    if (Peak > TONEMAP_KNEE)
+    {
+        float Over = Peak - TONEMAP_KNEE;
+        float Mapped = TONEMAP_KNEE + (1 - TONEMAP_KNEE) * Over / (Over + (1 - TONEMAP_KNEE));
+        Linear *= Mapped / Peak;
+    }
+    return float4(Linear, Color.a);
+}
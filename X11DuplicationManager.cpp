@@ -0,0 +1,659 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#include "X11DuplicationManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+
+struct X11_SHM
+{
+    XShmSegmentInfo Info;
+    bool Attached;
+};
+
+// Protocol errors are noted here instead of ending the process, as Xlib does by default. The server reports
+// them asynchronously, on a screen resize for one, so they are checked for after the requests that may fail.
+static bool X11ErrorSeen = false;
+static XErrorHandler PreviousErrorHandler = nullptr;
+
+static int CatchX11Error(Display*, XErrorEvent*)
+{
+    X11ErrorSeen = true;
+    return 0;
+}
+
+static uint64_t GetTimeNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//
+// The counterpart of ProcessFailure, expected errors are the ones a new InitDupl gets past
+//
+static DUPL_RETURN ReportFailure(const char* Message, DUPL_RETURN Ret)
+{
+    fprintf(stderr, "X11DUPLICATIONMANAGER: %s\n", Message);
+    return Ret;
+}
+
+//
+// Constructor sets up references / variables
+//
+X11DUPLICATIONMANAGER::X11DUPLICATIONMANAGER() : m_Display(nullptr),
+                                                 m_Root(0),
+                                                 m_Damage(0),
+                                                 m_Region(0),
+                                                 m_DamageEventBase(0),
+                                                 m_FixesEventBase(0),
+                                                 m_OutputNumber(0),
+                                                 m_Image(nullptr),
+                                                 m_Shm(nullptr),
+                                                 m_FrameAcquired(false),
+                                                 m_Damaged(false),
+                                                 m_FullDamage(false),
+                                                 m_ShapeChanged(false),
+                                                 m_Shape(nullptr),
+                                                 m_ShapeSize(0),
+                                                 m_ShapeCapacity(0),
+                                                 m_ShapePending(false),
+                                                 m_PointerVisible(false),
+                                                 m_PointerMoved(false)
+{
+    memset(&m_Frame, 0, sizeof(m_Frame));
+    memset(&m_ShapeInfo, 0, sizeof(m_ShapeInfo));
+    m_HotSpot.x = 0;
+    m_HotSpot.y = 0;
+}
+
+X11DUPLICATIONMANAGER::~X11DUPLICATIONMANAGER()
+{
+    Clean();
+}
+
+//
+// Connect to the X server named DisplayName, or the one in $DISPLAY when nullptr, and start duplicating its
+// default screen
+//
+DUPL_RETURN X11DUPLICATIONMANAGER::InitDupl(const char* DisplayName)
+{
+    Clean();
+
+    m_Display = XOpenDisplay(DisplayName);
+    if (!m_Display)
+    {
+        return ReportFailure("Failed to open the display", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+    PreviousErrorHandler = XSetErrorHandler(CatchX11Error);
+    X11ErrorSeen = false;
+
+    // Regions and cursor notifications need XFixes 2
+    int ErrorBase;
+    int FixesMajor = 0;
+    int FixesMinor = 0;
+    int DamageMajor = 0;
+    int DamageMinor = 0;
+    if (!XShmQueryExtension(m_Display) ||
+        !XDamageQueryExtension(m_Display, &m_DamageEventBase, &ErrorBase) || !XDamageQueryVersion(m_Display, &DamageMajor, &DamageMinor) ||
+        !XFixesQueryExtension(m_Display, &m_FixesEventBase, &ErrorBase) || !XFixesQueryVersion(m_Display, &FixesMajor, &FixesMinor) || FixesMajor < 2)
+    {
+        Clean();
+        return ReportFailure("The display lacks XShm, XDamage or XFixes 2", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+
+    m_OutputNumber = DefaultScreen(m_Display);
+    m_Root = RootWindow(m_Display, m_OutputNumber);
+    if (!CreateImage())
+    {
+        Clean();
+        return ReportFailure("Failed to share an image of the screen with the display, it must be local and 32 bits per pixel", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+
+    // One notification each time the damage goes from empty to not, it is emptied by taking it. A new screen
+    // size shows up as the root window changing.
+    m_Damage = XDamageCreate(m_Display, m_Root, XDamageReportNonEmpty);
+    m_Region = XFixesCreateRegion(m_Display, nullptr, 0);
+    XFixesSelectCursorInput(m_Display, m_Root, XFixesDisplayCursorNotifyMask);
+    XSelectInput(m_Display, m_Root, StructureNotifyMask);
+    XSync(m_Display, False);
+    if (X11ErrorSeen)
+    {
+        Clean();
+        return ReportFailure("Failed to start tracking damage", DUPL_RETURN_ERROR_EXPECTED);
+    }
+
+    m_Damaged = true;
+    m_FullDamage = true;
+    m_ShapeChanged = true;
+    m_PointerMoved = true;
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Shared memory image of the whole screen for the server to copy damaged rows into
+//
+bool X11DUPLICATIONMANAGER::CreateImage()
+{
+    m_Shm = new (std::nothrow) X11_SHM;
+    if (!m_Shm)
+    {
+        return false;
+    }
+    memset(&m_Shm->Info, 0, sizeof(m_Shm->Info));
+    m_Shm->Info.shmid = -1;
+    m_Shm->Attached = false;
+
+    UINT Width = DisplayWidth(m_Display, m_OutputNumber);
+    UINT Height = DisplayHeight(m_Display, m_OutputNumber);
+    m_Image = XShmCreateImage(m_Display, DefaultVisual(m_Display, m_OutputNumber), DefaultDepth(m_Display, m_OutputNumber), ZPixmap, nullptr, &m_Shm->Info, Width, Height);
+    if (!m_Image || m_Image->bits_per_pixel != 32)
+    {
+        return false;
+    }
+
+    m_Shm->Info.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(m_Image->bytes_per_line) * m_Image->height, IPC_CREAT | 0600);
+    if (m_Shm->Info.shmid < 0)
+    {
+        return false;
+    }
+    m_Shm->Info.shmaddr = static_cast<char*>(shmat(m_Shm->Info.shmid, nullptr, 0));
+    if (m_Shm->Info.shmaddr == reinterpret_cast<char*>(-1))
+    {
+        m_Shm->Info.shmaddr = nullptr;
+        shmctl(m_Shm->Info.shmid, IPC_RMID, nullptr);
+        return false;
+    }
+    m_Image->data = m_Shm->Info.shmaddr;
+    m_Shm->Info.readOnly = False;
+
+    // Attaching fails on a server on another machine
+    XShmAttach(m_Display, &m_Shm->Info);
+    XSync(m_Display, False);
+
+    // The segment goes away once both sides let go of it
+    shmctl(m_Shm->Info.shmid, IPC_RMID, nullptr);
+    m_Shm->Attached = !X11ErrorSeen;
+    if (!m_Shm->Attached)
+    {
+        return false;
+    }
+
+    m_Frame.Bits = reinterpret_cast<BYTE*>(m_Image->data);
+    m_Frame.Width = Width;
+    m_Frame.Height = Height;
+    m_Frame.Pitch = m_Image->bytes_per_line;
+    return true;
+}
+
+//
+// Note what the server reported since last time
+//
+void X11DUPLICATIONMANAGER::ProcessEvents()
+{
+    while (XPending(m_Display))
+    {
+        XEvent Event;
+        XNextEvent(m_Display, &Event);
+        if (Event.type == m_DamageEventBase + XDamageNotify)
+        {
+            m_Damaged = true;
+        }
+        else if (Event.type == m_FixesEventBase + XFixesCursorNotify)
+        {
+            m_ShapeChanged = true;
+        }
+        else if (Event.type == ConfigureNotify &&
+                 (static_cast<UINT>(Event.xconfigure.width) != m_Frame.Width || static_cast<UINT>(Event.xconfigure.height) != m_Frame.Height))
+        {
+            // Like DXGI on a mode change, the duplication has to be made again
+            X11ErrorSeen = true;
+        }
+    }
+}
+
+//
+// Note whether the pointer moved or left the screen since last time
+//
+void X11DUPLICATIONMANAGER::QueryPointer()
+{
+    Window RootReturn;
+    Window Child;
+    int RootX = 0;
+    int RootY = 0;
+    int WindowX;
+    int WindowY;
+    unsigned int Mask;
+    bool Visible = XQueryPointer(m_Display, m_Root, &RootReturn, &Child, &RootX, &RootY, &WindowX, &WindowY, &Mask) != False;
+    if (Visible != m_PointerVisible || (Visible && (RootX != m_HotSpot.x || RootY != m_HotSpot.y)))
+    {
+        m_PointerVisible = Visible;
+        if (Visible)
+        {
+            m_HotSpot.x = RootX;
+            m_HotSpot.y = RootY;
+        }
+        m_PointerMoved = true;
+    }
+}
+
+//
+// Fetch the cursor image and convert it to the color shape DXGI would report. XFixes gives premultiplied ARGB in
+// the low 32 bits of each unsigned long, color shapes are blended with straight alpha.
+//
+DUPL_RETURN X11DUPLICATIONMANAGER::FetchCursorImage()
+{
+    XFixesCursorImage* Cursor = XFixesGetCursorImage(m_Display);
+    if (!Cursor)
+    {
+        return ReportFailure("Failed to get the cursor image", DUPL_RETURN_ERROR_EXPECTED);
+    }
+
+    UINT PixelCount = static_cast<UINT>(Cursor->width) * Cursor->height;
+    UINT Size = PixelCount * SOFTWARE_BPP;
+    if (Size > m_ShapeCapacity)
+    {
+        delete [] m_Shape;
+        m_ShapeCapacity = 0;
+        m_Shape = new (std::nothrow) BYTE[Size];
+        if (!m_Shape)
+        {
+            XFree(Cursor);
+            return ReportFailure("Failed to allocate memory for the cursor image", DUPL_RETURN_ERROR_UNEXPECTED);
+        }
+        m_ShapeCapacity = Size;
+    }
+
+    UINT* Shape32 = reinterpret_cast<UINT*>(m_Shape);
+    for (UINT i = 0; i < PixelCount; ++i)
+    {
+        UINT Pixel = static_cast<UINT>(Cursor->pixels[i]);
+        UINT Alpha = Pixel >> 24;
+        UINT Out = Alpha << 24;
+        if (Alpha)
+        {
+            for (UINT Shift = 0; Shift < 24; Shift += 8)
+            {
+                UINT Channel = ((Pixel >> Shift) & 0xFF) * 255 / Alpha;
+                Out |= std::min(Channel, 255u) << Shift;
+            }
+        }
+        Shape32[i] = Out;
+    }
+
+    // A new hot spot moves the corner of the shape even when the pointer stays put
+    if (m_ShapeInfo.HotSpot.x != Cursor->xhot || m_ShapeInfo.HotSpot.y != Cursor->yhot)
+    {
+        m_PointerMoved = true;
+    }
+
+    m_ShapeInfo.Type = DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR;
+    m_ShapeInfo.Width = Cursor->width;
+    m_ShapeInfo.Height = Cursor->height;
+    m_ShapeInfo.Pitch = Cursor->width * SOFTWARE_BPP;
+    m_ShapeInfo.HotSpot.x = Cursor->xhot;
+    m_ShapeInfo.HotSpot.y = Cursor->yhot;
+    m_ShapeSize = Size;
+    m_ShapePending = (Size != 0);
+
+    XFree(Cursor);
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Take the damage accumulated so far as dirty rects, placed in Arena, and have the server copy the rows they
+// span into the image. One band of rows is one request however many rects there are.
+//
+DUPL_RETURN X11DUPLICATIONMANAGER::FetchDamage(FRAME_DATA* Data, FRAMEARENA* Arena)
+{
+    XDamageSubtract(m_Display, m_Damage, None, m_Region);
+    int RegionCount = 0;
+    XRectangle* Rects = XFixesFetchRegion(m_Display, m_Region, &RegionCount);
+
+    UINT Count = m_FullDamage ? 1 : static_cast<UINT>(RegionCount);
+    RECT* Dirty = Arena->AllocArray<RECT>(std::max(Count, 1u));
+    if (!Dirty)
+    {
+        if (Rects)
+        {
+            XFree(Rects);
+        }
+        return ReportFailure("Failed to allocate memory for metadata", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+
+    UINT DirtyCount = 0;
+    if (m_FullDamage)
+    {
+        Dirty[DirtyCount++] = {0, 0, static_cast<LONG>(m_Frame.Width), static_cast<LONG>(m_Frame.Height)};
+    }
+    else
+    {
+        for (int i = 0; i < RegionCount; ++i)
+        {
+            RECT Rect = {std::max<LONG>(Rects[i].x, 0), std::max<LONG>(Rects[i].y, 0),
+                         std::min<LONG>(Rects[i].x + Rects[i].width, m_Frame.Width), std::min<LONG>(Rects[i].y + Rects[i].height, m_Frame.Height)};
+            if (Rect.right > Rect.left && Rect.bottom > Rect.top)
+            {
+                Dirty[DirtyCount++] = Rect;
+            }
+        }
+    }
+    if (Rects)
+    {
+        XFree(Rects);
+    }
+    m_FullDamage = false;
+
+    Data->MetaData = reinterpret_cast<BYTE*>(Dirty);
+    Data->DirtyCount = DirtyCount;
+    Data->FrameInfo.TotalMetadataBufferSize = DirtyCount * sizeof(RECT);
+    if (!DirtyCount)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+
+    LONG Top = Dirty[0].top;
+    LONG Bottom = Dirty[0].bottom;
+    for (UINT i = 1; i < DirtyCount; ++i)
+    {
+        Top = std::min(Top, Dirty[i].top);
+        Bottom = std::max(Bottom, Dirty[i].bottom);
+    }
+
+    // The request carries the offset of the image data into the segment, so a band of rows lands in place
+    char* Bits = m_Image->data;
+    int Height = m_Image->height;
+    m_Image->data = Bits + static_cast<size_t>(Top) * m_Image->bytes_per_line;
+    m_Image->height = Bottom - Top;
+    Bool Fetched = XShmGetImage(m_Display, m_Root, m_Image, 0, Top, AllPlanes);
+    m_Image->data = Bits;
+    m_Image->height = Height;
+    if (!Fetched || X11ErrorSeen)
+    {
+        return ReportFailure("Failed to get the damaged rows of the screen", DUPL_RETURN_ERROR_EXPECTED);
+    }
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Publish the pointer position of a frame
+//
+void X11DUPLICATIONMANAGER::UpdatePointerPosition(PTR_POSITION* PtrPosition, DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY)
+{
+    // A non-zero mouse update timestamp indicates that there is a mouse position update
+    if (FrameInfo->LastMouseUpdateTime.QuadPart == 0)
+    {
+        return;
+    }
+
+    AcquireSRWLockExclusive(&PtrPosition->Lock);
+
+    bool UpdatePosition = true;
+
+    // Make sure we don't update pointer position wrongly
+    // If pointer is invisible, make sure we did not get an update from another output that the last time that said pointer
+    // was visible, if so, don't set it to invisible or update.
+    if (!FrameInfo->PointerPosition.Visible && (PtrPosition->WhoUpdatedPositionLast != m_OutputNumber))
+    {
+        UpdatePosition = false;
+    }
+
+    // If two outputs both say they have a visible, only update if new update has newer timestamp
+    if (FrameInfo->PointerPosition.Visible && PtrPosition->Visible && (PtrPosition->WhoUpdatedPositionLast != m_OutputNumber) && (PtrPosition->LastTimeStamp.QuadPart > FrameInfo->LastMouseUpdateTime.QuadPart))
+    {
+        UpdatePosition = false;
+    }
+
+    // Update position
+    if (UpdatePosition)
+    {
+        PtrPosition->Position.x = FrameInfo->PointerPosition.Position.x - OffsetX;
+        PtrPosition->Position.y = FrameInfo->PointerPosition.Position.y - OffsetY;
+        PtrPosition->WhoUpdatedPositionLast = m_OutputNumber;
+        PtrPosition->LastTimeStamp = FrameInfo->LastMouseUpdateTime;
+        PtrPosition->Visible = FrameInfo->PointerPosition.Visible != 0;
+        if (PtrPosition->Visible)
+        {
+            AddPointerSample(&PtrPosition->History, FrameInfo->LastMouseUpdateTime.QuadPart, PtrPosition->Position.x, PtrPosition->Position.y);
+        }
+    }
+
+    ReleaseSRWLockExclusive(&PtrPosition->Lock);
+}
+
+//
+// Retrieves mouse info, the position into PtrPosition and a new shape into PtrInfo. The frame must still be held
+// when it has a new shape.
+//
+DUPL_RETURN X11DUPLICATIONMANAGER::GetMouse(PTR_INFO* PtrInfo, PTR_POSITION* PtrPosition, DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY)
+{
+    UpdatePointerPosition(PtrPosition, FrameInfo, OffsetX, OffsetY);
+
+    // No new shape
+    if (FrameInfo->PointerShapeBufferSize == 0)
+    {
+        return DUPL_RETURN_SUCCESS;
+    }
+    if (!m_FrameAcquired || !m_ShapePending || FrameInfo->PointerShapeBufferSize != m_ShapeSize)
+    {
+        return ReportFailure("The shape of a released frame was asked for", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+
+    // Old buffer too small, grow it well past the request so new shapes rarely reallocate it
+    if (FrameInfo->PointerShapeBufferSize > PtrInfo->BufferSize)
+    {
+        UINT NewSize = std::max({FrameInfo->PointerShapeBufferSize, PtrInfo->BufferSize * 2, static_cast<UINT>(PTR_SHAPE_MIN_BUFFER_SIZE)});
+        if (PtrInfo->PtrShapeBuffer)
+        {
+            delete [] PtrInfo->PtrShapeBuffer;
+            PtrInfo->PtrShapeBuffer = nullptr;
+        }
+        PtrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[NewSize];
+        if (!PtrInfo->PtrShapeBuffer)
+        {
+            PtrInfo->BufferSize = 0;
+            return ReportFailure("Failed to allocate memory for pointer shape", DUPL_RETURN_ERROR_UNEXPECTED);
+        }
+
+        // Update buffer size
+        PtrInfo->BufferSize = NewSize;
+    }
+
+    memcpy(PtrInfo->PtrShapeBuffer, m_Shape, m_ShapeSize);
+    PtrInfo->ShapeInfo = m_ShapeInfo;
+
+    // Let the presenter know it must pick up the new shape
+    PtrInfo->ShapeSerial++;
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Wait up to X11_FRAME_TIMEOUT_MS for the screen or the pointer to change and write what did into Data, the
+// metadata is placed in Arena. The previous frame must have been released with DoneWithFrame.
+//
+DUPL_RETURN X11DUPLICATIONMANAGER::GetFrame(FRAME_DATA* Data, FRAMEARENA* Arena, bool* Timeout)
+{
+    if (m_FrameAcquired)
+    {
+        return ReportFailure("A frame was acquired before the last was released", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+
+    uint64_t DeadlineNs = GetTimeNs() + X11_FRAME_TIMEOUT_MS * 1000000ull;
+    for (;;)
+    {
+        QueryPointer();
+        ProcessEvents();
+        if (X11ErrorSeen)
+        {
+            *Timeout = false;
+            return ReportFailure("The screen changed, duplication must start over", DUPL_RETURN_ERROR_EXPECTED);
+        }
+        if (m_Damaged || m_ShapeChanged || m_PointerMoved)
+        {
+            break;
+        }
+
+        uint64_t NowNs = GetTimeNs();
+        if (NowNs >= DeadlineNs)
+        {
+            *Timeout = true;
+            return DUPL_RETURN_SUCCESS;
+        }
+
+        // Woken by the next event, or in time to look at the pointer again
+        pollfd Connection = {ConnectionNumber(m_Display), POLLIN, 0};
+        uint64_t WaitMs = std::min<uint64_t>((DeadlineNs - NowNs + 999999) / 1000000, X11_POINTER_POLL_MS);
+        poll(&Connection, 1, static_cast<int>(WaitMs));
+    }
+    *Timeout = false;
+
+    DXGI_OUTDUPL_FRAME_INFO* FrameInfo = &Data->FrameInfo;
+    memset(FrameInfo, 0, sizeof(DXGI_OUTDUPL_FRAME_INFO));
+    Data->MetaData = nullptr;
+    Data->DirtyCount = 0;
+    Data->MoveCount = 0;
+    LONGLONG NowNs = static_cast<LONGLONG>(GetTimeNs());
+
+    if (m_ShapeChanged)
+    {
+        m_ShapeChanged = false;
+        DUPL_RETURN Ret = FetchCursorImage();
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            return Ret;
+        }
+    }
+
+    if (m_Damaged)
+    {
+        m_Damaged = false;
+        DUPL_RETURN Ret = FetchDamage(Data, Arena);
+        if (Ret != DUPL_RETURN_SUCCESS)
+        {
+            return Ret;
+        }
+        FrameInfo->LastPresentTime.QuadPart = NowNs;
+        FrameInfo->AccumulatedFrames = 1;
+    }
+
+    if (m_PointerMoved || m_ShapePending)
+    {
+        m_PointerMoved = false;
+        FrameInfo->LastMouseUpdateTime.QuadPart = NowNs;
+    }
+    FrameInfo->PointerPosition.Position.x = m_HotSpot.x - m_ShapeInfo.HotSpot.x;
+    FrameInfo->PointerPosition.Position.y = m_HotSpot.y - m_ShapeInfo.HotSpot.y;
+    FrameInfo->PointerPosition.Visible = m_PointerVisible;
+    FrameInfo->PointerShapeBufferSize = m_ShapePending ? m_ShapeSize : 0;
+
+    Data->Frame = &m_Frame;
+    m_FrameAcquired = true;
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Release frame, a new shape it reported can no longer be fetched
+//
+DUPL_RETURN X11DUPLICATIONMANAGER::DoneWithFrame()
+{
+    if (!m_FrameAcquired)
+    {
+        return ReportFailure("A frame was released without being acquired", DUPL_RETURN_ERROR_UNEXPECTED);
+    }
+
+    m_FrameAcquired = false;
+    m_ShapePending = false;
+
+    return DUPL_RETURN_SUCCESS;
+}
+
+//
+// Where the screen is on the desktop, at the origin as X has one screen per root window
+//
+void X11DUPLICATIONMANAGER::GetDesktopCoordinates(RECT* Coordinates)
+{
+    Coordinates->left = 0;
+    Coordinates->top = 0;
+    Coordinates->right = m_Frame.Width;
+    Coordinates->bottom = m_Frame.Height;
+}
+
+void X11DUPLICATIONMANAGER::Clean()
+{
+    if (m_Display)
+    {
+        if (m_Damage)
+        {
+            XDamageDestroy(m_Display, m_Damage);
+        }
+        if (m_Region)
+        {
+            XFixesDestroyRegion(m_Display, m_Region);
+        }
+        if (m_Shm && m_Shm->Attached)
+        {
+            XShmDetach(m_Display, &m_Shm->Info);
+        }
+        if (m_Image)
+        {
+            // The data is the segment, not Xlib's to free
+            m_Image->data = nullptr;
+            XDestroyImage(m_Image);
+        }
+        XCloseDisplay(m_Display);
+        XSetErrorHandler(PreviousErrorHandler);
+        PreviousErrorHandler = nullptr;
+    }
+
+    if (m_Shm)
+    {
+        if (m_Shm->Info.shmaddr)
+        {
+            shmdt(m_Shm->Info.shmaddr);
+        }
+        delete m_Shm;
+    }
+
+    if (m_Shape)
+    {
+        delete [] m_Shape;
+    }
+
+    m_Display = nullptr;
+    m_Root = 0;
+    m_Damage = 0;
+    m_Region = 0;
+    m_OutputNumber = 0;
+    m_Image = nullptr;
+    m_Shm = nullptr;
+    memset(&m_Frame, 0, sizeof(m_Frame));
+    m_FrameAcquired = false;
+    m_Damaged = false;
+    m_FullDamage = false;
+    m_ShapeChanged = false;
+    m_Shape = nullptr;
+    m_ShapeSize = 0;
+    m_ShapeCapacity = 0;
+    m_ShapePending = false;
+    memset(&m_ShapeInfo, 0, sizeof(m_ShapeInfo));
+    m_PointerVisible = false;
+    m_PointerMoved = false;
+    X11ErrorSeen = false;
+}
@@ -0,0 +1,85 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved
+
+#ifndef _X11DUPLICATIONMANAGER_H_
+#define _X11DUPLICATIONMANAGER_H_
+
+#include "CaptureTypes.h"
+#include "FrameArena.h"
+
+// How long GetFrame waits for something to change, as long as DUPLICATIONMANAGER waits for DXGI
+#define X11_FRAME_TIMEOUT_MS 500
+
+// XFixes only reports new shapes, the pointer position is polled this often while waiting for damage
+#define X11_POINTER_POLL_MS 4
+
+// Shared memory segment of the image, the X headers stay out of this one
+struct X11_SHM;
+
+//
+// Handles the task of duplicating the screen of an X server, behind the same contract as DUPLICATIONMANAGER.
+// XDamage reports the damaged regions as dirty rects, XShm has the server copy the damaged rows straight into
+// memory shared with us and XFixes gives the cursor shape. XDamage has no notion of moves, so frames never
+// have move rects. Runs against any server with these extensions, Xvfb included, and needs no GPU. The screen
+// has to be 32 bits per pixel, which is what depth 24 gives.
+//
+// Frame and pointer times are steady clock nanoseconds. Owned by one thread.
+//
+class X11DUPLICATIONMANAGER
+{
+    public:
+        X11DUPLICATIONMANAGER();
+        ~X11DUPLICATIONMANAGER();
+        DUPL_RETURN GetFrame(FRAME_DATA* Data, FRAMEARENA* Arena, bool* Timeout);
+        DUPL_RETURN DoneWithFrame();
+        DUPL_RETURN InitDupl(const char* DisplayName);
+        DUPL_RETURN GetMouse(PTR_INFO* PtrInfo, PTR_POSITION* PtrPosition, DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY);
+        void UpdatePointerPosition(PTR_POSITION* PtrPosition, DXGI_OUTDUPL_FRAME_INFO* FrameInfo, INT OffsetX, INT OffsetY);
+        void GetDesktopCoordinates(RECT* Coordinates);
+        void Clean();
+
+    private:
+    // methods
+        bool CreateImage();
+        void ProcessEvents();
+        void QueryPointer();
+        DUPL_RETURN FetchCursorImage();
+        DUPL_RETURN FetchDamage(FRAME_DATA* Data, FRAMEARENA* Arena);
+
+    // vars
+        struct _XDisplay* m_Display;
+        unsigned long m_Root;
+        unsigned long m_Damage;
+        unsigned long m_Region;
+        int m_DamageEventBase;
+        int m_FixesEventBase;
+        UINT m_OutputNumber;
+
+        struct _XImage* m_Image;
+        X11_SHM* m_Shm;
+        SOFTWARE_SURFACE m_Frame;
+        bool m_FrameAcquired;
+
+        // Set by events until the next frame picks them up. The first frame is all damage and a new shape.
+        bool m_Damaged;
+        bool m_FullDamage;
+        bool m_ShapeChanged;
+
+        // Cursor image converted to a color shape, for GetMouse to pick up while the frame is held
+        BYTE* m_Shape;
+        UINT m_ShapeSize;
+        UINT m_ShapeCapacity;
+        DXGI_OUTDUPL_POINTER_SHAPE_INFO m_ShapeInfo;
+        bool m_ShapePending;
+
+        // Where the hot spot was last seen
+        POINT m_HotSpot;
+        bool m_PointerVisible;
+        bool m_PointerMoved;
+};
+
+#endif